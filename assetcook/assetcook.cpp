@@ -0,0 +1,504 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include <glm/glm.hpp>
+
+#include <common/objloader.hpp>
+#include <common/vboindexer.hpp>
+#include <common/tangentspace.hpp>
+#include <common/meshsimplify.hpp>
+#include <common/dds.hpp>
+#include <common/bcencode.hpp>
+#include <common/parallel.hpp>
+#include <common/cookedassets.hpp>
+
+using namespace glm;
+
+// Offline asset cooker : turns the OBJ, BMP and DDS files of an asset tree into what the runtime uploads as is.
+//   assetcook SOURCE_DIR OUTPUT_DIR [--threads N] [--force] [--bc3]
+// Outputs are named by the hash of their content. OUTPUT_DIR/cook.db remembers, per source, its hash, size and time,
+// the tool version and the settings it was cooked with : sources where none of them changed are skipped.
+// OUTPUT_DIR/manifest.txt maps the sources to their cooked file for the runtime (see loadCookedAssets).
+
+// Bumped whenever a cooked output would change for the same source and settings
+static const unsigned int COOK_TOOL_VERSION = 1;
+
+enum CookStage {
+    STAGE_HASH,
+    STAGE_PARSE,
+    STAGE_TANGENTS,
+    STAGE_INDEX,
+    STAGE_LODS,
+    STAGE_ENCODE,
+    STAGE_WRITE,
+    STAGE_COUNT
+};
+static const char * STAGE_NAMES[STAGE_COUNT] = { "hash", "parse", "tangents", "index", "lods", "encode", "write" };
+
+struct CookRecord {
+    unsigned long long sourceHash;
+    long long size, mtime;
+    unsigned int toolVersion;
+    unsigned long long settingsHash;
+    std::string output; // cooked file name, in OUTPUT_DIR
+};
+
+enum CookStatus { COOK_UP_TO_DATE, COOK_COOKED, COOK_FAILED };
+
+struct CookJob {
+    std::string source; // relative to SOURCE_DIR, '/' separated
+    bool hasRecord;
+    CookRecord record;  // from the database, then the new one
+    CookStatus status;
+    double stageMs[STAGE_COUNT];
+};
+
+struct CookSettings {
+    std::vector<float> lodRatios;
+    BCFormat bmpFormat;
+};
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start){
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static std::string extensionOf(const std::string & path){
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || path.find('/', dot) != std::string::npos)
+        return "";
+    std::string extension = path.substr(dot + 1);
+    for (size_t i=0; i<extension.size(); i++)
+        extension[i] = (char)tolower(extension[i]);
+    return extension;
+}
+
+static bool fileInfo(const std::string & path, long long & size, long long & mtime){
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return false;
+    size = (long long)info.st_size;
+    mtime = (long long)info.st_mtime;
+    return true;
+}
+
+// Names in directory, with whether each one is a directory. "." and ".." excluded.
+static void listDirectory(const std::string & directory, std::vector<std::string> & names, std::vector<bool> & directories){
+#ifdef _WIN32
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA((directory + "/*").c_str(), &data);
+    if (find == INVALID_HANDLE_VALUE)
+        return;
+    do {
+        if (strcmp(data.cFileName, ".") == 0 || strcmp(data.cFileName, "..") == 0)
+            continue;
+        names.push_back(data.cFileName);
+        directories.push_back((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    DIR * dir = opendir(directory.c_str());
+    if (dir == NULL)
+        return;
+    while (struct dirent * entry = readdir(dir)){
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+        struct stat info;
+        std::string path = directory + "/" + entry->d_name;
+        if (stat(path.c_str(), &info) != 0)
+            continue;
+        names.push_back(entry->d_name);
+        directories.push_back(S_ISDIR(info.st_mode));
+    }
+    closedir(dir);
+#endif
+}
+
+// The sources under root, hidden directories and the output directory excluded
+static void findSources(const std::string & root, const std::string & relative, const std::string & outputDir, std::vector<std::string> & sources){
+    std::string directory = relative.empty() ? root : root + "/" + relative;
+    if (directory == outputDir)
+        return;
+    std::vector<std::string> names;
+    std::vector<bool> directories;
+    listDirectory(directory, names, directories);
+    for (size_t i=0; i<names.size(); i++){
+        std::string path = relative.empty() ? names[i] : relative + "/" + names[i];
+        if (directories[i]){
+            if (names[i][0] != '.')
+                findSources(root, path, outputDir, sources);
+            continue;
+        }
+        std::string extension = extensionOf(names[i]);
+        if (extension == "obj" || extension == "bmp" || extension == "dds")
+            sources.push_back(path);
+    }
+}
+
+static bool loadDatabase(const std::string & path, std::map<std::string, CookRecord> & records){
+    FILE * file = fopen(path.c_str(), "r");
+    if (file == NULL)
+        return false;
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != NULL){
+        if (line[0] == '#')
+            continue;
+        CookRecord record;
+        char output[64];
+        int sourceStart = 0;
+        if (sscanf(line, "%llx %lld %lld %u %llx %63s %n", &record.sourceHash, &record.size, &record.mtime,
+            &record.toolVersion, &record.settingsHash, output, &sourceStart) < 6 || sourceStart == 0)
+            continue;
+        std::string source = line + sourceStart;
+        while (!source.empty() && (source[source.size() - 1] == '\n' || source[source.size() - 1] == '\r'))
+            source.erase(source.size() - 1);
+        record.output = output;
+        records[source] = record;
+    }
+    fclose(file);
+    return true;
+}
+
+// Written next to the final file, then renamed over it : an interrupted cook leaves the previous one
+static bool replaceFile(const std::string & temporary, const std::string & path){
+#ifdef _WIN32
+    remove(path.c_str());
+#endif
+    if (rename(temporary.c_str(), path.c_str()) != 0){
+        printf("%s could not be renamed to %s\n", temporary.c_str(), path.c_str());
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+static bool writeBytes(const std::string & path, const unsigned char * data, size_t size){
+    FILE * file = fopen(path.c_str(), "wb");
+    if (file == NULL){
+        printf("%s could not be created\n", path.c_str());
+        return false;
+    }
+    bool ok = fwrite(data, 1, size, file) == size;
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+        printf("%s could not be written\n", path.c_str());
+    return ok;
+}
+
+// Stores bytes under the name of their hash. Identical outputs are stored once.
+static bool storeOutput(const std::string & outputDir, const std::string & temporary, const unsigned char * data, size_t size,
+    const char * extension, std::string & name){
+    name = hashName(hashBytes(data, size)) + "." + extension;
+    std::string path = outputDir + "/" + name;
+    long long existingSize, mtime;
+    if (fileInfo(path, existingSize, mtime) && existingSize == (long long)size)
+        return true;
+    return writeBytes(temporary, data, size) && replaceFile(temporary, path);
+}
+
+// Same, for a file already written at temporary
+static bool storeFile(const std::string & outputDir, const std::string & temporary, const char * extension, std::string & name){
+    unsigned long long hash;
+    if (!hashFile(temporary.c_str(), hash)){
+        remove(temporary.c_str());
+        return false;
+    }
+    name = hashName(hash) + "." + extension;
+    std::string path = outputDir + "/" + name;
+    long long size, mtime;
+    if (fileInfo(path, size, mtime)){
+        remove(temporary.c_str());
+        return true;
+    }
+    return replaceFile(temporary, path);
+}
+
+static unsigned long long settingsHash(const std::string & extension, const CookSettings & settings){
+    unsigned long long hash = hashBytes(extension.c_str(), extension.size());
+    if (extension == "obj"){
+        hash = hashBytes(&settings.lodRatios[0], settings.lodRatios.size() * sizeof(float), hash);
+        hash = hashBytes(&COOKED_MESH_VERSION, sizeof(COOKED_MESH_VERSION), hash);
+    }
+    if (extension == "bmp")
+        hash = hashBytes(&settings.bmpFormat, sizeof(settings.bmpFormat), hash);
+    return hash;
+}
+
+// OBJ : parsed, tangent frames, indexed, LOD chain, one binary blob
+static bool cookOBJ(const std::string & path, const std::string & outputDir, const std::string & temporary,
+    const CookSettings & settings, CookJob & job){
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    std::vector<vec3> vertices;
+    std::vector<vec2> uvs;
+    std::vector<vec3> normals;
+    if (!loadOBJ(path.c_str(), vertices, uvs, normals))
+        return false;
+    job.stageMs[STAGE_PARSE] += elapsedMs(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    std::vector<vec3> tangents;
+    std::vector<vec3> bitangents;
+    computeTangentBasis(vertices, uvs, normals, tangents, bitangents);
+    job.stageMs[STAGE_TANGENTS] += elapsedMs(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    CookedMesh mesh;
+    std::vector<unsigned short> indices;
+    indexVBO_TBN(vertices, uvs, normals, tangents, bitangents, indices, mesh.vertices, mesh.uvs, mesh.normals, mesh.tangents, mesh.bitangents);
+    job.stageMs[STAGE_INDEX] += elapsedMs(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    buildLODChain(indices, mesh.vertices, settings.lodRatios, mesh.lodIndices, mesh.lods);
+    job.stageMs[STAGE_LODS] += elapsedMs(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    std::vector<unsigned char> bytes;
+    serializeCookedMesh(mesh, bytes);
+    bool ok = storeOutput(outputDir, temporary, &bytes[0], bytes.size(), "mesh", job.record.output);
+    job.stageMs[STAGE_WRITE] += elapsedMs(start);
+    return ok;
+}
+
+// BMP : mip chain encoded to BC1 or BC3
+static bool cookBMP(const std::string & path, const std::string & outputDir, const std::string & temporary,
+    const CookSettings & settings, CookJob & job){
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    unsigned int width, height;
+    std::vector<unsigned char> rgba;
+    if (!readBMP(path.c_str(), width, height, rgba))
+        return false;
+    job.stageMs[STAGE_PARSE] += elapsedMs(start);
+
+    // One thread per file : the files already keep every core busy
+    start = std::chrono::high_resolution_clock::now();
+    DDSImage image;
+    std::vector<unsigned char> data;
+    BCEncodeStats stats;
+    if (!compressImage(&rgba[0], width, height, settings.bmpFormat, 1, image, data, stats))
+        return false;
+    job.stageMs[STAGE_ENCODE] += elapsedMs(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    bool ok = writeDDS(temporary.c_str(), image, &data[0]) && storeFile(outputDir, temporary, "dds", job.record.output);
+    job.stageMs[STAGE_WRITE] += elapsedMs(start);
+    return ok;
+}
+
+// DDS : already a runtime format, validated and stored
+static bool cookDDS(const std::string & path, const std::string & outputDir, const std::string & temporary, CookJob & job){
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    MappedFile file;
+    if (!mapFile(path.c_str(), file)){
+        printf("%s could not be opened\n", path.c_str());
+        return false;
+    }
+    DDSImage image;
+    const char * error = NULL;
+    bool ok = parseDDS(file.data, file.size, image, &error);
+    if (!ok)
+        printf("%s : %s\n", path.c_str(), error);
+    job.stageMs[STAGE_PARSE] += elapsedMs(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    if (ok)
+        ok = storeOutput(outputDir, temporary, file.data, file.size, "dds", job.record.output);
+    unmapFile(file);
+    job.stageMs[STAGE_WRITE] += elapsedMs(start);
+    return ok;
+}
+
+static void cookSource(const std::string & sourceDir, const std::string & outputDir, const CookSettings & settings, bool force,
+    unsigned int index, CookJob & job){
+    std::string path = sourceDir + "/" + job.source;
+    std::string extension = extensionOf(job.source);
+    std::string temporary = outputDir + "/.cooking-" + std::to_string(index);
+    job.status = COOK_FAILED;
+    for (int s=0; s<STAGE_COUNT; s++)
+        job.stageMs[s] = 0.0;
+
+    CookRecord record;
+    record.toolVersion = COOK_TOOL_VERSION;
+    record.settingsHash = settingsHash(extension, settings);
+    if (!fileInfo(path, record.size, record.mtime)){
+        printf("%s could not be read\n", path.c_str());
+        return;
+    }
+
+    // Same tool and settings, and the output is still there : the source decides
+    long long outputSize, outputTime;
+    bool reusable = !force && job.hasRecord && job.record.toolVersion == record.toolVersion && job.record.settingsHash == record.settingsHash
+        && fileInfo(outputDir + "/" + job.record.output, outputSize, outputTime);
+    if (reusable && job.record.size == record.size && job.record.mtime == record.mtime){
+        job.status = COOK_UP_TO_DATE;
+        return;
+    }
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    if (!hashFile(path.c_str(), record.sourceHash)){
+        printf("%s could not be read\n", path.c_str());
+        return;
+    }
+    job.stageMs[STAGE_HASH] += elapsedMs(start);
+    if (reusable && job.record.sourceHash == record.sourceHash){
+        // Touched, not changed
+        job.record.size = record.size;
+        job.record.mtime = record.mtime;
+        job.status = COOK_UP_TO_DATE;
+        return;
+    }
+
+    CookRecord previous = job.record;
+    job.record = record;
+    bool ok;
+    if (extension == "obj")
+        ok = cookOBJ(path, outputDir, temporary, settings, job);
+    else if (extension == "bmp")
+        ok = cookBMP(path, outputDir, temporary, settings, job);
+    else
+        ok = cookDDS(path, outputDir, temporary, job);
+    if (ok){
+        job.status = COOK_COOKED;
+        printf("Cooked %s -> %s\n", job.source.c_str(), job.record.output.c_str());
+    }
+    else {
+        // Keep the last good output, if any, so that the runtime still has something. Its record stays too,
+        // so that the source is cooked again next time.
+        job.record = previous;
+        printf("Failed to cook %s\n", job.source.c_str());
+    }
+}
+
+// Cooked files that no source uses anymore
+static void pruneOutputs(const std::string & outputDir, const std::set<std::string> & used){
+    std::vector<std::string> names;
+    std::vector<bool> directories;
+    listDirectory(outputDir, names, directories);
+    for (size_t i=0; i<names.size(); i++){
+        std::string extension = extensionOf(names[i]);
+        bool cooked = names[i].size() == 16 + 1 + extension.size() && (extension == "mesh" || extension == "dds");
+        if (!directories[i] && cooked && used.count(names[i]) == 0){
+            remove((outputDir + "/" + names[i]).c_str());
+            printf("Removed %s\n", names[i].c_str());
+        }
+    }
+}
+
+int main(int argc, char * argv[]){
+    if (argc < 3){
+        printf("Usage : assetcook SOURCE_DIR OUTPUT_DIR [--threads N] [--force] [--bc3]\n");
+        return -1;
+    }
+    std::string sourceDir = argv[1];
+    std::string outputDir = argv[2];
+    while (sourceDir.size() > 1 && sourceDir[sourceDir.size() - 1] == '/')
+        sourceDir.erase(sourceDir.size() - 1);
+    while (outputDir.size() > 1 && outputDir[outputDir.size() - 1] == '/')
+        outputDir.erase(outputDir.size() - 1);
+    unsigned int threadCount = std::max(1u, std::thread::hardware_concurrency());
+    bool force = false;
+    CookSettings settings;
+    settings.lodRatios = { 0.5f, 0.25f, 0.125f }; // as the playground used to build them at load time
+    settings.bmpFormat = BC_FORMAT_BC1;
+    for (int i=3; i<argc; i++){
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threadCount = std::max(1, atoi(argv[++i]));
+        if (strcmp(argv[i], "--force") == 0)
+            force = true;
+        if (strcmp(argv[i], "--bc3") == 0)
+            settings.bmpFormat = BC_FORMAT_BC3;
+    }
+
+#ifdef _WIN32
+    CreateDirectoryA(outputDir.c_str(), NULL);
+#else
+    mkdir(outputDir.c_str(), 0755);
+#endif
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    std::vector<std::string> sources;
+    findSources(sourceDir, "", outputDir, sources);
+    std::sort(sources.begin(), sources.end());
+
+    std::map<std::string, CookRecord> records;
+    std::string databasePath = outputDir + "/cook.db";
+    loadDatabase(databasePath, records);
+
+    std::vector<CookJob> jobs(sources.size());
+    for (size_t i=0; i<sources.size(); i++){
+        jobs[i].source = sources[i];
+        std::map<std::string, CookRecord>::const_iterator it = records.find(sources[i]);
+        jobs[i].hasRecord = it != records.end();
+        if (jobs[i].hasRecord)
+            jobs[i].record = it->second;
+    }
+
+    // Files differ a lot in cost : each thread takes the next one
+    std::atomic<unsigned int> next(0);
+    unsigned int jobCount = (unsigned int)jobs.size();
+    parallelFor(threadCount, threadCount, [&](unsigned int, unsigned int){
+        for (unsigned int j; (j = next++) < jobCount; )
+            cookSource(sourceDir, outputDir, settings, force, j, jobs[j]);
+    });
+
+    // Database and manifest, replaced whole
+    std::set<std::string> used;
+    std::string databaseText = "# assetcook database : source hash, size, time, tool version, settings hash, output, source\n";
+    std::string manifestText;
+    unsigned int cooked = 0, upToDate = 0, failed = 0;
+    double stageMs[STAGE_COUNT] = {};
+    unsigned int stageFiles[STAGE_COUNT] = {};
+    for (size_t i=0; i<jobs.size(); i++){
+        const CookJob & job = jobs[i];
+        if (job.status == COOK_COOKED)
+            cooked++;
+        if (job.status == COOK_UP_TO_DATE)
+            upToDate++;
+        if (job.status == COOK_FAILED)
+            failed++;
+        for (int s=0; s<STAGE_COUNT; s++){
+            stageMs[s] += job.stageMs[s];
+            if (job.stageMs[s] > 0.0)
+                stageFiles[s]++;
+        }
+        if (job.record.output.empty() || (job.status == COOK_FAILED && !job.hasRecord))
+            continue;
+
+        char line[128];
+        snprintf(line, sizeof(line), "%016llx %lld %lld %u %016llx %s ", job.record.sourceHash, job.record.size, job.record.mtime,
+            job.record.toolVersion, job.record.settingsHash, job.record.output.c_str());
+        databaseText += line + job.source + "\n";
+        manifestText += job.record.output + " " + job.source + "\n";
+        used.insert(job.record.output);
+    }
+    bool ok = writeBytes(databasePath + ".tmp", (const unsigned char *)databaseText.c_str(), databaseText.size())
+        && replaceFile(databasePath + ".tmp", databasePath);
+    std::string manifestPath = outputDir + "/manifest.txt";
+    ok = ok && writeBytes(manifestPath + ".tmp", (const unsigned char *)manifestText.c_str(), manifestText.size())
+        && replaceFile(manifestPath + ".tmp", manifestPath);
+    if (ok)
+        pruneOutputs(outputDir, used);
+
+    printf("%u sources : %u cooked, %u up to date, %u failed, in %.1f ms on %u threads\n", (unsigned int)jobs.size(),
+        cooked, upToDate, failed, elapsedMs(start), threadCount);
+    for (int s=0; s<STAGE_COUNT; s++){
+        if (stageFiles[s] > 0)
+            printf("    %-8s %9.2f ms over %u files\n", STAGE_NAMES[s], stageMs[s], stageFiles[s]);
+    }
+    return ok && failed == 0 ? 0 : -1;
+}
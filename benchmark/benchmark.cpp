@@ -0,0 +1,615 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+
+#ifdef _WIN32
+#include <io.h>
+#define dup _dup
+#define dup2 _dup2
+#define close _close
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+using namespace glm;
+
+#include <common/objloader.hpp>
+#include <common/vboindexer.hpp>
+#include <common/tangentspace.hpp>
+#include <common/text2D.hpp>
+#include <common/dds.hpp>
+#include <common/quaternion_utils.hpp>
+#include <common/animation.hpp>
+#include <common/trace.hpp>
+#include <common/scenegraph.hpp>
+
+// Microbenchmarks of the common/ code, to judge optimizations against.
+//   benchmark [--filter TEXT] [--samples N] [--min-time MS] [--json FILE]
+// Every case runs on inputs of growing size : the exponent of the fit of time against size is the measured complexity.
+// A case is warmed up, then timed in samples of enough iterations to last min-time each.
+// Results are the median of the samples, with the mean and a 95% confidence interval of it.
+
+struct BenchmarkOptions {
+    const char * filter;
+    unsigned int samples;
+    double minSampleMs;
+    double warmupMs;
+};
+
+struct BenchmarkResult {
+    std::string group, name;
+    unsigned int size;           // what the case scales, in items
+    unsigned int iterations;     // per sample
+    std::vector<double> samples; // ns per iteration
+    double min, median, mean, stddev, ci95;
+};
+
+struct BenchmarkGroup {
+    std::string name;
+    double exponent; // time ~ size^exponent
+};
+
+static std::vector<BenchmarkResult> results;
+static std::vector<BenchmarkGroup> groups;
+
+// Keeps the compiler from removing a computation whose result is not used
+template <typename T>
+static void doNotOptimize(const T & value){
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void * sink;
+    sink = &value;
+#endif
+}
+
+static double nowMs(){
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+// Student's t at 97.5% for df degrees of freedom
+static double studentT(unsigned int df){
+    static const double table[] = { 0.0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060,
+        2.056, 2.052, 2.048, 2.045, 2.042 };
+    return df < sizeof(table) / sizeof(table[0]) ? table[df] : 1.96;
+}
+
+static bool selected(const BenchmarkOptions & options, const std::string & group, const std::string & name){
+    return options.filter == NULL || strstr(group.c_str(), options.filter) != NULL || strstr(name.c_str(), options.filter) != NULL;
+}
+
+static void printResult(const BenchmarkOptions & options, const BenchmarkResult & r){
+    printf("%-22s %-20s %8u %12.1f us %10.2f ns/item  +-%4.1f%%  (%u x %u)\n", r.group.c_str(), r.name.c_str(), r.size, r.median / 1000.0,
+        r.median / std::max(1u, r.size), r.mean > 0.0 ? 100.0 * r.ci95 / r.mean : 0.0, options.samples, r.iterations);
+}
+
+// Times func() : setup() runs before every call, outside of the measure, when the call consumes its input
+template <typename Setup, typename Func>
+static void runBenchmark(const BenchmarkOptions & options, const char * group, const std::string & name, unsigned int size, Setup setup, Func func){
+    if (!selected(options, group, name))
+        return;
+
+    // Warmup : caches, page faults, lazy allocations
+    double warmupEnd = nowMs() + options.warmupMs;
+    do {
+        setup();
+        func();
+    } while (nowMs() < warmupEnd);
+
+    // Enough iterations for a sample to be well above the clock resolution
+    unsigned int iterations = 1;
+    for (;;){
+        double time = 0.0;
+        for (unsigned int i=0; i<iterations; i++){
+            setup();
+            double start = nowMs();
+            func();
+            time += nowMs() - start;
+        }
+        if (time >= options.minSampleMs || iterations >= (1u << 24))
+            break;
+        iterations = time > 0.0 ? std::max(iterations * 2, (unsigned int)(iterations * options.minSampleMs * 1.2 / time)) : iterations * 16;
+    }
+
+    BenchmarkResult result;
+    result.group = group;
+    result.name = name;
+    result.size = size;
+    result.iterations = iterations;
+    for (unsigned int s=0; s<options.samples; s++){
+        double time = 0.0;
+        for (unsigned int i=0; i<iterations; i++){
+            setup();
+            double start = nowMs();
+            func();
+            time += nowMs() - start;
+        }
+        result.samples.push_back(time * 1e6 / iterations);
+    }
+
+    std::vector<double> sorted = result.samples;
+    std::sort(sorted.begin(), sorted.end());
+    size_t n = sorted.size();
+    result.min = sorted[0];
+    result.median = n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) * 0.5;
+    result.mean = 0.0;
+    for (size_t i=0; i<n; i++)
+        result.mean += sorted[i];
+    result.mean /= n;
+    double variance = 0.0;
+    for (size_t i=0; i<n; i++)
+        variance += (sorted[i] - result.mean) * (sorted[i] - result.mean);
+    result.stddev = n > 1 ? sqrt(variance / (n - 1)) : 0.0;
+    result.ci95 = n > 1 ? studentT((unsigned int)n - 1) * result.stddev / sqrt((double)n) : 0.0;
+    results.push_back(result);
+    printResult(options, result);
+}
+
+template <typename Func>
+static void runBenchmark(const BenchmarkOptions & options, const char * group, const std::string & name, unsigned int size, Func func){
+    runBenchmark(options, group, name, size, [](){}, func);
+}
+
+// Least squares slope of log(median) over log(size), for the results of a group timed since first
+static void fitComplexity(const char * group, size_t first){
+    if (results.size() - first < 2)
+        return;
+    double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+    double n = (double)(results.size() - first);
+    for (size_t i=first; i<results.size(); i++){
+        double x = log((double)results[i].size), y = log(results[i].median);
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+    }
+    double denominator = n * sxx - sx * sx;
+    if (denominator <= 0.0)
+        return;
+    BenchmarkGroup g = { group, (n * sxy - sx * sy) / denominator };
+    groups.push_back(g);
+    printf("%-22s time ~ n^%.2f\n", group, g.exponent);
+}
+
+// UV sphere as a triangle soup, like loadOBJ returns it : 2 * segments * segments triangles
+static void generateSphere(unsigned int segments, std::vector<vec3> & vertices, std::vector<vec2> & uvs, std::vector<vec3> & normals){
+    vertices.clear();
+    uvs.clear();
+    normals.clear();
+    for (unsigned int j=0; j<segments; j++){
+        for (unsigned int i=0; i<segments; i++){
+            unsigned int corners[6][2] = { { i, j }, { i + 1, j }, { i + 1, j + 1 }, { i, j }, { i + 1, j + 1 }, { i, j + 1 } };
+            for (int c=0; c<6; c++){
+                float u = corners[c][0] / (float)segments, v = corners[c][1] / (float)segments;
+                float theta = u * 6.2831853f, phi = v * 3.1415927f;
+                vec3 n = vec3(sin(phi) * cos(theta), cos(phi), sin(phi) * sin(theta));
+                vertices.push_back(n);
+                uvs.push_back(vec2(u, v));
+                normals.push_back(n);
+            }
+        }
+    }
+}
+
+// The same sphere as an OBJ file, shared positions, UVs and normals referenced by index like exporters write them
+static bool writeSphereOBJ(const char * path, unsigned int segments){
+    FILE * file = fopen(path, "w");
+    if (file == NULL)
+        return false;
+    for (unsigned int j=0; j<=segments; j++){
+        for (unsigned int i=0; i<=segments; i++){
+            float u = i / (float)segments, v = j / (float)segments;
+            float theta = u * 6.2831853f, phi = v * 3.1415927f;
+            vec3 n = vec3(sin(phi) * cos(theta), cos(phi), sin(phi) * sin(theta));
+            fprintf(file, "v %f %f %f\nvt %f %f\nvn %f %f %f\n", n.x, n.y, n.z, u, v, n.x, n.y, n.z);
+        }
+    }
+    for (unsigned int j=0; j<segments; j++){
+        for (unsigned int i=0; i<segments; i++){
+            unsigned int a = j * (segments + 1) + i + 1, b = a + 1, c = a + segments + 2, d = a + segments + 1;
+            fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+            fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, c, c, c, d, d, d);
+        }
+    }
+    return fclose(file) == 0;
+}
+
+// A BC1 2D array of 16x16 layers with all their levels, DX10 header
+static void generateDDS(unsigned int layers, std::vector<unsigned char> & bytes){
+    const unsigned int size = 16, levels = 5;
+    size_t layerBytes = 0;
+    for (unsigned int l=0; l<levels; l++)
+        layerBytes += (size_t)((std::max(1u, size >> l) + 3) / 4) * ((std::max(1u, size >> l) + 3) / 4) * 8;
+    bytes.assign(4 + 124 + 20 + layerBytes * layers, 0);
+    unsigned int header[37] = {};
+    header[0] = 124;
+    header[1] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000; // caps, height, width, pixel format, mip count
+    header[2] = size;
+    header[3] = size;
+    header[6] = levels;
+    header[18] = 32;         // pixel format size
+    header[19] = 0x4;        // four CC
+    header[20] = 0x30315844; // "DX10"
+    header[26] = 0x1000 | 0x8 | 0x400000;
+    header[31] = 71;         // DXGI_FORMAT_BC1_UNORM
+    header[32] = 3;          // 2D
+    header[34] = layers;
+    memcpy(&bytes[0], "DDS ", 4);
+    memcpy(&bytes[4], header, sizeof(header));
+}
+
+// loadOBJ prints a line per file : silenced while it is timed
+struct QuietStdout {
+    int saved;
+    QuietStdout(){
+        fflush(stdout);
+        saved = dup(fileno(stdout));
+#ifdef _WIN32
+        FILE * null = freopen("NUL", "w", stdout);
+#else
+        FILE * null = freopen("/dev/null", "w", stdout);
+#endif
+        (void)null;
+    }
+    ~QuietStdout(){
+        fflush(stdout);
+        dup2(saved, fileno(stdout));
+        close(saved);
+    }
+};
+
+static void benchmarkLoadOBJ(const BenchmarkOptions & options){
+    if (!selected(options, "loadOBJ", "sphere"))
+        return;
+    size_t first = results.size();
+    unsigned int sizes[] = { 16, 32, 64, 128 };
+    for (unsigned int s=0; s<4; s++){
+        char path[64];
+        snprintf(path, sizeof(path), "benchmark_sphere_%u.obj", sizes[s]);
+        if (!writeSphereOBJ(path, sizes[s])){
+            printf("%s could not be written\n", path);
+            return;
+        }
+        std::vector<vec3> vertices, normals;
+        std::vector<vec2> uvs;
+        unsigned int triangles = 2 * sizes[s] * sizes[s];
+        {
+            QuietStdout quiet;
+            runBenchmark(options, "loadOBJ", "sphere", triangles,
+                [&](){ vertices.clear(); uvs.clear(); normals.clear(); },
+                [&](){ loadOBJ(path, vertices, uvs, normals); doNotOptimize(vertices[0]); });
+        }
+        printResult(options, results.back());
+        remove(path);
+    }
+    fitComplexity("loadOBJ", first);
+}
+
+static void benchmarkIndexing(const BenchmarkOptions & options){
+    // indexVBO_slow and indexVBO_TBN search linearly : quadratic, so their sizes stop earlier.
+    // 128 segments is about the most 16 bits indices can address.
+    unsigned int sizes[] = { 8, 16, 32, 64, 128 };
+    const char * names[] = { "indexVBO", "indexVBO_slow", "indexVBO_TBN" };
+    unsigned int maxSizes[] = { 128, 32, 32 };
+    for (int f=0; f<3; f++){
+        size_t first = results.size();
+        for (unsigned int s=0; s<5 && sizes[s]<=maxSizes[f]; s++){
+            std::vector<vec3> vertices, normals, tangents, bitangents;
+            std::vector<vec2> uvs;
+            generateSphere(sizes[s], vertices, uvs, normals);
+            if (f == 2)
+                computeTangentBasis(vertices, uvs, normals, tangents, bitangents);
+            std::vector<unsigned short> indices;
+            std::vector<vec3> outVertices, outNormals, outTangents, outBitangents;
+            std::vector<vec2> outUVs;
+            runBenchmark(options, names[f], "sphere", (unsigned int)vertices.size(),
+                [&](){ indices.clear(); outVertices.clear(); outUVs.clear(); outNormals.clear(); outTangents.clear(); outBitangents.clear(); },
+                [&](){
+                    if (f == 0)
+                        indexVBO(vertices, uvs, normals, indices, outVertices, outUVs, outNormals);
+                    if (f == 1)
+                        indexVBO_slow(vertices, uvs, normals, indices, outVertices, outUVs, outNormals);
+                    if (f == 2)
+                        indexVBO_TBN(vertices, uvs, normals, tangents, bitangents, indices, outVertices, outUVs, outNormals, outTangents, outBitangents);
+                    doNotOptimize(indices[0]);
+                });
+        }
+        fitComplexity(names[f], first);
+    }
+}
+
+static void benchmarkTangents(const BenchmarkOptions & options){
+    size_t first = results.size();
+    unsigned int sizes[] = { 16, 64, 256 };
+    for (unsigned int s=0; s<3; s++){
+        std::vector<vec3> vertices, normals, tangents, bitangents;
+        std::vector<vec2> uvs;
+        generateSphere(sizes[s], vertices, uvs, normals);
+        runBenchmark(options, "computeTangentBasis", "sphere", (unsigned int)vertices.size(),
+            [&](){ tangents.clear(); bitangents.clear(); },
+            [&](){ computeTangentBasis(vertices, uvs, normals, tangents, bitangents); doNotOptimize(tangents[0]); });
+    }
+    fitComplexity("computeTangentBasis", first);
+}
+
+static void benchmarkText(const BenchmarkOptions & options){
+    size_t first = results.size();
+    unsigned int lengths[] = { 16, 256, 4096, 65536 };
+    for (unsigned int s=0; s<4; s++){
+        std::string text(lengths[s], ' ');
+        for (unsigned int i=0; i<lengths[s]; i++)
+            text[i] = (char)(32 + i % 95);
+        std::vector<vec2> vertices(lengths[s] * 6), uvs(lengths[s] * 6);
+        runBenchmark(options, "buildText2DQuads", "characters", lengths[s],
+            [&](){ buildText2DQuads(text.c_str(), lengths[s], 50, 50, 20, &vertices[0], &uvs[0]); doNotOptimize(vertices[0]); });
+    }
+    fitComplexity("buildText2DQuads", first);
+}
+
+static void benchmarkDDS(const BenchmarkOptions & options){
+    size_t first = results.size();
+    unsigned int layers[] = { 1, 16, 256, 2048 };
+    for (unsigned int s=0; s<4; s++){
+        std::vector<unsigned char> bytes;
+        generateDDS(layers[s], bytes);
+        DDSImage image;
+        const char * error = NULL;
+        if (!parseDDS(&bytes[0], bytes.size(), image, &error)){
+            printf("Generated DDS rejected : %s\n", error);
+            return;
+        }
+        // The surface table grows with the layers : that is what is scaled
+        unsigned int surfaces = (unsigned int)image.surfaces.size();
+        runBenchmark(options, "parseDDS", "BC1 array surfaces", surfaces,
+            [&](){ parseDDS(&bytes[0], bytes.size(), image, &error); doNotOptimize(image.surfaces[0]); });
+    }
+    fitComplexity("parseDDS", first);
+}
+
+static void benchmarkQuaternions(const BenchmarkOptions & options){
+    unsigned int sizes[] = { 1024, 16384, 262144 };
+    const char * names[] = { "RotationBetweenVectors", "LookAt", "RotateTowards" };
+    for (int f=0; f<3; f++){
+        size_t first = results.size();
+        for (unsigned int s=0; s<3; s++){
+            std::vector<vec3> a(sizes[s]), b(sizes[s]);
+            std::vector<quat> qa(sizes[s]), qb(sizes[s]), out(sizes[s]);
+            srand(1);
+            for (unsigned int i=0; i<sizes[s]; i++){
+                a[i] = normalize(vec3(rand() / (float)RAND_MAX - 0.5f, rand() / (float)RAND_MAX - 0.5f, rand() / (float)RAND_MAX - 0.5f) + vec3(0.0f, 0.0f, 1e-3f));
+                b[i] = normalize(vec3(rand() / (float)RAND_MAX - 0.5f, rand() / (float)RAND_MAX - 0.5f, rand() / (float)RAND_MAX - 0.5f) + vec3(1e-3f, 0.0f, 0.0f));
+                qa[i] = normalize(quat(rand() / (float)RAND_MAX, a[i]));
+                qb[i] = normalize(quat(rand() / (float)RAND_MAX, b[i]));
+            }
+            runBenchmark(options, names[f], "random", sizes[s], [&](){
+                for (unsigned int i=0; i<sizes[s]; i++){
+                    if (f == 0)
+                        out[i] = RotationBetweenVectors(a[i], b[i]);
+                    if (f == 1)
+                        out[i] = LookAt(a[i], b[i]);
+                    if (f == 2)
+                        out[i] = RotateTowards(qa[i], qb[i], 0.1f);
+                }
+                doNotOptimize(out[0]);
+            });
+        }
+        fitComplexity(names[f], first);
+    }
+}
+
+// Bones swinging around their own axis at their own rate, on top of a fixed offset, the root walking forward.
+// Most translation and scale tracks are constant, like in a skinned character.
+static void generateAnimationClip(unsigned int boneCount, unsigned int frameCount, RawAnimationClip & clip){
+    clip.framesPerSecond = 30.0f;
+    clip.frameCount = frameCount;
+    clip.boneCount = boneCount;
+    clip.rotations.resize(boneCount * frameCount);
+    clip.translations.resize(boneCount * frameCount);
+    clip.scales.resize(boneCount * frameCount);
+    srand(1);
+    for (unsigned int bone=0; bone<boneCount; bone++){
+        vec3 axis = normalize(vec3(rand() / (float)RAND_MAX - 0.5f, rand() / (float)RAND_MAX - 0.5f, rand() / (float)RAND_MAX - 0.5f) + vec3(0.0f, 1e-3f, 0.0f));
+        float rate = 0.5f + 2.0f * rand() / (float)RAND_MAX, phase = 6.2831853f * rand() / (float)RAND_MAX;
+        vec3 offset = vec3(0.0f, 0.1f * (bone % 8), 0.05f * (bone / 8));
+        for (unsigned int f=0; f<frameCount; f++){
+            float t = f / clip.framesPerSecond;
+            unsigned int i = bone * frameCount + f;
+            clip.rotations[i] = angleAxis(0.8f * sin(rate * t + phase), axis);
+            clip.translations[i] = bone == 0 ? vec3(0.0f, 0.0f, 1.5f * t) : offset;
+            clip.scales[i] = vec3(1.0f);
+        }
+    }
+}
+
+// Playing a 10 s clip forward at 60 Hz, from the compressed stream and from the raw keys. Sizes are bone counts,
+// per item times are per bone and sample. printAnimationClipStats gives the ratio and the error of each clip.
+static void benchmarkAnimation(const BenchmarkOptions & options){
+    unsigned int sizes[] = { 16, 64, 256 };
+    const unsigned int frames = 300;
+    const AnimationCompressionSettings settings = { 0.001f, 0.001f, 0.001f };
+    const char * names[] = { "compressAnimationClip", "sampleAnimationClip", "sample raw clip" };
+    for (int f=0; f<3; f++){
+        size_t first = results.size();
+        for (unsigned int s=0; s<3; s++){
+            RawAnimationClip raw;
+            generateAnimationClip(sizes[s], frames, raw);
+            CompressedAnimationClip compressed;
+            compressAnimationClip(raw, settings, compressed);
+            if (f == 1 && selected(options, names[f], "60 Hz"))
+                printAnimationClipStats(raw, compressed);
+
+            float duration = (frames - 1) / raw.framesPerSecond;
+            unsigned int samples = (unsigned int)(duration * 60.0f) + 1;
+            AnimationCursor cursor;
+            std::vector<BonePose> poses(sizes[s]);
+            if (f == 0){
+                runBenchmark(options, names[f], "bones", sizes[s],
+                    [&](){ compressAnimationClip(raw, settings, compressed); doNotOptimize(compressed.keys[0]); });
+                continue;
+            }
+            runBenchmark(options, names[f], "60 Hz", sizes[s] * samples, [&](){
+                for (unsigned int i=0; i<samples; i++){
+                    float time = i / 60.0f;
+                    if (f == 1){
+                        sampleAnimationClip(compressed, cursor, time, poses);
+                        continue;
+                    }
+                    // Linear keys, bone-major like the importer gives them
+                    float frame = std::min(time * raw.framesPerSecond, (float)(frames - 1));
+                    unsigned int f0 = std::min((unsigned int)frame, frames - 2);
+                    float t = frame - f0;
+                    for (unsigned int bone=0; bone<sizes[s]; bone++){
+                        unsigned int k = bone * frames + f0;
+                        poses[bone].rotation = normalize(lerp(raw.rotations[k], raw.rotations[k + 1], t));
+                        poses[bone].translation = mix(raw.translations[k], raw.translations[k + 1], t);
+                        poses[bone].scale = mix(raw.scales[k], raw.scales[k + 1], t);
+                    }
+                }
+                doNotOptimize(poses[0]);
+            });
+        }
+        fitComplexity(names[f], first);
+    }
+}
+
+// The cost of an empty zone : its whole overhead, with tracing off and on (the ring buffer wrapping around)
+static void benchmarkTrace(const BenchmarkOptions & options){
+    unsigned int sizes[] = { 256, 4096 };
+    initTrace();
+    for (int enabled=0; enabled<2; enabled++){
+        setTraceEnabled(enabled != 0);
+        size_t first = results.size();
+        const char * group = enabled ? "TRACE_ZONE enabled" : "TRACE_ZONE disabled";
+        for (unsigned int s=0; s<2; s++){
+            runBenchmark(options, group, "empty zones", sizes[s], [&](){
+                for (unsigned int i=0; i<sizes[s]; i++){
+                    TRACE_ZONE("benchmark");
+                }
+            });
+        }
+        fitComplexity(group, first);
+    }
+    cleanupTrace();
+}
+
+// A deep random hierarchy : each node goes 0 to 3 levels up from the previous one, then down one
+static void buildSceneGraph(SceneGraph & graph, unsigned int size, std::vector<unsigned int> & roots){
+    initSceneGraph(graph, size);
+    roots.clear();
+    std::vector<int> path;
+    srand(1);
+    for (unsigned int i=0; i<size; i++){
+        for (int up=rand() % 4; up>0 && !path.empty(); up--)
+            path.pop_back();
+        if (path.size() >= 64)
+            path.pop_back();
+        int parent = path.empty() ? -1 : path.back();
+        vec3 position(rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX);
+        quat rotation = normalize(quat(1.0f, rand() / (float)RAND_MAX - 0.5f, rand() / (float)RAND_MAX - 0.5f, rand() / (float)RAND_MAX - 0.5f));
+        int node = addSceneNode(graph, parent, position, rotation, vec3(1.0f));
+        if (parent == -1)
+            roots.push_back(node);
+        path.push_back(node);
+    }
+    updateSceneGraph(graph, 1);
+}
+
+// World matrices : all of them with plain glm, all of them from dirty roots, and 1% of the nodes moved
+static void benchmarkSceneGraph(const BenchmarkOptions & options){
+    unsigned int sizes[] = { 100000, 1000000 };
+    unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    const char * names[] = { "scene graph naive", "scene graph 1 thread", "scene graph threads", "scene graph 1% dirty" };
+    for (int f=0; f<4; f++){
+        size_t first = results.size();
+        for (unsigned int s=0; s<2; s++){
+            SceneGraph graph;
+            std::vector<unsigned int> roots;
+            buildSceneGraph(graph, sizes[s], roots);
+            runBenchmark(options, names[f], f == 3 ? "random nodes" : "all nodes", sizes[s], [&](){
+                if (f == 1 || f == 2){
+                    for (size_t r=0; r<roots.size(); r++)
+                        setSceneNodePosition(graph, roots[r], graph.positions[roots[r]]);
+                }
+                if (f == 3){
+                    for (unsigned int i=0; i<sizes[s]/100; i++){
+                        unsigned int node = (unsigned int)(((unsigned long long)rand() * RAND_MAX + rand()) % sizes[s]);
+                        setSceneNodePosition(graph, node, graph.positions[node]);
+                    }
+                }
+            }, [&](){
+                if (f == 0)
+                    updateSceneGraphNaive(graph);
+                else
+                    updateSceneGraph(graph, f == 1 ? 1 : threads);
+                doNotOptimize(graph.worlds[sizes[s] - 1]);
+            });
+        }
+        fitComplexity(names[f], first);
+    }
+}
+
+static void writeJSON(const char * path, const BenchmarkOptions & options){
+    FILE * file = fopen(path, "w");
+    if (file == NULL){
+        printf("%s could not be written\n", path);
+        return;
+    }
+    fprintf(file, "{\n  \"samples\": %u,\n  \"min_sample_ms\": %.3f,\n  \"warmup_ms\": %.3f,\n  \"benchmarks\": [\n",
+        options.samples, options.minSampleMs, options.warmupMs);
+    for (size_t i=0; i<results.size(); i++){
+        const BenchmarkResult & r = results[i];
+        fprintf(file, "    {\"group\": \"%s\", \"name\": \"%s\", \"size\": %u, \"iterations\": %u, "
+            "\"min_ns\": %.3f, \"median_ns\": %.3f, \"mean_ns\": %.3f, \"stddev_ns\": %.3f, \"ci95_ns\": %.3f, \"ns_per_item\": %.4f, \"samples_ns\": [",
+            r.group.c_str(), r.name.c_str(), r.size, r.iterations, r.min, r.median, r.mean, r.stddev, r.ci95, r.median / std::max(1u, r.size));
+        for (size_t s=0; s<r.samples.size(); s++)
+            fprintf(file, "%s%.3f", s ? ", " : "", r.samples[s]);
+        fprintf(file, "]}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ],\n  \"complexity\": [\n");
+    for (size_t i=0; i<groups.size(); i++){
+        fprintf(file, "    {\"group\": \"%s\", \"exponent\": %.3f}%s\n", groups[i].name.c_str(), groups[i].exponent, i + 1 < groups.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    printf("Results written to %s\n", path);
+}
+
+int main(int argc, char * argv[]){
+    BenchmarkOptions options = { NULL, 15, 20.0, 50.0 };
+    const char * jsonPath = NULL;
+    for (int i=1; i+1<argc; i++){
+        if (strcmp(argv[i], "--filter") == 0)
+            options.filter = argv[i + 1];
+        if (strcmp(argv[i], "--samples") == 0)
+            options.samples = std::max(2, atoi(argv[i + 1]));
+        if (strcmp(argv[i], "--min-time") == 0)
+            options.minSampleMs = std::max(0.1, atof(argv[i + 1]));
+        if (strcmp(argv[i], "--json") == 0)
+            jsonPath = argv[i + 1];
+    }
+
+    printf("%-22s %-20s %8s %15s %18s\n", "group", "case", "size", "median", "per item");
+    benchmarkLoadOBJ(options);
+    benchmarkIndexing(options);
+    benchmarkTangents(options);
+    benchmarkText(options);
+    benchmarkDDS(options);
+    benchmarkQuaternions(options);
+    benchmarkAnimation(options);
+    benchmarkTrace(options);
+    benchmarkSceneGraph(options);
+
+    if (jsonPath != NULL)
+        writeJSON(jsonPath, options);
+    return 0;
+}
@@ -0,0 +1,333 @@
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "animation.hpp"
+
+// Compression works on three kinds of tracks per bone.
+// Every value is handled as a vec4 : quaternions as (x,y,z,w), vectors as (x,y,z,0).
+enum { CHANNEL_ROTATION = 0, CHANNEL_TRANSLATION = 1, CHANNEL_SCALE = 2, CHANNEL_COUNT = 3 };
+
+static const float SQRT2 = 1.41421356f;
+
+// "Smallest three" : drop the largest component of the quaternion (it can be rebuilt since |q| = 1),
+// and store the 3 others on 15 bits each. 2 bits for the index of the dropped one : 47 bits total.
+static void packRotation(const glm::vec4 & q, unsigned short data[3]){
+    int largest = 0;
+    for (int i=1; i<4; i++){
+        if (fabs(q[i]) > fabs(q[largest]))
+            largest = i;
+    }
+    // q and -q are the same rotation : make the dropped component positive
+    float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+
+    unsigned long long bits = largest;
+    for (int i=0; i<4; i++){
+        if (i == largest)
+            continue;
+        // The 3 smallest components are in [-1/sqrt(2), 1/sqrt(2)]
+        float v = glm::clamp(q[i] * sign * SQRT2 * 0.5f + 0.5f, 0.0f, 1.0f);
+        bits = (bits << 15) | (unsigned long long)(v * 32767.0f + 0.5f);
+    }
+    data[0] = (unsigned short)(bits >> 32);
+    data[1] = (unsigned short)(bits >> 16);
+    data[2] = (unsigned short)(bits);
+}
+
+static glm::vec4 unpackRotation(const unsigned short data[3]){
+    unsigned long long bits = ((unsigned long long)data[0] << 32) | ((unsigned long long)data[1] << 16) | data[2];
+    int largest = (int)(bits >> 45) & 3;
+
+    glm::vec4 q;
+    float sum = 0.0f;
+    int shift = 30;
+    for (int i=0; i<4; i++){
+        if (i == largest)
+            continue;
+        float v = ((bits >> shift) & 0x7FFF) / 32767.0f;
+        q[i] = (v * 2.0f - 1.0f) / SQRT2;
+        sum += q[i] * q[i];
+        shift -= 15;
+    }
+    q[largest] = sqrt(std::max(0.0f, 1.0f - sum));
+    return q;
+}
+
+static void packVector(const glm::vec4 & v, const glm::vec3 & rangeMin, const glm::vec3 & rangeExtent, unsigned short data[3]){
+    for (int i=0; i<3; i++){
+        float n = rangeExtent[i] > 0.0f ? (v[i] - rangeMin[i]) / rangeExtent[i] : 0.0f;
+        data[i] = (unsigned short)(glm::clamp(n, 0.0f, 1.0f) * 65535.0f + 0.5f);
+    }
+}
+
+static glm::vec4 unpackVector(const unsigned short data[3], const glm::vec3 & rangeMin, const glm::vec3 & rangeExtent){
+    glm::vec3 n = glm::vec3(data[0], data[1], data[2]) / 65535.0f;
+    return glm::vec4(rangeMin + n * rangeExtent, 0.0f);
+}
+
+static glm::vec4 rawValue(const RawAnimationClip & clip, unsigned int bone, int channel, unsigned int frame){
+    unsigned int i = bone * clip.frameCount + frame;
+    if (channel == CHANNEL_ROTATION){
+        const glm::quat & q = clip.rotations[i];
+        return glm::vec4(q.x, q.y, q.z, q.w);
+    }
+    if (channel == CHANNEL_TRANSLATION)
+        return glm::vec4(clip.translations[i], 0.0f);
+    return glm::vec4(clip.scales[i], 0.0f);
+}
+
+// Linear interpolation for vectors, normalized lerp for rotations.
+// Both keys of a rotation pair are in the same hemisphere (see shiftWindow / compressAnimationClip).
+static glm::vec4 interpolate(int channel, const glm::vec4 & a, const glm::vec4 & b, float t){
+    glm::vec4 v = a + (b - a) * t;
+    if (channel == CHANNEL_ROTATION)
+        v = glm::normalize(v);
+    return v;
+}
+
+static float keyError(int channel, const glm::vec4 & a, const glm::vec4 & b){
+    if (channel == CHANNEL_ROTATION){
+        // Angle of the rotation between a and b. |a-b| = 2 sin(angle/4) is more precise than acos(dot) near 0.
+        glm::vec4 d = glm::dot(a, b) < 0.0f ? a + b : a - b;
+        return 4.0f * asin(std::min(1.0f, glm::length(d) * 0.5f));
+    }
+    if (channel == CHANNEL_TRANSLATION)
+        return glm::length(glm::vec3(a - b));
+    glm::vec3 d = glm::abs(glm::vec3(a - b));
+    return std::max(d.x, std::max(d.y, d.z));
+}
+
+static glm::vec4 decodeKey(const CompressedAnimationClip & clip, const PackedAnimationKey & key){
+    if (key.track % CHANNEL_COUNT == CHANNEL_ROTATION)
+        return unpackRotation(key.data);
+    return unpackVector(key.data, clip.rangeMin[key.track], clip.rangeExtent[key.track]);
+}
+
+void compressAnimationClip(
+    const RawAnimationClip & in_clip,
+    const AnimationCompressionSettings & settings,
+    CompressedAnimationClip & out_clip
+){
+    unsigned int trackCount = in_clip.boneCount * CHANNEL_COUNT;
+    if (in_clip.frameCount == 0 || in_clip.frameCount > 65535 || trackCount > 65535){
+        printf("Animation clip is too big to be compressed (%u frames, %u bones)\n", in_clip.frameCount, in_clip.boneCount);
+        return;
+    }
+
+    out_clip.framesPerSecond = in_clip.framesPerSecond;
+    out_clip.frameCount = in_clip.frameCount;
+    out_clip.boneCount = in_clip.boneCount;
+    out_clip.rangeMin.assign(trackCount, glm::vec3(0.0f));
+    out_clip.rangeExtent.assign(trackCount, glm::vec3(0.0f));
+    out_clip.keys.clear();
+
+    const float tolerances[CHANNEL_COUNT] = {
+        settings.rotationTolerance, settings.translationTolerance, settings.scaleTolerance
+    };
+
+    // Keys of all tracks, with the frame at which the sampler will need them
+    struct StreamKey {
+        int need;
+        PackedAnimationKey key;
+    };
+    std::vector<StreamKey> stream;
+
+    std::vector<glm::vec4> values(in_clip.frameCount);
+    std::vector<glm::vec4> quantized(in_clip.frameCount);
+    std::vector<unsigned short> kept;
+
+    for (unsigned int track=0; track<trackCount; track++){
+        unsigned int bone = track / CHANNEL_COUNT;
+        int channel = track % CHANNEL_COUNT;
+
+        for (unsigned int f=0; f<in_clip.frameCount; f++){
+            values[f] = rawValue(in_clip, bone, channel, f);
+            // Keep consecutive rotations in the same hemisphere, so that nlerp takes the short path
+            if (channel == CHANNEL_ROTATION && f > 0 && glm::dot(values[f], values[f-1]) < 0.0f)
+                values[f] = -values[f];
+        }
+
+        // Range of the track, for 16 bits quantization
+        if (channel != CHANNEL_ROTATION){
+            glm::vec3 lo = glm::vec3(values[0]);
+            glm::vec3 hi = lo;
+            for (unsigned int f=1; f<in_clip.frameCount; f++){
+                lo = glm::min(lo, glm::vec3(values[f]));
+                hi = glm::max(hi, glm::vec3(values[f]));
+            }
+            out_clip.rangeMin[track] = lo;
+            out_clip.rangeExtent[track] = hi - lo;
+        }
+
+        // Error is measured on the values the sampler will actually see, i.e. after quantization
+        std::vector<PackedAnimationKey> packed(in_clip.frameCount);
+        for (unsigned int f=0; f<in_clip.frameCount; f++){
+            packed[f].track = (unsigned short)track;
+            packed[f].frame = (unsigned short)f;
+            if (channel == CHANNEL_ROTATION)
+                packRotation(values[f], packed[f].data);
+            else
+                packVector(values[f], out_clip.rangeMin[track], out_clip.rangeExtent[track], packed[f].data);
+            quantized[f] = decodeKey(out_clip, packed[f]);
+            if (channel == CHANNEL_ROTATION && glm::dot(quantized[f], values[f]) < 0.0f)
+                quantized[f] = -quantized[f];
+        }
+
+        // Greedy keyframe reduction : from key a, extend the span as long as
+        // interpolating between a and b stays within tolerance for every frame in between.
+        kept.clear();
+        kept.push_back(0);
+        unsigned int a = 0;
+        unsigned int last = in_clip.frameCount - 1;
+        while (a < last){
+            unsigned int b = a + 1;
+            while (b + 1 <= last){
+                unsigned int candidate = b + 1;
+                bool fits = true;
+                for (unsigned int f=a+1; f<candidate && fits; f++){
+                    float t = float(f - a) / float(candidate - a);
+                    glm::vec4 v = interpolate(channel, quantized[a], quantized[candidate], t);
+                    fits = keyError(channel, v, values[f]) <= tolerances[channel];
+                }
+                if (!fits)
+                    break;
+                b = candidate;
+            }
+            kept.push_back((unsigned short)b);
+            a = b;
+        }
+        // Single frame clips : the sampler always wants a pair of keys
+        if (kept.size() == 1)
+            kept.push_back(0);
+
+        // The first two keys are needed right away, key i is needed when the time passes key i-1
+        for (unsigned int k=0; k<kept.size(); k++){
+            StreamKey sk;
+            sk.need = k < 2 ? -1 : kept[k-1];
+            sk.key = packed[kept[k]];
+            stream.push_back(sk);
+        }
+    }
+
+    // Sort by the frame at which they are needed. Stable, so that key 0 stays before key 1.
+    std::stable_sort(stream.begin(), stream.end(), [](const StreamKey & a, const StreamKey & b){
+        if (a.need != b.need)
+            return a.need < b.need;
+        return a.key.track < b.key.track;
+    });
+
+    out_clip.keys.reserve(stream.size());
+    for (unsigned int i=0; i<stream.size(); i++)
+        out_clip.keys.push_back(stream[i].key);
+}
+
+// The next key of a track becomes the previous one, "key" becomes the next one
+static void shiftWindow(const CompressedAnimationClip & clip, AnimationTrackWindow & window, const PackedAnimationKey & key){
+    window.frame0 = window.frame1;
+    window.value0 = window.value1;
+    window.frame1 = key.frame;
+    window.value1 = decodeKey(clip, key);
+    if (key.track % CHANNEL_COUNT == CHANNEL_ROTATION && glm::dot(window.value0, window.value1) < 0.0f)
+        window.value1 = -window.value1;
+}
+
+void resetAnimationCursor(const CompressedAnimationClip & clip, AnimationCursor & cursor){
+    unsigned int trackCount = clip.boneCount * CHANNEL_COUNT;
+    cursor.frame = 0.0f;
+    cursor.windows.assign(trackCount, AnimationTrackWindow());
+
+    // The stream starts with the first two keys of every track
+    cursor.next = std::min((unsigned int)clip.keys.size(), trackCount * 2);
+    for (unsigned int i=0; i<cursor.next; i++){
+        const PackedAnimationKey & key = clip.keys[i];
+        shiftWindow(clip, cursor.windows[key.track], key);
+    }
+}
+
+void sampleAnimationClip(
+    const CompressedAnimationClip & clip,
+    AnimationCursor & cursor,
+    float time,
+    std::vector<BonePose> & out_poses
+){
+    float frame = glm::clamp(time * clip.framesPerSecond, 0.0f, float(clip.frameCount - 1));
+
+    // Going backwards (or looping) : start again from the beginning of the stream
+    if (frame < cursor.frame || cursor.windows.size() != clip.boneCount * CHANNEL_COUNT)
+        resetAnimationCursor(clip, cursor);
+    cursor.frame = frame;
+
+    // Forward scan : the key at the head of the stream is needed as soon as
+    // the time passes the current "next" key of its track.
+    unsigned int keyCount = (unsigned int)clip.keys.size();
+    while (cursor.next < keyCount){
+        const PackedAnimationKey & key = clip.keys[cursor.next];
+        AnimationTrackWindow & window = cursor.windows[key.track];
+        if (window.frame1 > frame)
+            break;
+        shiftWindow(clip, window, key);
+        cursor.next++;
+    }
+
+    out_poses.resize(clip.boneCount);
+    for (unsigned int bone=0; bone<clip.boneCount; bone++){
+        glm::vec4 v[CHANNEL_COUNT];
+        for (int channel=0; channel<CHANNEL_COUNT; channel++){
+            const AnimationTrackWindow & window = cursor.windows[bone * CHANNEL_COUNT + channel];
+            float span = window.frame1 - window.frame0;
+            float t = span > 0.0f ? (frame - window.frame0) / span : 0.0f;
+            v[channel] = interpolate(channel, window.value0, window.value1, t);
+        }
+        out_poses[bone].rotation = glm::quat(v[0].w, v[0].x, v[0].y, v[0].z);
+        out_poses[bone].translation = glm::vec3(v[1]);
+        out_poses[bone].scale = glm::vec3(v[2]);
+    }
+}
+
+void printAnimationClipStats(const RawAnimationClip & raw, const CompressedAnimationClip & compressed){
+    size_t rawBytes = (size_t)raw.boneCount * raw.frameCount * (sizeof(glm::quat) + 2 * sizeof(glm::vec3));
+    size_t compressedBytes = compressed.keys.size() * sizeof(PackedAnimationKey)
+                           + compressed.rangeMin.size() * 2 * sizeof(glm::vec3);
+
+    // Max error, measured on every frame
+    AnimationCursor cursor;
+    resetAnimationCursor(compressed, cursor);
+    std::vector<BonePose> poses;
+    float maxRotation = 0.0f, maxTranslation = 0.0f, maxScale = 0.0f;
+    for (unsigned int f=0; f<raw.frameCount; f++){
+        sampleAnimationClip(compressed, cursor, f / raw.framesPerSecond, poses);
+        for (unsigned int bone=0; bone<raw.boneCount; bone++){
+            unsigned int i = bone * raw.frameCount + f;
+            const glm::quat & q = poses[bone].rotation;
+            maxRotation    = std::max(maxRotation,    keyError(CHANNEL_ROTATION, glm::vec4(q.x, q.y, q.z, q.w), rawValue(raw, bone, CHANNEL_ROTATION, f)));
+            maxTranslation = std::max(maxTranslation, glm::length(poses[bone].translation - raw.translations[i]));
+            glm::vec3 ds = glm::abs(poses[bone].scale - raw.scales[i]);
+            maxScale       = std::max(maxScale, std::max(ds.x, std::max(ds.y, ds.z)));
+        }
+    }
+
+    // Sampling cost : play the clip at 60 Hz a few times, like the game would
+    float duration = (raw.frameCount - 1) / raw.framesPerSecond;
+    unsigned int loops = 8;
+    unsigned int samples = 0;
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    for (unsigned int l=0; l<loops; l++){
+        for (float t=0.0f; t<=duration; t+=1.0f/60.0f){
+            sampleAnimationClip(compressed, cursor, t, poses);
+            samples++;
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+
+    printf("Animation clip : %u bones, %u frames\n", raw.boneCount, raw.frameCount);
+    printf("  %u keys kept out of %u (%.1f%%)\n", (unsigned int)compressed.keys.size(), raw.boneCount * raw.frameCount * CHANNEL_COUNT,
+        100.0 * compressed.keys.size() / std::max(1u, raw.boneCount * raw.frameCount * CHANNEL_COUNT));
+    printf("  %u bytes -> %u bytes (ratio %.1f:1)\n", (unsigned int)rawBytes, (unsigned int)compressedBytes, double(rawBytes) / std::max<size_t>(1, compressedBytes));
+    printf("  max error : rotation %f rad, translation %f, scale %f\n", maxRotation, maxTranslation, maxScale);
+    printf("  sampling : %.1f ns per bone\n", ns / std::max(1u, samples) / std::max(1u, raw.boneCount));
+}
@@ -0,0 +1,85 @@
+#ifndef ANIMATION_HPP
+#define ANIMATION_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Uncompressed clip, as it comes out of the importer : one key per frame for every bone.
+// Keys are stored bone-major : [bone * frameCount + frame]
+struct RawAnimationClip {
+    float framesPerSecond;
+    unsigned int frameCount;
+    unsigned int boneCount;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> translations;
+    std::vector<glm::vec3> scales;
+};
+
+// Maximum error allowed when dropping keys (quantization included)
+struct AnimationCompressionSettings {
+    float rotationTolerance;    // radians
+    float translationTolerance; // units
+    float scaleTolerance;
+};
+
+// One key of the interleaved stream : 10 bytes.
+// Rotations are stored "smallest three" in 48 bits,
+// translations and scales are 16 bits per component inside the range of their track.
+struct PackedAnimationKey {
+    unsigned short track; // bone * 3 + channel (0 : rotation, 1 : translation, 2 : scale)
+    unsigned short frame;
+    unsigned short data[3];
+};
+
+// Keys of all tracks are sorted by the time at which the sampler needs them,
+// so sampling the whole skeleton at increasing times is one forward scan of "keys".
+struct CompressedAnimationClip {
+    float framesPerSecond;
+    unsigned int frameCount;
+    unsigned int boneCount;
+    std::vector<glm::vec3> rangeMin;    // per track, unused for rotations
+    std::vector<glm::vec3> rangeExtent; // per track, unused for rotations
+    std::vector<PackedAnimationKey> keys;
+};
+
+// Decoded keys surrounding the current time, one pair per track
+struct AnimationTrackWindow {
+    float frame0, frame1;
+    glm::vec4 value0, value1;
+};
+
+// Sampling state, kept by the caller from one frame to the next
+struct AnimationCursor {
+    float frame;       // position of the last sample, in frames
+    unsigned int next; // next key to read in the stream
+    std::vector<AnimationTrackWindow> windows;
+};
+
+struct BonePose {
+    glm::quat rotation;
+    glm::vec3 translation;
+    glm::vec3 scale;
+};
+
+void compressAnimationClip(
+    const RawAnimationClip & in_clip,
+    const AnimationCompressionSettings & settings,
+    CompressedAnimationClip & out_clip
+);
+
+// Rewinds the cursor to the start of the clip
+void resetAnimationCursor(const CompressedAnimationClip & clip, AnimationCursor & cursor);
+
+// Samples all bones at "time" (in seconds). Going backwards rewinds the cursor.
+void sampleAnimationClip(
+    const CompressedAnimationClip & clip,
+    AnimationCursor & cursor,
+    float time,
+    std::vector<BonePose> & out_poses
+);
+
+// Prints the compression ratio, the max error and the sampling cost per bone
+void printAnimationClipStats(const RawAnimationClip & raw, const CompressedAnimationClip & compressed);
+
+#endif
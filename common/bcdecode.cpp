@@ -0,0 +1,350 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+// SSE2 is always there on x86-64. Other targets use the reference path.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BCDECODE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "parallel.hpp"
+#include "bcdecode.hpp"
+
+static const unsigned int BLOCK_BYTES[5] = { 8, 16, 16, 8, 16 };
+
+bool bcFormatFromGL(GLenum internalFormat, BCFormat & format){
+    switch (internalFormat){
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT: format = BC_FORMAT_BC1; return true;
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT: format = BC_FORMAT_BC2; return true;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT: format = BC_FORMAT_BC3; return true;
+    case GL_COMPRESSED_RED_RGTC1:                format = BC_FORMAT_BC4; return true;
+    case GL_COMPRESSED_RG_RGTC2:                 format = BC_FORMAT_BC5; return true;
+    }
+    return false;
+}
+
+// Palettes. Colors are packed as RGBA8 in memory order : r | g << 8 | b << 16 | a << 24
+
+static unsigned int packRGBA(unsigned int r, unsigned int g, unsigned int b, unsigned int a){
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+// RGB565 endpoints expanded by bit replication, interpolated in 8 bits with truncating divisions.
+// BC2 and BC3 always use the 4 colors mode.
+static void colorPalette(const unsigned char * block, bool fourColors, unsigned int palette[4]){
+    unsigned int c0 = block[0] | (block[1] << 8);
+    unsigned int c1 = block[2] | (block[3] << 8);
+    unsigned int r0 = ((c0 >> 11) << 3) | (c0 >> 13), g0 = (((c0 >> 5) & 63) << 2) | ((c0 >> 9) & 3), b0 = ((c0 & 31) << 3) | ((c0 >> 2) & 7);
+    unsigned int r1 = ((c1 >> 11) << 3) | (c1 >> 13), g1 = (((c1 >> 5) & 63) << 2) | ((c1 >> 9) & 3), b1 = ((c1 & 31) << 3) | ((c1 >> 2) & 7);
+
+    palette[0] = packRGBA(r0, g0, b0, 255);
+    palette[1] = packRGBA(r1, g1, b1, 255);
+    if (c0 > c1 || fourColors){
+        palette[2] = packRGBA((2 * r0 + r1) / 3, (2 * g0 + g1) / 3, (2 * b0 + b1) / 3, 255);
+        palette[3] = packRGBA((r0 + 2 * r1) / 3, (g0 + 2 * g1) / 3, (b0 + 2 * b1) / 3, 255);
+    }
+    else {
+        palette[2] = packRGBA((r0 + r1) / 2, (g0 + g1) / 2, (b0 + b1) / 2, 255);
+        palette[3] = 0; // transparent black
+    }
+}
+
+// BC4 : 8 values from 2 endpoints, 6 interpolated, or 4 interpolated + 0 and 255
+static void channelPalette(const unsigned char * block, unsigned int palette[8]){
+    unsigned int a0 = block[0], a1 = block[1];
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1){
+        for (unsigned int i=1; i<7; i++)
+            palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    }
+    else {
+        for (unsigned int i=1; i<5; i++)
+            palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+static unsigned long long channelIndices(const unsigned char * block){
+    unsigned long long bits = 0;
+    for (int i=0; i<6; i++)
+        bits |= (unsigned long long)block[2 + i] << (8 * i);
+    return bits;
+}
+
+static unsigned int colorIndices(const unsigned char * block){
+    return block[4] | (block[5] << 8) | (block[6] << 16) | ((unsigned int)block[7] << 24);
+}
+
+// Reference decoder : one pixel at a time, straight from the formulas above
+
+void decodeBCBlockReference(BCFormat format, const unsigned char * block, unsigned char * out, size_t stride){
+    unsigned int pixels[16];
+
+    if (format == BC_FORMAT_BC4 || format == BC_FORMAT_BC5){
+        unsigned int red[8], green[8];
+        channelPalette(block, red);
+        unsigned long long redBits = channelIndices(block);
+        unsigned long long greenBits = 0;
+        if (format == BC_FORMAT_BC5){
+            channelPalette(block + 8, green);
+            greenBits = channelIndices(block + 8);
+        }
+        for (int i=0; i<16; i++){
+            unsigned int g = format == BC_FORMAT_BC5 ? green[(greenBits >> (3 * i)) & 7] : 0;
+            pixels[i] = packRGBA(red[(redBits >> (3 * i)) & 7], g, 0, 255);
+        }
+    }
+    else {
+        const unsigned char * colorBlock = format == BC_FORMAT_BC1 ? block : block + 8;
+        unsigned int palette[4];
+        colorPalette(colorBlock, format != BC_FORMAT_BC1, palette);
+        unsigned int bits = colorIndices(colorBlock);
+        for (int i=0; i<16; i++)
+            pixels[i] = palette[(bits >> (2 * i)) & 3];
+
+        if (format == BC_FORMAT_BC2){
+            for (int i=0; i<16; i++){
+                unsigned int alpha = (block[i / 2] >> (4 * (i & 1))) & 15;
+                pixels[i] = (pixels[i] & 0x00FFFFFF) | ((alpha * 17) << 24);
+            }
+        }
+        else if (format == BC_FORMAT_BC3){
+            unsigned int alpha[8];
+            channelPalette(block, alpha);
+            unsigned long long alphaBits = channelIndices(block);
+            for (int i=0; i<16; i++)
+                pixels[i] = (pixels[i] & 0x00FFFFFF) | (alpha[(alphaBits >> (3 * i)) & 7] << 24);
+        }
+    }
+
+    for (int y=0; y<4; y++)
+        memcpy(out + y * stride, &pixels[y * 4], 16);
+}
+
+#ifdef BCDECODE_SSE2
+
+// Palette entries are selected with compares : the lanes whose index equals k get palette[k] ^ palette[0]
+// XORed onto palette[0]. Exactly one compare matches in each lane, so no variable shifts or gathers are needed.
+
+// 2 bit color indices, one row of the block per vector : lane x of row y reads bits 2 * (4y + x)
+static inline void selectColors(const unsigned int palette[4], unsigned int bits, __m128i rows[4]){
+    const __m128i fieldMask = _mm_setr_epi32(3, 3 << 2, 3 << 4, 3 << 6);
+    __m128i p0 = _mm_set1_epi32(palette[0]);
+    __m128i d1 = _mm_set1_epi32(palette[0] ^ palette[1]);
+    __m128i d2 = _mm_set1_epi32(palette[0] ^ palette[2]);
+    __m128i d3 = _mm_set1_epi32(palette[0] ^ palette[3]);
+    for (int y=0; y<4; y++){
+        __m128i field = _mm_and_si128(_mm_set1_epi32(bits >> (8 * y)), fieldMask);
+        __m128i row = _mm_xor_si128(p0, _mm_and_si128(_mm_cmpeq_epi32(field, _mm_setr_epi32(1, 1 << 2, 1 << 4, 1 << 6)), d1));
+        row = _mm_xor_si128(row, _mm_and_si128(_mm_cmpeq_epi32(field, _mm_setr_epi32(2, 2 << 2, 2 << 4, 2 << 6)), d2));
+        rows[y] = _mm_xor_si128(row, _mm_and_si128(_mm_cmpeq_epi32(field, fieldMask), d3));
+    }
+}
+
+// BC4 palette, all 8 entries at once in 16 bit lanes : (w0 * a0 + w1 * a1) / d.
+// The divisions are multiplications by 65536 / d rounded up, exact for every sum up to 255 * d.
+static inline void channelPaletteSIMD(const unsigned char * block, unsigned char palette[16]){
+    unsigned int a0 = block[0], a1 = block[1];
+    __m128i sum, divided;
+    if (a0 > a1){
+        sum = _mm_add_epi16(_mm_mullo_epi16(_mm_set1_epi16((short)a0), _mm_setr_epi16(7, 0, 6, 5, 4, 3, 2, 1)),
+                            _mm_mullo_epi16(_mm_set1_epi16((short)a1), _mm_setr_epi16(0, 7, 1, 2, 3, 4, 5, 6)));
+        divided = _mm_mulhi_epu16(sum, _mm_set1_epi16(9363));
+    }
+    else {
+        sum = _mm_add_epi16(_mm_mullo_epi16(_mm_set1_epi16((short)a0), _mm_setr_epi16(5, 0, 4, 3, 2, 1, 0, 0)),
+                            _mm_mullo_epi16(_mm_set1_epi16((short)a1), _mm_setr_epi16(0, 5, 1, 2, 3, 4, 0, 0)));
+        divided = _mm_or_si128(_mm_mulhi_epu16(sum, _mm_set1_epi16(13108)), _mm_setr_epi16(0, 0, 0, 0, 0, 0, 0, 255));
+    }
+    _mm_storeu_si128((__m128i *)palette, _mm_packus_epi16(divided, divided));
+}
+
+// 3 bit indices : 8 entries is too many for compares to beat a table lookup, so the 16 bytes are gathered
+// in scalar code and only the palette and the interleaving into RGBA are vectorized
+static inline __m128i selectChannel(const unsigned char * block){
+    unsigned char palette[16], values[16];
+    channelPaletteSIMD(block, palette);
+    unsigned long long bits = channelIndices(block);
+    for (int i=0; i<16; i++)
+        values[i] = palette[(bits >> (3 * i)) & 7];
+    return _mm_loadu_si128((const __m128i *)values);
+}
+
+// 16 alpha bytes into the top byte of the 4 rows of RGBA pixels
+static inline void mergeAlpha(__m128i alpha, __m128i rows[4]){
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i colorMask = _mm_set1_epi32(0x00FFFFFF);
+    __m128i lo = _mm_unpacklo_epi8(zero, alpha), hi = _mm_unpackhi_epi8(zero, alpha);
+    rows[0] = _mm_or_si128(_mm_and_si128(rows[0], colorMask), _mm_unpacklo_epi16(zero, lo));
+    rows[1] = _mm_or_si128(_mm_and_si128(rows[1], colorMask), _mm_unpackhi_epi16(zero, lo));
+    rows[2] = _mm_or_si128(_mm_and_si128(rows[2], colorMask), _mm_unpacklo_epi16(zero, hi));
+    rows[3] = _mm_or_si128(_mm_and_si128(rows[3], colorMask), _mm_unpackhi_epi16(zero, hi));
+}
+
+void decodeBCBlock(BCFormat format, const unsigned char * block, unsigned char * out, size_t stride){
+    __m128i rows[4];
+
+    if (format == BC_FORMAT_BC4 || format == BC_FORMAT_BC5){
+        __m128i r = selectChannel(block);
+        __m128i g = format == BC_FORMAT_BC5 ? selectChannel(block + 8) : _mm_setzero_si128();
+        // (r, g) pairs, then (b, a) = (0, 255)
+        const __m128i blueAlpha = _mm_set1_epi16((short)0xFF00);
+        __m128i lo = _mm_unpacklo_epi8(r, g), hi = _mm_unpackhi_epi8(r, g);
+        rows[0] = _mm_unpacklo_epi16(lo, blueAlpha);
+        rows[1] = _mm_unpackhi_epi16(lo, blueAlpha);
+        rows[2] = _mm_unpacklo_epi16(hi, blueAlpha);
+        rows[3] = _mm_unpackhi_epi16(hi, blueAlpha);
+    }
+    else {
+        const unsigned char * colorBlock = format == BC_FORMAT_BC1 ? block : block + 8;
+        unsigned int palette[4];
+        colorPalette(colorBlock, format != BC_FORMAT_BC1, palette);
+        selectColors(palette, colorIndices(colorBlock), rows);
+
+        if (format == BC_FORMAT_BC2){
+            // 4 bits per pixel, low nibble first. alpha * 17 == alpha | alpha << 4
+            const __m128i nibbleMask = _mm_set1_epi8(15);
+            __m128i packed = _mm_loadl_epi64((const __m128i *)block);
+            __m128i alpha = _mm_unpacklo_epi8(_mm_and_si128(packed, nibbleMask), _mm_and_si128(_mm_srli_epi16(packed, 4), nibbleMask));
+            mergeAlpha(_mm_or_si128(alpha, _mm_slli_epi16(alpha, 4)), rows);
+        }
+        else if (format == BC_FORMAT_BC3){
+            mergeAlpha(selectChannel(block), rows);
+        }
+    }
+
+    for (int y=0; y<4; y++)
+        _mm_storeu_si128((__m128i *)(out + y * stride), rows[y]);
+}
+
+#else
+
+void decodeBCBlock(BCFormat format, const unsigned char * block, unsigned char * out, size_t stride){
+    decodeBCBlockReference(format, block, out, stride);
+}
+
+#endif
+
+// Block rows [rowBegin, rowEnd) of a surface. Blocks that go past the right or bottom edge are decoded aside, then cropped.
+static void decodeBlockRows(BCFormat format, const unsigned char * blocks, unsigned int width, unsigned int height, unsigned int rowBegin, unsigned int rowEnd, unsigned char * out){
+    unsigned int blocksX = (width + 3) / 4;
+    size_t stride = (size_t)width * 4;
+    unsigned char edge[64];
+    for (unsigned int by=rowBegin; by<rowEnd; by++){
+        const unsigned char * block = blocks + (size_t)by * blocksX * BLOCK_BYTES[format];
+        for (unsigned int bx=0; bx<blocksX; bx++, block += BLOCK_BYTES[format]){
+            unsigned int w = std::min(4u, width - bx * 4), h = std::min(4u, height - by * 4);
+            unsigned char * dst = out + (size_t)by * 4 * stride + bx * 16;
+            if (w == 4 && h == 4){
+                decodeBCBlock(format, block, dst, stride);
+            }
+            else {
+                decodeBCBlock(format, block, edge, 16);
+                for (unsigned int y=0; y<h; y++)
+                    memcpy(dst + y * stride, edge + y * 16, w * 4);
+            }
+        }
+    }
+}
+
+void decodeBCSurface(BCFormat format, const unsigned char * blocks, unsigned int width, unsigned int height, unsigned char * out){
+    decodeBlockRows(format, blocks, width, height, 0, (height + 3) / 4, out);
+}
+
+bool decodeDDSImage(const DDSImage & image, const unsigned char * data, DDSImage & out_image, std::vector<unsigned char> & out_data, unsigned int threadCount){
+    BCFormat format;
+    if (!image.compressed || !bcFormatFromGL(image.internalFormat, format))
+        return false;
+
+    out_image = image;
+    out_image.compressed = false;
+    out_image.format = GL_RGBA;
+    out_image.type = GL_UNSIGNED_BYTE;
+    out_image.blockBytes = 4;
+    bool sRGB = image.internalFormat == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+             || image.internalFormat == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT
+             || image.internalFormat == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+    out_image.internalFormat = sRGB ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+
+    // One job per block row, over all the surfaces
+    std::vector<unsigned int> rowSurface, rowIndex;
+    size_t offset = 0;
+    for (size_t i=0; i<out_image.surfaces.size(); i++){
+        DDSSurface & surface = out_image.surfaces[i];
+        surface.offset = offset;
+        surface.size = ddsSurfaceSize(out_image, surface.width, surface.height, surface.depth);
+        offset += surface.size;
+        unsigned int rows = (surface.height + 3) / 4 * surface.depth;
+        for (unsigned int r=0; r<rows; r++){
+            rowSurface.push_back((unsigned int)i);
+            rowIndex.push_back(r);
+        }
+    }
+    out_data.resize(offset);
+
+    parallelFor((unsigned int)rowSurface.size(), threadCount, [&](unsigned int begin, unsigned int end){
+        for (unsigned int j=begin; j<end; j++){
+            const DDSSurface & in = image.surfaces[rowSurface[j]];
+            const DDSSurface & out = out_image.surfaces[rowSurface[j]];
+            // 3D textures : slices are stored one after the other, each made of its block rows
+            unsigned int rowsPerSlice = (in.height + 3) / 4;
+            unsigned int slice = rowIndex[j] / rowsPerSlice, row = rowIndex[j] % rowsPerSlice;
+            size_t inSlice = in.size / in.depth, outSlice = out.size / out.depth;
+            decodeBlockRows(format, data + in.offset + slice * inSlice, in.width, in.height, row, row + 1, &out_data[out.offset + slice * outSlice]);
+        }
+    });
+    return true;
+}
+
+void benchmarkBCDecoder(unsigned int threadCount){
+    const char * names[5] = { "BC1", "BC2", "BC3", "BC4", "BC5" };
+    const unsigned int size = 1024; // 64K blocks
+    const unsigned int blockCount = (size / 4) * (size / 4);
+    std::vector<unsigned char> pixels((size_t)size * size * 4), reference(64);
+
+    for (int f=0; f<5; f++){
+        BCFormat format = (BCFormat)f;
+        std::vector<unsigned char> blocks((size_t)blockCount * BLOCK_BYTES[f]);
+        srand(f + 1);
+        for (size_t i=0; i<blocks.size(); i++)
+            blocks[i] = (unsigned char)(rand() >> 4);
+
+        // Bit-exact check, block by block
+        unsigned int mismatches = 0;
+        unsigned char simd[64];
+        for (unsigned int b=0; b<blockCount; b++){
+            const unsigned char * block = &blocks[(size_t)b * BLOCK_BYTES[f]];
+            decodeBCBlock(format, block, simd, 16);
+            decodeBCBlockReference(format, block, &reference[0], 16);
+            if (memcmp(simd, &reference[0], 64) != 0)
+                mismatches++;
+        }
+
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        for (unsigned int b=0; b<blockCount; b++)
+            decodeBCBlockReference(format, &blocks[(size_t)b * BLOCK_BYTES[f]], &pixels[((size_t)(b / (size / 4)) * 4 * size + (b % (size / 4)) * 4) * 4], size * 4);
+        double referenceTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        start = std::chrono::high_resolution_clock::now();
+        decodeBCSurface(format, &blocks[0], size, size, &pixels[0]);
+        double simdTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        start = std::chrono::high_resolution_clock::now();
+        parallelFor(size / 4, threadCount, [&](unsigned int begin, unsigned int end){
+            decodeBlockRows(format, &blocks[0], size, size, begin, end, &pixels[0]);
+        });
+        double threadedTime = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        printf("%s : reference %.1f M blocks/s, SIMD %.1f M blocks/s, %u threads %.1f M blocks/s, %u mismatches\n",
+            names[f], blockCount / referenceTime / 1e6, blockCount / simdTime / 1e6, threadCount, blockCount / threadedTime / 1e6, mismatches);
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef BCDECODE_HPP
+#define BCDECODE_HPP
+
+#include <vector>
+#include <stddef.h>
+#include <GL/glew.h>
+
+#include "dds.hpp"
+
+// Software decoding of the block formats, for contexts that can't sample them (llvmpipe without S3TC...)
+enum BCFormat {
+    BC_FORMAT_BC1, // DXT1, with 1 bit alpha
+    BC_FORMAT_BC2, // DXT3
+    BC_FORMAT_BC3, // DXT5
+    BC_FORMAT_BC4, // red, unsigned
+    BC_FORMAT_BC5  // red + green, unsigned
+};
+
+// Returns false for the formats that can't be decoded (signed RGTC, BPTC)
+bool bcFormatFromGL(GLenum internalFormat, BCFormat & format);
+
+// Decodes one 4x4 block to RGBA8, rows stride bytes apart.
+// The SIMD version (SSE2 when available) is bit-exact with the reference one.
+void decodeBCBlock(BCFormat format, const unsigned char * block, unsigned char * out, size_t stride);
+void decodeBCBlockReference(BCFormat format, const unsigned char * block, unsigned char * out, size_t stride);
+
+// Decodes a whole width x height surface to RGBA8 (width * height * 4 bytes)
+void decodeBCSurface(BCFormat format, const unsigned char * blocks, unsigned int width, unsigned int height, unsigned char * out);
+
+// Decodes every surface of a compressed image to RGBA8, in parallel over all the block rows of all the levels.
+// out_image describes out_data, with the same surfaces in the same order.
+bool decodeDDSImage(const DDSImage & image, const unsigned char * data, DDSImage & out_image, std::vector<unsigned char> & out_data, unsigned int threadCount);
+
+// Checks the SIMD decoder against the reference one, and prints the throughput of both in blocks per second
+void benchmarkBCDecoder(unsigned int threadCount);
+
+#endif
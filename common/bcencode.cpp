@@ -0,0 +1,493 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+// SSE2 is always there on x86-64. Other targets use the scalar path.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BCENCODE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "parallel.hpp"
+#include "bcencode.hpp"
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start){
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static unsigned int readUint(const unsigned char * data, size_t offset){
+    unsigned int value;
+    memcpy(&value, data + offset, 4);
+    return value;
+}
+
+bool readBMP(const char * path, unsigned int & width, unsigned int & height, std::vector<unsigned char> & rgba){
+    MappedFile file;
+    if (!mapFile(path, file)){
+        printf("%s could not be opened\n", path);
+        return false;
+    }
+    // Same checks as loadBMP_custom, plus the size of the data
+    bool ok = file.size >= 54 && file.data[0] == 'B' && file.data[1] == 'M'
+           && readUint(file.data, 0x1E) == 0 && (readUint(file.data, 0x1C) & 0xFFFF) == 24;
+    if (ok){
+        unsigned int dataPos = readUint(file.data, 0x0A);
+        width  = readUint(file.data, 0x12);
+        height = readUint(file.data, 0x16);
+        if (dataPos == 0) dataPos = 54;
+        size_t pitch = (width * 3 + 3) & ~3u;
+        ok = width > 0 && height > 0 && width <= 16384 && height <= 16384 && dataPos + pitch * height <= file.size;
+        if (ok){
+            rgba.resize((size_t)width * height * 4);
+            for (unsigned int y=0; y<height; y++){
+                const unsigned char * src = file.data + dataPos + pitch * y;
+                unsigned char * dst = &rgba[(size_t)y * width * 4];
+                for (unsigned int x=0; x<width; x++, src += 3, dst += 4){
+                    dst[0] = src[2];
+                    dst[1] = src[1];
+                    dst[2] = src[0];
+                    dst[3] = 255;
+                }
+            }
+        }
+    }
+    if (!ok)
+        printf("%s : not a correct BMP file\n", path);
+    unmapFile(file);
+    return ok;
+}
+
+// sRGB <-> linear. Decoding is a 256 entries table; encoding is a finer table, within a fifth of a step of the exact curve.
+static const unsigned int LINEAR_STEPS = 16384;
+
+struct GammaTables {
+    float toLinear[256];
+    unsigned char toSRGB[LINEAR_STEPS];
+    GammaTables(){
+        for (int i=0; i<256; i++){
+            float c = i / 255.0f;
+            toLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (unsigned int i=0; i<LINEAR_STEPS; i++){
+            float c = i / (float)(LINEAR_STEPS - 1);
+            float s = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+            toSRGB[i] = (unsigned char)(s * 255.0f + 0.5f);
+        }
+    }
+};
+static const GammaTables gammaTables;
+
+// Box filter taps of one destination pixel along one axis. An odd source size spreads
+// each destination pixel over 3 source pixels, weighted by how much of them it covers.
+struct FilterTaps {
+    unsigned int index[3];
+    float weight[3];
+};
+
+static std::vector<FilterTaps> filterTaps(unsigned int srcSize, unsigned int dstSize){
+    std::vector<FilterTaps> taps(dstSize);
+    for (unsigned int x=0; x<dstSize; x++){
+        FilterTaps & t = taps[x];
+        if (srcSize == 1){
+            t.index[0] = t.index[1] = t.index[2] = 0;
+            t.weight[0] = 1.0f;
+            t.weight[1] = t.weight[2] = 0.0f;
+        }
+        else if (srcSize % 2 == 0){
+            t.index[0] = 2 * x;
+            t.index[1] = t.index[2] = 2 * x + 1;
+            t.weight[0] = t.weight[1] = 0.5f;
+            t.weight[2] = 0.0f;
+        }
+        else {
+            float n = (float)srcSize;
+            t.index[0] = 2 * x;
+            t.index[1] = 2 * x + 1;
+            t.index[2] = 2 * x + 2;
+            t.weight[0] = (dstSize - x) / n;
+            t.weight[1] = dstSize / n;
+            t.weight[2] = (x + 1) / n;
+        }
+    }
+    return taps;
+}
+
+// One level down, linear RGBA floats
+static void downsample(const std::vector<float> & src, unsigned int srcWidth, unsigned int srcHeight,
+                       std::vector<float> & dst, unsigned int dstWidth, unsigned int dstHeight, unsigned int threadCount){
+    std::vector<FilterTaps> tapsX = filterTaps(srcWidth, dstWidth);
+    std::vector<FilterTaps> tapsY = filterTaps(srcHeight, dstHeight);
+    dst.resize((size_t)dstWidth * dstHeight * 4);
+
+    parallelFor(dstHeight, threadCount, [&](unsigned int begin, unsigned int end){
+        for (unsigned int y=begin; y<end; y++){
+            const FilterTaps & ty = tapsY[y];
+            for (unsigned int x=0; x<dstWidth; x++){
+                const FilterTaps & tx = tapsX[x];
+                float * out = &dst[((size_t)y * dstWidth + x) * 4];
+#ifdef BCENCODE_SSE2
+                // One pixel per register
+                __m128 sum = _mm_setzero_ps();
+                for (int j=0; j<3; j++){
+                    const float * row = &src[(size_t)ty.index[j] * srcWidth * 4];
+                    __m128 h = _mm_mul_ps(_mm_loadu_ps(row + tx.index[0] * 4), _mm_set1_ps(tx.weight[0]));
+                    h = _mm_add_ps(h, _mm_mul_ps(_mm_loadu_ps(row + tx.index[1] * 4), _mm_set1_ps(tx.weight[1])));
+                    h = _mm_add_ps(h, _mm_mul_ps(_mm_loadu_ps(row + tx.index[2] * 4), _mm_set1_ps(tx.weight[2])));
+                    sum = _mm_add_ps(sum, _mm_mul_ps(h, _mm_set1_ps(ty.weight[j])));
+                }
+                _mm_storeu_ps(out, sum);
+#else
+                for (int c=0; c<4; c++){
+                    float sum = 0.0f;
+                    for (int j=0; j<3; j++){
+                        const float * row = &src[(size_t)ty.index[j] * srcWidth * 4];
+                        float h = row[tx.index[0] * 4 + c] * tx.weight[0] + row[tx.index[1] * 4 + c] * tx.weight[1] + row[tx.index[2] * 4 + c] * tx.weight[2];
+                        sum += h * ty.weight[j];
+                    }
+                    out[c] = sum;
+                }
+#endif
+            }
+        }
+    });
+}
+
+static void toLinear(const unsigned char * rgba, size_t pixels, std::vector<float> & linear){
+    linear.resize(pixels * 4);
+    for (size_t i=0; i<pixels * 4; i += 4){
+        linear[i]     = gammaTables.toLinear[rgba[i]];
+        linear[i + 1] = gammaTables.toLinear[rgba[i + 1]];
+        linear[i + 2] = gammaTables.toLinear[rgba[i + 2]];
+        linear[i + 3] = rgba[i + 3] / 255.0f; // alpha is linear already
+    }
+}
+
+static unsigned char linearToSRGB(float c){
+    return gammaTables.toSRGB[(unsigned int)(std::min(std::max(c, 0.0f), 1.0f) * (LINEAR_STEPS - 1) + 0.5f)];
+}
+
+static void toSRGB(const std::vector<float> & linear, std::vector<unsigned char> & rgba){
+    rgba.resize(linear.size());
+    for (size_t i=0; i<linear.size(); i += 4){
+        rgba[i]     = linearToSRGB(linear[i]);
+        rgba[i + 1] = linearToSRGB(linear[i + 1]);
+        rgba[i + 2] = linearToSRGB(linear[i + 2]);
+        rgba[i + 3] = (unsigned char)(std::min(std::max(linear[i + 3], 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+}
+
+// Block encoders. Palettes come from the decoder itself, so that the indices are chosen
+// against exactly the colors the GPU will produce.
+
+// Flat blocks : the endpoints whose 2/3 - 1/3 mix is closest to each 8 bits value, per channel width.
+// Quantizing the color itself would be off by up to 4.
+struct SingleColorTables {
+    unsigned char match5[256][2], match6[256][2];
+    static void build(unsigned char match[256][2], int bits){
+        int count = 1 << bits;
+        for (int v=0; v<256; v++){
+            int bestError = 1 << 30;
+            for (int a=0; a<count; a++){
+                for (int b=0; b<count; b++){
+                    int ea = bits == 5 ? (a << 3) | (a >> 2) : (a << 2) | (a >> 4);
+                    int eb = bits == 5 ? (b << 3) | (b >> 2) : (b << 2) | (b >> 4);
+                    int error = abs((2 * ea + eb) / 3 - v) * 256 + abs(ea - eb); // then the closest endpoints
+                    if (error < bestError){
+                        bestError = error;
+                        match[v][0] = (unsigned char)a;
+                        match[v][1] = (unsigned char)b;
+                    }
+                }
+            }
+        }
+    }
+    SingleColorTables(){
+        build(match5, 5);
+        build(match6, 6);
+    }
+};
+static const SingleColorTables singleColor;
+
+static bool encodeSingleColor(const unsigned char pixels[64], unsigned char * out){
+    for (int i=1; i<16; i++){
+        if (pixels[i * 4] != pixels[0] || pixels[i * 4 + 1] != pixels[1] || pixels[i * 4 + 2] != pixels[2])
+            return false;
+    }
+    const unsigned char * r = singleColor.match5[pixels[0]];
+    const unsigned char * g = singleColor.match6[pixels[1]];
+    const unsigned char * b = singleColor.match5[pixels[2]];
+    unsigned int c0 = (r[0] << 11) | (g[0] << 5) | b[0];
+    unsigned int c1 = (r[1] << 11) | (g[1] << 5) | b[1];
+    unsigned int index = 2; // 2/3 c0 + 1/3 c1
+    if (c0 < c1){
+        std::swap(c0, c1);
+        index = 3;
+    }
+    else if (c0 == c1){
+        index = 0;
+    }
+    unsigned int bits = index * 0x55555555u;
+    out[0] = (unsigned char)c0; out[1] = (unsigned char)(c0 >> 8);
+    out[2] = (unsigned char)c1; out[3] = (unsigned char)(c1 >> 8);
+    for (int i=0; i<4; i++)
+        out[4 + i] = (unsigned char)(bits >> (8 * i));
+    return true;
+}
+
+static unsigned int pack565(const float c[3]){
+    int r = (int)(std::min(std::max(c[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    int g = (int)(std::min(std::max(c[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+    int b = (int)(std::min(std::max(c[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+    return (r << 11) | (g << 5) | b;
+}
+
+// Range fit : endpoints on the principal axis of the colors, inset by 1/16 of the range.
+// 4 colors mode, as BC3 always decodes it and as BC1 does when c0 > c1.
+static void encodeColors(const unsigned char pixels[64], unsigned char * out){
+    if (encodeSingleColor(pixels, out))
+        return;
+
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for (int i=0; i<16; i++)
+        for (int c=0; c<3; c++)
+            mean[c] += pixels[i * 4 + c] / 16.0f;
+    float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f }; // rr rg rb gg gb bb
+    for (int i=0; i<16; i++){
+        float r = pixels[i * 4] - mean[0], g = pixels[i * 4 + 1] - mean[1], b = pixels[i * 4 + 2] - mean[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+    // Power iteration, from the luminance direction
+    float axis[3] = { 0.577f, 0.577f, 0.577f };
+    for (int it=0; it<6; it++){
+        float v[3] = {
+            cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+            cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+            cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]
+        };
+        float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        if (length < 1e-6f)
+            break; // flat block : any axis will do
+        for (int c=0; c<3; c++)
+            axis[c] = v[c] / length;
+    }
+
+    float tMin = 1e30f, tMax = -1e30f;
+    for (int i=0; i<16; i++){
+        float t = (pixels[i * 4] - mean[0]) * axis[0] + (pixels[i * 4 + 1] - mean[1]) * axis[1] + (pixels[i * 4 + 2] - mean[2]) * axis[2];
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+    float inset = (tMax - tMin) / 16.0f;
+    tMin += inset;
+    tMax -= inset;
+    float hi[3], lo[3];
+    for (int c=0; c<3; c++){
+        hi[c] = mean[c] + axis[c] * tMax;
+        lo[c] = mean[c] + axis[c] * tMin;
+    }
+    unsigned int c0 = pack565(hi), c1 = pack565(lo);
+    if (c0 < c1)
+        std::swap(c0, c1);
+
+    // Palette : decode a block whose first row uses indices 0, 1, 2, 3
+    unsigned char probe[16] = { 0, 0, 0, 0, 0, 0, 0, 0,
+        (unsigned char)c0, (unsigned char)(c0 >> 8), (unsigned char)c1, (unsigned char)(c1 >> 8), 0xE4, 0, 0, 0 };
+    unsigned char palette[64];
+    decodeBCBlockReference(BC_FORMAT_BC3, probe, palette, 16);
+
+    unsigned int bits = 0;
+    if (c0 != c1){
+        for (int i=0; i<16; i++){
+            int best = 0, bestError = 1 << 30;
+            for (int k=0; k<4; k++){
+                int dr = pixels[i * 4] - palette[k * 4], dg = pixels[i * 4 + 1] - palette[k * 4 + 1], db = pixels[i * 4 + 2] - palette[k * 4 + 2];
+                int error = dr * dr + dg * dg + db * db;
+                if (error < bestError){
+                    bestError = error;
+                    best = k;
+                }
+            }
+            bits |= best << (2 * i);
+        }
+    }
+    // else all indices 0 : also right for BC1, whose c0 == c1 block is in 3 colors mode
+
+    out[0] = (unsigned char)c0; out[1] = (unsigned char)(c0 >> 8);
+    out[2] = (unsigned char)c1; out[3] = (unsigned char)(c1 >> 8);
+    for (int i=0; i<4; i++)
+        out[4 + i] = (unsigned char)(bits >> (8 * i));
+}
+
+// BC3 alpha : min and max as endpoints, 8 values mode
+static void encodeAlpha(const unsigned char pixels[64], unsigned char * out){
+    unsigned int a0 = 0, a1 = 255;
+    for (int i=0; i<16; i++){
+        a0 = std::max(a0, (unsigned int)pixels[i * 4 + 3]);
+        a1 = std::min(a1, (unsigned int)pixels[i * 4 + 3]);
+    }
+    unsigned long long bits = 0;
+    if (a0 != a1){
+        // Palette : decode a BC4 block whose first 8 pixels use indices 0 to 7
+        unsigned char probe[8] = { (unsigned char)a0, (unsigned char)a1, 0x88, 0xC6, 0xFA, 0, 0, 0 };
+        unsigned char palette[64];
+        decodeBCBlockReference(BC_FORMAT_BC4, probe, palette, 16);
+        for (int i=0; i<16; i++){
+            int best = 0, bestError = 1 << 30;
+            for (int k=0; k<8; k++){
+                int error = abs((int)pixels[i * 4 + 3] - (int)palette[k * 4]);
+                if (error < bestError){
+                    bestError = error;
+                    best = k;
+                }
+            }
+            bits |= (unsigned long long)best << (3 * i);
+        }
+    }
+    out[0] = (unsigned char)a0;
+    out[1] = (unsigned char)a1;
+    for (int i=0; i<6; i++)
+        out[2 + i] = (unsigned char)(bits >> (8 * i));
+}
+
+// One row of blocks. Returns the squared error of the decoded pixels against the source.
+static double encodeBlockRow(BCFormat format, const unsigned char * rgba, unsigned int width, unsigned int height, unsigned int by, unsigned char * out){
+    unsigned int blockBytes = format == BC_FORMAT_BC1 ? 8 : 16;
+    int channels = format == BC_FORMAT_BC1 ? 3 : 4;
+    double error = 0.0;
+    unsigned char pixels[64], decoded[64];
+    for (unsigned int bx=0; bx<(width + 3) / 4; bx++, out += blockBytes){
+        // Partial blocks repeat their last row and column
+        for (unsigned int y=0; y<4; y++){
+            unsigned int sy = std::min(by * 4 + y, height - 1);
+            for (unsigned int x=0; x<4; x++){
+                unsigned int sx = std::min(bx * 4 + x, width - 1);
+                memcpy(pixels + (y * 4 + x) * 4, rgba + ((size_t)sy * width + sx) * 4, 4);
+            }
+        }
+        if (format == BC_FORMAT_BC1){
+            encodeColors(pixels, out);
+        }
+        else {
+            encodeAlpha(pixels, out);
+            encodeColors(pixels, out + 8);
+        }
+
+        decodeBCBlock(format, out, decoded, 16);
+        for (unsigned int y=0; y<4 && by * 4 + y < height; y++){
+            for (unsigned int x=0; x<4 && bx * 4 + x < width; x++){
+                for (int c=0; c<channels; c++){
+                    int d = decoded[(y * 4 + x) * 4 + c] - pixels[(y * 4 + x) * 4 + c];
+                    error += d * d;
+                }
+            }
+        }
+    }
+    return error;
+}
+
+bool compressImage(const unsigned char * rgba, unsigned int width, unsigned int height, BCFormat format, unsigned int threadCount,
+                   DDSImage & image, std::vector<unsigned char> & data, BCEncodeStats & stats){
+    if (format != BC_FORMAT_BC1 && format != BC_FORMAT_BC3){
+        printf("Only BC1 and BC3 can be encoded\n");
+        return false;
+    }
+    memset(&stats, 0, sizeof(stats));
+
+    image.target = GL_TEXTURE_2D;
+    image.internalFormat = format == BC_FORMAT_BC1 ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    image.compressed = true;
+    image.format = image.type = 0;
+    image.blockBytes = format == BC_FORMAT_BC1 ? 8 : 16;
+    image.width = width;
+    image.height = height;
+    image.depth = image.layers = image.faces = 1;
+    image.levels = 1;
+    for (unsigned int m = std::max(width, height); m > 1; m /= 2)
+        image.levels++;
+
+    // Mip chain : filtered in linear space, stored back as sRGB bytes
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    std::vector<std::vector<unsigned char> > levels(image.levels);
+    levels[0].assign(rgba, rgba + (size_t)width * height * 4);
+    std::vector<float> linear, smaller;
+    toLinear(rgba, (size_t)width * height, linear);
+    image.surfaces.clear();
+    size_t offset = 0;
+    for (unsigned int l=0; l<image.levels; l++){
+        DDSSurface surface;
+        surface.layer = surface.face = 0;
+        surface.level = l;
+        surface.width = std::max(1u, width >> l);
+        surface.height = std::max(1u, height >> l);
+        surface.depth = 1;
+        surface.offset = offset;
+        surface.size = ddsSurfaceSize(image, surface.width, surface.height, 1);
+        offset += surface.size;
+        if (l > 0){
+            const DDSSurface & previous = image.surfaces[l - 1];
+            downsample(linear, previous.width, previous.height, smaller, surface.width, surface.height, threadCount);
+            linear.swap(smaller);
+            toSRGB(linear, levels[l]);
+        }
+        image.surfaces.push_back(surface);
+        stats.pixels += (size_t)surface.width * surface.height;
+    }
+    stats.mipMs = elapsedMs(start);
+
+    // One job per block row, over all the levels
+    start = std::chrono::high_resolution_clock::now();
+    data.resize(offset);
+    std::vector<unsigned int> rowLevel, rowIndex;
+    for (unsigned int l=0; l<image.levels; l++){
+        for (unsigned int r=0; r<(image.surfaces[l].height + 3) / 4; r++){
+            rowLevel.push_back(l);
+            rowIndex.push_back(r);
+        }
+    }
+    std::vector<double> rowError(rowLevel.size());
+    parallelFor((unsigned int)rowLevel.size(), threadCount, [&](unsigned int begin, unsigned int end){
+        for (unsigned int j=begin; j<end; j++){
+            const DDSSurface & surface = image.surfaces[rowLevel[j]];
+            unsigned char * out = &data[surface.offset + (size_t)rowIndex[j] * ((surface.width + 3) / 4) * image.blockBytes];
+            rowError[j] = encodeBlockRow(format, &levels[rowLevel[j]][0], surface.width, surface.height, rowIndex[j], out);
+        }
+    });
+    stats.encodeMs = elapsedMs(start);
+
+    int channels = format == BC_FORMAT_BC1 ? 3 : 4;
+    double error0 = 0.0, error = 0.0;
+    for (size_t j=0; j<rowError.size(); j++){
+        if (rowLevel[j] == 0) error0 += rowError[j];
+        error += rowError[j];
+    }
+    stats.levels = image.levels;
+    stats.rgbaBytes = stats.pixels * 4;
+    stats.encodedBytes = offset;
+    stats.rmse0 = sqrt(error0 / ((double)width * height * channels));
+    stats.rmse = sqrt(error / ((double)stats.pixels * channels));
+    return true;
+}
+
+void printBCEncodeStats(const char * name, const BCEncodeStats & stats){
+    printf("%s : %u levels, %.1f KB RGBA8 -> %.1f KB (%.1fx), mips %.2f ms, encode %.2f ms (%.1f Mpixels/s), RMSE %.2f (level 0 %.2f)\n",
+        name, stats.levels, stats.rgbaBytes / 1024.0, stats.encodedBytes / 1024.0, (double)stats.rgbaBytes / stats.encodedBytes,
+        stats.mipMs, stats.encodeMs, stats.encodeMs > 0.0 ? stats.pixels / (stats.encodeMs * 1000.0) : 0.0, stats.rmse, stats.rmse0);
+}
+
+bool compressBMP(const char * bmpPath, const char * ddsPath, BCFormat format, unsigned int threadCount){
+    unsigned int width, height;
+    std::vector<unsigned char> rgba, data;
+    DDSImage image;
+    BCEncodeStats stats;
+    if (!readBMP(bmpPath, width, height, rgba) || !compressImage(&rgba[0], width, height, format, threadCount, image, data, stats))
+        return false;
+    if (!writeDDS(ddsPath, image, &data[0]))
+        return false;
+    printBCEncodeStats(ddsPath, stats);
+    return true;
+}
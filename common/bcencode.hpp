@@ -0,0 +1,34 @@
+#ifndef BCENCODE_HPP
+#define BCENCODE_HPP
+
+#include <vector>
+#include <stddef.h>
+#include <GL/glew.h>
+
+#include "dds.hpp"
+#include "bcdecode.hpp"
+
+struct BCEncodeStats {
+    unsigned int levels;
+    size_t pixels;         // over all levels
+    size_t rgbaBytes;      // the same chain, uncompressed RGBA8 : what GL stores for a GL_RGB texture
+    size_t encodedBytes;
+    double mipMs, encodeMs;
+    double rmse0, rmse;    // level 0, then all levels, on the 0-255 scale of the channels encoded
+};
+
+// Reads a 24 bits .BMP file into RGBA8, rows bottom to top like the file and glTexImage2D
+bool readBMP(const char * path, unsigned int & width, unsigned int & height, std::vector<unsigned char> & rgba);
+
+// Builds the mip chain of an sRGB RGBA8 image, filtered in linear space, then encodes every level to
+// BC1 (opaque) or BC3 on threadCount threads. image describes data, surfaces from offset 0.
+// Rows keep their order : a .BMP converted this way replaces loadBMP_custom with the same UVs.
+bool compressImage(const unsigned char * rgba, unsigned int width, unsigned int height, BCFormat format, unsigned int threadCount,
+                   DDSImage & image, std::vector<unsigned char> & data, BCEncodeStats & stats);
+
+void printBCEncodeStats(const char * name, const BCEncodeStats & stats);
+
+// Offline path : .BMP in, .DDS out, stats printed
+bool compressBMP(const char * bmpPath, const char * ddsPath, BCFormat format, unsigned int threadCount);
+
+#endif
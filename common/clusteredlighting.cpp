@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "parallel.hpp"
+#include "clusteredlighting.hpp"
+#include "gpuresources.hpp"
+#include "glcapture.hpp"
+
+// Clusters touched by one light, bounds included
+struct LightClusterRange {
+    int x0, x1, y0, y1, z0, z1;
+};
+
+void initClusterGrid(ClusterGrid & grid, unsigned int tilesX, unsigned int tilesY, unsigned int slices, float zNear, float zFar){
+    grid.tilesX = tilesX;
+    grid.tilesY = tilesY;
+    grid.slices = slices;
+    grid.zNear = zNear;
+    grid.zFar = zFar;
+    grid.clusters.assign(tilesX * tilesY * slices * 2, 0);
+    grid.lightIndices.clear();
+    grid.lightData.clear();
+    grid.binningTime = 0.0;
+}
+
+// Exponential slicing : every slice covers the same ratio of depth
+static int depthToSlice(const ClusterGrid & grid, float depth){
+    if (depth <= grid.zNear)
+        return 0;
+    int slice = (int)(log(depth / grid.zNear) / log(grid.zFar / grid.zNear) * grid.slices);
+    return std::min(slice, (int)grid.slices - 1);
+}
+
+// Conservative bounds of a view space sphere : project the corners of its bounding box,
+// with the depth clamped to the near plane (things only get bigger closer to the camera).
+static bool computeClusterRange(const ClusterGrid & grid, const glm::vec3 & center, float radius, const glm::mat4 & projMat, LightClusterRange & range){
+    float depth = -center.z;
+    if (depth + radius < grid.zNear || depth - radius > grid.zFar)
+        return false;
+
+    float nearDepth = std::max(grid.zNear, depth - radius);
+    float farDepth  = std::min(grid.zFar,  depth + radius);
+
+    glm::vec2 lo(1e30f), hi(-1e30f);
+    for (int i=0; i<8; i++){
+        glm::vec4 corner(
+            center.x + ((i & 1) ? radius : -radius),
+            center.y + ((i & 2) ? radius : -radius),
+            (i & 4) ? -farDepth : -nearDepth,
+            1.0f);
+        glm::vec4 clip = projMat * corner;
+        glm::vec2 ndc = glm::vec2(clip) / clip.w;
+        lo = glm::min(lo, ndc);
+        hi = glm::max(hi, ndc);
+    }
+    if (hi.x < -1.0f || hi.y < -1.0f || lo.x > 1.0f || lo.y > 1.0f)
+        return false;
+
+    // NDC to tiles, y going up like gl_FragCoord
+    range.x0 = glm::clamp((int)floor((lo.x * 0.5f + 0.5f) * grid.tilesX), 0, (int)grid.tilesX - 1);
+    range.x1 = glm::clamp((int)floor((hi.x * 0.5f + 0.5f) * grid.tilesX), 0, (int)grid.tilesX - 1);
+    range.y0 = glm::clamp((int)floor((lo.y * 0.5f + 0.5f) * grid.tilesY), 0, (int)grid.tilesY - 1);
+    range.y1 = glm::clamp((int)floor((hi.y * 0.5f + 0.5f) * grid.tilesY), 0, (int)grid.tilesY - 1);
+    range.z0 = depthToSlice(grid, nearDepth);
+    range.z1 = depthToSlice(grid, farDepth);
+    return true;
+}
+
+void binLights(
+    ClusterGrid & grid,
+    const std::vector<PointLight> & lights,
+    const glm::mat4 & viewMat,
+    const glm::mat4 & projMat,
+    unsigned int threadCount
+){
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    unsigned int lightCount = (unsigned int)lights.size();
+    unsigned int clustersPerSlice = grid.tilesX * grid.tilesY;
+
+    // 1. Lights to view space, and the clusters they touch
+    std::vector<LightClusterRange> ranges(lightCount);
+    std::vector<char> visible(lightCount);
+    grid.lightData.resize(lightCount * 2);
+    parallelFor(lightCount, threadCount, [&](unsigned int begin, unsigned int end){
+        for (unsigned int i=begin; i<end; i++){
+            const PointLight & light = lights[i];
+            glm::vec3 center = glm::vec3(viewMat * glm::vec4(light.position, 1.0f));
+            grid.lightData[i*2+0] = glm::vec4(center, light.radius);
+            grid.lightData[i*2+1] = glm::vec4(light.color * light.power, 0.0f);
+            visible[i] = computeClusterRange(grid, center, light.radius, projMat, ranges[i]);
+        }
+    });
+
+    // 2. Count the lights of each cluster. Threads own whole slices, so they never write to the same cluster.
+    std::vector<unsigned int> counts(clustersPerSlice * grid.slices, 0);
+    parallelFor(grid.slices, threadCount, [&](unsigned int sliceBegin, unsigned int sliceEnd){
+        for (unsigned int i=0; i<lightCount; i++){
+            if (!visible[i])
+                continue;
+            const LightClusterRange & r = ranges[i];
+            int z0 = std::max(r.z0, (int)sliceBegin);
+            int z1 = std::min(r.z1, (int)sliceEnd - 1);
+            for (int z=z0; z<=z1; z++)
+                for (int y=r.y0; y<=r.y1; y++)
+                    for (int x=r.x0; x<=r.x1; x++)
+                        counts[(z * grid.tilesY + y) * grid.tilesX + x]++;
+        }
+    });
+
+    // 3. Offsets of each cluster in the index list
+    unsigned int total = 0;
+    for (unsigned int c=0; c<counts.size(); c++){
+        grid.clusters[c*2+0] = total;
+        grid.clusters[c*2+1] = counts[c];
+        total += counts[c];
+    }
+    grid.lightIndices.resize(total);
+
+    // 4. Fill the index lists, same partitioning as 2.
+    parallelFor(grid.slices, threadCount, [&](unsigned int sliceBegin, unsigned int sliceEnd){
+        std::vector<unsigned int> cursor(clustersPerSlice * (sliceEnd - sliceBegin));
+        for (unsigned int c=0; c<cursor.size(); c++)
+            cursor[c] = grid.clusters[(sliceBegin * clustersPerSlice + c) * 2];
+        for (unsigned int i=0; i<lightCount; i++){
+            if (!visible[i])
+                continue;
+            const LightClusterRange & r = ranges[i];
+            int z0 = std::max(r.z0, (int)sliceBegin);
+            int z1 = std::min(r.z1, (int)sliceEnd - 1);
+            for (int z=z0; z<=z1; z++)
+                for (int y=r.y0; y<=r.y1; y++)
+                    for (int x=r.x0; x<=r.x1; x++)
+                        grid.lightIndices[cursor[((z - sliceBegin) * grid.tilesY + y) * grid.tilesX + x]++] = i;
+        }
+    });
+
+    grid.binningTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// The memory is the buffer's : the texture is only a view of it
+static void createTextureBuffer(const char * tag, GLuint & buffer, GLuint & texture, GLenum format){
+    buffer = createGPUResource(GPU_BUFFER, tag);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+    setGPUResourceBytes(GPU_BUFFER, buffer, 16);
+
+    texture = createGPUResource(GPU_TEXTURE, tag);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+}
+
+void initClusteredLighting(ClusteredLightingBuffers & buffers){
+    createTextureBuffer("cluster grid",  buffers.clusterBuffer, buffers.clusterTexture, GL_RG32UI);
+    createTextureBuffer("light indices", buffers.indexBuffer,   buffers.indexTexture,   GL_R32UI);
+    createTextureBuffer("light data",    buffers.lightBuffer,   buffers.lightTexture,   GL_RGBA32F);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// Orphan the old storage, so that we don't wait for the GPU to be done with last frame's data
+static void streamBuffer(GLuint buffer, size_t size, const void * data){
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(size, 16), NULL, GL_STREAM_DRAW);
+    setGPUResourceBytes(GPU_BUFFER, buffer, std::max<size_t>(size, 16));
+    if (size > 0)
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+}
+
+void uploadClusteredLighting(ClusteredLightingBuffers & buffers, const ClusterGrid & grid){
+    streamBuffer(buffers.clusterBuffer, grid.clusters.size() * sizeof(unsigned int), grid.clusters.data());
+    streamBuffer(buffers.indexBuffer, grid.lightIndices.size() * sizeof(unsigned int), grid.lightIndices.data());
+    streamBuffer(buffers.lightBuffer, grid.lightData.size() * sizeof(glm::vec4), grid.lightData.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void bindClusteredLighting(const ClusteredLightingBuffers & buffers, const ClusterGrid & grid, GLuint programID, int firstUnit, float viewportWidth, float viewportHeight){
+    const GLuint textures[3] = { buffers.clusterTexture, buffers.indexTexture, buffers.lightTexture };
+    const char * samplers[3] = { "ClusterGrid", "LightIndices", "LightData" };
+    for (int i=0; i<3; i++){
+        glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        glUniform1i(glGetUniformLocation(programID, samplers[i]), firstUnit + i);
+    }
+    glActiveTexture(GL_TEXTURE0);
+
+    glUniform3i(glGetUniformLocation(programID, "ClusterCount"), grid.tilesX, grid.tilesY, grid.slices);
+    glUniform2f(glGetUniformLocation(programID, "TileSize"), viewportWidth / grid.tilesX, viewportHeight / grid.tilesY);
+    glUniform1f(glGetUniformLocation(programID, "ZNear"), grid.zNear);
+    glUniform1f(glGetUniformLocation(programID, "SliceScale"), grid.slices / log(grid.zFar / grid.zNear));
+}
+
+void cleanupClusteredLighting(ClusteredLightingBuffers & buffers){
+    deleteGPUResource(GPU_TEXTURE, buffers.clusterTexture);
+    deleteGPUResource(GPU_TEXTURE, buffers.indexTexture);
+    deleteGPUResource(GPU_TEXTURE, buffers.lightTexture);
+    deleteGPUResource(GPU_BUFFER, buffers.clusterBuffer);
+    deleteGPUResource(GPU_BUFFER, buffers.indexBuffer);
+    deleteGPUResource(GPU_BUFFER, buffers.lightBuffer);
+}
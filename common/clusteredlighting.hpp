@@ -0,0 +1,55 @@
+#ifndef CLUSTEREDLIGHTING_HPP
+#define CLUSTEREDLIGHTING_HPP
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+struct PointLight {
+    glm::vec3 position; // world space
+    float radius;       // no light at all beyond this distance
+    glm::vec3 color;
+    float power;
+};
+
+// Froxel grid : screen tiles x exponential depth slices.
+// Filled on the CPU by binLights, read by ClusteredFragmentShader.frag
+struct ClusterGrid {
+    unsigned int tilesX, tilesY, slices;
+    float zNear, zFar;
+
+    std::vector<unsigned int> clusters;     // 2 per cluster : offset in lightIndices, light count
+    std::vector<unsigned int> lightIndices;
+    std::vector<glm::vec4> lightData;       // 2 per light : view space position + radius, color * power
+
+    double binningTime; // ms, last call to binLights
+};
+
+struct ClusteredLightingBuffers {
+    GLuint clusterBuffer, clusterTexture;
+    GLuint indexBuffer, indexTexture;
+    GLuint lightBuffer, lightTexture;
+};
+
+void initClusterGrid(ClusterGrid & grid, unsigned int tilesX, unsigned int tilesY, unsigned int slices, float zNear, float zFar);
+
+// Bins the lights in the clusters they touch, in parallel over depth slices. CPU only.
+void binLights(
+    ClusterGrid & grid,
+    const std::vector<PointLight> & lights,
+    const glm::mat4 & viewMat,
+    const glm::mat4 & projMat,
+    unsigned int threadCount
+);
+
+void initClusteredLighting(ClusteredLightingBuffers & buffers);
+
+// Sends the grid, the index lists and the lights to their texture buffers
+void uploadClusteredLighting(ClusteredLightingBuffers & buffers, const ClusterGrid & grid);
+
+// Binds the texture buffers to 3 texture units starting at firstUnit, and sets the uniforms of programID
+void bindClusteredLighting(const ClusteredLightingBuffers & buffers, const ClusterGrid & grid, GLuint programID, int firstUnit, float viewportWidth, float viewportHeight);
+
+void cleanupClusteredLighting(ClusteredLightingBuffers & buffers);
+
+#endif
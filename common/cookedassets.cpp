@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "dds.hpp"
+#include "cookedassets.hpp"
+
+static const unsigned int COOKED_MESH_MAGIC = 0x48534D43; // "CMSH"
+
+unsigned long long hashBytes(const void * data, size_t size, unsigned long long hash){
+    const unsigned char * bytes = (const unsigned char *)data;
+    for (size_t i=0; i<size; i++){
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool hashFile(const char * path, unsigned long long & hash){
+    FILE * file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+    hash = HASH_SEED;
+    unsigned char buffer[64 * 1024];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        hash = hashBytes(buffer, read, hash);
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+std::string hashName(unsigned long long hash){
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", hash);
+    return name;
+}
+
+template <typename T>
+static void appendArray(std::vector<unsigned char> & bytes, const std::vector<T> & array){
+    if (array.empty())
+        return;
+    size_t offset = bytes.size();
+    bytes.resize(offset + array.size() * sizeof(T));
+    memcpy(&bytes[offset], &array[0], array.size() * sizeof(T));
+}
+
+static void appendUint(std::vector<unsigned char> & bytes, unsigned int value){
+    std::vector<unsigned int> one(1, value);
+    appendArray(bytes, one);
+}
+
+// Reads count elements at offset, advancing it
+template <typename T>
+static bool readArray(const unsigned char * data, size_t size, size_t & offset, size_t count, std::vector<T> & array){
+    if (count > (size - offset) / sizeof(T))
+        return false;
+    array.resize(count);
+    if (count > 0)
+        memcpy(&array[0], data + offset, count * sizeof(T));
+    offset += count * sizeof(T);
+    return true;
+}
+
+void serializeCookedMesh(const CookedMesh & mesh, std::vector<unsigned char> & bytes){
+    bytes.clear();
+    appendUint(bytes, COOKED_MESH_MAGIC);
+    appendUint(bytes, COOKED_MESH_VERSION);
+    appendUint(bytes, (unsigned int)mesh.vertices.size());
+    appendUint(bytes, (unsigned int)mesh.lodIndices.size());
+    appendUint(bytes, (unsigned int)mesh.lods.size());
+    appendArray(bytes, mesh.vertices);
+    appendArray(bytes, mesh.uvs);
+    appendArray(bytes, mesh.normals);
+    appendArray(bytes, mesh.tangents);
+    appendArray(bytes, mesh.bitangents);
+    appendArray(bytes, mesh.lodIndices);
+    if (mesh.lodIndices.size() % 2)
+        appendArray(bytes, std::vector<unsigned short>(1, 0)); // the LODs stay 4 bytes aligned
+    for (size_t l=0; l<mesh.lods.size(); l++){
+        appendUint(bytes, mesh.lods[l].indexOffset);
+        appendUint(bytes, mesh.lods[l].indexCount);
+        appendArray(bytes, std::vector<float>(1, mesh.lods[l].error));
+    }
+}
+
+bool deserializeCookedMesh(const unsigned char * data, size_t size, CookedMesh & mesh){
+    std::vector<unsigned int> header;
+    size_t offset = 0;
+    if (!readArray(data, size, offset, 5, header) || header[0] != COOKED_MESH_MAGIC){
+        printf("Not a cooked mesh\n");
+        return false;
+    }
+    if (header[1] != COOKED_MESH_VERSION){
+        printf("Cooked mesh version %u, expected %u : cook the assets again\n", header[1], COOKED_MESH_VERSION);
+        return false;
+    }
+    unsigned int vertexCount = header[2], indexCount = header[3], lodCount = header[4];
+    if (lodCount == 0){
+        printf("Cooked mesh without LOD 0\n");
+        return false;
+    }
+    std::vector<unsigned int> lods;
+    bool ok = readArray(data, size, offset, vertexCount, mesh.vertices)
+        && readArray(data, size, offset, vertexCount, mesh.uvs)
+        && readArray(data, size, offset, vertexCount, mesh.normals)
+        && readArray(data, size, offset, vertexCount, mesh.tangents)
+        && readArray(data, size, offset, vertexCount, mesh.bitangents)
+        && readArray(data, size, offset, indexCount, mesh.lodIndices);
+    offset += indexCount % 2 * sizeof(unsigned short);
+    // 3 values per LOD : checked before the multiply, which could wrap
+    ok = ok && offset <= size && lodCount <= (size - offset) / (3 * sizeof(unsigned int))
+        && readArray(data, size, offset, (size_t)lodCount * 3, lods);
+    if (!ok){
+        printf("Cooked mesh truncated\n");
+        return false;
+    }
+    mesh.lods.resize(lodCount);
+    for (unsigned int l=0; l<lodCount; l++){
+        mesh.lods[l].indexOffset = lods[l * 3];
+        mesh.lods[l].indexCount = lods[l * 3 + 1];
+        memcpy(&mesh.lods[l].error, &lods[l * 3 + 2], sizeof(float));
+        if (mesh.lods[l].indexOffset > indexCount || mesh.lods[l].indexCount > indexCount - mesh.lods[l].indexOffset){
+            printf("Cooked mesh LOD %u out of the index buffer\n", l);
+            return false;
+        }
+    }
+    for (unsigned int i=0; i<indexCount; i++){
+        if (mesh.lodIndices[i] >= vertexCount){
+            printf("Cooked mesh index %u out of the vertex buffer\n", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool loadCookedMesh(const char * path, CookedMesh & mesh){
+    MappedFile file;
+    if (!mapFile(path, file)){
+        printf("%s could not be opened\n", path);
+        return false;
+    }
+    bool ok = deserializeCookedMesh(file.data, file.size, mesh);
+    unmapFile(file);
+    return ok;
+}
+
+bool loadCookedAssets(const char * directory, CookedAssets & assets){
+    assets.directory = directory;
+    assets.files.clear();
+    std::string path = assets.directory + "/manifest.txt";
+    FILE * file = fopen(path.c_str(), "r");
+    if (file == NULL)
+        return false;
+
+    // "<cooked file> <source>" per line, the source last since it may hold spaces
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != NULL){
+        char * separator = strchr(line, ' ');
+        if (separator == NULL)
+            continue;
+        *separator = '\0';
+        std::string source = separator + 1;
+        while (!source.empty() && (source[source.size() - 1] == '\n' || source[source.size() - 1] == '\r'))
+            source.erase(source.size() - 1);
+        assets.files[source] = line;
+    }
+    fclose(file);
+    return true;
+}
+
+std::string cookedAssetPath(const CookedAssets & assets, const char * source){
+    std::map<std::string, std::string>::const_iterator it = assets.files.find(source);
+    if (it == assets.files.end())
+        return "";
+    return assets.directory + "/" + it->second;
+}
+
+std::string resolveAssetPath(const CookedAssets & assets, const char * source){
+    std::string path = cookedAssetPath(assets, source);
+    return path.empty() ? source : path;
+}
@@ -0,0 +1,52 @@
+#ifndef COOKEDASSETS_HPP
+#define COOKEDASSETS_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <glm/glm.hpp>
+
+#include "meshsimplify.hpp"
+
+// Bumped whenever the layout of a cooked mesh changes
+static const unsigned int COOKED_MESH_VERSION = 1;
+
+// An OBJ after loadOBJ, computeTangentBasis, indexVBO_TBN and buildLODChain : ready for glBufferData
+struct CookedMesh {
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec3> tangents;
+    std::vector<glm::vec3> bitangents;
+    std::vector<unsigned short> lodIndices; // all the LODs, LOD 0 first
+    std::vector<MeshLOD> lods;
+};
+
+// 64 bits FNV-1a. Chain calls by passing the previous hash.
+static const unsigned long long HASH_SEED = 14695981039346656037ULL;
+unsigned long long hashBytes(const void * data, size_t size, unsigned long long hash = HASH_SEED);
+bool hashFile(const char * path, unsigned long long & hash);
+// 16 hexadecimal digits : the name of a cooked file, before its extension
+std::string hashName(unsigned long long hash);
+
+// The file layout, little endian like every platform we ship on
+void serializeCookedMesh(const CookedMesh & mesh, std::vector<unsigned char> & bytes);
+// Never reads outside [data, data + size)
+bool deserializeCookedMesh(const unsigned char * data, size_t size, CookedMesh & mesh);
+bool loadCookedMesh(const char * path, CookedMesh & mesh);
+
+// Source path (relative to the asset tree, '/' separated) -> cooked file, from <directory>/manifest.txt
+struct CookedAssets {
+    std::string directory;
+    std::map<std::string, std::string> files;
+};
+
+// Returns false, with no entries, when the directory was never cooked
+bool loadCookedAssets(const char * directory, CookedAssets & assets);
+// The cooked file of a source, or "" when it has none
+std::string cookedAssetPath(const CookedAssets & assets, const char * source);
+// For formats the runtime reads either way (DDS) : the cooked file, else the source itself
+std::string resolveAssetPath(const CookedAssets & assets, const char * source);
+
+#endif
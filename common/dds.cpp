@@ -0,0 +1,506 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <GL/glew.h>
+
+#include "dds.hpp"
+#include "bcdecode.hpp"
+#include "gpuresources.hpp"
+#include "glcapture.hpp"
+
+// "DDS " magic + header, then the optional DX10 header. Fields below are read at their offset in the file.
+static const size_t DDS_HEADER_SIZE = 4 + 124;
+static const size_t DX10_HEADER_SIZE = 20;
+
+#define DDSD_CAPS          0x1
+#define DDSD_HEIGHT        0x2
+#define DDSD_WIDTH         0x4
+#define DDSD_PIXELFORMAT   0x1000
+#define DDSD_MIPMAPCOUNT   0x20000
+#define DDSD_LINEARSIZE    0x80000
+#define DDSD_DEPTH         0x800000
+#define DDPF_ALPHAPIXELS   0x1
+#define DDPF_FOURCC        0x4
+#define DDPF_RGB           0x40
+#define DDPF_LUMINANCE     0x20000
+#define DDSCAPS_COMPLEX    0x8
+#define DDSCAPS_TEXTURE    0x1000
+#define DDSCAPS_MIPMAP     0x400000
+#define DDSCAPS2_CUBEMAP   0x200
+#define DDSCAPS2_ALLFACES  0xFC00
+#define DDSCAPS2_VOLUME    0x200000
+
+#define DX10_DIMENSION_TEXTURE1D 2
+#define DX10_DIMENSION_TEXTURE2D 3
+#define DX10_DIMENSION_TEXTURE3D 4
+#define DX10_MISC_TEXTURECUBE    0x4
+
+#define MAKE_FOURCC(a, b, c, d) ((unsigned int)(a) | ((unsigned int)(b) << 8) | ((unsigned int)(c) << 16) | ((unsigned int)(d) << 24))
+
+// Limits : anything above is a broken or hostile file
+static const unsigned int MAX_DIMENSION = 16384;
+static const unsigned int MAX_DEPTH = 2048;
+static const unsigned int MAX_LAYERS = 2048;
+
+struct DDSFormat {
+    unsigned int dxgi;
+    GLenum internalFormat;
+    bool compressed;
+    GLenum format, type;
+    unsigned int blockBytes;
+};
+
+// DXGI formats we can upload as they are. Typeless formats are read as UNORM.
+static const DDSFormat DDS_FORMATS[] = {
+    {  2, GL_RGBA32F,       false, GL_RGBA, GL_FLOAT,         16 },
+    { 10, GL_RGBA16F,       false, GL_RGBA, GL_HALF_FLOAT,     8 },
+    { 28, GL_RGBA8,         false, GL_RGBA, GL_UNSIGNED_BYTE,  4 },
+    { 29, GL_SRGB8_ALPHA8,  false, GL_RGBA, GL_UNSIGNED_BYTE,  4 },
+    { 49, GL_RG8,           false, GL_RG,   GL_UNSIGNED_BYTE,  2 },
+    { 61, GL_R8,            false, GL_RED,  GL_UNSIGNED_BYTE,  1 },
+    { 87, GL_RGBA8,         false, GL_BGRA, GL_UNSIGNED_BYTE,  4 },
+    { 91, GL_SRGB8_ALPHA8,  false, GL_BGRA, GL_UNSIGNED_BYTE,  4 },
+    { 70, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT,       true, 0, 0,  8 }, // BC1
+    { 71, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT,       true, 0, 0,  8 },
+    { 72, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, true, 0, 0,  8 },
+    { 73, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT,       true, 0, 0, 16 }, // BC2
+    { 74, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT,       true, 0, 0, 16 },
+    { 75, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, true, 0, 0, 16 },
+    { 76, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,       true, 0, 0, 16 }, // BC3
+    { 77, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,       true, 0, 0, 16 },
+    { 78, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, true, 0, 0, 16 },
+    { 79, GL_COMPRESSED_RED_RGTC1,                true, 0, 0,  8 }, // BC4
+    { 80, GL_COMPRESSED_RED_RGTC1,                true, 0, 0,  8 },
+    { 81, GL_COMPRESSED_SIGNED_RED_RGTC1,         true, 0, 0,  8 },
+    { 82, GL_COMPRESSED_RG_RGTC2,                 true, 0, 0, 16 }, // BC5
+    { 83, GL_COMPRESSED_RG_RGTC2,                 true, 0, 0, 16 },
+    { 84, GL_COMPRESSED_SIGNED_RG_RGTC2,          true, 0, 0, 16 },
+    { 94, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT,  true, 0, 0, 16 }, // BC6H
+    { 95, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT,  true, 0, 0, 16 },
+    { 96, GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT,    true, 0, 0, 16 },
+    { 97, GL_COMPRESSED_RGBA_BPTC_UNORM,          true, 0, 0, 16 }, // BC7
+    { 98, GL_COMPRESSED_RGBA_BPTC_UNORM,          true, 0, 0, 16 },
+    { 99, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM,    true, 0, 0, 16 },
+};
+
+static const DDSFormat * findFormat(unsigned int dxgi){
+    for (size_t i=0; i<sizeof(DDS_FORMATS) / sizeof(DDS_FORMATS[0]); i++){
+        if (DDS_FORMATS[i].dxgi == dxgi)
+            return &DDS_FORMATS[i];
+    }
+    return NULL;
+}
+
+// Legacy headers : FourCC codes and RGB masks, mapped to their DXGI equivalent
+static unsigned int legacyFormat(const unsigned char * data){
+    unsigned int flags, fourCC, bits, r, g, b;
+    memcpy(&flags, data + 80, 4);
+    memcpy(&fourCC, data + 84, 4);
+    memcpy(&bits, data + 88, 4);
+    memcpy(&r, data + 92, 4);
+    memcpy(&g, data + 96, 4);
+    memcpy(&b, data + 100, 4);
+
+    if (flags & DDPF_FOURCC){
+        switch (fourCC){
+        case MAKE_FOURCC('D','X','T','1'): return 71;
+        case MAKE_FOURCC('D','X','T','2'):
+        case MAKE_FOURCC('D','X','T','3'): return 74;
+        case MAKE_FOURCC('D','X','T','4'):
+        case MAKE_FOURCC('D','X','T','5'): return 77;
+        case MAKE_FOURCC('A','T','I','1'):
+        case MAKE_FOURCC('B','C','4','U'): return 80;
+        case MAKE_FOURCC('B','C','4','S'): return 81;
+        case MAKE_FOURCC('A','T','I','2'):
+        case MAKE_FOURCC('B','C','5','U'): return 83;
+        case MAKE_FOURCC('B','C','5','S'): return 84;
+        case 113: return 10; // D3DFMT_A16B16G16R16F
+        case 116: return 2;  // D3DFMT_A32B32G32R32F
+        }
+        return 0;
+    }
+    if ((flags & DDPF_RGB) && bits == 32){
+        if (r == 0x000000FF && g == 0x0000FF00 && b == 0x00FF0000) return 28;
+        if (r == 0x00FF0000 && g == 0x0000FF00 && b == 0x000000FF) return 87;
+    }
+    // Luminance is read as red
+    if ((flags & DDPF_LUMINANCE) && bits == 8 && !(flags & DDPF_ALPHAPIXELS))
+        return 61;
+    return 0;
+}
+
+static unsigned int readUint(const unsigned char * data, size_t offset){
+    unsigned int value;
+    memcpy(&value, data + offset, 4);
+    return value;
+}
+
+size_t ddsSurfaceSize(const DDSImage & image, unsigned int width, unsigned int height, unsigned int depth){
+    unsigned long long size;
+    if (image.compressed)
+        size = (unsigned long long)((width + 3) / 4) * ((height + 3) / 4) * image.blockBytes * depth;
+    else
+        size = (unsigned long long)width * height * image.blockBytes * depth;
+    return size == (size_t)size ? (size_t)size : 0;
+}
+
+static bool fail(const char ** error, const char * reason){
+    if (error) *error = reason;
+    return false;
+}
+
+bool parseDDS(const unsigned char * data, size_t size, DDSImage & image, const char ** error){
+    if (data == NULL || size < DDS_HEADER_SIZE)
+        return fail(error, "file too small");
+    if (memcmp(data, "DDS ", 4) != 0)
+        return fail(error, "not a DDS file");
+    if (readUint(data, 4) != 124 || readUint(data, 76) != 32)
+        return fail(error, "bad header size");
+
+    unsigned int flags    = readUint(data, 8);
+    unsigned int height   = readUint(data, 12);
+    unsigned int width    = readUint(data, 16);
+    unsigned int depth    = readUint(data, 24);
+    unsigned int mipCount = (flags & DDSD_MIPMAPCOUNT) ? readUint(data, 28) : 1;
+    unsigned int caps2    = readUint(data, 112);
+    unsigned int fourCC   = readUint(data, 84);
+    bool dx10 = (readUint(data, 80) & DDPF_FOURCC) && fourCC == MAKE_FOURCC('D','X','1','0');
+
+    size_t dataOffset = DDS_HEADER_SIZE;
+    unsigned int dxgi, layers = 1, faces = 1;
+    bool volume = false;
+    if (dx10){
+        if (size < DDS_HEADER_SIZE + DX10_HEADER_SIZE)
+            return fail(error, "truncated DX10 header");
+        dxgi = readUint(data, 128);
+        unsigned int dimension = readUint(data, 132);
+        unsigned int miscFlag  = readUint(data, 136);
+        layers = readUint(data, 140);
+        dataOffset += DX10_HEADER_SIZE;
+
+        if (dimension == DX10_DIMENSION_TEXTURE1D) height = std::max(1u, height);
+        else if (dimension == DX10_DIMENSION_TEXTURE3D) volume = true;
+        else if (dimension != DX10_DIMENSION_TEXTURE2D) return fail(error, "unknown resource dimension");
+        if (miscFlag & DX10_MISC_TEXTURECUBE) faces = 6;
+    }
+    else {
+        dxgi = legacyFormat(data);
+        if (caps2 & DDSCAPS2_CUBEMAP){
+            if ((caps2 & DDSCAPS2_ALLFACES) != DDSCAPS2_ALLFACES)
+                return fail(error, "partial cubemaps are not supported");
+            faces = 6;
+        }
+        if (caps2 & DDSCAPS2_VOLUME) volume = true;
+    }
+
+    const DDSFormat * format = findFormat(dxgi);
+    if (format == NULL)
+        return fail(error, "unsupported format");
+
+    depth = volume ? std::max(1u, depth) : 1;
+    mipCount = std::max(1u, mipCount);
+    if (width == 0 || height == 0 || width > MAX_DIMENSION || height > MAX_DIMENSION || depth > MAX_DEPTH)
+        return fail(error, "bad dimensions");
+    if (layers == 0 || layers > MAX_LAYERS)
+        return fail(error, "bad array size");
+    if (faces == 6 && (width != height || volume))
+        return fail(error, "bad cubemap");
+    if (volume && layers > 1)
+        return fail(error, "arrays of 3D textures are not supported");
+
+    unsigned int fullChain = 1;
+    for (unsigned int m = std::max(std::max(width, height), depth); m > 1; m /= 2)
+        fullChain++;
+    if (mipCount > fullChain)
+        return fail(error, "too many mip levels");
+
+    image.internalFormat = format->internalFormat;
+    image.compressed = format->compressed;
+    image.format = format->format;
+    image.type = format->type;
+    image.blockBytes = format->blockBytes;
+    image.width = width;
+    image.height = height;
+    image.depth = depth;
+    image.levels = mipCount;
+    image.layers = layers;
+    image.faces = faces;
+    if (volume) image.target = GL_TEXTURE_3D;
+    else if (faces == 6) image.target = layers > 1 ? GL_TEXTURE_CUBE_MAP_ARRAY : GL_TEXTURE_CUBE_MAP;
+    else image.target = layers > 1 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+
+    // Layer after layer, each with all its faces, each with all its levels
+    image.surfaces.clear();
+    size_t offset = dataOffset;
+    for (unsigned int layer=0; layer<layers; layer++){
+        for (unsigned int face=0; face<faces; face++){
+            for (unsigned int level=0; level<mipCount; level++){
+                DDSSurface surface;
+                surface.layer = layer;
+                surface.face = face;
+                surface.level = level;
+                surface.width = std::max(1u, width >> level);
+                surface.height = std::max(1u, height >> level);
+                surface.depth = std::max(1u, depth >> level);
+                surface.offset = offset;
+                surface.size = ddsSurfaceSize(image, surface.width, surface.height, surface.depth);
+                if (surface.size == 0 || surface.size > size - offset)
+                    return fail(error, "truncated data");
+                offset += surface.size;
+                image.surfaces.push_back(surface);
+            }
+        }
+    }
+    return true;
+}
+
+static void writeUint(unsigned char * data, size_t offset, unsigned int value){
+    memcpy(data + offset, &value, 4);
+}
+
+bool writeDDS(const char * path, const DDSImage & image, const unsigned char * data){
+    unsigned int fourCC = 0;
+    if (image.layers == 1 && image.target != GL_TEXTURE_3D){
+        switch (image.internalFormat){
+        case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT: fourCC = MAKE_FOURCC('D','X','T','1'); break;
+        case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT: fourCC = MAKE_FOURCC('D','X','T','3'); break;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: fourCC = MAKE_FOURCC('D','X','T','5'); break;
+        }
+    }
+    // DX10 : the table lists the typeless code of a format first, the UNORM one after it
+    unsigned int dxgi = 0;
+    if (fourCC == 0){
+        for (size_t i=0; i<sizeof(DDS_FORMATS) / sizeof(DDS_FORMATS[0]); i++){
+            const DDSFormat & f = DDS_FORMATS[i];
+            if (f.internalFormat == image.internalFormat && (image.compressed || (f.format == image.format && f.type == image.type)))
+                dxgi = f.dxgi;
+        }
+        if (dxgi == 0){
+            printf("Format 0x%04X can't be written to a .DDS file\n", image.internalFormat);
+            return false;
+        }
+    }
+
+    unsigned char header[DDS_HEADER_SIZE + DX10_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    memcpy(header, "DDS ", 4);
+    bool volume = image.target == GL_TEXTURE_3D;
+    writeUint(header, 4, 124);
+    writeUint(header, 8, DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | (image.compressed ? DDSD_LINEARSIZE : 0) | (volume ? DDSD_DEPTH : 0));
+    writeUint(header, 12, image.height);
+    writeUint(header, 16, image.width);
+    writeUint(header, 20, (unsigned int)image.surfaces[0].size);
+    writeUint(header, 24, volume ? image.depth : 0);
+    writeUint(header, 28, image.levels);
+    writeUint(header, 76, 32);
+    writeUint(header, 80, DDPF_FOURCC);
+    writeUint(header, 84, fourCC != 0 ? fourCC : MAKE_FOURCC('D','X','1','0'));
+    writeUint(header, 108, DDSCAPS_TEXTURE | (image.levels > 1 ? DDSCAPS_MIPMAP | DDSCAPS_COMPLEX : 0) | (image.faces == 6 || volume ? DDSCAPS_COMPLEX : 0));
+    writeUint(header, 112, (image.faces == 6 ? DDSCAPS2_CUBEMAP | DDSCAPS2_ALLFACES : 0) | (volume ? DDSCAPS2_VOLUME : 0));
+    if (fourCC == 0){
+        writeUint(header, 128, dxgi);
+        writeUint(header, 132, volume ? DX10_DIMENSION_TEXTURE3D : DX10_DIMENSION_TEXTURE2D);
+        writeUint(header, 136, image.faces == 6 ? DX10_MISC_TEXTURECUBE : 0);
+        writeUint(header, 140, image.layers);
+    }
+
+    FILE * file = fopen(path, "wb");
+    if (!file){
+        printf("%s could not be written\n", path);
+        return false;
+    }
+    size_t headerSize = fourCC != 0 ? DDS_HEADER_SIZE : sizeof(header);
+    bool ok = fwrite(header, 1, headerSize, file) == headerSize;
+    for (size_t i=0; ok && i<image.surfaces.size(); i++)
+        ok = fwrite(data + image.surfaces[i].offset, 1, image.surfaces[i].size, file) == image.surfaces[i].size;
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+        printf("%s could not be written\n", path);
+    return ok;
+}
+
+bool mapFile(const char * path, MappedFile & file){
+    file.data = NULL;
+    file.size = 0;
+    file.handle = NULL;
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0){
+        CloseHandle(handle);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(handle);
+    if (mapping == NULL)
+        return false;
+    file.data = (const unsigned char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (file.data == NULL){
+        CloseHandle(mapping);
+        return false;
+    }
+    file.size = (size_t)size.QuadPart;
+    file.handle = mapping;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0){
+        close(fd);
+        return false;
+    }
+    void * data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+    file.data = (const unsigned char *)data;
+    file.size = info.st_size;
+#endif
+    return true;
+}
+
+void unmapFile(MappedFile & file){
+    if (file.data == NULL)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(file.data);
+    CloseHandle((HANDLE)file.handle);
+#else
+    munmap((void *)file.data, file.size);
+#endif
+    file.data = NULL;
+    file.size = 0;
+}
+
+static bool hasExtension(const char * name){
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i=0; i<count; i++){
+        const char * extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+void queryDDSSupport(DDSSupport & support){
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    int version = major * 10 + minor;
+
+    support.s3tc = hasExtension("GL_EXT_texture_compression_s3tc");
+    // The sRGB variants come with EXT_texture_sRGB, or EXT_texture_compression_s3tc_srgb on newer drivers
+    support.s3tcSRGB = support.s3tc && (hasExtension("GL_EXT_texture_sRGB") || hasExtension("GL_EXT_texture_compression_s3tc_srgb"));
+    support.bptc = version >= 42 || hasExtension("GL_ARB_texture_compression_bptc");
+    support.cubeMapArray = version >= 40 || hasExtension("GL_ARB_texture_cube_map_array");
+}
+
+bool ddsFormatSupported(const DDSSupport & support, GLenum internalFormat){
+    switch (internalFormat){
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        return support.s3tc;
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+        return support.s3tcSRGB;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM_ARB:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM_ARB:
+    case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT_ARB:
+    case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT_ARB:
+        return support.bptc;
+    }
+    return true;
+}
+
+GLuint uploadDDS(const DDSImage & image, const unsigned char * data, const char * tag){
+    DDSSupport support;
+    queryDDSSupport(support);
+    if (image.target == GL_TEXTURE_CUBE_MAP_ARRAY && !support.cubeMapArray){
+        printf("Cubemap arrays are not supported by this GPU\n");
+        return 0;
+    }
+    if (!ddsFormatSupported(support, image.internalFormat)){
+        // Software fallback : 4 to 8 times the memory, but it works everywhere
+        DDSImage decoded;
+        std::vector<unsigned char> pixels;
+        if (!decodeDDSImage(image, data, decoded, pixels, std::max(1u, std::thread::hardware_concurrency()))){
+            printf("This GPU can't sample the texture format 0x%04X, and it can't be decoded in software\n", image.internalFormat);
+            return 0;
+        }
+        printf("Texture format 0x%04X is not supported by this GPU : decoded to RGBA8\n", image.internalFormat);
+        return uploadDDS(decoded, &pixels[0], tag);
+    }
+
+    GLuint textureID = createGPUResource(GPU_TEXTURE, tag);
+    glBindTexture(image.target, textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    size_t bytes = 0;
+    for (size_t i=0; i<image.surfaces.size(); i++)
+        bytes += image.surfaces[i].size;
+    setGPUResourceBytes(GPU_TEXTURE, textureID, bytes);
+
+    bool layered = image.target == GL_TEXTURE_2D_ARRAY || image.target == GL_TEXTURE_CUBE_MAP_ARRAY;
+    if (layered){
+        // The file stores each layer with all its levels : gather the layers of each level
+        std::vector<unsigned char> level;
+        unsigned int count = image.layers * image.faces;
+        for (unsigned int l=0; l<image.levels; l++){
+            const DDSSurface & first = image.surfaces[l];
+            level.resize(first.size * count);
+            for (unsigned int i=0; i<count; i++)
+                memcpy(&level[first.size * i], data + image.surfaces[i * image.levels + l].offset, first.size);
+            if (image.compressed)
+                glCompressedTexImage3D(image.target, l, image.internalFormat, first.width, first.height, count, 0, (GLsizei)level.size(), &level[0]);
+            else
+                glTexImage3D(image.target, l, image.internalFormat, first.width, first.height, count, 0, image.format, image.type, &level[0]);
+        }
+    }
+    else {
+        // Straight from the file
+        for (size_t i=0; i<image.surfaces.size(); i++){
+            const DDSSurface & s = image.surfaces[i];
+            const unsigned char * pixels = data + s.offset;
+            if (image.target == GL_TEXTURE_3D){
+                if (image.compressed)
+                    glCompressedTexImage3D(GL_TEXTURE_3D, s.level, image.internalFormat, s.width, s.height, s.depth, 0, (GLsizei)s.size, pixels);
+                else
+                    glTexImage3D(GL_TEXTURE_3D, s.level, image.internalFormat, s.width, s.height, s.depth, 0, image.format, image.type, pixels);
+            }
+            else {
+                GLenum target = image.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + s.face : GL_TEXTURE_2D;
+                if (image.compressed)
+                    glCompressedTexImage2D(target, s.level, image.internalFormat, s.width, s.height, 0, (GLsizei)s.size, pixels);
+                else
+                    glTexImage2D(target, s.level, image.internalFormat, s.width, s.height, 0, image.format, image.type, pixels);
+            }
+        }
+    }
+
+    GLenum wrap = image.faces == 6 ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+    glTexParameteri(image.target, GL_TEXTURE_MAX_LEVEL, image.levels - 1);
+    glTexParameteri(image.target, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(image.target, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(image.target, GL_TEXTURE_WRAP_R, wrap);
+    glTexParameteri(image.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(image.target, GL_TEXTURE_MIN_FILTER, image.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+
+    return textureID;
+}
@@ -0,0 +1,63 @@
+#ifndef DDS_HPP
+#define DDS_HPP
+
+#include <vector>
+#include <stddef.h>
+#include <GL/glew.h>
+
+// Read-only view of a whole file, mapped in memory
+struct MappedFile {
+    const unsigned char * data;
+    size_t size;
+    void * handle; // platform specific
+};
+
+// One mip level of one face of one array layer, in the order of the file
+struct DDSSurface {
+    unsigned int layer, face, level;
+    unsigned int width, height, depth;
+    size_t offset, size; // in the file
+};
+
+struct DDSImage {
+    GLenum target;         // GL_TEXTURE_2D, _CUBE_MAP, _2D_ARRAY, _CUBE_MAP_ARRAY or _3D
+    GLenum internalFormat;
+    bool compressed;       // 4x4 blocks of blockBytes, else pixels of blockBytes
+    GLenum format, type;   // for uncompressed formats
+    unsigned int blockBytes;
+    unsigned int width, height, depth;
+    unsigned int levels, layers, faces;
+    std::vector<DDSSurface> surfaces; // layers x faces x levels
+};
+
+bool mapFile(const char * path, MappedFile & file);
+void unmapFile(MappedFile & file);
+
+// Validates the header (legacy or DX10) and computes the exact size and offset of every surface.
+// Never reads outside [data, data + size). On failure, error says why.
+bool parseDDS(const unsigned char * data, size_t size, DDSImage & image, const char ** error);
+
+// Writes image as a .DDS file, its surfaces read from data at their offset.
+// DXT1/3/5 2D textures and cubemaps get a legacy header, everything else a DX10 one.
+bool writeDDS(const char * path, const DDSImage & image, const unsigned char * data);
+
+// Bytes of one surface of a format, 0 if it doesn't fit in size_t
+size_t ddsSurfaceSize(const DDSImage & image, unsigned int width, unsigned int height, unsigned int depth);
+
+// What the current context can sample. GLEW fills its extension flags from glGetString(GL_EXTENSIONS),
+// which core profiles don't have : this asks glGetStringi instead. Must be called with a current context.
+struct DDSSupport {
+    bool s3tc, s3tcSRGB;  // BC1-3
+    bool bptc;            // BC6H, BC7
+    bool cubeMapArray;
+};
+void queryDDSSupport(DDSSupport & support);
+
+// RGTC and the uncompressed formats are core in 3.3
+bool ddsFormatSupported(const DDSSupport & support, GLenum internalFormat);
+
+// Creates a texture of image.target, uploading straight from data (usually a MappedFile).
+// BC1-5 formats the context can't sample are decoded to RGBA8 first. tag names it in the GPU resource reports.
+GLuint uploadDDS(const DDSImage & image, const unsigned char * data, const char * tag = "DDS");
+
+#endif
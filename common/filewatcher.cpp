@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+#include "filewatcher.hpp"
+
+static std::string directoryOf(const std::string & path){
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+static time_t modificationTime(const std::string & path){
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? info.st_mtime : 0;
+}
+
+void initFileWatcher(FileWatcher & watcher){
+    watcher.fd = -1;
+    watcher.directories.clear();
+    watcher.files.clear();
+    watcher.modified.clear();
+#ifdef __linux__
+    watcher.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher.fd == -1)
+        printf("inotify_init1 failed (%s) : polling modification times instead\n", strerror(errno));
+#endif
+}
+
+void watchFile(FileWatcher & watcher, const std::string & path){
+    if (!watcher.files.insert(path).second)
+        return;
+    if (watcher.fd == -1){
+        watcher.modified[path] = modificationTime(path);
+        return;
+    }
+#ifdef __linux__
+    std::string directory = directoryOf(path);
+    for (std::map<int, std::string>::const_iterator it = watcher.directories.begin(); it != watcher.directories.end(); ++it)
+        if (it->second == directory)
+            return;
+    int wd = inotify_add_watch(watcher.fd, directory.empty() ? "." : directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd == -1){
+        printf("Can't watch %s (%s)\n", directory.c_str(), strerror(errno));
+        return;
+    }
+    watcher.directories[wd] = directory;
+#endif
+}
+
+// Adds path to changed if it is watched and not there yet
+static void addChange(const FileWatcher & watcher, const std::string & path, std::vector<std::string> & changed){
+    if (watcher.files.count(path) == 0)
+        return;
+    for (size_t i=0; i<changed.size(); i++)
+        if (changed[i] == path)
+            return;
+    changed.push_back(path);
+}
+
+void pollFileWatcher(FileWatcher & watcher, std::vector<std::string> & changed){
+    changed.clear();
+    if (watcher.fd == -1){
+        for (std::map<std::string, time_t>::iterator it = watcher.modified.begin(); it != watcher.modified.end(); ++it){
+            time_t time = modificationTime(it->first);
+            if (time != it->second){
+                it->second = time;
+                addChange(watcher, it->first, changed);
+            }
+        }
+        return;
+    }
+#ifdef __linux__
+    // Events are variable sized : a name follows each header
+    alignas(struct inotify_event) char buffer[4096];
+    for (;;){
+        ssize_t size = read(watcher.fd, buffer, sizeof(buffer));
+        if (size <= 0)
+            break; // EAGAIN : nothing more
+        for (ssize_t offset = 0; offset < size; ){
+            const struct inotify_event * event = (const struct inotify_event *)(buffer + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+            std::map<int, std::string>::const_iterator directory = watcher.directories.find(event->wd);
+            if (directory != watcher.directories.end() && event->len > 0)
+                addChange(watcher, directory->second + event->name, changed);
+        }
+    }
+#endif
+}
+
+void cleanupFileWatcher(FileWatcher & watcher){
+#ifdef __linux__
+    if (watcher.fd != -1)
+        close(watcher.fd);
+#endif
+    watcher.fd = -1;
+    watcher.directories.clear();
+    watcher.files.clear();
+    watcher.modified.clear();
+}
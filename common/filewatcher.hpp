@@ -0,0 +1,29 @@
+#ifndef FILEWATCHER_HPP
+#define FILEWATCHER_HPP
+
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include <time.h>
+
+// Tells which of a set of files were written. On Linux, inotify watches their directories : editors that save to a
+// new file and rename it over the old one are seen too. Elsewhere, the modification times are compared on each poll.
+struct FileWatcher {
+    int fd;                                  // inotify, -1 when polling
+    std::map<int, std::string> directories;  // by watch descriptor, with their trailing '/', empty for the working one
+    std::set<std::string> files;             // as they were given
+    std::map<std::string, time_t> modified;  // when polling
+};
+
+void initFileWatcher(FileWatcher & watcher);
+
+// Paths are compared as strings : give them the way the changes will be looked up
+void watchFile(FileWatcher & watcher, const std::string & path);
+
+// Never blocks. The watched files written since the last poll, each once.
+void pollFileWatcher(FileWatcher & watcher, std::vector<std::string> & changed);
+
+void cleanupFileWatcher(FileWatcher & watcher);
+
+#endif
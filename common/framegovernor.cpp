@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <GL/glew.h>
+
+#include "framegovernor.hpp"
+#include "gpuresources.hpp"
+#include "glcapture.hpp"
+
+// Sleeping is only precise to a millisecond or two : the rest of the wait is spent spinning
+static const double SPIN_TIME = 0.002;
+
+static double now(){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void resetStats(FrameStats & stats){
+    stats.count = stats.gpuCount = 0;
+    stats.minScale = 1e9f;
+    stats.maxScale = stats.scaleSum = 0.0f;
+    stats.gpuSum = stats.frameSum = stats.frameMax = 0.0f;
+}
+
+void initFrameGovernor(FrameGovernor & governor, float targetMs, float fpsCap, int samples, bool keepHistory){
+    governor.targetMs = targetMs;
+    governor.minScale = 0.5f;
+    governor.maxScale = 1.0f;
+    governor.kp = 0.15f; // tuned for the 3 frames of query latency
+    governor.ki = 0.03f;
+    governor.kd = 0.05f;
+    governor.integral = 0.0f;
+    governor.previousError = 0.0f;
+    governor.scale = governor.maxScale;
+
+    governor.fpsCap = fpsCap;
+    governor.nextFrameTime = now();
+    governor.lastFrameStart = 0.0;
+
+    governor.samples = samples;
+    governor.width = governor.height = 0;
+    governor.renderWidth = governor.renderHeight = 0;
+    governor.fbo = governor.colorBuffer = governor.depthBuffer = 0;
+    governor.resolveFbo = governor.resolveBuffer = 0;
+
+    glGenQueries(GOVERNOR_QUERY_COUNT, governor.queries);
+    governor.frame = 0;
+    resetStats(governor.stats);
+    governor.keepHistory = keepHistory;
+    governor.history.clear();
+}
+
+static void deleteTargets(FrameGovernor & governor){
+    glDeleteFramebuffers(1, &governor.fbo);
+    deleteGPUResource(GPU_RENDERBUFFER, governor.colorBuffer);
+    deleteGPUResource(GPU_RENDERBUFFER, governor.depthBuffer);
+    glDeleteFramebuffers(1, &governor.resolveFbo);
+    deleteGPUResource(GPU_RENDERBUFFER, governor.resolveBuffer);
+    governor.fbo = governor.colorBuffer = governor.depthBuffer = 0;
+    governor.resolveFbo = governor.resolveBuffer = 0;
+}
+
+static GLuint createRenderbuffer(const char * tag, GLenum format, int samples, int width, int height){
+    GLuint buffer = createGPUResource(GPU_RENDERBUFFER, tag);
+    glBindRenderbuffer(GL_RENDERBUFFER, buffer);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, format, width, height);
+    // Each sample is a layer's worth
+    setGPUResourceBytes(GPU_RENDERBUFFER, buffer, gpuTextureBytes(format, width, height, std::max(1, samples), 1));
+    return buffer;
+}
+
+static void createTargets(FrameGovernor & governor, int width, int height){
+    deleteTargets(governor);
+    governor.width = width;
+    governor.height = height;
+
+    int samples = governor.samples > 1 ? governor.samples : 0;
+    governor.colorBuffer = createRenderbuffer("scene color", GL_RGBA8, samples, width, height);
+    governor.depthBuffer = createRenderbuffer("scene depth", GL_DEPTH_COMPONENT24, samples, width, height);
+    glGenFramebuffers(1, &governor.fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, governor.fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, governor.colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, governor.depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        printf("Frame governor : incomplete framebuffer (%d samples)\n", samples);
+
+    if (samples > 0){
+        governor.resolveBuffer = createRenderbuffer("scene resolve", GL_RGBA8, 0, width, height);
+        glGenFramebuffers(1, &governor.resolveFbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, governor.resolveFbo);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, governor.resolveBuffer);
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+}
+
+void beginScaledFrame(FrameGovernor & governor, int windowWidth, int windowHeight){
+    double start = now();
+    FrameSample & sample = governor.current;
+    sample.scale = governor.scale;
+    sample.gpuMs = -1.0f;
+    sample.frameMs = governor.lastFrameStart > 0.0 ? (float)((start - governor.lastFrameStart) * 1000.0) : 0.0f;
+    governor.lastFrameStart = start;
+
+    if (windowWidth != governor.width || windowHeight != governor.height)
+        createTargets(governor, windowWidth, windowHeight);
+
+    governor.renderWidth = std::max(1, (int)(windowWidth * governor.scale));
+    governor.renderHeight = std::max(1, (int)(windowHeight * governor.scale));
+    glBindFramebuffer(GL_FRAMEBUFFER, governor.fbo);
+    glViewport(0, 0, governor.renderWidth, governor.renderHeight);
+
+    glBeginQuery(GL_TIME_ELAPSED, governor.queries[governor.frame % GOVERNOR_QUERY_COUNT]);
+}
+
+// PID on the relative error. The integral holds the steady state scale offset,
+// and is clamped so that it can't wind up past what the scale range can absorb.
+static void updateScale(FrameGovernor & governor, float gpuMs){
+    float error = (governor.targetMs - gpuMs) / governor.targetMs;
+    governor.integral += error;
+    governor.integral = std::min(std::max(governor.integral, (governor.minScale - governor.maxScale) / governor.ki), 0.0f);
+    float derivative = error - governor.previousError;
+    governor.previousError = error;
+
+    float scale = governor.maxScale + governor.kp * error + governor.ki * governor.integral + governor.kd * derivative;
+    governor.scale = std::min(std::max(scale, governor.minScale), governor.maxScale);
+}
+
+void endScaledFrame(FrameGovernor & governor, int windowWidth, int windowHeight){
+    glEndQuery(GL_TIME_ELAPSED);
+
+    // Multisampled buffers must be resolved at the same size before they can be scaled
+    GLuint source = governor.fbo;
+    if (governor.resolveFbo != 0){
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, governor.fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, governor.resolveFbo);
+        glBlitFramebuffer(0, 0, governor.renderWidth, governor.renderHeight, 0, 0, governor.renderWidth, governor.renderHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        source = governor.resolveFbo;
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, source);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, governor.renderWidth, governor.renderHeight, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, windowWidth, windowHeight);
+    glClear(GL_DEPTH_BUFFER_BIT); // For what is drawn on top, at full resolution
+
+    // Oldest query : issued GOVERNOR_QUERY_COUNT - 1 frames ago
+    governor.frame++;
+    if (governor.frame >= GOVERNOR_QUERY_COUNT){
+        GLuint query = governor.queries[governor.frame % GOVERNOR_QUERY_COUNT];
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available){
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+            float gpuMs = (float)(elapsed / 1000000.0);
+            governor.current.gpuMs = gpuMs;
+            updateScale(governor, gpuMs);
+        }
+    }
+
+    const FrameSample & sample = governor.current;
+    FrameStats & stats = governor.stats;
+    stats.count++;
+    stats.minScale = std::min(stats.minScale, sample.scale);
+    stats.maxScale = std::max(stats.maxScale, sample.scale);
+    stats.scaleSum += sample.scale;
+    if (sample.gpuMs >= 0.0f){
+        stats.gpuSum += sample.gpuMs;
+        stats.gpuCount++;
+    }
+    stats.frameSum += sample.frameMs;
+    stats.frameMax = std::max(stats.frameMax, sample.frameMs);
+    if (governor.keepHistory)
+        governor.history.push_back(sample);
+}
+
+void paceFrame(FrameGovernor & governor){
+    if (governor.fpsCap <= 0.0f)
+        return;
+
+    double period = 1.0 / governor.fpsCap;
+    double current = now();
+    governor.nextFrameTime += period;
+    // Too late : start again from now instead of rushing the next frames
+    if (governor.nextFrameTime < current){
+        governor.nextFrameTime = current;
+        return;
+    }
+
+    double sleepTime = governor.nextFrameTime - current - SPIN_TIME;
+    if (sleepTime > 0.0)
+        std::this_thread::sleep_for(std::chrono::duration<double>(sleepTime));
+    while (now() < governor.nextFrameTime)
+        ;
+}
+
+void printFrameGovernorStats(FrameGovernor & governor){
+    const FrameStats & stats = governor.stats;
+    if (stats.count == 0)
+        return;
+
+    printf("Governor : scale %.2f (%.2f - %.2f), GPU %.2f ms (target %.2f), frame %.2f ms avg, %.2f ms max\n",
+        stats.scaleSum / stats.count, stats.minScale, stats.maxScale, stats.gpuCount > 0 ? stats.gpuSum / stats.gpuCount : 0.0f,
+        governor.targetMs, stats.frameSum / stats.count, stats.frameMax);
+    resetStats(governor.stats);
+}
+
+bool writeFrameGovernorLog(const FrameGovernor & governor, const char * path){
+    FILE * file = fopen(path, "w");
+    if (file == NULL){
+        printf("Impossible to open %s\n", path);
+        return false;
+    }
+    fprintf(file, "frame,scale,gpu_ms,frame_ms\n");
+    for (size_t i=0; i<governor.history.size(); i++){
+        const FrameSample & sample = governor.history[i];
+        fprintf(file, "%u,%.3f,%.3f,%.3f\n", (unsigned int)i, sample.scale, sample.gpuMs, sample.frameMs);
+    }
+    fclose(file);
+    return true;
+}
+
+void cleanupFrameGovernor(FrameGovernor & governor){
+    deleteTargets(governor);
+    glDeleteQueries(GOVERNOR_QUERY_COUNT, governor.queries);
+}
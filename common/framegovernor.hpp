@@ -0,0 +1,74 @@
+#ifndef FRAMEGOVERNOR_HPP
+#define FRAMEGOVERNOR_HPP
+
+#include <vector>
+#include <GL/glew.h>
+
+// GPU scene time is read back a few frames late, so the queries are never waited on
+static const int GOVERNOR_QUERY_COUNT = 4;
+
+struct FrameSample {
+    float scale;
+    float gpuMs;   // scene pass, read back GOVERNOR_QUERY_COUNT - 1 frames later, -1 if not available
+    float frameMs; // CPU, start to start
+};
+
+// Frames since the last printFrameGovernorStats
+struct FrameStats {
+    unsigned int count, gpuCount;
+    float minScale, maxScale, scaleSum;
+    float gpuSum, frameSum, frameMax;
+};
+
+// Renders the scene into an offscreen target whose resolution follows a frame time budget,
+// then upscales it to the backbuffer. Optionally caps the frame rate.
+struct FrameGovernor {
+    // Controller
+    float targetMs;          // GPU budget of the scene pass
+    float minScale, maxScale;
+    float kp, ki, kd;        // on the relative error (target - gpu) / target
+    float integral, previousError;
+    float scale;             // of each axis, in [minScale, maxScale]
+
+    // Pacing
+    float fpsCap;            // 0 : no cap
+    double nextFrameTime;
+    double lastFrameStart;
+
+    // Offscreen target, allocated at full size : only the viewport changes with the scale
+    int samples;
+    int width, height;       // allocated size
+    int renderWidth, renderHeight; // this frame
+    GLuint fbo, colorBuffer, depthBuffer;
+    GLuint resolveFbo, resolveBuffer; // when multisampled : scaled blits can't read multisampled buffers
+
+    GLuint queries[GOVERNOR_QUERY_COUNT];
+    unsigned int frame;
+
+    FrameSample current;
+    FrameStats stats;
+    bool keepHistory;
+    std::vector<FrameSample> history; // one per frame, only with keepHistory
+};
+
+// keepHistory : every frame is kept for writeFrameGovernorLog, otherwise only the statistics are
+void initFrameGovernor(FrameGovernor & governor, float targetMs, float fpsCap, int samples, bool keepHistory);
+
+// Call at the start of the frame, with the backbuffer size : binds the offscreen target at the current scale
+void beginScaledFrame(FrameGovernor & governor, int windowWidth, int windowHeight);
+
+// Upscales to the backbuffer, which stays bound, and updates the scale for the next frame
+void endScaledFrame(FrameGovernor & governor, int windowWidth, int windowHeight);
+
+// Call right before swapping : sleeps, then spins until the capped frame time is reached
+void paceFrame(FrameGovernor & governor);
+
+// Prints a summary of the frames since the last call
+void printFrameGovernorStats(FrameGovernor & governor);
+
+// Writes the whole history as CSV (needs keepHistory) : frame, scale, GPU ms, frame ms
+bool writeFrameGovernorLog(const FrameGovernor & governor, const char * path);
+
+void cleanupFrameGovernor(FrameGovernor & governor);
+
+#endif
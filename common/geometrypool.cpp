@@ -0,0 +1,460 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "gpuresources.hpp"
+#include "geometrypool.hpp"
+
+static const unsigned int SL_COUNT = 1 << TLSF_SL_BITS;
+
+// Index of the lowest / highest set bit. x must not be 0.
+static int lowestBit(unsigned int x){
+#if defined(__GNUC__)
+    return __builtin_ctz(x);
+#else
+    int bit = 0;
+    while ((x & 1) == 0){ x >>= 1; bit++; }
+    return bit;
+#endif
+}
+
+static int highestBit(unsigned int x){
+#if defined(__GNUC__)
+    return 31 - __builtin_clz(x);
+#else
+    int bit = 0;
+    while (x >>= 1) bit++;
+    return bit;
+#endif
+}
+
+// Size class : sizes under SL_COUNT get one list each, larger ones SL_COUNT lists per power of two
+static void mapping(unsigned int size, int & fl, int & sl){
+    if (size < SL_COUNT){
+        fl = 0;
+        sl = (int)size;
+        return;
+    }
+    int f = highestBit(size);
+    fl = f - TLSF_SL_BITS + 1;
+    sl = (int)((size >> (f - TLSF_SL_BITS)) - SL_COUNT);
+}
+
+static int newBlock(RangeAllocator & allocator){
+    if (!allocator.unusedBlocks.empty()){
+        int block = allocator.unusedBlocks.back();
+        allocator.unusedBlocks.pop_back();
+        return block;
+    }
+    allocator.blocks.push_back(TLSFBlock());
+    return (int)allocator.blocks.size() - 1;
+}
+
+static void releaseBlock(RangeAllocator & allocator, int block){
+    TLSFBlock & b = allocator.blocks[block];
+    b.size = 0;
+    b.free = false;
+    allocator.unusedBlocks.push_back(block);
+}
+
+static void insertFree(RangeAllocator & allocator, int block){
+    TLSFBlock & b = allocator.blocks[block];
+    int fl, sl;
+    mapping(b.size, fl, sl);
+    int & head = allocator.heads[fl][sl];
+    b.free = true;
+    b.prevFree = -1;
+    b.nextFree = head;
+    if (head != -1)
+        allocator.blocks[head].prevFree = block;
+    head = block;
+    allocator.flBitmap |= 1u << fl;
+    allocator.slBitmaps[fl] |= 1u << sl;
+}
+
+static void removeFree(RangeAllocator & allocator, int block){
+    TLSFBlock & b = allocator.blocks[block];
+    int fl, sl;
+    mapping(b.size, fl, sl);
+    if (b.prevFree != -1)
+        allocator.blocks[b.prevFree].nextFree = b.nextFree;
+    else
+        allocator.heads[fl][sl] = b.nextFree;
+    if (b.nextFree != -1)
+        allocator.blocks[b.nextFree].prevFree = b.prevFree;
+    if (allocator.heads[fl][sl] == -1){
+        allocator.slBitmaps[fl] &= ~(1u << sl);
+        if (allocator.slBitmaps[fl] == 0)
+            allocator.flBitmap &= ~(1u << fl);
+    }
+    b.free = false;
+}
+
+// A free block of at least size, or -1
+static int findFree(RangeAllocator & allocator, unsigned int size){
+    // Rounded up to the next class, so that any block of the lists found is big enough
+    unsigned int rounded = size;
+    if (size >= SL_COUNT)
+        rounded += (1u << (highestBit(size) - TLSF_SL_BITS)) - 1;
+    int fl, sl;
+    mapping(rounded, fl, sl);
+    if (fl < TLSF_FL_COUNT){
+        unsigned int slBits = allocator.slBitmaps[fl] & (~0u << sl);
+        if (slBits == 0){
+            unsigned int flBits = fl + 1 < TLSF_FL_COUNT ? allocator.flBitmap & (~0u << (fl + 1)) : 0;
+            if (flBits != 0){
+                fl = lowestBit(flBits);
+                slBits = allocator.slBitmaps[fl];
+            }
+        }
+        if (slBits != 0)
+            return allocator.heads[fl][lowestBit(slBits)];
+    }
+
+    // The class of size itself may still hold a block that fits, when the pool is nearly full
+    mapping(size, fl, sl);
+    for (int block = allocator.heads[fl][sl]; block != -1; block = allocator.blocks[block].nextFree){
+        if (allocator.blocks[block].size >= size)
+            return block;
+    }
+    return -1;
+}
+
+void initRangeAllocator(RangeAllocator & allocator, unsigned int capacity){
+    allocator.capacity = capacity;
+    allocator.used = 0;
+    allocator.blocks.clear();
+    allocator.unusedBlocks.clear();
+    allocator.flBitmap = 0;
+    for (int fl=0; fl<TLSF_FL_COUNT; fl++){
+        allocator.slBitmaps[fl] = 0;
+        for (unsigned int sl=0; sl<SL_COUNT; sl++)
+            allocator.heads[fl][sl] = -1;
+    }
+    if (capacity == 0)
+        return;
+
+    int block = newBlock(allocator);
+    TLSFBlock & b = allocator.blocks[block];
+    b.offset = 0;
+    b.size = capacity;
+    b.prevPhysical = b.nextPhysical = -1;
+    insertFree(allocator, block);
+}
+
+int rangeAllocate(RangeAllocator & allocator, unsigned int size, unsigned int & offset){
+    if (size == 0 || size > allocator.capacity - allocator.used)
+        return -1;
+    int block = findFree(allocator, size);
+    if (block == -1)
+        return -1;
+    removeFree(allocator, block);
+
+    // Split : the rest stays free, right after
+    if (allocator.blocks[block].size > size){
+        int rest = newBlock(allocator); // may move blocks
+        TLSFBlock & b = allocator.blocks[block];
+        TLSFBlock & r = allocator.blocks[rest];
+        r.offset = b.offset + size;
+        r.size = b.size - size;
+        r.prevPhysical = block;
+        r.nextPhysical = b.nextPhysical;
+        if (b.nextPhysical != -1)
+            allocator.blocks[b.nextPhysical].prevPhysical = rest;
+        b.nextPhysical = rest;
+        b.size = size;
+        insertFree(allocator, rest);
+    }
+
+    allocator.used += size;
+    offset = allocator.blocks[block].offset;
+    return block;
+}
+
+void rangeFree(RangeAllocator & allocator, int block){
+    if (block < 0 || block >= (int)allocator.blocks.size() || allocator.blocks[block].free || allocator.blocks[block].size == 0){
+        printf("Warning : freeing range block %d, which is not allocated\n", block);
+        return;
+    }
+    allocator.used -= allocator.blocks[block].size;
+
+    // Merge with the free neighbours
+    int next = allocator.blocks[block].nextPhysical;
+    if (next != -1 && allocator.blocks[next].free){
+        removeFree(allocator, next);
+        TLSFBlock & b = allocator.blocks[block];
+        b.size += allocator.blocks[next].size;
+        b.nextPhysical = allocator.blocks[next].nextPhysical;
+        if (b.nextPhysical != -1)
+            allocator.blocks[b.nextPhysical].prevPhysical = block;
+        releaseBlock(allocator, next);
+    }
+    int previous = allocator.blocks[block].prevPhysical;
+    if (previous != -1 && allocator.blocks[previous].free){
+        removeFree(allocator, previous);
+        TLSFBlock & p = allocator.blocks[previous];
+        p.size += allocator.blocks[block].size;
+        p.nextPhysical = allocator.blocks[block].nextPhysical;
+        if (p.nextPhysical != -1)
+            allocator.blocks[p.nextPhysical].prevPhysical = previous;
+        releaseBlock(allocator, block);
+        block = previous;
+    }
+    insertFree(allocator, block);
+}
+
+float rangeFragmentation(const RangeAllocator & allocator, unsigned int * freeRanges, unsigned int * largestFree){
+    unsigned int ranges = 0, largest = 0;
+    for (size_t i=0; i<allocator.blocks.size(); i++){
+        if (allocator.blocks[i].free){
+            ranges++;
+            largest = std::max(largest, allocator.blocks[i].size);
+        }
+    }
+    if (freeRanges != NULL) *freeRanges = ranges;
+    if (largestFree != NULL) *largestFree = largest;
+    unsigned int totalFree = allocator.capacity - allocator.used;
+    return totalFree > 0 ? 1.0f - (float)largest / totalFree : 0.0f;
+}
+
+static bool hasExtension(const char * name){
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i=0; i<count; i++){
+        const char * extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+static GLuint createPoolBuffer(GLenum target, size_t bytes, GLenum usage, const char * tag){
+    GLuint buffer = createGPUResource(GPU_BUFFER, tag);
+    glBindBuffer(target, buffer);
+    glBufferData(target, bytes, NULL, usage);
+    setGPUResourceBytes(GPU_BUFFER, buffer, bytes);
+    return buffer;
+}
+
+// Model matrices : 4 vec4 attributes, one per instance
+static void pointModelAttributes(size_t model){
+    for (int c=0; c<4; c++)
+        glVertexAttribPointer(4 + c, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(model * sizeof(glm::mat4) + c * sizeof(glm::vec4)));
+}
+
+// Grows to fit bytes, orphaning the previous content otherwise, then fills
+static void streamBuffer(GLenum target, GLuint buffer, unsigned int & capacity, const void * data, size_t bytes){
+    glBindBuffer(target, buffer);
+    if (bytes > capacity){
+        capacity = (unsigned int)std::max(bytes, (size_t)capacity * 2);
+        setGPUResourceBytes(GPU_BUFFER, buffer, capacity);
+    }
+    glBufferData(target, capacity, NULL, GL_STREAM_DRAW);
+    glBufferSubData(target, 0, bytes, data);
+}
+
+void initGeometryPool(GeometryPool & pool, unsigned int vertexCapacity, unsigned int indexCapacity){
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    int version = major * 10 + minor;
+    pool.indirect = (version >= 43 || (hasExtension("GL_ARB_multi_draw_indirect") && hasExtension("GL_ARB_base_instance")))
+        && glMultiDrawElementsIndirect != NULL;
+
+    initRangeAllocator(pool.vertices, vertexCapacity);
+    initRangeAllocator(pool.indices, indexCapacity);
+    pool.meshes.clear();
+    pool.freeMeshes.clear();
+    pool.stats.calls = pool.stats.draws = 0;
+
+    pool.positionBuffer = createPoolBuffer(GL_ARRAY_BUFFER, vertexCapacity * sizeof(glm::vec3), GL_STATIC_DRAW, "geometry pool positions");
+    pool.uvBuffer = createPoolBuffer(GL_ARRAY_BUFFER, vertexCapacity * sizeof(glm::vec2), GL_STATIC_DRAW, "geometry pool uvs");
+    pool.normalBuffer = createPoolBuffer(GL_ARRAY_BUFFER, vertexCapacity * sizeof(glm::vec3), GL_STATIC_DRAW, "geometry pool normals");
+    pool.modelCapacity = 64 * sizeof(glm::mat4);
+    pool.modelBuffer = createPoolBuffer(GL_ARRAY_BUFFER, pool.modelCapacity, GL_STREAM_DRAW, "geometry pool models");
+    pool.commandCapacity = 0;
+    pool.indirectBuffer = 0;
+    if (pool.indirect){
+        pool.commandCapacity = 256 * sizeof(DrawElementsIndirectCommand);
+        pool.indirectBuffer = createPoolBuffer(GL_DRAW_INDIRECT_BUFFER, pool.commandCapacity, GL_STREAM_DRAW, "geometry pool draws");
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    pool.vao = createGPUResource(GPU_VERTEX_ARRAY, "geometry pool");
+    glBindVertexArray(pool.vao);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, pool.positionBuffer);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, pool.uvBuffer);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(2);
+    glBindBuffer(GL_ARRAY_BUFFER, pool.normalBuffer);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glBindBuffer(GL_ARRAY_BUFFER, pool.modelBuffer);
+    for (int c=0; c<4; c++){
+        glEnableVertexAttribArray(4 + c);
+        glVertexAttribDivisor(4 + c, 1);
+    }
+    pointModelAttributes(0);
+    pool.indexBuffer = createGPUResource(GPU_BUFFER, "geometry pool indices");
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCapacity * sizeof(unsigned short), NULL, GL_STATIC_DRAW);
+    setGPUResourceBytes(GPU_BUFFER, pool.indexBuffer, indexCapacity * sizeof(unsigned short));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    printf("Geometry pool : %u vertices, %u indices, drawn with %s\n", vertexCapacity, indexCapacity,
+        pool.indirect ? "glMultiDrawElementsIndirect" : "glMultiDrawElementsBaseVertex");
+}
+
+int addPoolMesh(GeometryPool & pool,
+    const std::vector<glm::vec3> & vertices,
+    const std::vector<glm::vec2> & uvs,
+    const std::vector<glm::vec3> & normals,
+    const std::vector<unsigned short> & indices
+){
+    if (vertices.empty() || indices.empty() || uvs.size() != vertices.size() || normals.size() != vertices.size()){
+        printf("Geometry pool : invalid mesh, %u vertices, %u uvs, %u normals, %u indices\n", (unsigned int)vertices.size(),
+            (unsigned int)uvs.size(), (unsigned int)normals.size(), (unsigned int)indices.size());
+        return -1;
+    }
+
+    PoolMesh mesh;
+    mesh.vertexCount = (unsigned int)vertices.size();
+    mesh.indexCount = (unsigned int)indices.size();
+    mesh.vertexBlock = rangeAllocate(pool.vertices, mesh.vertexCount, mesh.baseVertex);
+    mesh.indexBlock = rangeAllocate(pool.indices, mesh.indexCount, mesh.firstIndex);
+    if (mesh.vertexBlock == -1 || mesh.indexBlock == -1){
+        if (mesh.vertexBlock != -1) rangeFree(pool.vertices, mesh.vertexBlock);
+        if (mesh.indexBlock != -1) rangeFree(pool.indices, mesh.indexBlock);
+        printf("Geometry pool : no room for %u vertices and %u indices\n", mesh.vertexCount, mesh.indexCount);
+        return -1;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, pool.positionBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, mesh.baseVertex * sizeof(glm::vec3), mesh.vertexCount * sizeof(glm::vec3), &vertices[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, pool.uvBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, mesh.baseVertex * sizeof(glm::vec2), mesh.vertexCount * sizeof(glm::vec2), &uvs[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, pool.normalBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, mesh.baseVertex * sizeof(glm::vec3), mesh.vertexCount * sizeof(glm::vec3), &normals[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // Through GL_COPY_WRITE_BUFFER : the element array binding belongs to the VAO bound by the caller
+    glBindBuffer(GL_COPY_WRITE_BUFFER, pool.indexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, mesh.firstIndex * sizeof(unsigned short), mesh.indexCount * sizeof(unsigned short), &indices[0]);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if (!pool.freeMeshes.empty()){
+        int handle = (int)pool.freeMeshes.back();
+        pool.freeMeshes.pop_back();
+        pool.meshes[handle] = mesh;
+        return handle;
+    }
+    pool.meshes.push_back(mesh);
+    return (int)pool.meshes.size() - 1;
+}
+
+void removePoolMesh(GeometryPool & pool, int mesh){
+    if (mesh < 0 || mesh >= (int)pool.meshes.size() || pool.meshes[mesh].vertexBlock == -1){
+        printf("Warning : removing pool mesh %d, which is not in the pool\n", mesh);
+        return;
+    }
+    PoolMesh & m = pool.meshes[mesh];
+    rangeFree(pool.vertices, m.vertexBlock);
+    rangeFree(pool.indices, m.indexBlock);
+    m.vertexBlock = m.indexBlock = -1;
+    pool.freeMeshes.push_back(mesh);
+}
+
+void addPoolDraw(GeometryPoolDraws & draws, const GeometryPool & pool, int mesh, unsigned int model, unsigned int firstIndex, unsigned int indexCount){
+    const PoolMesh & m = pool.meshes[mesh];
+    DrawElementsIndirectCommand command;
+    command.count = indexCount;
+    command.instanceCount = 1;
+    command.firstIndex = m.firstIndex + firstIndex;
+    command.baseVertex = (GLint)m.baseVertex;
+    command.baseInstance = model;
+    draws.commands.push_back(command);
+}
+
+void addPoolDraw(GeometryPoolDraws & draws, const GeometryPool & pool, int mesh, unsigned int model){
+    addPoolDraw(draws, pool, mesh, model, 0, pool.meshes[mesh].indexCount);
+}
+
+static bool byModel(const DrawElementsIndirectCommand & a, const DrawElementsIndirectCommand & b){
+    return a.baseInstance < b.baseInstance;
+}
+
+void drawGeometryPool(GeometryPool & pool, const GeometryPoolDraws & draws){
+    drawGeometryPool(pool, draws, draws.models.empty() ? NULL : &draws.models[0], (unsigned int)draws.models.size());
+}
+
+void drawGeometryPool(GeometryPool & pool, const GeometryPoolDraws & draws, const glm::mat4 * models, unsigned int modelCount){
+    pool.stats.calls = pool.stats.draws = 0;
+    if (draws.commands.empty() || modelCount == 0)
+        return;
+
+    glBindVertexArray(pool.vao);
+    streamBuffer(GL_ARRAY_BUFFER, pool.modelBuffer, pool.modelCapacity, models, modelCount * sizeof(glm::mat4));
+
+    if (pool.indirect){
+        // The whole pass in one call : each command picks its model matrix with its base instance
+        pointModelAttributes(0);
+        streamBuffer(GL_DRAW_INDIRECT_BUFFER, pool.indirectBuffer, pool.commandCapacity,
+            &draws.commands[0], draws.commands.size() * sizeof(DrawElementsIndirectCommand));
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (void*)0, (GLsizei)draws.commands.size(), 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        pool.stats.calls = 1;
+    }
+    else {
+        // No base instance : one call per model matrix, with the attributes pointing at it
+        pool.sorted.assign(draws.commands.begin(), draws.commands.end());
+        std::stable_sort(pool.sorted.begin(), pool.sorted.end(), byModel);
+        for (size_t begin = 0; begin < pool.sorted.size(); ){
+            size_t end = begin;
+            pool.counts.clear();
+            pool.offsets.clear();
+            pool.baseVertices.clear();
+            while (end < pool.sorted.size() && pool.sorted[end].baseInstance == pool.sorted[begin].baseInstance){
+                pool.counts.push_back((GLsizei)pool.sorted[end].count);
+                pool.offsets.push_back((const void*)(pool.sorted[end].firstIndex * sizeof(unsigned short)));
+                pool.baseVertices.push_back(pool.sorted[end].baseVertex);
+                end++;
+            }
+            pointModelAttributes(pool.sorted[begin].baseInstance);
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, &pool.counts[0], GL_UNSIGNED_SHORT, &pool.offsets[0], (GLsizei)pool.counts.size(), &pool.baseVertices[0]);
+            pool.stats.calls++;
+            begin = end;
+        }
+    }
+    pool.stats.draws = (unsigned int)draws.commands.size();
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void printGeometryPoolStats(const GeometryPool & pool){
+    unsigned int vertexRanges, vertexLargest, indexRanges, indexLargest;
+    float vertexFragmentation = rangeFragmentation(pool.vertices, &vertexRanges, &vertexLargest);
+    float indexFragmentation = rangeFragmentation(pool.indices, &indexRanges, &indexLargest);
+    printf("Geometry pool : %u meshes, vertices %u / %u (%u free ranges, largest %u, %.0f%% fragmented), indices %u / %u (%u free ranges, largest %u, %.0f%% fragmented)\n",
+        (unsigned int)(pool.meshes.size() - pool.freeMeshes.size()),
+        pool.vertices.used, pool.vertices.capacity, vertexRanges, vertexLargest, vertexFragmentation * 100.0f,
+        pool.indices.used, pool.indices.capacity, indexRanges, indexLargest, indexFragmentation * 100.0f);
+    printf("Geometry pool : %u draws in %u calls, %.1f draws per call\n", pool.stats.draws, pool.stats.calls,
+        pool.stats.calls > 0 ? (float)pool.stats.draws / pool.stats.calls : 0.0f);
+}
+
+void cleanupGeometryPool(GeometryPool & pool){
+    deleteGPUResource(GPU_BUFFER, pool.positionBuffer);
+    deleteGPUResource(GPU_BUFFER, pool.uvBuffer);
+    deleteGPUResource(GPU_BUFFER, pool.normalBuffer);
+    deleteGPUResource(GPU_BUFFER, pool.indexBuffer);
+    deleteGPUResource(GPU_BUFFER, pool.modelBuffer);
+    deleteGPUResource(GPU_BUFFER, pool.indirectBuffer);
+    deleteGPUResource(GPU_VERTEX_ARRAY, pool.vao);
+    pool.meshes.clear();
+    pool.freeMeshes.clear();
+}
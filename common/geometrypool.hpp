@@ -0,0 +1,110 @@
+#ifndef GEOMETRYPOOL_HPP
+#define GEOMETRYPOOL_HPP
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Two level segregated fit (TLSF) allocator of ranges of a buffer, in elements (vertices or indices).
+// Constant time allocate and free : free blocks are kept in lists by size class, found through two bitmaps,
+// and merged with their free neighbours when released.
+static const int TLSF_FL_COUNT = 32;
+static const int TLSF_SL_BITS = 3; // 8 lists per power of two
+
+struct TLSFBlock {
+    unsigned int offset, size;
+    int prevPhysical, nextPhysical; // neighbours in the buffer, -1 at the ends
+    int prevFree, nextFree;         // in its free list
+    bool free;
+};
+
+struct RangeAllocator {
+    unsigned int capacity;
+    unsigned int used;
+    std::vector<TLSFBlock> blocks;
+    std::vector<int> unusedBlocks;  // recycled entries of blocks
+    unsigned int flBitmap;
+    unsigned int slBitmaps[TLSF_FL_COUNT];
+    int heads[TLSF_FL_COUNT][1 << TLSF_SL_BITS];
+};
+
+void initRangeAllocator(RangeAllocator & allocator, unsigned int capacity);
+// Returns the block, or -1 when no free range is big enough. offset gets its start.
+int rangeAllocate(RangeAllocator & allocator, unsigned int size, unsigned int & offset);
+void rangeFree(RangeAllocator & allocator, int block);
+// 0 when all the free space is one range, close to 1 when it is scattered in small ones
+float rangeFragmentation(const RangeAllocator & allocator, unsigned int * freeRanges = NULL, unsigned int * largestFree = NULL);
+
+// Same layout as GL expects in the GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+struct PoolMesh {
+    int vertexBlock, indexBlock; // -1 : free slot
+    unsigned int baseVertex, vertexCount;
+    unsigned int firstIndex, indexCount;
+};
+
+struct GeometryPoolStats {
+    unsigned int calls;  // last frame
+    unsigned int draws;  // last frame
+};
+
+// Static meshes suballocated from a few big buffers : positions, uvs, normals and 16 bits indices,
+// relative to each mesh's base vertex. One VAO for all of them, so a whole pass needs no bind between meshes.
+// Model matrices are an instanced attribute (locations 4 to 7) that each draw selects with its base instance.
+// Draws go through glMultiDrawElementsIndirect (GL 4.3, or ARB_multi_draw_indirect + ARB_base_instance).
+// Without it, glMultiDrawElementsBaseVertex draws every run of draws that share a model matrix.
+struct GeometryPool {
+    GLuint positionBuffer, uvBuffer, normalBuffer, indexBuffer;
+    GLuint modelBuffer, indirectBuffer;     // refilled every draw
+    unsigned int modelCapacity, commandCapacity; // in bytes
+    GLuint vao;
+    bool indirect;
+    RangeAllocator vertices, indices;
+    std::vector<PoolMesh> meshes;
+    std::vector<unsigned int> freeMeshes;
+    GeometryPoolStats stats;
+    // Fallback path scratch, kept between frames
+    std::vector<DrawElementsIndirectCommand> sorted;
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    std::vector<GLint> baseVertices;
+};
+
+// A pass : the draws, in submission order, and the model matrices they use
+struct GeometryPoolDraws {
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<glm::mat4> models;
+};
+
+void initGeometryPool(GeometryPool & pool, unsigned int vertexCapacity, unsigned int indexCapacity);
+
+// Returns the mesh handle, or -1 when the pool is full
+int addPoolMesh(GeometryPool & pool,
+    const std::vector<glm::vec3> & vertices,
+    const std::vector<glm::vec2> & uvs,
+    const std::vector<glm::vec3> & normals,
+    const std::vector<unsigned short> & indices
+);
+void removePoolMesh(GeometryPool & pool, int mesh);
+
+// Draws index range [firstIndex, firstIndex + indexCount) of the mesh (for example a LOD) with models[model]
+void addPoolDraw(GeometryPoolDraws & draws, const GeometryPool & pool, int mesh, unsigned int model, unsigned int firstIndex, unsigned int indexCount);
+void addPoolDraw(GeometryPoolDraws & draws, const GeometryPool & pool, int mesh, unsigned int model);
+
+// Draws the pass with the program in use, which reads its model matrix from attribute 4 (see PoolVertexShader.vert).
+// Leaves no VAO bound.
+void drawGeometryPool(GeometryPool & pool, const GeometryPoolDraws & draws);
+// Same, with the model matrices taken from elsewhere, for example a range of SceneGraph::worlds, without a copy
+void drawGeometryPool(GeometryPool & pool, const GeometryPoolDraws & draws, const glm::mat4 * models, unsigned int modelCount);
+
+void printGeometryPoolStats(const GeometryPool & pool);
+void cleanupGeometryPool(GeometryPool & pool);
+
+#endif
@@ -0,0 +1,751 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <set>
+#include <map>
+#include <string>
+#include <initializer_list>
+
+// The wrappers forward to the real GL 1.1 functions
+#define GLCAPTURE_NO_REDIRECT
+#include "cookedassets.hpp"
+#include "glcapture.hpp"
+
+// The application writes to the shadow, copied to the real mapping on flush and unmap : write-only mappings
+// can't be read back, and are often write-combined memory, slow to read anyway.
+struct MappedRange {
+    void * pointer;                    // the real mapping
+    std::vector<unsigned char> shadow;
+    GLintptr offset;
+    GLsizeiptr length;
+    GLbitfield access;
+};
+
+struct GLCapture {
+    FILE * file;
+    bool active;
+    std::vector<unsigned char> stream;    // records not written yet
+    size_t record;                        // offset of the record being written
+    std::set<unsigned long long> blobs;   // hashes already in the file
+    std::map<GLenum, MappedRange> mapped; // per buffer target, until glUnmapBuffer
+    GLint unpackAlignment;
+    GLuint unpackBuffer;                  // GL_PIXEL_UNPACK_BUFFER binding
+    GLuint indirectBuffer;                // GL_DRAW_INDIRECT_BUFFER binding
+    unsigned int frames;
+    unsigned long long calls, written, payloadBytes, dedupedBytes;
+};
+
+static GLCapture capture;
+
+// Entry points past GL 1.1 : the GLEW pointers swapped for the hooks below while capturing
+#define CAPTURE_HOOKS(HOOK) \
+    HOOK(ActiveTexture) HOOK(TexImage3D) HOOK(TexSubImage3D) HOOK(CompressedTexImage2D) HOOK(CompressedTexImage3D) \
+    HOOK(GenerateMipmap) HOOK(TexBuffer) \
+    HOOK(GenBuffers) HOOK(DeleteBuffers) HOOK(BindBuffer) HOOK(BufferData) HOOK(BufferSubData) HOOK(MapBufferRange) \
+    HOOK(FlushMappedBufferRange) HOOK(UnmapBuffer) \
+    HOOK(GenVertexArrays) HOOK(DeleteVertexArrays) HOOK(BindVertexArray) HOOK(EnableVertexAttribArray) HOOK(DisableVertexAttribArray) \
+    HOOK(VertexAttribPointer) HOOK(VertexAttribDivisor) \
+    HOOK(GenFramebuffers) HOOK(DeleteFramebuffers) HOOK(BindFramebuffer) HOOK(FramebufferRenderbuffer) HOOK(BlitFramebuffer) \
+    HOOK(GenRenderbuffers) HOOK(DeleteRenderbuffers) HOOK(BindRenderbuffer) HOOK(RenderbufferStorageMultisample) \
+    HOOK(CreateShader) HOOK(DeleteShader) HOOK(ShaderSource) HOOK(CompileShader) \
+    HOOK(CreateProgram) HOOK(DeleteProgram) HOOK(AttachShader) HOOK(DetachShader) HOOK(LinkProgram) HOOK(UseProgram) \
+    HOOK(GetUniformLocation) HOOK(Uniform1i) HOOK(Uniform1f) HOOK(Uniform2f) HOOK(Uniform3f) HOOK(Uniform3i) \
+    HOOK(Uniform4fv) HOOK(UniformMatrix4fv) \
+    HOOK(MultiDrawElements) HOOK(MultiDrawElementsBaseVertex) HOOK(MultiDrawElementsIndirect)
+
+#define DECLARE_REAL(name) static decltype(__glew##name) real##name = NULL;
+CAPTURE_HOOKS(DECLARE_REAL)
+
+// Records are flushed at the end of every frame, or sooner while loading
+static const size_t FLUSH_BYTES = 16 * 1024 * 1024;
+
+static void flushStream(){
+    if (!capture.stream.empty()){
+        fwrite(&capture.stream[0], 1, capture.stream.size(), capture.file);
+        capture.written += capture.stream.size();
+        capture.stream.clear();
+    }
+}
+
+static void put(const void * data, size_t size){
+    size_t offset = capture.stream.size();
+    capture.stream.resize(offset + size);
+    if (size > 0)
+        memcpy(&capture.stream[offset], data, size);
+}
+
+static void put32(unsigned int value){
+    put(&value, sizeof(value));
+}
+
+static void put64(unsigned long long value){
+    put(&value, sizeof(value));
+}
+
+static unsigned int bits(float value){
+    unsigned int result;
+    memcpy(&result, &value, sizeof(result));
+    return result;
+}
+
+static void beginRecord(GLCaptureOp op){
+    capture.record = capture.stream.size();
+    put32(op);
+    put32(0);
+}
+
+static void endRecord(){
+    unsigned int size = (unsigned int)(capture.stream.size() - capture.record - 2 * sizeof(unsigned int));
+    memcpy(&capture.stream[capture.record + sizeof(unsigned int)], &size, sizeof(size));
+    capture.calls++;
+    if (capture.stream.size() >= FLUSH_BYTES)
+        flushStream();
+}
+
+// The common case : 32 bits arguments only
+static void recordWords(GLCaptureOp op, std::initializer_list<unsigned int> words){
+    beginRecord(op);
+    for (unsigned int word : words)
+        put32(word);
+    endRecord();
+}
+
+static void recordNames(GLCaptureOp op, GLsizei n, const GLuint * names){
+    beginRecord(op);
+    put32(n);
+    put(names, n * sizeof(GLuint));
+    endRecord();
+}
+
+struct Payload {
+    unsigned int kind;
+    unsigned long long value;
+};
+
+// Before the record using it : writes the blob the first time its content is seen
+static Payload blobPayload(const void * data, size_t size){
+    Payload payload = { PAYLOAD_NONE, 0 };
+    if (data == NULL)
+        return payload;
+    unsigned long long sizeBits = size;
+    payload.kind = PAYLOAD_BLOB;
+    payload.value = hashBytes(&sizeBits, sizeof(sizeBits), hashBytes(data, size));
+    capture.payloadBytes += size;
+    if (capture.blobs.insert(payload.value).second){
+        beginRecord(CAPTURE_BLOB);
+        put64(payload.value);
+        put(data, size);
+        endRecord();
+    }
+    else {
+        capture.dedupedBytes += size;
+    }
+    return payload;
+}
+
+// Pixels and draw commands are an offset when a buffer is bound for them
+static Payload sourcePayload(const void * data, size_t size, GLuint boundBuffer){
+    if (boundBuffer == 0)
+        return blobPayload(data, size);
+    Payload payload = { PAYLOAD_OFFSET, (unsigned long long)(size_t)data };
+    return payload;
+}
+
+static void putPayload(const Payload & payload){
+    put32(payload.kind);
+    put64(payload.value);
+}
+
+static size_t pixelBytes(GLenum format, GLenum type){
+    switch (type){
+    case GL_UNSIGNED_BYTE_3_3_2: case GL_UNSIGNED_BYTE_2_3_3_REV:
+        return 1;
+    case GL_UNSIGNED_SHORT_5_6_5: case GL_UNSIGNED_SHORT_5_6_5_REV: case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_4_4_4_4_REV: case GL_UNSIGNED_SHORT_5_5_5_1: case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+        return 2;
+    case GL_UNSIGNED_INT_8_8_8_8: case GL_UNSIGNED_INT_8_8_8_8_REV: case GL_UNSIGNED_INT_10_10_10_2:
+    case GL_UNSIGNED_INT_2_10_10_10_REV: case GL_UNSIGNED_INT_10F_11F_11F_REV: case GL_UNSIGNED_INT_5_9_9_9_REV:
+    case GL_UNSIGNED_INT_24_8:
+        return 4;
+    }
+    size_t components;
+    switch (format){
+    case GL_RG: case GL_RG_INTEGER: case GL_DEPTH_STENCIL:
+        components = 2; break;
+    case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: case GL_BGR_INTEGER:
+        components = 3; break;
+    case GL_RGBA: case GL_BGRA: case GL_RGBA_INTEGER: case GL_BGRA_INTEGER:
+        components = 4; break;
+    default:
+        components = 1; break;
+    }
+    switch (type){
+    case GL_SHORT: case GL_UNSIGNED_SHORT: case GL_HALF_FLOAT:
+        return components * 2;
+    case GL_INT: case GL_UNSIGNED_INT: case GL_FLOAT:
+        return components * 4;
+    default:
+        return components;
+    }
+}
+
+// What glTexImage reads from the client : rows are padded to the unpack alignment, except the last one
+static size_t imageBytes(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type){
+    if (width <= 0 || height <= 0 || depth <= 0)
+        return 0;
+    size_t row = width * pixelBytes(format, type);
+    size_t alignment = capture.unpackAlignment > 0 ? capture.unpackAlignment : 4;
+    size_t stride = (row + alignment - 1) / alignment * alignment;
+    return stride * ((size_t)height * depth - 1) + row;
+}
+
+// GL 1.1
+
+void captureClear(GLbitfield mask){
+    glClear(mask);
+    if (capture.active) recordWords(CAPTURE_CLEAR, { mask });
+}
+
+void captureClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha){
+    glClearColor(red, green, blue, alpha);
+    if (capture.active) recordWords(CAPTURE_CLEAR_COLOR, { bits(red), bits(green), bits(blue), bits(alpha) });
+}
+
+void captureViewport(GLint x, GLint y, GLsizei width, GLsizei height){
+    glViewport(x, y, width, height);
+    if (capture.active) recordWords(CAPTURE_VIEWPORT, { (unsigned int)x, (unsigned int)y, (unsigned int)width, (unsigned int)height });
+}
+
+void captureEnable(GLenum cap){
+    glEnable(cap);
+    if (capture.active) recordWords(CAPTURE_ENABLE, { cap });
+}
+
+void captureDisable(GLenum cap){
+    glDisable(cap);
+    if (capture.active) recordWords(CAPTURE_DISABLE, { cap });
+}
+
+void captureDepthFunc(GLenum func){
+    glDepthFunc(func);
+    if (capture.active) recordWords(CAPTURE_DEPTH_FUNC, { func });
+}
+
+void captureBlendFunc(GLenum sfactor, GLenum dfactor){
+    glBlendFunc(sfactor, dfactor);
+    if (capture.active) recordWords(CAPTURE_BLEND_FUNC, { sfactor, dfactor });
+}
+
+void capturePixelStorei(GLenum pname, GLint param){
+    glPixelStorei(pname, param);
+    if (!capture.active) return;
+    if (pname == GL_UNPACK_ALIGNMENT) capture.unpackAlignment = param;
+    recordWords(CAPTURE_PIXEL_STORE, { pname, (unsigned int)param });
+}
+
+void captureGenTextures(GLsizei n, GLuint * textures){
+    glGenTextures(n, textures);
+    if (capture.active) recordNames(CAPTURE_GEN_TEXTURES, n, textures);
+}
+
+void captureDeleteTextures(GLsizei n, const GLuint * textures){
+    glDeleteTextures(n, textures);
+    if (capture.active) recordNames(CAPTURE_DELETE_TEXTURES, n, textures);
+}
+
+void captureBindTexture(GLenum target, GLuint texture){
+    glBindTexture(target, texture);
+    if (capture.active) recordWords(CAPTURE_BIND_TEXTURE, { target, texture });
+}
+
+void captureTexParameteri(GLenum target, GLenum pname, GLint param){
+    glTexParameteri(target, pname, param);
+    if (capture.active) recordWords(CAPTURE_TEX_PARAMETER, { target, pname, (unsigned int)param });
+}
+
+void captureTexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void * pixels){
+    glTexImage2D(target, level, internalFormat, width, height, border, format, type, pixels);
+    if (!capture.active) return;
+    Payload payload = sourcePayload(pixels, imageBytes(width, height, 1, format, type), capture.unpackBuffer);
+    beginRecord(CAPTURE_TEX_IMAGE_2D);
+    for (unsigned int word : { target, (unsigned int)level, (unsigned int)internalFormat, (unsigned int)width, (unsigned int)height, (unsigned int)border, format, type })
+        put32(word);
+    putPayload(payload);
+    endRecord();
+}
+
+void captureDrawArrays(GLenum mode, GLint first, GLsizei count){
+    glDrawArrays(mode, first, count);
+    if (capture.active) recordWords(CAPTURE_DRAW_ARRAYS, { mode, (unsigned int)first, (unsigned int)count });
+}
+
+// Indices always come from the element buffer : the core profile has no client side arrays
+void captureDrawElements(GLenum mode, GLsizei count, GLenum type, const void * indices){
+    glDrawElements(mode, count, type, indices);
+    if (!capture.active) return;
+    beginRecord(CAPTURE_DRAW_ELEMENTS);
+    put32(mode);
+    put32(count);
+    put32(type);
+    put64((size_t)indices);
+    endRecord();
+}
+
+// Past GL 1.1 : only installed while capturing
+
+static void GLAPIENTRY hookActiveTexture(GLenum texture){
+    realActiveTexture(texture);
+    recordWords(CAPTURE_ACTIVE_TEXTURE, { texture });
+}
+
+static void GLAPIENTRY hookTexImage3D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void * pixels){
+    realTexImage3D(target, level, internalFormat, width, height, depth, border, format, type, pixels);
+    Payload payload = sourcePayload(pixels, imageBytes(width, height, depth, format, type), capture.unpackBuffer);
+    beginRecord(CAPTURE_TEX_IMAGE_3D);
+    for (unsigned int word : { target, (unsigned int)level, (unsigned int)internalFormat, (unsigned int)width, (unsigned int)height, (unsigned int)depth, (unsigned int)border, format, type })
+        put32(word);
+    putPayload(payload);
+    endRecord();
+}
+
+static void GLAPIENTRY hookTexSubImage3D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void * pixels){
+    realTexSubImage3D(target, level, xoffset, yoffset, zoffset, width, height, depth, format, type, pixels);
+    Payload payload = sourcePayload(pixels, imageBytes(width, height, depth, format, type), capture.unpackBuffer);
+    beginRecord(CAPTURE_TEX_SUB_IMAGE_3D);
+    for (unsigned int word : { target, (unsigned int)level, (unsigned int)xoffset, (unsigned int)yoffset, (unsigned int)zoffset, (unsigned int)width, (unsigned int)height, (unsigned int)depth, format, type })
+        put32(word);
+    putPayload(payload);
+    endRecord();
+}
+
+static void GLAPIENTRY hookCompressedTexImage2D(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const void * data){
+    realCompressedTexImage2D(target, level, internalformat, width, height, border, imageSize, data);
+    Payload payload = sourcePayload(data, imageSize, capture.unpackBuffer);
+    beginRecord(CAPTURE_COMPRESSED_TEX_IMAGE_2D);
+    for (unsigned int word : { target, (unsigned int)level, internalformat, (unsigned int)width, (unsigned int)height, (unsigned int)border, (unsigned int)imageSize })
+        put32(word);
+    putPayload(payload);
+    endRecord();
+}
+
+static void GLAPIENTRY hookCompressedTexImage3D(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLsizei imageSize, const void * data){
+    realCompressedTexImage3D(target, level, internalformat, width, height, depth, border, imageSize, data);
+    Payload payload = sourcePayload(data, imageSize, capture.unpackBuffer);
+    beginRecord(CAPTURE_COMPRESSED_TEX_IMAGE_3D);
+    for (unsigned int word : { target, (unsigned int)level, internalformat, (unsigned int)width, (unsigned int)height, (unsigned int)depth, (unsigned int)border, (unsigned int)imageSize })
+        put32(word);
+    putPayload(payload);
+    endRecord();
+}
+
+static void GLAPIENTRY hookGenerateMipmap(GLenum target){
+    realGenerateMipmap(target);
+    recordWords(CAPTURE_GENERATE_MIPMAP, { target });
+}
+
+static void GLAPIENTRY hookTexBuffer(GLenum target, GLenum internalFormat, GLuint buffer){
+    realTexBuffer(target, internalFormat, buffer);
+    recordWords(CAPTURE_TEX_BUFFER, { target, internalFormat, buffer });
+}
+
+static void GLAPIENTRY hookGenBuffers(GLsizei n, GLuint * buffers){
+    realGenBuffers(n, buffers);
+    recordNames(CAPTURE_GEN_BUFFERS, n, buffers);
+}
+
+static void GLAPIENTRY hookDeleteBuffers(GLsizei n, const GLuint * buffers){
+    realDeleteBuffers(n, buffers);
+    for (GLsizei i=0; i<n; i++){
+        if (buffers[i] == capture.unpackBuffer) capture.unpackBuffer = 0;
+        if (buffers[i] == capture.indirectBuffer) capture.indirectBuffer = 0;
+    }
+    recordNames(CAPTURE_DELETE_BUFFERS, n, buffers);
+}
+
+static void GLAPIENTRY hookBindBuffer(GLenum target, GLuint buffer){
+    realBindBuffer(target, buffer);
+    if (target == GL_PIXEL_UNPACK_BUFFER) capture.unpackBuffer = buffer;
+    if (target == GL_DRAW_INDIRECT_BUFFER) capture.indirectBuffer = buffer;
+    recordWords(CAPTURE_BIND_BUFFER, { target, buffer });
+}
+
+static void GLAPIENTRY hookBufferData(GLenum target, GLsizeiptr size, const void * data, GLenum usage){
+    realBufferData(target, size, data, usage);
+    Payload payload = blobPayload(data, size);
+    beginRecord(CAPTURE_BUFFER_DATA);
+    put32(target);
+    put64(size);
+    put32(usage);
+    putPayload(payload);
+    endRecord();
+}
+
+static void GLAPIENTRY hookBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void * data){
+    realBufferSubData(target, offset, size, data);
+    Payload payload = blobPayload(data, size);
+    beginRecord(CAPTURE_BUFFER_SUB_DATA);
+    put32(target);
+    put64(offset);
+    put64(size);
+    putPayload(payload);
+    endRecord();
+}
+
+// What is written to a mapping is only known when it is unmapped
+static void * GLAPIENTRY hookMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access){
+    if (!(access & GL_MAP_WRITE_BIT) || length <= 0)
+        return realMapBufferRange(target, offset, length, access);
+
+    // The shadow starts as the range is : what the application doesn't write must stay. Invalidated ranges are undefined.
+    MappedRange & range = capture.mapped[target];
+    range.shadow.assign((size_t)length, 0);
+    if (!(access & (GL_MAP_READ_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT)))
+        glGetBufferSubData(target, offset, length, &range.shadow[0]);
+    range.pointer = realMapBufferRange(target, offset, length, access);
+    if (range.pointer == NULL){
+        capture.mapped.erase(target);
+        return NULL;
+    }
+    if (access & GL_MAP_READ_BIT)
+        memcpy(&range.shadow[0], range.pointer, (size_t)length);
+    range.offset = offset;
+    range.length = length;
+    range.access = access;
+    return &range.shadow[0];
+}
+
+static void GLAPIENTRY hookFlushMappedBufferRange(GLenum target, GLintptr offset, GLsizeiptr length){
+    std::map<GLenum, MappedRange>::iterator it = capture.mapped.find(target);
+    if (it != capture.mapped.end() && offset >= 0 && length >= 0 && offset + length <= it->second.length)
+        memcpy((unsigned char *)it->second.pointer + offset, &it->second.shadow[offset], (size_t)length);
+    realFlushMappedBufferRange(target, offset, length);
+}
+
+static GLboolean GLAPIENTRY hookUnmapBuffer(GLenum target){
+    std::map<GLenum, MappedRange>::iterator it = capture.mapped.find(target);
+    if (it != capture.mapped.end()){
+        const MappedRange & range = it->second;
+        // With explicit flushes, only the flushed ranges were written : they are copied already
+        if (!(range.access & GL_MAP_FLUSH_EXPLICIT_BIT))
+            memcpy(range.pointer, &range.shadow[0], range.shadow.size());
+        Payload payload = blobPayload(&range.shadow[0], range.length);
+        beginRecord(CAPTURE_MAPPED_WRITE);
+        put32(target);
+        put64(range.offset);
+        put64(range.length);
+        put32(range.access);
+        putPayload(payload);
+        endRecord();
+        capture.mapped.erase(it);
+    }
+    return realUnmapBuffer(target);
+}
+
+static void GLAPIENTRY hookGenVertexArrays(GLsizei n, GLuint * arrays){
+    realGenVertexArrays(n, arrays);
+    recordNames(CAPTURE_GEN_VERTEX_ARRAYS, n, arrays);
+}
+
+static void GLAPIENTRY hookDeleteVertexArrays(GLsizei n, const GLuint * arrays){
+    realDeleteVertexArrays(n, arrays);
+    recordNames(CAPTURE_DELETE_VERTEX_ARRAYS, n, arrays);
+}
+
+static void GLAPIENTRY hookBindVertexArray(GLuint array){
+    realBindVertexArray(array);
+    recordWords(CAPTURE_BIND_VERTEX_ARRAY, { array });
+}
+
+static void GLAPIENTRY hookEnableVertexAttribArray(GLuint index){
+    realEnableVertexAttribArray(index);
+    recordWords(CAPTURE_ENABLE_ATTRIB, { index });
+}
+
+static void GLAPIENTRY hookDisableVertexAttribArray(GLuint index){
+    realDisableVertexAttribArray(index);
+    recordWords(CAPTURE_DISABLE_ATTRIB, { index });
+}
+
+static void GLAPIENTRY hookVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void * pointer){
+    realVertexAttribPointer(index, size, type, normalized, stride, pointer);
+    beginRecord(CAPTURE_ATTRIB_POINTER);
+    put32(index);
+    put32(size);
+    put32(type);
+    put32(normalized);
+    put32(stride);
+    put64((size_t)pointer);
+    endRecord();
+}
+
+static void GLAPIENTRY hookVertexAttribDivisor(GLuint index, GLuint divisor){
+    realVertexAttribDivisor(index, divisor);
+    recordWords(CAPTURE_ATTRIB_DIVISOR, { index, divisor });
+}
+
+static void GLAPIENTRY hookGenFramebuffers(GLsizei n, GLuint * framebuffers){
+    realGenFramebuffers(n, framebuffers);
+    recordNames(CAPTURE_GEN_FRAMEBUFFERS, n, framebuffers);
+}
+
+static void GLAPIENTRY hookDeleteFramebuffers(GLsizei n, const GLuint * framebuffers){
+    realDeleteFramebuffers(n, framebuffers);
+    recordNames(CAPTURE_DELETE_FRAMEBUFFERS, n, framebuffers);
+}
+
+static void GLAPIENTRY hookBindFramebuffer(GLenum target, GLuint framebuffer){
+    realBindFramebuffer(target, framebuffer);
+    recordWords(CAPTURE_BIND_FRAMEBUFFER, { target, framebuffer });
+}
+
+static void GLAPIENTRY hookFramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer){
+    realFramebufferRenderbuffer(target, attachment, renderbuffertarget, renderbuffer);
+    recordWords(CAPTURE_FRAMEBUFFER_RENDERBUFFER, { target, attachment, renderbuffertarget, renderbuffer });
+}
+
+static void GLAPIENTRY hookBlitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1, GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter){
+    realBlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask, filter);
+    recordWords(CAPTURE_BLIT_FRAMEBUFFER, { (unsigned int)srcX0, (unsigned int)srcY0, (unsigned int)srcX1, (unsigned int)srcY1,
+        (unsigned int)dstX0, (unsigned int)dstY0, (unsigned int)dstX1, (unsigned int)dstY1, mask, filter });
+}
+
+static void GLAPIENTRY hookGenRenderbuffers(GLsizei n, GLuint * renderbuffers){
+    realGenRenderbuffers(n, renderbuffers);
+    recordNames(CAPTURE_GEN_RENDERBUFFERS, n, renderbuffers);
+}
+
+static void GLAPIENTRY hookDeleteRenderbuffers(GLsizei n, const GLuint * renderbuffers){
+    realDeleteRenderbuffers(n, renderbuffers);
+    recordNames(CAPTURE_DELETE_RENDERBUFFERS, n, renderbuffers);
+}
+
+static void GLAPIENTRY hookBindRenderbuffer(GLenum target, GLuint renderbuffer){
+    realBindRenderbuffer(target, renderbuffer);
+    recordWords(CAPTURE_BIND_RENDERBUFFER, { target, renderbuffer });
+}
+
+static void GLAPIENTRY hookRenderbufferStorageMultisample(GLenum target, GLsizei samples, GLenum internalformat, GLsizei width, GLsizei height){
+    realRenderbufferStorageMultisample(target, samples, internalformat, width, height);
+    recordWords(CAPTURE_RENDERBUFFER_STORAGE_MULTISAMPLE, { target, (unsigned int)samples, internalformat, (unsigned int)width, (unsigned int)height });
+}
+
+static GLuint GLAPIENTRY hookCreateShader(GLenum type){
+    GLuint shader = realCreateShader(type);
+    recordWords(CAPTURE_CREATE_SHADER, { type, shader });
+    return shader;
+}
+
+static void GLAPIENTRY hookDeleteShader(GLuint shader){
+    realDeleteShader(shader);
+    recordWords(CAPTURE_DELETE_SHADER, { shader });
+}
+
+// The strings are joined : the replay passes them as one
+static void GLAPIENTRY hookShaderSource(GLuint shader, GLsizei count, const GLchar * const * string, const GLint * length){
+    realShaderSource(shader, count, string, length);
+    std::string source;
+    for (GLsizei i=0; i<count; i++){
+        if (length != NULL && length[i] >= 0)
+            source.append(string[i], length[i]);
+        else
+            source.append(string[i]);
+    }
+    Payload payload = blobPayload(source.data(), source.size());
+    beginRecord(CAPTURE_SHADER_SOURCE);
+    put32(shader);
+    putPayload(payload);
+    endRecord();
+}
+
+static void GLAPIENTRY hookCompileShader(GLuint shader){
+    realCompileShader(shader);
+    recordWords(CAPTURE_COMPILE_SHADER, { shader });
+}
+
+static GLuint GLAPIENTRY hookCreateProgram(){
+    GLuint program = realCreateProgram();
+    recordWords(CAPTURE_CREATE_PROGRAM, { program });
+    return program;
+}
+
+static void GLAPIENTRY hookDeleteProgram(GLuint program){
+    realDeleteProgram(program);
+    recordWords(CAPTURE_DELETE_PROGRAM, { program });
+}
+
+static void GLAPIENTRY hookAttachShader(GLuint program, GLuint shader){
+    realAttachShader(program, shader);
+    recordWords(CAPTURE_ATTACH_SHADER, { program, shader });
+}
+
+static void GLAPIENTRY hookDetachShader(GLuint program, GLuint shader){
+    realDetachShader(program, shader);
+    recordWords(CAPTURE_DETACH_SHADER, { program, shader });
+}
+
+static void GLAPIENTRY hookLinkProgram(GLuint program){
+    realLinkProgram(program);
+    recordWords(CAPTURE_LINK_PROGRAM, { program });
+}
+
+static void GLAPIENTRY hookUseProgram(GLuint program){
+    realUseProgram(program);
+    recordWords(CAPTURE_USE_PROGRAM, { program });
+}
+
+static GLint GLAPIENTRY hookGetUniformLocation(GLuint program, const GLchar * name){
+    GLint location = realGetUniformLocation(program, name);
+    unsigned int length = (unsigned int)strlen(name);
+    beginRecord(CAPTURE_UNIFORM_LOCATION);
+    put32(program);
+    put32(location);
+    put32(length);
+    put(name, length);
+    endRecord();
+    return location;
+}
+
+static void GLAPIENTRY hookUniform1i(GLint location, GLint v0){
+    realUniform1i(location, v0);
+    recordWords(CAPTURE_UNIFORM_1I, { (unsigned int)location, (unsigned int)v0 });
+}
+
+static void GLAPIENTRY hookUniform1f(GLint location, GLfloat v0){
+    realUniform1f(location, v0);
+    recordWords(CAPTURE_UNIFORM_1F, { (unsigned int)location, bits(v0) });
+}
+
+static void GLAPIENTRY hookUniform2f(GLint location, GLfloat v0, GLfloat v1){
+    realUniform2f(location, v0, v1);
+    recordWords(CAPTURE_UNIFORM_2F, { (unsigned int)location, bits(v0), bits(v1) });
+}
+
+static void GLAPIENTRY hookUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2){
+    realUniform3f(location, v0, v1, v2);
+    recordWords(CAPTURE_UNIFORM_3F, { (unsigned int)location, bits(v0), bits(v1), bits(v2) });
+}
+
+static void GLAPIENTRY hookUniform3i(GLint location, GLint v0, GLint v1, GLint v2){
+    realUniform3i(location, v0, v1, v2);
+    recordWords(CAPTURE_UNIFORM_3I, { (unsigned int)location, (unsigned int)v0, (unsigned int)v1, (unsigned int)v2 });
+}
+
+static void GLAPIENTRY hookUniform4fv(GLint location, GLsizei count, const GLfloat * value){
+    realUniform4fv(location, count, value);
+    beginRecord(CAPTURE_UNIFORM_4FV);
+    put32(location);
+    put32(count);
+    put(value, count * 4 * sizeof(GLfloat));
+    endRecord();
+}
+
+static void GLAPIENTRY hookUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat * value){
+    realUniformMatrix4fv(location, count, transpose, value);
+    beginRecord(CAPTURE_UNIFORM_MATRIX_4FV);
+    put32(location);
+    put32(count);
+    put32(transpose);
+    put(value, count * 16 * sizeof(GLfloat));
+    endRecord();
+}
+
+static void putDrawRanges(GLsizei drawcount, const GLsizei * count, const void * const * indices){
+    put32(drawcount);
+    put(count, drawcount * sizeof(GLsizei));
+    for (GLsizei i=0; i<drawcount; i++)
+        put64((size_t)indices[i]);
+}
+
+static void GLAPIENTRY hookMultiDrawElements(GLenum mode, const GLsizei * count, GLenum type, const void * const * indices, GLsizei drawcount){
+    realMultiDrawElements(mode, count, type, indices, drawcount);
+    beginRecord(CAPTURE_MULTI_DRAW_ELEMENTS);
+    put32(mode);
+    put32(type);
+    putDrawRanges(drawcount, count, indices);
+    endRecord();
+}
+
+static void GLAPIENTRY hookMultiDrawElementsBaseVertex(GLenum mode, const GLsizei * count, GLenum type, const void * const * indices, GLsizei drawcount, const GLint * basevertex){
+    realMultiDrawElementsBaseVertex(mode, count, type, indices, drawcount, basevertex);
+    beginRecord(CAPTURE_MULTI_DRAW_ELEMENTS_BASE_VERTEX);
+    put32(mode);
+    put32(type);
+    putDrawRanges(drawcount, count, indices);
+    put(basevertex, drawcount * sizeof(GLint));
+    endRecord();
+}
+
+static void GLAPIENTRY hookMultiDrawElementsIndirect(GLenum mode, GLenum type, const void * indirect, GLsizei drawcount, GLsizei stride){
+    realMultiDrawElementsIndirect(mode, type, indirect, drawcount, stride);
+    size_t commandBytes = drawcount > 0 ? (size_t)(drawcount - 1) * (stride ? stride : 20) + 20 : 0;
+    Payload payload = sourcePayload(indirect, commandBytes, capture.indirectBuffer);
+    beginRecord(CAPTURE_MULTI_DRAW_ELEMENTS_INDIRECT);
+    put32(mode);
+    put32(type);
+    put32(drawcount);
+    put32(stride);
+    putPayload(payload);
+    endRecord();
+}
+
+bool startGLCapture(const char * path, int width, int height){
+    if (capture.active){
+        printf("GL capture already running\n");
+        return false;
+    }
+    capture.file = fopen(path, "wb");
+    if (capture.file == NULL){
+        printf("%s could not be created\n", path);
+        return false;
+    }
+    GLCaptureHeader header = { GL_CAPTURE_MAGIC, GL_CAPTURE_VERSION, (unsigned int)width, (unsigned int)height };
+    fwrite(&header, sizeof(header), 1, capture.file);
+
+    capture.stream.clear();
+    capture.blobs.clear();
+    capture.mapped.clear();
+    capture.unpackAlignment = 4;
+    capture.unpackBuffer = capture.indirectBuffer = 0;
+    capture.frames = 0;
+    capture.calls = capture.payloadBytes = capture.dedupedBytes = 0;
+    capture.written = sizeof(header);
+
+    // Missing entry points stay NULL, for the extension checks
+#define INSTALL_HOOK(name) real##name = __glew##name; if (real##name != NULL) __glew##name = hook##name;
+    CAPTURE_HOOKS(INSTALL_HOOK)
+#undef INSTALL_HOOK
+    capture.active = true;
+    printf("Capturing GL calls to %s\n", path);
+    return true;
+}
+
+void endGLCaptureFrame(){
+    if (!capture.active)
+        return;
+    recordWords(CAPTURE_FRAME, { capture.frames });
+    capture.frames++;
+    flushStream();
+}
+
+void stopGLCapture(){
+    if (!capture.active)
+        return;
+#define REMOVE_HOOK(name) if (real##name != NULL) __glew##name = real##name;
+    CAPTURE_HOOKS(REMOVE_HOOK)
+#undef REMOVE_HOOK
+    if (!capture.mapped.empty())
+        printf("GL capture stopped with %u buffers mapped : what is written to them is lost\n", (unsigned int)capture.mapped.size());
+    capture.active = false;
+    flushStream();
+    fclose(capture.file);
+    capture.file = NULL;
+    printf("GL capture : %u frames, %llu calls, %.1f MB written, %.1f of %.1f MB of payloads deduplicated\n",
+        capture.frames, capture.calls, capture.written / (1024.0 * 1024.0),
+        capture.dedupedBytes / (1024.0 * 1024.0), capture.payloadBytes / (1024.0 * 1024.0));
+    capture.stream = std::vector<unsigned char>();
+    capture.blobs.clear();
+}
+
+bool glCaptureActive(){
+    return capture.active;
+}
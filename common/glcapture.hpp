@@ -0,0 +1,148 @@
+#ifndef GLCAPTURE_HPP
+#define GLCAPTURE_HPP
+
+#include <GL/glew.h>
+
+// GL command capture : every GL call of the application that changes what is drawn, written to a file that
+// glreplay plays back without the window, the input or the simulation. Gets and queries are not recorded.
+// Buffer, texture and shader payloads are stored once per content hash, and referenced by every call using them.
+//
+// Entry points newer than GL 1.1 are GLEW function pointers : capturing swaps them for recording wrappers, so
+// call sites and extension checks stay as they are. GL 1.1 ones are plain functions : the files making GL calls
+// include this header after GL/glew.h, which redirects them to the wrappers below (a flag test when not capturing).
+
+static const unsigned int GL_CAPTURE_MAGIC = 0x50434C47; // "GLCP"
+static const unsigned int GL_CAPTURE_VERSION = 1;
+
+// File : GLCaptureHeader, then records. A record is its GLCaptureOp and its size in bytes (32 bits each), then its
+// arguments : 32 bits for enums, names, ints and floats, 64 bits for offsets and payload hashes.
+struct GLCaptureHeader {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int width, height; // of the default framebuffer
+};
+
+enum GLCaptureOp {
+    CAPTURE_FRAME,              // end of a frame : the swap
+    CAPTURE_BLOB,               // hash, then the bytes : before the first call using them
+    CAPTURE_CLEAR,
+    CAPTURE_CLEAR_COLOR,
+    CAPTURE_VIEWPORT,
+    CAPTURE_ENABLE,
+    CAPTURE_DISABLE,
+    CAPTURE_DEPTH_FUNC,
+    CAPTURE_BLEND_FUNC,
+    CAPTURE_PIXEL_STORE,
+    CAPTURE_GEN_TEXTURES,
+    CAPTURE_DELETE_TEXTURES,
+    CAPTURE_BIND_TEXTURE,
+    CAPTURE_ACTIVE_TEXTURE,
+    CAPTURE_TEX_PARAMETER,
+    CAPTURE_TEX_IMAGE_2D,
+    CAPTURE_TEX_IMAGE_3D,
+    CAPTURE_TEX_SUB_IMAGE_3D,
+    CAPTURE_COMPRESSED_TEX_IMAGE_2D,
+    CAPTURE_COMPRESSED_TEX_IMAGE_3D,
+    CAPTURE_GENERATE_MIPMAP,
+    CAPTURE_TEX_BUFFER,
+    CAPTURE_GEN_BUFFERS,
+    CAPTURE_DELETE_BUFFERS,
+    CAPTURE_BIND_BUFFER,
+    CAPTURE_BUFFER_DATA,
+    CAPTURE_BUFFER_SUB_DATA,
+    CAPTURE_MAPPED_WRITE,       // glMapBufferRange + what was written + glUnmapBuffer
+    CAPTURE_GEN_VERTEX_ARRAYS,
+    CAPTURE_DELETE_VERTEX_ARRAYS,
+    CAPTURE_BIND_VERTEX_ARRAY,
+    CAPTURE_ENABLE_ATTRIB,
+    CAPTURE_DISABLE_ATTRIB,
+    CAPTURE_ATTRIB_POINTER,
+    CAPTURE_ATTRIB_DIVISOR,
+    CAPTURE_GEN_FRAMEBUFFERS,
+    CAPTURE_DELETE_FRAMEBUFFERS,
+    CAPTURE_BIND_FRAMEBUFFER,
+    CAPTURE_FRAMEBUFFER_RENDERBUFFER,
+    CAPTURE_BLIT_FRAMEBUFFER,
+    CAPTURE_GEN_RENDERBUFFERS,
+    CAPTURE_DELETE_RENDERBUFFERS,
+    CAPTURE_BIND_RENDERBUFFER,
+    CAPTURE_RENDERBUFFER_STORAGE_MULTISAMPLE,
+    CAPTURE_CREATE_SHADER,
+    CAPTURE_DELETE_SHADER,
+    CAPTURE_SHADER_SOURCE,
+    CAPTURE_COMPILE_SHADER,
+    CAPTURE_CREATE_PROGRAM,
+    CAPTURE_DELETE_PROGRAM,
+    CAPTURE_ATTACH_SHADER,
+    CAPTURE_DETACH_SHADER,
+    CAPTURE_LINK_PROGRAM,
+    CAPTURE_USE_PROGRAM,
+    CAPTURE_UNIFORM_LOCATION,   // program, the location it returned, the name : replays map locations through it
+    CAPTURE_UNIFORM_1I,
+    CAPTURE_UNIFORM_1F,
+    CAPTURE_UNIFORM_2F,
+    CAPTURE_UNIFORM_3F,
+    CAPTURE_UNIFORM_3I,
+    CAPTURE_UNIFORM_4FV,
+    CAPTURE_UNIFORM_MATRIX_4FV,
+    CAPTURE_DRAW_ARRAYS,
+    CAPTURE_DRAW_ELEMENTS,
+    CAPTURE_MULTI_DRAW_ELEMENTS,
+    CAPTURE_MULTI_DRAW_ELEMENTS_BASE_VERTEX,
+    CAPTURE_MULTI_DRAW_ELEMENTS_INDIRECT,
+    CAPTURE_OP_COUNT
+};
+
+// Where the data of a call comes from : its pixels, vertices or draw commands
+enum GLCapturePayload {
+    PAYLOAD_NONE,   // NULL
+    PAYLOAD_BLOB,   // 64 bits hash of a CAPTURE_BLOB
+    PAYLOAD_OFFSET  // 64 bits offset in the buffer bound for it (pixel unpack, draw indirect)
+};
+
+// Right after glewInit, before anything is created : the replay starts from an empty context.
+// width, height : the size of the default framebuffer.
+bool startGLCapture(const char * path, int width, int height);
+// Before the swap : frames are what the replay loops over and times
+void endGLCaptureFrame();
+// Writes what is left and puts the GL entry points back. Not while a buffer is mapped : the application writes
+// to a copy of the mapping, given back on unmap.
+void stopGLCapture();
+bool glCaptureActive();
+
+// GL 1.1 : recorded, then forwarded
+void captureClear(GLbitfield mask);
+void captureClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+void captureViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+void captureEnable(GLenum cap);
+void captureDisable(GLenum cap);
+void captureDepthFunc(GLenum func);
+void captureBlendFunc(GLenum sfactor, GLenum dfactor);
+void capturePixelStorei(GLenum pname, GLint param);
+void captureGenTextures(GLsizei n, GLuint * textures);
+void captureDeleteTextures(GLsizei n, const GLuint * textures);
+void captureBindTexture(GLenum target, GLuint texture);
+void captureTexParameteri(GLenum target, GLenum pname, GLint param);
+void captureTexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void * pixels);
+void captureDrawArrays(GLenum mode, GLint first, GLsizei count);
+void captureDrawElements(GLenum mode, GLsizei count, GLenum type, const void * indices);
+
+#ifndef GLCAPTURE_NO_REDIRECT
+#define glClear captureClear
+#define glClearColor captureClearColor
+#define glViewport captureViewport
+#define glEnable captureEnable
+#define glDisable captureDisable
+#define glDepthFunc captureDepthFunc
+#define glBlendFunc captureBlendFunc
+#define glPixelStorei capturePixelStorei
+#define glGenTextures captureGenTextures
+#define glDeleteTextures captureDeleteTextures
+#define glBindTexture captureBindTexture
+#define glTexParameteri captureTexParameteri
+#define glTexImage2D captureTexImage2D
+#define glDrawArrays captureDrawArrays
+#define glDrawElements captureDrawElements
+#endif
+
+#endif
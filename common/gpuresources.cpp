@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#include <GL/glew.h>
+
+#include "gpuresources.hpp"
+#include "glcapture.hpp"
+
+static const char * CATEGORY_NAMES[GPU_RESOURCE_TYPES] = {
+    "buffers", "textures", "renderbuffers", "programs", "vertex arrays"
+};
+static const char * RESOURCE_NAMES[GPU_RESOURCE_TYPES] = {
+    "buffer", "texture", "renderbuffer", "program", "vertex array"
+};
+
+GPUResources & gpuResources(){
+    static GPUResources * resources = NULL;
+    if (resources == NULL){
+        // Never freed, like the GL context it describes until glfwTerminate
+        resources = new GPUResources();
+        for (int t=0; t<GPU_RESOURCE_TYPES; t++){
+            GPUResourceCategory & c = resources->categories[t];
+            c.bytes = c.highWater = c.budget = 0;
+            c.overBudget = false;
+            c.created = c.deleted = 0;
+        }
+    }
+    return *resources;
+}
+
+// Last two parts of the path : CMake passes absolute ones
+static const char * shortPath(const char * path){
+    const char * last = NULL, * previous = NULL;
+    for (const char * p = path; *p; p++){
+        if (*p == '/' || *p == '\\'){
+            previous = last;
+            last = p;
+        }
+    }
+    return previous != NULL ? previous + 1 : path;
+}
+
+static void checkBudget(GPUResourceType type){
+    GPUResourceCategory & c = gpuResources().categories[type];
+    if (c.budget == 0 || c.bytes <= c.budget){
+        c.overBudget = false;
+        return;
+    }
+    if (c.overBudget)
+        return;
+    c.overBudget = true;
+
+    std::map<GLuint, GPUResource>::const_iterator largest = c.live.begin();
+    for (std::map<GLuint, GPUResource>::const_iterator it = c.live.begin(); it != c.live.end(); ++it){
+        if (it->second.bytes > largest->second.bytes)
+            largest = it;
+    }
+    printf("Warning : GPU %s over budget, %.1f MB of %.1f MB. Largest : %s %u '%s' (%.1f MB) from %s:%d\n",
+        CATEGORY_NAMES[type], c.bytes / (1024.0 * 1024.0), c.budget / (1024.0 * 1024.0),
+        RESOURCE_NAMES[type], largest->first, largest->second.tag.c_str(), largest->second.bytes / (1024.0 * 1024.0),
+        shortPath(largest->second.file), largest->second.line);
+}
+
+void registerGPUResourceAt(GPUResourceType type, GLuint name, const char * tag, const char * file, int line){
+    if (name == 0)
+        return;
+    GPUResourceCategory & c = gpuResources().categories[type];
+    GPUResource & resource = c.live[name];
+    c.bytes -= resource.bytes; // a name the driver reused without us seeing the delete
+    resource.tag = tag != NULL ? tag : "";
+    resource.file = file;
+    resource.line = line;
+    resource.bytes = 0;
+    c.created++;
+}
+
+GLuint createGPUResourceAt(GPUResourceType type, const char * tag, const char * file, int line){
+    GLuint name = 0;
+    switch (type){
+    case GPU_BUFFER:       glGenBuffers(1, &name); break;
+    case GPU_TEXTURE:      glGenTextures(1, &name); break;
+    case GPU_RENDERBUFFER: glGenRenderbuffers(1, &name); break;
+    case GPU_PROGRAM:      name = glCreateProgram(); break;
+    case GPU_VERTEX_ARRAY: glGenVertexArrays(1, &name); break;
+    default: break;
+    }
+    registerGPUResourceAt(type, name, tag, file, line);
+    return name;
+}
+
+void deleteGPUResource(GPUResourceType type, GLuint & name){
+    if (name == 0)
+        return;
+    switch (type){
+    case GPU_BUFFER:       glDeleteBuffers(1, &name); break;
+    case GPU_TEXTURE:      glDeleteTextures(1, &name); break;
+    case GPU_RENDERBUFFER: glDeleteRenderbuffers(1, &name); break;
+    case GPU_PROGRAM:      glDeleteProgram(name); break;
+    case GPU_VERTEX_ARRAY: glDeleteVertexArrays(1, &name); break;
+    default: break;
+    }
+
+    GPUResourceCategory & c = gpuResources().categories[type];
+    std::map<GLuint, GPUResource>::iterator it = c.live.find(name);
+    if (it != c.live.end()){
+        c.bytes -= it->second.bytes;
+        c.live.erase(it);
+        c.deleted++;
+        checkBudget(type);
+    }
+    else printf("Warning : deleting %s %u, which was never created or is already deleted\n", RESOURCE_NAMES[type], name);
+    name = 0;
+}
+
+void setGPUResourceBytes(GPUResourceType type, GLuint name, size_t bytes){
+    GPUResourceCategory & c = gpuResources().categories[type];
+    std::map<GLuint, GPUResource>::iterator it = c.live.find(name);
+    if (it == c.live.end())
+        return;
+    c.bytes = c.bytes - it->second.bytes + bytes;
+    it->second.bytes = bytes;
+    c.highWater = std::max(c.highWater, c.bytes);
+    checkBudget(type);
+}
+
+// Bytes per pixel, or per 4x4 block for compressed formats
+static size_t formatBytes(GLenum internalFormat, bool & compressed){
+    compressed = true;
+    switch (internalFormat){
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RED_RGTC1:
+    case GL_COMPRESSED_SIGNED_RED_RGTC1:
+        return 8;
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_RG_RGTC2:
+    case GL_COMPRESSED_SIGNED_RG_RGTC2:
+    case GL_COMPRESSED_RGBA_BPTC_UNORM_ARB:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM_ARB:
+    case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT_ARB:
+    case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT_ARB:
+        return 16;
+    }
+    compressed = false;
+    switch (internalFormat){
+    case GL_R8: case GL_R8UI: case GL_R8I: case GL_RED:
+        return 1;
+    case GL_RG8: case GL_R16F: case GL_R16: case GL_R16UI: case GL_R16I: case GL_DEPTH_COMPONENT16:
+        return 2;
+    case GL_RGBA16F: case GL_RGBA16: case GL_RG32F: case GL_RG32UI: case GL_RG32I: case GL_DEPTH32F_STENCIL8:
+        return 8;
+    case GL_RGB32F: case GL_RGB32UI: case GL_RGB32I:
+        return 12;
+    case GL_RGBA32F: case GL_RGBA32UI: case GL_RGBA32I:
+        return 16;
+    }
+    // RGBA8, sRGB, RGB10_A2, R32F, depth 24 / 32... and RGB8, which drivers pad to 4 bytes
+    return 4;
+}
+
+size_t gpuTextureBytes(GLenum internalFormat, unsigned int width, unsigned int height, unsigned int depth, unsigned int levels){
+    bool compressed;
+    size_t unit = formatBytes(internalFormat, compressed);
+    size_t bytes = 0;
+    for (unsigned int l=0; levels == 0 || l < levels; l++){
+        if (compressed)
+            bytes += (size_t)((width + 3) / 4) * ((height + 3) / 4) * unit * depth;
+        else
+            bytes += (size_t)width * height * unit * depth;
+        if (width == 1 && height == 1)
+            break;
+        width = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+    }
+    return bytes;
+}
+
+void setGPUBudget(GPUResourceType type, size_t bytes){
+    gpuResources().categories[type].budget = bytes;
+    checkBudget(type);
+}
+
+void printGPUResourceStats(){
+    GPUResources & resources = gpuResources();
+    size_t total = 0;
+    unsigned int created = 0, deleted = 0;
+    char line[512];
+    int length = 0;
+    for (int t=0; t<GPU_RESOURCE_TYPES; t++){
+        GPUResourceCategory & c = resources.categories[t];
+        total += c.bytes;
+        created += c.created;
+        deleted += c.deleted;
+        c.created = c.deleted = 0;
+        if (t == GPU_PROGRAM || t == GPU_VERTEX_ARRAY)
+            length += snprintf(line + length, sizeof(line) - length, "%s%s %u", t ? ", " : "", CATEGORY_NAMES[t], (unsigned int)c.live.size());
+        else
+            length += snprintf(line + length, sizeof(line) - length, "%s%s %u %.1f MB", t ? ", " : "", CATEGORY_NAMES[t], (unsigned int)c.live.size(), c.bytes / (1024.0 * 1024.0));
+        length = std::min(length, (int)sizeof(line) - 1);
+    }
+    printf("GPU memory : %.1f MB (%s), %u created, %u deleted\n", total / (1024.0 * 1024.0), line, created, deleted);
+}
+
+unsigned int reportGPUResourceLeaks(){
+    GPUResources & resources = gpuResources();
+    unsigned int count = 0;
+    for (int t=0; t<GPU_RESOURCE_TYPES; t++)
+        count += (unsigned int)resources.categories[t].live.size();
+    if (count == 0){
+        printf("GPU resources : no leaks\n");
+        return 0;
+    }
+
+    printf("GPU resources : %u leaked\n", count);
+    for (int t=0; t<GPU_RESOURCE_TYPES; t++){
+        const GPUResourceCategory & c = resources.categories[t];
+        for (std::map<GLuint, GPUResource>::const_iterator it = c.live.begin(); it != c.live.end(); ++it){
+            printf("    %s %u '%s', %.1f KB, created at %s:%d\n", RESOURCE_NAMES[t], it->first,
+                it->second.tag.c_str(), it->second.bytes / 1024.0, shortPath(it->second.file), it->second.line);
+        }
+    }
+    return count;
+}
@@ -0,0 +1,68 @@
+#ifndef GPURESOURCES_HPP
+#define GPURESOURCES_HPP
+
+#include <map>
+#include <string>
+#include <stddef.h>
+#include <GL/glew.h>
+
+enum GPUResourceType {
+    GPU_BUFFER,
+    GPU_TEXTURE,
+    GPU_RENDERBUFFER,
+    GPU_PROGRAM,
+    GPU_VERTEX_ARRAY,
+    GPU_RESOURCE_TYPES
+};
+
+struct GPUResource {
+    std::string tag;   // what it holds, for the reports
+    const char * file; // where it was created
+    int line;
+    size_t bytes;      // as specified : the driver may pad, and programs and VAOs stay at 0
+};
+
+struct GPUResourceCategory {
+    std::map<GLuint, GPUResource> live;
+    size_t bytes;
+    size_t highWater;
+    size_t budget;     // 0 : none
+    bool overBudget;   // warned, until back under
+    unsigned int created, deleted; // since the last print
+};
+
+// Every buffer, texture, renderbuffer, program and VAO of the application, with its size and creation site.
+// GL thread only. Framebuffers and queries hold no memory of their own and are not tracked.
+struct GPUResources {
+    GPUResourceCategory categories[GPU_RESOURCE_TYPES];
+};
+
+GPUResources & gpuResources();
+
+// glGen* (glCreateProgram for programs) and registration. Use the macros, which record the call site.
+GLuint createGPUResourceAt(GPUResourceType type, const char * tag, const char * file, int line);
+// For names made elsewhere
+void registerGPUResourceAt(GPUResourceType type, GLuint name, const char * tag, const char * file, int line);
+#define createGPUResource(type, tag) createGPUResourceAt(type, tag, __FILE__, __LINE__)
+#define registerGPUResource(type, name, tag) registerGPUResourceAt(type, name, tag, __FILE__, __LINE__)
+
+// glDelete* and unregistration. Name 0 is ignored, name is set to 0.
+void deleteGPUResource(GPUResourceType type, GLuint & name);
+
+// After glBufferData, glTexImage*, glRenderbufferStorage* : the total of the resource, all levels included
+void setGPUResourceBytes(GPUResourceType type, GLuint name, size_t bytes);
+
+// Bytes of levels [0, levels) of a texture, depth being the layers (x6 for cubemaps) or the 3D depth.
+// levels 0, or more than the chain has : the whole chain down to 1x1. Block compressed formats included.
+size_t gpuTextureBytes(GLenum internalFormat, unsigned int width, unsigned int height, unsigned int depth, unsigned int levels);
+
+// Warns once when a category goes over budget, with its largest resource
+void setGPUBudget(GPUResourceType type, size_t bytes);
+
+// Live totals per category. Clears the created / deleted counters.
+void printGPUResourceStats();
+
+// At shutdown, before the context goes : lists whatever is still alive. Returns how many.
+unsigned int reportGPUResourceLeaks();
+
+#endif
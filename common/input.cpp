@@ -1,31 +1,134 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
 #include "input.hpp"
 
-void computeMatricesFromInputs(GLFWwindow* window, mat4& projMat, mat4& viewMat) {
-    static double lastTime = glfwGetTime();
-    static float initialFOV = 50.0f;
-    static float FOV = initialFOV;
+static void keyCallback(GLFWwindow * window, int key, int, int action, int){
+    InputEvent event = { INPUT_EVENT_KEY, glfwGetTime(), key, action, 0.0, 0.0 };
+    pushInputEvent(*(InputSystem *)glfwGetWindowUserPointer(window), event);
+}
+
+static void scrollCallback(GLFWwindow * window, double xOffset, double yOffset){
+    InputEvent event = { INPUT_EVENT_SCROLL, glfwGetTime(), 0, 0, xOffset, yOffset };
+    pushInputEvent(*(InputSystem *)glfwGetWindowUserPointer(window), event);
+}
+
+static void windowSizeCallback(GLFWwindow * window, int width, int height){
+    InputEvent event = { INPUT_EVENT_RESIZE, glfwGetTime(), 0, 0, (double)width, (double)height };
+    pushInputEvent(*(InputSystem *)glfwGetWindowUserPointer(window), event);
+}
+
+void initInput(GLFWwindow * window, InputSystem & input){
+    input.head = 0;
+    input.tail = 0;
+    input.dropped = 0;
+    memset(input.keys, 0, sizeof(input.keys));
+    memset(&input.latched, 0, sizeof(input.latched));
+
+    glfwSetWindowUserPointer(window, &input);
+    glfwSetKeyCallback(window, keyCallback);
+    glfwSetScrollCallback(window, scrollCallback);
+    glfwSetWindowSizeCallback(window, windowSizeCallback);
+}
+
+void initCamera(Camera & camera, GLFWwindow * window){
+    camera.position = vec3(4, 2, 0);
+    camera.angle = 0.0f;
+    camera.radius = 4.0f;
+    camera.FOV = 50.0f;
+    camera.zNear = 0.1f;
+    camera.zFar = 100.0f;
+    glfwGetWindowSize(window, &camera.width, &camera.height);
+}
+
+bool pushInputEvent(InputSystem & input, const InputEvent & event){
+    unsigned int tail = input.tail.load(std::memory_order_relaxed);
+    unsigned int head = input.head.load(std::memory_order_acquire);
+    if (tail - head == InputSystem::CAPACITY){
+        input.dropped++;
+        return false;
+    }
+    input.events[tail & (InputSystem::CAPACITY - 1)] = event;
+    // Publish the event : the consumer sees it only once it is completely written
+    input.tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+static void applyEvent(InputSystem & input, Camera & camera, const InputEvent & event){
+    switch (event.type){
+    case INPUT_EVENT_KEY:
+        if (event.key >= 0 && event.key <= GLFW_KEY_LAST)
+            input.keys[event.key] = event.action != GLFW_RELEASE;
+        break;
+    case INPUT_EVENT_SCROLL:
+        // Mouse wheel turns around the origin
+        camera.angle += (float)event.y * 5;
+        camera.position.x = camera.radius * cos(radians(camera.angle));
+        camera.position.z = camera.radius * sin(radians(camera.angle));
+        break;
+    case INPUT_EVENT_RESIZE:
+        camera.width = (int)event.x;
+        camera.height = (int)event.y;
+        break;
+    }
+}
+
+void latchInputEvents(InputSystem & input, Camera & camera){
+    unsigned int head = input.head.load(std::memory_order_relaxed);
+    unsigned int tail = input.tail.load(std::memory_order_acquire);
+    for (; head!=tail; head++){
+        const InputEvent & event = input.events[head & (InputSystem::CAPACITY - 1)];
+        applyEvent(input, camera, event);
+
+        if (input.latched.count == 0)
+            input.latched.oldest = event.time;
+        input.latched.timeSum += event.time;
+        input.latched.count++;
+    }
+    // Give the slots back to the producer
+    input.head.store(head, std::memory_order_release);
+}
 
-    static vec3 position = vec3(4, 2, 0);
-    static float angle = 0.0f;
+bool isKeyDown(const InputSystem & input, int key){
+    return key >= 0 && key <= GLFW_KEY_LAST && input.keys[key];
+}
 
-    int width, height;
-    double currentTime = glfwGetTime();
+void computeCameraMatrices(const Camera & camera, mat4 & projMat, mat4 & viewMat){
+    float aspect = camera.height > 0 ? (float)camera.width / (float)camera.height : 1.0f;
+    projMat = perspective(radians(camera.FOV), aspect, camera.zNear, camera.zFar);
+    viewMat = lookAt(camera.position, vec3(0, 0, 0), vec3(0, 1, 0));
+}
 
-    glfwGetWindowSize(window, &width, &height);
+LatchedInput takeLatchedInput(InputSystem & input){
+    LatchedInput latched = input.latched;
+    memset(&input.latched, 0, sizeof(input.latched));
+    return latched;
+}
 
-    // Return mouse cursor to center
-    glfwSetCursorPos(window, width / 2, height / 2);
+void mergeLatchedInput(LatchedInput & into, const LatchedInput & from){
+    if (from.count == 0)
+        return;
+    into.oldest = into.count == 0 ? from.oldest : std::min(into.oldest, from.oldest);
+    into.timeSum += from.timeSum;
+    into.count += from.count;
+}
 
-    // Mouse wheel callback (FOV)
-    glfwSetScrollCallback(window, [](GLFWwindow* window, double xOffset, double yOffset) {
-        angle += yOffset * 5;
-        position.x = 4 * cos(radians(angle));
-        position.z = 4 * sin(radians(angle));
-    });
+void recordInputLatency(InputLatencyStats & stats, const LatchedInput & latched, double submitTime){
+    if (latched.count == 0)
+        return;
 
-    lastTime = currentTime;
+    stats.sum += latched.count * submitTime - latched.timeSum;
+    stats.max = std::max(stats.max, submitTime - latched.oldest);
+    stats.count += latched.count;
+}
 
-    // Calculate matrix
-    projMat = perspective(radians(FOV), (float)width / (float)height, 0.1f, 100.0f);
-    viewMat = lookAt(position, vec3(0, 0, 0), vec3(0, 1, 0));
-}
\ No newline at end of file
+void printInputLatency(InputLatencyStats & stats, const InputSystem & input){
+    if (stats.count > 0){
+        printf("Input : %u events, event to submit latency avg %.3f ms, max %.3f ms, %u dropped\n",
+            stats.count, stats.sum / stats.count * 1000.0, stats.max * 1000.0, input.dropped.load());
+    }
+    stats.sum = 0.0;
+    stats.max = 0.0;
+    stats.count = 0;
+}
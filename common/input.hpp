@@ -1,11 +1,86 @@
 #ifndef INPUT_HPP
 #define INPUT_HPP
 
+#include <atomic>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 using namespace glm;
 
-void computeMatricesFromInputs(GLFWwindow* window, mat4& projMat, mat4& viewMat);
+enum InputEventType {
+    INPUT_EVENT_KEY,
+    INPUT_EVENT_SCROLL,
+    INPUT_EVENT_RESIZE
+};
+
+struct InputEvent {
+    int type;
+    double time; // glfwGetTime() when GLFW called us
+    int key, action;
+    double x, y; // scroll offset, or new window size
+};
+
+// Events applied to a camera but not on screen yet
+struct LatchedInput {
+    unsigned int count;
+    double timeSum; // sum of the event times
+    double oldest;
+};
+
+// Event to submit latency, in seconds
+struct InputLatencyStats {
+    double sum, max;
+    unsigned int count;
+};
+
+// Single producer (GLFW callbacks) / single consumer (whoever latches the camera) lock-free queue.
+// One per window : the window user pointer points to it.
+struct InputSystem {
+    static const unsigned int CAPACITY = 256; // power of 2
+    InputEvent events[CAPACITY];
+    std::atomic<unsigned int> head; // next event to read, written by the consumer
+    std::atomic<unsigned int> tail; // next event to write, written by the producer
+    std::atomic<unsigned int> dropped; // events lost because the queue was full
+
+    // Consumer side
+    bool keys[GLFW_KEY_LAST + 1];
+    LatchedInput latched; // since the last takeLatchedInput
+};
+
+// Orbit camera around the origin, driven by the mouse wheel
+struct Camera {
+    vec3 position;
+    float angle; // degrees
+    float radius;
+    float FOV;   // degrees
+    float zNear, zFar;
+    int width, height;
+};
+
+// Registers the GLFW callbacks of this window, once
+void initInput(GLFWwindow * window, InputSystem & input);
+
+void initCamera(Camera & camera, GLFWwindow * window);
+
+// Producer side : called by the GLFW callbacks, or to replay recorded events
+bool pushInputEvent(InputSystem & input, const InputEvent & event);
+
+// Applies all the pending events to the camera and the key states.
+// Call it as late as possible, right before the view matrix is needed.
+void latchInputEvents(InputSystem & input, Camera & camera);
+
+bool isKeyDown(const InputSystem & input, int key);
+
+void computeCameraMatrices(const Camera & camera, mat4 & projMat, mat4 & viewMat);
+
+// Returns the events latched since the last call, to hand them over with what they changed
+LatchedInput takeLatchedInput(InputSystem & input);
+void mergeLatchedInput(LatchedInput & into, const LatchedInput & from);
+
+// Call right after submitting the frame that shows these events
+void recordInputLatency(InputLatencyStats & stats, const LatchedInput & latched, double submitTime);
+
+// Prints and resets the latency statistics
+void printInputLatency(InputLatencyStats & stats, const InputSystem & input);
 
 #endif
@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <map>
+#include <utility>
+#include <algorithm>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "materialtextures.hpp"
+#include "gpuresources.hpp"
+#include "glcapture.hpp"
+
+void initMaterialTextures(MaterialTextures & materials, unsigned int pageSize, unsigned int padding){
+    materials.pageSize = pageSize;
+    materials.padding = std::max(1u, padding);
+    materials.images.clear();
+    materials.slots.clear();
+    materials.arrays.clear();
+    materials.atlasPages = 0;
+    materials.atlasOccupancy = 0.0f;
+}
+
+unsigned int addMaterialImage(MaterialTextures & materials, const unsigned char * rgba, unsigned int width, unsigned int height){
+    MaterialImage image;
+    image.rgba.assign(rgba, rgba + (size_t)width * height * 4);
+    image.width = width;
+    image.height = height;
+    materials.images.push_back(image);
+    return (unsigned int)materials.images.size() - 1;
+}
+
+static bool isPowerOfTwo(unsigned int x){
+    return x != 0 && (x & (x - 1)) == 0;
+}
+
+static GLuint createArray(const char * tag, unsigned int width, unsigned int height, unsigned int layers, unsigned int maxLevel){
+    GLuint texture = createGPUResource(GPU_TEXTURE, tag);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    setGPUResourceBytes(GPU_TEXTURE, texture, gpuTextureBytes(GL_RGBA8, width, height, layers, maxLevel + 1)); // mipmaps generated later
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, maxLevel);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    return texture;
+}
+
+static void uploadLayer(unsigned int layer, unsigned int width, unsigned int height, const unsigned char * rgba){
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+}
+
+// Skyline bottom-left packer : the top of the packed area, as horizontal segments from left to right.
+// A rectangle goes where its top is the lowest, leftmost on ties.
+struct SkylineSegment {
+    unsigned int x, y, width;
+};
+
+static bool skylineFit(const std::vector<SkylineSegment> & skyline, size_t index, unsigned int width, unsigned int pageSize, unsigned int & y){
+    unsigned int x = skyline[index].x;
+    if (x + width > pageSize)
+        return false;
+    y = 0;
+    unsigned int remaining = width;
+    for (size_t i=index; remaining > 0; i++){
+        if (i == skyline.size())
+            return false;
+        y = std::max(y, skyline[i].y);
+        remaining -= std::min(remaining, skyline[i].width);
+    }
+    return true;
+}
+
+static bool skylinePack(std::vector<SkylineSegment> & skyline, unsigned int width, unsigned int height, unsigned int pageSize, unsigned int & outX, unsigned int & outY){
+    size_t best = skyline.size();
+    unsigned int bestY = pageSize;
+    for (size_t i=0; i<skyline.size(); i++){
+        unsigned int y;
+        if (skylineFit(skyline, i, width, pageSize, y) && y + height <= pageSize && y < bestY){
+            best = i;
+            bestY = y;
+        }
+    }
+    if (best == skyline.size())
+        return false;
+
+    outX = skyline[best].x;
+    outY = bestY;
+
+    // The new segment replaces everything it covers
+    SkylineSegment segment = { outX, bestY + height, width };
+    size_t end = best;
+    while (end < skyline.size() && skyline[end].x + skyline[end].width <= outX + width)
+        end++;
+    if (end < skyline.size() && skyline[end].x < outX + width){
+        unsigned int cut = outX + width - skyline[end].x;
+        skyline[end].x += cut;
+        skyline[end].width -= cut;
+    }
+    skyline.erase(skyline.begin() + best, skyline.begin() + end);
+    skyline.insert(skyline.begin() + best, segment);
+
+    // Merge neighbours at the same height
+    for (size_t i=0; i + 1 < skyline.size(); ){
+        if (skyline[i].y == skyline[i + 1].y){
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        }
+        else i++;
+    }
+    return true;
+}
+
+// Size of an atlas entry : the image and its padding, rounded up to the padding
+// so that mips of different entries don't share texels
+static unsigned int atlasEntrySize(unsigned int size, unsigned int padding){
+    return (size + 2 * padding + padding - 1) / padding * padding;
+}
+
+// One array of images of the same size, a layer each
+static void buildImageArray(MaterialTextures & materials, const std::vector<unsigned int> & members){
+    const std::vector<MaterialImage> & images = materials.images;
+    unsigned int width = images[members[0]].width, height = images[members[0]].height;
+    GLuint texture = createArray("material array", width, height, (unsigned int)members.size(), 1000);
+    for (size_t l=0; l<members.size(); l++){
+        uploadLayer((unsigned int)l, width, height, &images[members[l]].rgba[0]);
+        MaterialSlot slot = { texture, (float)l, glm::vec4(0, 0, 1, 1) };
+        materials.slots[members[l]] = slot;
+    }
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    materials.arrays.push_back(texture);
+}
+
+// Copies an image into a page with padding pixels of its edges all around
+static void blitPadded(std::vector<unsigned char> & page, unsigned int pageSize, const MaterialImage & image, unsigned int x, unsigned int y, unsigned int padding){
+    for (unsigned int row=0; row<image.height + 2 * padding; row++){
+        unsigned int sy = (unsigned int)std::min(std::max((int)row - (int)padding, 0), (int)image.height - 1);
+        unsigned char * dst = &page[((size_t)(y + row) * pageSize + x) * 4];
+        const unsigned char * src = &image.rgba[(size_t)sy * image.width * 4];
+        for (unsigned int col=0; col<padding; col++)
+            memcpy(dst + col * 4, src, 4);
+        memcpy(dst + padding * 4, src, image.width * 4);
+        for (unsigned int col=0; col<padding; col++)
+            memcpy(dst + (padding + image.width + col) * 4, src + (image.width - 1) * 4, 4);
+    }
+}
+
+void buildMaterialTextures(MaterialTextures & materials, bool shareTextures){
+    std::vector<MaterialImage> & images = materials.images;
+    materials.slots.resize(images.size());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    if (!shareTextures){
+        for (size_t i=0; i<images.size(); i++){
+            GLuint texture = createArray("material", images[i].width, images[i].height, 1, 1000);
+            uploadLayer(0, images[i].width, images[i].height, &images[i].rgba[0]);
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+            MaterialSlot slot = { texture, 0.0f, glm::vec4(0, 0, 1, 1) };
+            materials.slots[i] = slot;
+            materials.arrays.push_back(texture);
+        }
+        images.clear();
+        return;
+    }
+
+    // Group by size. Lone sizes and sizes that aren't powers of two go to the atlas, unless they are too large
+    // for a page : those get an array of their own, like the shared sizes.
+    std::map<std::pair<unsigned int, unsigned int>, std::vector<unsigned int> > sizes;
+    for (size_t i=0; i<images.size(); i++)
+        sizes[std::make_pair(images[i].width, images[i].height)].push_back((unsigned int)i);
+
+    std::vector<unsigned int> atlased;
+    for (std::map<std::pair<unsigned int, unsigned int>, std::vector<unsigned int> >::iterator it = sizes.begin(); it != sizes.end(); ++it){
+        unsigned int width = it->first.first, height = it->first.second;
+        const std::vector<unsigned int> & members = it->second;
+        bool fitsPage = atlasEntrySize(width, materials.padding) <= materials.pageSize && atlasEntrySize(height, materials.padding) <= materials.pageSize;
+        if (fitsPage && (members.size() < 2 || !isPowerOfTwo(width) || !isPowerOfTwo(height))){
+            atlased.insert(atlased.end(), members.begin(), members.end());
+            continue;
+        }
+        buildImageArray(materials, members);
+    }
+
+    // Atlas : tallest first
+    std::sort(atlased.begin(), atlased.end(), [&](unsigned int a, unsigned int b){ return images[a].height > images[b].height; });
+    unsigned int pageSize = materials.pageSize, padding = materials.padding;
+    std::vector<std::vector<unsigned char> > pages;
+    std::vector<std::vector<SkylineSegment> > skylines;
+    std::vector<glm::uvec3> placements(images.size()); // x, y, page
+    std::vector<unsigned int> packed;
+    size_t texels = 0;
+    for (size_t i=0; i<atlased.size(); i++){
+        const MaterialImage & image = images[atlased[i]];
+        unsigned int width = atlasEntrySize(image.width, padding);
+        unsigned int height = atlasEntrySize(image.height, padding);
+        unsigned int x, y, page;
+        for (page=0; page<skylines.size(); page++){
+            if (skylinePack(skylines[page], width, height, pageSize, x, y))
+                break;
+        }
+        if (page == skylines.size()){
+            SkylineSegment empty = { 0, 0, pageSize };
+            std::vector<SkylineSegment> skyline(1, empty);
+            // fitsPage checked the same size, so an empty page always fits : this is only a safety net
+            if (!skylinePack(skyline, width, height, pageSize, x, y)){
+                printf("Material atlas : a %ux%u image doesn't fit a %u page\n", image.width, image.height, pageSize);
+                buildImageArray(materials, std::vector<unsigned int>(1, atlased[i]));
+                continue;
+            }
+            skylines.push_back(skyline);
+            pages.push_back(std::vector<unsigned char>((size_t)pageSize * pageSize * 4, 0));
+        }
+        blitPadded(pages[page], pageSize, image, x, y, padding);
+        placements[atlased[i]] = glm::uvec3(x, y, page);
+        packed.push_back(atlased[i]);
+        texels += (size_t)image.width * image.height;
+    }
+    if (!pages.empty()){
+        // Levels until the padding is down to one texel
+        unsigned int maxLevel = 0;
+        while ((padding >> (maxLevel + 1)) > 0)
+            maxLevel++;
+        GLuint texture = createArray("material atlas", pageSize, pageSize, (unsigned int)pages.size(), maxLevel);
+        for (size_t p=0; p<pages.size(); p++)
+            uploadLayer((unsigned int)p, pageSize, pageSize, &pages[p][0]);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        materials.arrays.push_back(texture);
+
+        for (size_t i=0; i<packed.size(); i++){
+            const MaterialImage & image = images[packed[i]];
+            glm::uvec3 p = placements[packed[i]];
+            MaterialSlot slot = { texture, (float)p.z, glm::vec4(
+                (p.x + padding) / (float)pageSize, (p.y + padding) / (float)pageSize,
+                image.width / (float)pageSize, image.height / (float)pageSize) };
+            materials.slots[packed[i]] = slot;
+        }
+        materials.atlasPages = (unsigned int)pages.size();
+        materials.atlasOccupancy = texels / ((float)pages.size() * pageSize * pageSize);
+    }
+    images.clear();
+}
+
+void printMaterialTextureStats(const MaterialTextures & materials){
+    printf("Materials : %u materials in %u textures, %u atlas pages (%.0f%% used)\n",
+        (unsigned int)materials.slots.size(), (unsigned int)materials.arrays.size(), materials.atlasPages, materials.atlasOccupancy * 100.0f);
+}
+
+void cleanupMaterialTextures(MaterialTextures & materials){
+    for (size_t i=0; i<materials.arrays.size(); i++)
+        deleteGPUResource(GPU_TEXTURE, materials.arrays[i]);
+    materials.arrays.clear();
+    materials.slots.clear();
+    materials.images.clear();
+}
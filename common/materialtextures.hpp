@@ -0,0 +1,48 @@
+#ifndef MATERIALTEXTURES_HPP
+#define MATERIALTEXTURES_HPP
+
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+// Where a material's texture ended up : a layer of a GL_TEXTURE_2D_ARRAY, and the part of it the image covers
+struct MaterialSlot {
+    GLuint texture;
+    float layer;
+    glm::vec4 uvRect; // offset in xy, scale in zw : uv' = offset + fract(uv) * scale
+};
+
+struct MaterialImage {
+    std::vector<unsigned char> rgba;
+    unsigned int width, height;
+};
+
+// Material textures, grouped so that many materials share one texture binding :
+// - power of two images that have the same size as another one are the layers of an array,
+// - the others are packed into atlas pages (skyline packer), which are the layers of one more array,
+// - images too large for a page get an array of their own.
+// Atlas entries get a padding of replicated edge pixels, and mips stop while that padding still covers
+// a whole texel, so that filtering never reaches a neighbour.
+struct MaterialTextures {
+    unsigned int pageSize;  // atlas pages are pageSize x pageSize
+    unsigned int padding;   // power of two
+    std::vector<MaterialImage> images; // until built
+    std::vector<MaterialSlot> slots;   // one per material
+    std::vector<GLuint> arrays;
+    unsigned int atlasPages;
+    float atlasOccupancy;   // image texels / page texels
+};
+
+void initMaterialTextures(MaterialTextures & materials, unsigned int pageSize, unsigned int padding);
+
+// RGBA8 image, copied. Returns the material index.
+unsigned int addMaterialImage(MaterialTextures & materials, const unsigned char * rgba, unsigned int width, unsigned int height);
+
+// Creates the textures. With shareTextures false, every material gets its own single layer array :
+// same shaders, one binding per material, for comparison.
+void buildMaterialTextures(MaterialTextures & materials, bool shareTextures);
+
+void printMaterialTextureStats(const MaterialTextures & materials);
+void cleanupMaterialTextures(MaterialTextures & materials);
+
+#endif
@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include "memory.hpp"
+
+static size_t alignUp(size_t value, size_t alignment){
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static void initStats(MemoryStats & stats, const char * name, size_t capacity){
+    memset(&stats, 0, sizeof(stats));
+    stats.name = name;
+    stats.capacity = capacity;
+}
+
+static void addUsed(MemoryStats & stats, size_t bytes){
+    stats.used += bytes;
+    stats.highWater = std::max(stats.highWater, stats.used);
+}
+
+// Arena
+
+void initArena(Arena & arena, const char * name, size_t capacity){
+    initStats(arena.stats, name, 0);
+    arena.chunks.clear();
+    arena.chunkSizes.clear();
+    arena.chunk = 0;
+    arena.offset = 0;
+    if (capacity > 0){
+        arena.chunks.push_back(new unsigned char[capacity]);
+        arena.chunkSizes.push_back(capacity);
+        arena.stats.capacity = capacity;
+    }
+}
+
+void * arenaAllocate(Arena & arena, size_t size, size_t alignment){
+    arena.stats.allocations++;
+    // Chunks come from new[], aligned for any fundamental type : aligning the offset is enough
+    while (arena.chunk < arena.chunks.size()){
+        size_t offset = alignUp(arena.offset, alignment);
+        if (offset + size <= arena.chunkSizes[arena.chunk]){
+            addUsed(arena.stats, offset + size - arena.offset);
+            arena.offset = offset + size;
+            return arena.chunks[arena.chunk] + offset;
+        }
+        // The rest of this chunk is lost until the rewind
+        addUsed(arena.stats, arena.chunkSizes[arena.chunk] - arena.offset);
+        if (arena.chunk + 1 == arena.chunks.size())
+            break;
+        arena.chunk++;
+        arena.offset = 0;
+    }
+
+    // New chunk, at least as big as everything before it
+    size_t chunkSize = std::max(size + alignment, std::max(arena.stats.capacity, (size_t)4096));
+    arena.chunks.push_back(new unsigned char[chunkSize]);
+    arena.chunkSizes.push_back(chunkSize);
+    arena.stats.capacity += chunkSize;
+    arena.stats.overflows++;
+    arena.chunk = arena.chunks.size() - 1;
+    size_t offset = alignUp((size_t)arena.chunks[arena.chunk], alignment) - (size_t)arena.chunks[arena.chunk];
+    arena.offset = offset + size;
+    addUsed(arena.stats, arena.offset);
+    return arena.chunks[arena.chunk] + offset;
+}
+
+ArenaMarker arenaMark(const Arena & arena){
+    ArenaMarker marker = { arena.chunk, arena.offset, arena.stats.used };
+    return marker;
+}
+
+void arenaRewind(Arena & arena, const ArenaMarker & marker){
+    arena.chunk = marker.chunk;
+    arena.offset = marker.offset;
+    arena.stats.used = marker.used;
+}
+
+void resetArena(Arena & arena){
+    // Several chunks : replace them with one that holds the high water mark
+    if (arena.chunks.size() > 1){
+        for (size_t i=0; i<arena.chunks.size(); i++)
+            delete [] arena.chunks[i];
+        size_t capacity = alignUp(arena.stats.highWater, 4096);
+        arena.chunks.assign(1, new unsigned char[capacity]);
+        arena.chunkSizes.assign(1, capacity);
+        arena.stats.capacity = capacity;
+    }
+    arena.chunk = 0;
+    arena.offset = 0;
+    arena.stats.used = 0;
+}
+
+void cleanupArena(Arena & arena){
+    for (size_t i=0; i<arena.chunks.size(); i++)
+        delete [] arena.chunks[i];
+    arena.chunks.clear();
+    arena.chunkSizes.clear();
+    arena.chunk = arena.offset = 0;
+    arena.stats.used = arena.stats.capacity = 0;
+}
+
+// Frame allocator
+
+void initFrameAllocator(FrameAllocator & frame, const char * name, size_t capacity){
+    initStats(frame.stats, name, capacity);
+    frame.buffer = new unsigned char[capacity];
+    frame.capacity = capacity;
+    frame.offset = 0;
+    frame.overflowBytes = 0;
+    frame.allocations = 0;
+}
+
+void * frameAllocate(FrameAllocator & frame, size_t size, size_t alignment){
+    frame.allocations++;
+    // Reserve enough for any alignment : the buffer start is only aligned for fundamental types
+    size_t begin = frame.offset.fetch_add(size + alignment - 1);
+    size_t offset = alignUp((size_t)frame.buffer + begin, alignment) - (size_t)frame.buffer;
+    if (offset + size <= frame.capacity)
+        return frame.buffer + offset;
+
+    std::lock_guard<std::mutex> lock(frame.overflowMutex);
+    void * p = ::operator new(size + alignment);
+    frame.overflow.push_back(p);
+    frame.overflowBytes += size + alignment;
+    return (void *)alignUp((size_t)p, alignment);
+}
+
+void resetFrameAllocator(FrameAllocator & frame){
+    MemoryStats & s = frame.stats;
+    size_t used = std::min((size_t)frame.offset, frame.capacity) + frame.overflowBytes;
+    s.used = used;
+    s.highWater = std::max(s.highWater, used);
+    s.allocations += frame.allocations.exchange(0);
+    s.overflows += (unsigned int)frame.overflow.size();
+
+    for (size_t i=0; i<frame.overflow.size(); i++)
+        ::operator delete(frame.overflow[i]);
+    if (!frame.overflow.empty()){
+        // Next frames fit, with some room
+        delete [] frame.buffer;
+        frame.capacity = alignUp(used + used / 2, 4096);
+        frame.buffer = new unsigned char[frame.capacity];
+        s.capacity = frame.capacity;
+    }
+    frame.overflow.clear();
+    frame.overflowBytes = 0;
+    frame.offset = 0;
+}
+
+void cleanupFrameAllocator(FrameAllocator & frame){
+    resetFrameAllocator(frame);
+    delete [] frame.buffer;
+    frame.buffer = NULL;
+    frame.capacity = 0;
+}
+
+FrameAllocator & frameMemory(){
+    static FrameAllocator * frame = NULL;
+    if (frame == NULL){
+        // Never freed : it may still be used by static destructors
+        frame = new FrameAllocator();
+        initFrameAllocator(*frame, "frame", 256 * 1024);
+    }
+    return *frame;
+}
+
+// Pools
+
+void initPool(Pool & pool, const char * name, size_t nodeSize, size_t nodesPerBlock){
+    initStats(pool.stats, name, 0);
+    pool.nodeSize = alignUp(std::max(nodeSize, sizeof(void *)), sizeof(void *));
+    pool.nodesPerBlock = std::max((size_t)1, nodesPerBlock);
+    pool.blocks.clear();
+    pool.freeList = NULL;
+}
+
+void * poolAllocate(Pool & pool){
+    pool.stats.allocations++;
+    if (pool.freeList == NULL){
+        // New block : thread all its nodes into the free list
+        unsigned char * block = new unsigned char[pool.nodeSize * pool.nodesPerBlock];
+        pool.blocks.push_back(block);
+        pool.stats.capacity += pool.nodeSize * pool.nodesPerBlock;
+        pool.stats.overflows++;
+        for (size_t i=pool.nodesPerBlock; i-- > 0; ){
+            void * node = block + i * pool.nodeSize;
+            *(void **)node = pool.freeList;
+            pool.freeList = node;
+        }
+    }
+    void * node = pool.freeList;
+    pool.freeList = *(void **)node;
+    addUsed(pool.stats, pool.nodeSize);
+    return node;
+}
+
+void poolFree(Pool & pool, void * node){
+    *(void **)node = pool.freeList;
+    pool.freeList = node;
+    pool.stats.used -= pool.nodeSize;
+}
+
+void cleanupPool(Pool & pool){
+    for (size_t i=0; i<pool.blocks.size(); i++)
+        delete [] pool.blocks[i];
+    pool.blocks.clear();
+    pool.freeList = NULL;
+    pool.stats.used = pool.stats.capacity = 0;
+}
+
+static int nodeClass(size_t size){
+    int c = 0;
+    while (c < NODE_POOL_CLASSES && ((size_t)16 << c) < size)
+        c++;
+    return c;
+}
+
+void initNodePools(NodePools & pools, const char * name, size_t nodesPerBlock){
+    for (int c=0; c<NODE_POOL_CLASSES; c++)
+        initPool(pools.pools[c], name, (size_t)16 << c, nodesPerBlock);
+}
+
+void * nodePoolAllocate(NodePools & pools, size_t size){
+    int c = nodeClass(size);
+    return c < NODE_POOL_CLASSES ? poolAllocate(pools.pools[c]) : NULL;
+}
+
+void nodePoolFree(NodePools & pools, void * node, size_t size){
+    poolFree(pools.pools[nodeClass(size)], node);
+}
+
+void cleanupNodePools(NodePools & pools){
+    for (int c=0; c<NODE_POOL_CLASSES; c++)
+        cleanupPool(pools.pools[c]);
+}
+
+void printMemoryStats(MemoryStats & stats){
+    printf("Memory %s : %.1f KB used, %.1f KB high water, %.1f KB reserved, %u allocations, %u overflows\n",
+        stats.name, stats.used / 1024.0, stats.highWater / 1024.0, stats.capacity / 1024.0, stats.allocations, stats.overflows);
+    stats.allocations = 0;
+    stats.overflows = 0;
+}
@@ -0,0 +1,163 @@
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <stddef.h>
+
+struct MemoryStats {
+    const char * name;
+    size_t used;           // bytes right now
+    size_t highWater;      // most bytes ever used at once
+    size_t capacity;       // bytes reserved from the system
+    unsigned int allocations; // since the last print
+    unsigned int overflows;   // allocations that had to go to the system, since the last print
+};
+
+// Bump arena for load time scratch : allocations are never freed one by one,
+// the whole arena is rewound to a marker or reset once the asset is loaded.
+// Running out of the current chunk adds a bigger one. A reset then merges them,
+// so after the first asset the arena usually runs in a single chunk.
+struct Arena {
+    std::vector<unsigned char *> chunks;
+    std::vector<size_t> chunkSizes;
+    size_t chunk;   // current chunk
+    size_t offset;  // in the current chunk
+    MemoryStats stats;
+};
+
+struct ArenaMarker {
+    size_t chunk, offset, used;
+};
+
+void initArena(Arena & arena, const char * name, size_t capacity);
+void * arenaAllocate(Arena & arena, size_t size, size_t alignment);
+ArenaMarker arenaMark(const Arena & arena);
+void arenaRewind(Arena & arena, const ArenaMarker & marker);
+void resetArena(Arena & arena);
+void cleanupArena(Arena & arena);
+
+// Rewinds the arena when it goes out of scope, on every return path. Does nothing without an arena.
+struct ArenaScope {
+    Arena * arena;
+    ArenaMarker marker;
+    ArenaScope(Arena * arena) : arena(arena){ if (arena) marker = arenaMark(*arena); }
+    ~ArenaScope(){ if (arena) arenaRewind(*arena, marker); }
+};
+
+// Per frame linear allocator, reset at swap. Allocation is a single atomic add, so any thread can use it.
+// When the buffer is full, allocations fall back to the heap until the reset, and the next reset grows the buffer.
+struct FrameAllocator {
+    unsigned char * buffer;
+    size_t capacity;
+    std::atomic<size_t> offset;
+    std::mutex overflowMutex;
+    std::vector<void *> overflow;
+    size_t overflowBytes;
+    std::atomic<unsigned int> allocations;
+    MemoryStats stats;
+};
+
+void initFrameAllocator(FrameAllocator & frame, const char * name, size_t capacity);
+void * frameAllocate(FrameAllocator & frame, size_t size, size_t alignment);
+void resetFrameAllocator(FrameAllocator & frame); // GL thread, once all the frame's users are done
+void cleanupFrameAllocator(FrameAllocator & frame);
+
+// The allocator the render loop resets at swap
+FrameAllocator & frameMemory();
+
+// Fixed size nodes, carved out of blocks and recycled through a free list. Single threaded.
+struct Pool {
+    size_t nodeSize;
+    size_t nodesPerBlock;
+    std::vector<unsigned char *> blocks;
+    void * freeList;
+    MemoryStats stats;
+};
+
+void initPool(Pool & pool, const char * name, size_t nodeSize, size_t nodesPerBlock);
+void * poolAllocate(Pool & pool);
+void poolFree(Pool & pool, void * node);
+void cleanupPool(Pool & pool);
+
+// Pools for node based containers : sizes up to 256 bytes in power of two classes
+static const int NODE_POOL_CLASSES = 5; // 16, 32, 64, 128, 256
+struct NodePools {
+    Pool pools[NODE_POOL_CLASSES];
+};
+
+void initNodePools(NodePools & pools, const char * name, size_t nodesPerBlock);
+void * nodePoolAllocate(NodePools & pools, size_t size); // NULL when too big for the pools
+void nodePoolFree(NodePools & pools, void * node, size_t size);
+void cleanupNodePools(NodePools & pools);
+
+// Prints and clears the per second counters
+void printMemoryStats(MemoryStats & stats);
+
+// STL adaptors. A NULL source means the heap, so the same container type works without one.
+
+template <typename T>
+struct ArenaAllocator {
+    typedef T value_type;
+    Arena * arena;
+
+    ArenaAllocator(Arena * arena = NULL) : arena(arena){}
+    template <typename U> ArenaAllocator(const ArenaAllocator<U> & other) : arena(other.arena){}
+
+    T * allocate(size_t n){
+        if (arena == NULL) return static_cast<T *>(::operator new(n * sizeof(T)));
+        return static_cast<T *>(arenaAllocate(*arena, n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T * p, size_t){
+        if (arena == NULL) ::operator delete(p);
+    }
+    template <typename U> struct rebind { typedef ArenaAllocator<U> other; };
+};
+template <typename T, typename U> bool operator==(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b){ return a.arena == b.arena; }
+template <typename T, typename U> bool operator!=(const ArenaAllocator<T> & a, const ArenaAllocator<U> & b){ return a.arena != b.arena; }
+
+template <typename T>
+struct FrameAllocatorAdaptor {
+    typedef T value_type;
+    FrameAllocator * frame;
+
+    FrameAllocatorAdaptor(FrameAllocator * frame = NULL) : frame(frame){}
+    template <typename U> FrameAllocatorAdaptor(const FrameAllocatorAdaptor<U> & other) : frame(other.frame){}
+
+    T * allocate(size_t n){
+        if (frame == NULL) return static_cast<T *>(::operator new(n * sizeof(T)));
+        return static_cast<T *>(frameAllocate(*frame, n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T * p, size_t){
+        if (frame == NULL) ::operator delete(p);
+    }
+    template <typename U> struct rebind { typedef FrameAllocatorAdaptor<U> other; };
+};
+template <typename T, typename U> bool operator==(const FrameAllocatorAdaptor<T> & a, const FrameAllocatorAdaptor<U> & b){ return a.frame == b.frame; }
+template <typename T, typename U> bool operator!=(const FrameAllocatorAdaptor<T> & a, const FrameAllocatorAdaptor<U> & b){ return a.frame != b.frame; }
+
+// For std::map / std::set / std::list : single nodes come from the pools, anything else from the heap
+template <typename T>
+struct PoolAllocator {
+    typedef T value_type;
+    NodePools * pools;
+
+    PoolAllocator(NodePools * pools = NULL) : pools(pools){}
+    template <typename U> PoolAllocator(const PoolAllocator<U> & other) : pools(other.pools){}
+
+    T * allocate(size_t n){
+        void * p = pools != NULL && n == 1 ? nodePoolAllocate(*pools, sizeof(T)) : NULL;
+        return static_cast<T *>(p != NULL ? p : ::operator new(n * sizeof(T)));
+    }
+    void deallocate(T * p, size_t n){
+        if (pools != NULL && n == 1 && sizeof(T) <= 256) nodePoolFree(*pools, p, sizeof(T));
+        else ::operator delete(p);
+    }
+    template <typename U> struct rebind { typedef PoolAllocator<U> other; };
+};
+template <typename T, typename U> bool operator==(const PoolAllocator<T> & a, const PoolAllocator<U> & b){ return a.pools == b.pools; }
+template <typename T, typename U> bool operator!=(const PoolAllocator<T> & a, const PoolAllocator<U> & b){ return a.pools != b.pools; }
+
+#endif
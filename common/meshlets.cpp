@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+#include "meshlets.hpp"
+
+// A normal deviating by 90 degrees costs as much as half a new vertex
+static const float CONE_WEIGHT = 0.5f;
+// Unused triangles looked at, in spatial order, when a meshlet has no neighbour left
+static const unsigned int FALLBACK_WINDOW = 16;
+static const float FALLBACK_MIN_DOT = 0.7f; // with the meshlet's average normal : about 45 degrees
+
+// Interleaves the low 10 bits of x : 00000000000000000000ABCDEFGHIJ -> 0000A00B00C00D00E00F00G00H00I00J
+static unsigned int spreadBits(unsigned int x){
+    x = (x | (x << 16)) & 0x030000FF;
+    x = (x | (x << 8)) & 0x0300F00F;
+    x = (x | (x << 4)) & 0x030C30C3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+static void computeBounds(Meshlet & meshlet, const unsigned short * indices, const std::vector<glm::vec3> & vertices,
+                          const std::vector<glm::vec3> & normals, unsigned int firstTriangle){
+    glm::vec3 lo = vertices[indices[0]], hi = lo;
+    for (unsigned int i=1; i<meshlet.indexCount; i++){
+        lo = glm::min(lo, vertices[indices[i]]);
+        hi = glm::max(hi, vertices[indices[i]]);
+    }
+    meshlet.center = (lo + hi) * 0.5f;
+    float radius2 = 0.0f;
+    for (unsigned int i=0; i<meshlet.indexCount; i++){
+        glm::vec3 d = vertices[indices[i]] - meshlet.center;
+        radius2 = std::max(radius2, glm::dot(d, d));
+    }
+    meshlet.radius = sqrtf(radius2);
+
+    // Cone : around the average normal, as wide as the normal furthest from it
+    glm::vec3 sum(0.0f);
+    for (unsigned int t=0; t<meshlet.indexCount / 3; t++)
+        sum += normals[firstTriangle + t];
+    float length = glm::length(sum);
+    meshlet.coneAxis = length > 1e-6f ? sum / length : glm::vec3(0, 0, 1);
+    meshlet.coneCutoff = 1.0f;
+    if (length > 1e-6f){
+        float minDot = 1.0f;
+        for (unsigned int t=0; t<meshlet.indexCount / 3; t++){
+            const glm::vec3 & n = normals[firstTriangle + t];
+            if (n != glm::vec3(0.0f))
+                minDot = std::min(minDot, glm::dot(n, meshlet.coneAxis));
+        }
+        if (minDot > 0.0f)
+            meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+    }
+}
+
+void buildMeshlets(
+    const std::vector<unsigned short> & in_indices,
+    unsigned int indexOffset,
+    unsigned int indexCount,
+    const std::vector<glm::vec3> & vertices,
+    std::vector<unsigned short> & out_indices,
+    std::vector<Meshlet> & out_meshlets
+){
+    const unsigned short * indices = &in_indices[indexOffset];
+    unsigned int triangleCount = indexCount / 3;
+    if (triangleCount == 0)
+        return;
+
+    // Triangles of each vertex
+    std::vector<unsigned int> adjacencyStart(vertices.size() + 1, 0);
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    for (unsigned int i=0; i<triangleCount * 3; i++)
+        adjacencyStart[indices[i] + 1]++;
+    for (size_t v=0; v<vertices.size(); v++)
+        adjacencyStart[v + 1] += adjacencyStart[v];
+    std::vector<unsigned int> cursor(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (unsigned int i=0; i<triangleCount * 3; i++)
+        adjacency[cursor[indices[i]]++] = i / 3;
+
+    // Unit normals (0 for degenerate triangles) and centroids
+    std::vector<glm::vec3> normals(triangleCount), centroids(triangleCount);
+    for (unsigned int t=0; t<triangleCount; t++){
+        const glm::vec3 & a = vertices[indices[t * 3]], & b = vertices[indices[t * 3 + 1]], & c = vertices[indices[t * 3 + 2]];
+        glm::vec3 n = glm::cross(b - a, c - a);
+        float length = glm::length(n);
+        normals[t] = length > 0.0f ? n / length : glm::vec3(0.0f);
+        centroids[t] = (a + b + c) / 3.0f;
+    }
+
+    // Seeds and fallbacks follow a Morton order of the centroids : nearby in the order is nearby in space
+    glm::vec3 lo = centroids[0], hi = lo;
+    for (unsigned int t=1; t<triangleCount; t++){
+        lo = glm::min(lo, centroids[t]);
+        hi = glm::max(hi, centroids[t]);
+    }
+    glm::vec3 scale = 1023.0f / glm::max(hi - lo, glm::vec3(1e-20f));
+    std::vector<std::pair<unsigned int, unsigned int> > keyed(triangleCount);
+    for (unsigned int t=0; t<triangleCount; t++){
+        glm::vec3 q = (centroids[t] - lo) * scale;
+        keyed[t] = std::make_pair(spreadBits((unsigned int)q.x) | (spreadBits((unsigned int)q.y) << 1) | (spreadBits((unsigned int)q.z) << 2), t);
+    }
+    std::sort(keyed.begin(), keyed.end());
+    std::vector<unsigned int> order(triangleCount);
+    for (unsigned int t=0; t<triangleCount; t++)
+        order[t] = keyed[t].second;
+
+    // Emitted triangles, in meshlet order, for the bounds
+    std::vector<glm::vec3> emittedNormals;
+    emittedNormals.reserve(triangleCount);
+
+    std::vector<unsigned char> used(triangleCount, 0);
+    std::vector<unsigned int> stamp(vertices.size(), ~0u); // last meshlet each vertex was added to
+    std::vector<unsigned int> candidates;
+    unsigned int seed = 0;
+    unsigned int id = 0;
+
+    while (true){
+        while (seed < triangleCount && used[order[seed]])
+            seed++;
+        if (seed == triangleCount)
+            break;
+
+        Meshlet meshlet;
+        meshlet.indexOffset = (unsigned int)out_indices.size();
+        unsigned int firstTriangle = (unsigned int)emittedNormals.size();
+        unsigned int vertexCount = 0, meshletTriangles = 0;
+        glm::vec3 normalSum(0.0f), centroidSum(0.0f);
+        candidates.clear();
+
+        unsigned int next = order[seed];
+        while (true){
+            used[next] = 1;
+            meshletTriangles++;
+            for (int k=0; k<3; k++){
+                unsigned short v = indices[next * 3 + k];
+                out_indices.push_back(v);
+                if (stamp[v] != id){
+                    stamp[v] = id;
+                    vertexCount++;
+                    for (unsigned int a=adjacencyStart[v]; a<adjacencyStart[v + 1]; a++){
+                        if (!used[adjacency[a]])
+                            candidates.push_back(adjacency[a]);
+                    }
+                }
+            }
+            emittedNormals.push_back(normals[next]);
+            normalSum += normals[next];
+            centroidSum += centroids[next];
+            if (meshletTriangles == MESHLET_MAX_TRIANGLES)
+                break;
+
+            // Best neighbour. vertexCount + new vertices never goes down, so what doesn't fit now never will.
+            glm::vec3 axis = glm::length(normalSum) > 1e-6f ? glm::normalize(normalSum) : glm::vec3(0.0f);
+            unsigned int best = ~0u;
+            float bestScore = 1e30f;
+            size_t kept = 0;
+            for (size_t c=0; c<candidates.size(); c++){
+                unsigned int t = candidates[c];
+                if (used[t])
+                    continue;
+                unsigned int added = 0;
+                for (int k=0; k<3; k++)
+                    added += stamp[indices[t * 3 + k]] != id;
+                if (vertexCount + added > MESHLET_MAX_VERTICES)
+                    continue;
+                candidates[kept++] = t;
+                float score = added + CONE_WEIGHT * (1.0f - glm::dot(normals[t], axis));
+                if (score < bestScore || (score == bestScore && t < best)){
+                    bestScore = score;
+                    best = t;
+                }
+            }
+            candidates.resize(kept);
+
+            if (best == ~0u){
+                // No neighbour (seams split meshes into pieces) : the closest of the next unused triangles in spatial order,
+                // if it faces roughly the same way, so that the cone stays narrow enough to cull
+                glm::vec3 centroid = centroidSum / (float)meshletTriangles;
+                float bestDistance2 = 1e30f;
+                unsigned int looked = 0;
+                for (unsigned int o=seed; o<triangleCount && looked<FALLBACK_WINDOW; o++){
+                    unsigned int t = order[o];
+                    if (used[t])
+                        continue;
+                    looked++;
+                    if (vertexCount + 3 > MESHLET_MAX_VERTICES || glm::dot(normals[t], axis) < FALLBACK_MIN_DOT)
+                        continue;
+                    glm::vec3 d = centroids[t] - centroid;
+                    if (glm::dot(d, d) < bestDistance2){
+                        bestDistance2 = glm::dot(d, d);
+                        best = t;
+                    }
+                }
+                if (best == ~0u)
+                    break;
+            }
+            next = best;
+        }
+
+        meshlet.indexCount = meshletTriangles * 3;
+        meshlet.vertexCount = vertexCount;
+        computeBounds(meshlet, &out_indices[meshlet.indexOffset], vertices, emittedNormals, firstTriangle);
+        out_meshlets.push_back(meshlet);
+        id++;
+    }
+}
+
+GLsizei cullMeshlets(
+    const Meshlet * meshlets,
+    unsigned int count,
+    const glm::mat4 & viewProj,
+    const glm::mat4 & model,
+    const glm::vec3 & eye_worldspace,
+    GLsizei * counts,
+    const void ** offsets,
+    MeshletCullStats & stats
+){
+    // Frustum planes in object space (Gribb & Hartmann), normalized so that distances are in object units
+    glm::mat4 m = viewProj * model;
+    glm::vec4 rows[4];
+    for (int r=0; r<4; r++)
+        rows[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+    glm::vec4 planes[6] = {
+        rows[3] + rows[0], rows[3] - rows[0],
+        rows[3] + rows[1], rows[3] - rows[1],
+        rows[3] + rows[2], rows[3] - rows[2]
+    };
+    for (int p=0; p<6; p++)
+        planes[p] /= glm::length(glm::vec3(planes[p]));
+    glm::vec3 eye = glm::vec3(glm::inverse(model) * glm::vec4(eye_worldspace, 1.0f));
+
+    unsigned int frustumCulled = 0, coneCulled = 0;
+    unsigned long long triangles = 0, visibleTriangles = 0;
+    GLsizei ranges = 0;
+    unsigned int rangeEnd = 0;
+    for (unsigned int i=0; i<count; i++){
+        const Meshlet & meshlet = meshlets[i];
+        triangles += meshlet.indexCount / 3;
+
+        bool outside = false;
+        for (int p=0; p<6 && !outside; p++)
+            outside = glm::dot(glm::vec3(planes[p]), meshlet.center) + planes[p].w < -meshlet.radius;
+        if (outside){
+            frustumCulled++;
+            continue;
+        }
+
+        // Every triangle faces away when the eye is inside the cone's "back" region, for every point of the sphere
+        glm::vec3 toCenter = meshlet.center - eye;
+        if (meshlet.coneCutoff < 1.0f && glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius){
+            coneCulled++;
+            continue;
+        }
+
+        visibleTriangles += meshlet.indexCount / 3;
+        if (ranges > 0 && meshlet.indexOffset == rangeEnd)
+            counts[ranges - 1] += meshlet.indexCount;
+        else {
+            counts[ranges] = meshlet.indexCount;
+            offsets[ranges] = (const void *)(meshlet.indexOffset * sizeof(unsigned short));
+            ranges++;
+        }
+        rangeEnd = meshlet.indexOffset + meshlet.indexCount;
+    }
+
+    stats.tested += count;
+    stats.frustumCulled += frustumCulled;
+    stats.coneCulled += coneCulled;
+    stats.draws += ranges > 0;
+    stats.ranges += ranges;
+    stats.triangles += triangles;
+    stats.visibleTriangles += visibleTriangles;
+    return ranges;
+}
+
+void resetMeshletCullStats(MeshletCullStats & stats){
+    stats.tested = stats.frustumCulled = stats.coneCulled = 0;
+    stats.draws = stats.ranges = 0;
+    stats.triangles = stats.visibleTriangles = 0;
+}
+
+void printMeshletStats(const std::vector<Meshlet> & meshlets){
+    if (meshlets.empty())
+        return;
+    size_t triangles = 0, vertices = 0, cullable = 0;
+    for (size_t i=0; i<meshlets.size(); i++){
+        triangles += meshlets[i].indexCount / 3;
+        vertices += meshlets[i].vertexCount;
+        cullable += meshlets[i].coneCutoff < 1.0f;
+    }
+    printf("Meshlets : %u meshlets, %.1f triangles and %.1f vertices on average, %.0f%% with a backface cone\n",
+        (unsigned int)meshlets.size(), triangles / (double)meshlets.size(), vertices / (double)meshlets.size(),
+        cullable * 100.0 / meshlets.size());
+}
+
+void printMeshletCullStats(MeshletCullStats & stats){
+    unsigned int tested = stats.tested;
+    if (tested > 0){
+        unsigned long long triangles = stats.triangles;
+        unsigned int draws = stats.draws;
+        printf("Meshlet culling : %.1f%% of %u meshlets rejected (frustum %.1f%%, backface cone %.1f%%), %.1f%% of the triangles drawn, %.1f ranges per draw\n",
+            (stats.frustumCulled + stats.coneCulled) * 100.0 / tested, tested,
+            stats.frustumCulled * 100.0 / tested, stats.coneCulled * 100.0 / tested,
+            triangles > 0 ? stats.visibleTriangles * 100.0 / triangles : 0.0,
+            draws > 0 ? stats.ranges / (double)draws : 0.0);
+    }
+    resetMeshletCullStats(stats);
+}
@@ -0,0 +1,66 @@
+#ifndef MESHLETS_HPP
+#define MESHLETS_HPP
+
+#include <vector>
+#include <atomic>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+static const unsigned int MESHLET_MAX_VERTICES = 64;
+static const unsigned int MESHLET_MAX_TRIANGLES = 124;
+
+// A cluster of triangles : a range of the index buffer, with bounds for culling (object space)
+struct Meshlet {
+    unsigned int indexOffset; // in indices, not bytes
+    unsigned int indexCount;
+    unsigned int vertexCount; // unique
+    glm::vec3 center;         // bounding sphere
+    float radius;
+    glm::vec3 coneAxis;       // average triangle normal
+    float coneCutoff;         // sin of the cone's half angle. 1 : the normals spread too much to ever cull.
+};
+
+struct MeshletCullStats {
+    std::atomic<unsigned int> tested;
+    std::atomic<unsigned int> frustumCulled;
+    std::atomic<unsigned int> coneCulled;
+    std::atomic<unsigned int> draws, ranges;
+    std::atomic<unsigned long long> triangles, visibleTriangles;
+};
+
+// Splits indices [indexOffset, indexOffset + indexCount) into meshlets of up to
+// MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles, appended to out_indices / out_meshlets.
+// The triangles are only reordered : they still index the same vertex buffer.
+// Meshlets grow from a seed triangle through its neighbours, preferring the ones that add the fewest vertices,
+// then the ones facing the same way (for tight cones). When there are no neighbours left, the next unused triangle
+// is taken if it is close enough to keep the bounds small.
+void buildMeshlets(
+    const std::vector<unsigned short> & in_indices,
+    unsigned int indexOffset,
+    unsigned int indexCount,
+    const std::vector<glm::vec3> & vertices,
+    std::vector<unsigned short> & out_indices,
+    std::vector<Meshlet> & out_meshlets
+);
+
+// Frustum and backface cone culling of the meshlets of one object.
+// Writes the visible ones as index ranges for glMultiDrawElements, neighbours in the index buffer merged,
+// into counts / offsets (room for count ranges). Returns how many ranges.
+// Everything is tested in object space, so any model matrix works.
+GLsizei cullMeshlets(
+    const Meshlet * meshlets,
+    unsigned int count,
+    const glm::mat4 & viewProj,
+    const glm::mat4 & model,
+    const glm::vec3 & eye_worldspace,
+    GLsizei * counts,
+    const void ** offsets,
+    MeshletCullStats & stats
+);
+
+void resetMeshletCullStats(MeshletCullStats & stats);
+void printMeshletStats(const std::vector<Meshlet> & meshlets);
+// Prints and resets
+void printMeshletCullStats(MeshletCullStats & stats);
+
+#endif
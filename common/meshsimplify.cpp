@@ -0,0 +1,365 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include "meshsimplify.hpp"
+
+// Symmetric 4x4 matrix : a00 a01 a02 a03 a11 a12 a13 a22 a23 a33
+struct Quadric {
+    double a[10];
+};
+
+static void planeQuadric(Quadric & q, const glm::vec3 & n, float d){
+    q.a[0] = n.x*n.x; q.a[1] = n.x*n.y; q.a[2] = n.x*n.z; q.a[3] = n.x*d;
+    q.a[4] = n.y*n.y; q.a[5] = n.y*n.z; q.a[6] = n.y*d;
+    q.a[7] = n.z*n.z; q.a[8] = n.z*d;
+    q.a[9] = d*d;
+}
+
+static void addQuadric(Quadric & q, const Quadric & other){
+    for (int i=0; i<10; i++)
+        q.a[i] += other.a[i];
+}
+
+// Sum of the squared distances from p to the planes accumulated in q
+static double evaluateQuadric(const Quadric & q, const glm::vec3 & p){
+    double x = p.x, y = p.y, z = p.z;
+    double r = q.a[0]*x*x + 2*q.a[1]*x*y + 2*q.a[2]*x*z + 2*q.a[3]*x
+             + q.a[4]*y*y + 2*q.a[5]*y*z + 2*q.a[6]*y
+             + q.a[7]*z*z + 2*q.a[8]*z
+             + q.a[9];
+    return r > 0.0 ? r : 0.0;
+}
+
+struct CollapseCandidate {
+    unsigned short from;
+    unsigned short to;
+    double cost;
+};
+
+// Same position = same id, whatever the UVs and normals
+static unsigned int buildPositionIds(const std::vector<glm::vec3> & vertices, std::vector<unsigned int> & ids){
+    std::vector<unsigned int> order(vertices.size());
+    for (unsigned int i=0; i<order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b){
+        return memcmp(&vertices[a], &vertices[b], sizeof(glm::vec3)) < 0;
+    });
+
+    ids.resize(vertices.size());
+    unsigned int count = 0;
+    for (unsigned int i=0; i<order.size(); i++){
+        if (i > 0 && memcmp(&vertices[order[i]], &vertices[order[i-1]], sizeof(glm::vec3)) != 0)
+            count++;
+        ids[order[i]] = count;
+    }
+    return vertices.empty() ? 0 : count + 1;
+}
+
+static glm::vec3 triangleNormal(const glm::vec3 & a, const glm::vec3 & b, const glm::vec3 & c){
+    return glm::cross(b - a, c - a);
+}
+
+// Quadric of the plane through the edge a-b, perpendicular to the triangle of normal n : moving a or b off the line
+// of an attribute seam costs as much as moving them off the surface
+static void edgeQuadric(Quadric & q, const glm::vec3 & a, const glm::vec3 & b, const glm::vec3 & n){
+    glm::vec3 side = glm::cross(b - a, n);
+    float length = glm::length(side);
+    if (length == 0.0f){
+        memset(&q, 0, sizeof(q));
+        return;
+    }
+    side /= length;
+    planeQuadric(q, side, -glm::dot(side, a));
+}
+
+float simplifyMesh(
+    const std::vector<unsigned short> & in_indices,
+    const std::vector<glm::vec3> & in_vertices,
+    unsigned int targetIndexCount,
+    std::vector<unsigned short> & out_indices
+){
+    out_indices = in_indices;
+    unsigned int vertexCount = (unsigned int)in_vertices.size();
+
+    std::vector<unsigned int> positionIds;
+    unsigned int positionCount = buildPositionIds(in_vertices, positionIds);
+
+    // Wedges : the vertices of each position. More than one on UV and normal seams (see indexVBO).
+    std::vector<unsigned int> wedgeOffsets(positionCount + 1, 0);
+    for (unsigned int i=0; i<vertexCount; i++)
+        wedgeOffsets[positionIds[i] + 1]++;
+    for (unsigned int p=0; p<positionCount; p++)
+        wedgeOffsets[p+1] += wedgeOffsets[p];
+    std::vector<unsigned int> wedges(vertexCount);
+    std::vector<unsigned int> wedgeFill(wedgeOffsets.begin(), wedgeOffsets.end() - 1);
+    for (unsigned int i=0; i<vertexCount; i++)
+        wedges[wedgeFill[positionIds[i]]++] = i;
+
+    // Edges by position, with the vertices of their first triangle. Used once : border. Used twice through
+    // different vertices : seam.
+    struct Edge {
+        unsigned int positions[2];
+        unsigned short vertices[2];
+        unsigned int triangle;
+    };
+    std::vector<Edge> edges;
+    for (unsigned int i=0; i<out_indices.size(); i+=3){
+        for (int e=0; e<3; e++){
+            unsigned short a = out_indices[i+e], b = out_indices[i+(e+1)%3];
+            if (positionIds[a] > positionIds[b])
+                std::swap(a, b);
+            Edge edge = { { positionIds[a], positionIds[b] }, { a, b }, i };
+            edges.push_back(edge);
+        }
+    }
+    std::sort(edges.begin(), edges.end(), [](const Edge & a, const Edge & b){
+        return a.positions[0] != b.positions[0] ? a.positions[0] < b.positions[0] : a.positions[1] < b.positions[1];
+    });
+
+    // One quadric per position, made of the planes of the triangles around it, and of the seams through it
+    std::vector<Quadric> quadrics(positionCount);
+    for (unsigned int i=0; i<out_indices.size(); i+=3){
+        const glm::vec3 & p0 = in_vertices[out_indices[i+0]];
+        const glm::vec3 & p1 = in_vertices[out_indices[i+1]];
+        const glm::vec3 & p2 = in_vertices[out_indices[i+2]];
+        glm::vec3 n = triangleNormal(p0, p1, p2);
+        float length = glm::length(n);
+        if (length == 0.0f)
+            continue;
+        n /= length;
+        Quadric q;
+        planeQuadric(q, n, -glm::dot(n, p0));
+        for (int k=0; k<3; k++)
+            addQuadric(quadrics[positionIds[out_indices[i+k]]], q);
+    }
+
+    // Borders are never moved
+    std::vector<bool> locked(vertexCount, false);
+    for (unsigned int i=0; i<edges.size(); ){
+        unsigned int j = i;
+        while (j < edges.size() && edges[j].positions[0] == edges[i].positions[0] && edges[j].positions[1] == edges[i].positions[1])
+            j++;
+        if (j - i == 1){
+            for (int k=0; k<2; k++)
+                for (unsigned int w=wedgeOffsets[edges[i].positions[k]]; w<wedgeOffsets[edges[i].positions[k] + 1]; w++)
+                    locked[wedges[w]] = true;
+        }
+        else if (j - i == 2 && (edges[i].vertices[0] != edges[i+1].vertices[0] || edges[i].vertices[1] != edges[i+1].vertices[1])){
+            for (unsigned int k=i; k<j; k++){
+                const glm::vec3 & a = in_vertices[edges[k].vertices[0]];
+                const glm::vec3 & b = in_vertices[edges[k].vertices[1]];
+                unsigned int t = edges[k].triangle;
+                glm::vec3 n = triangleNormal(in_vertices[out_indices[t]], in_vertices[out_indices[t+1]], in_vertices[out_indices[t+2]]);
+                float length = glm::length(n);
+                if (length == 0.0f)
+                    continue;
+                Quadric q;
+                edgeQuadric(q, a, b, n / length);
+                addQuadric(quadrics[edges[k].positions[0]], q);
+                addQuadric(quadrics[edges[k].positions[1]], q);
+            }
+        }
+        i = j;
+    }
+
+    double maxCost = 0.0;
+    unsigned int triangleCount = (unsigned int)out_indices.size() / 3;
+    unsigned int targetTriangles = targetIndexCount / 3;
+
+    std::vector<unsigned int> adjacencyOffsets(vertexCount + 1);
+    std::vector<unsigned int> adjacency;
+    std::vector<CollapseCandidate> candidates;
+    std::vector<unsigned short> remap(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    std::vector<std::pair<unsigned short, unsigned short> > moves;
+
+    // Each pass collapses the cheapest edges that don't touch each other
+    for (int pass=0; pass<100 && triangleCount > targetTriangles; pass++){
+
+        // Vertex -> triangles
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (unsigned int i=0; i<out_indices.size(); i++)
+            adjacencyOffsets[out_indices[i] + 1]++;
+        for (unsigned int i=0; i<vertexCount; i++)
+            adjacencyOffsets[i+1] += adjacencyOffsets[i];
+        adjacency.resize(out_indices.size());
+        std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (unsigned int i=0; i<out_indices.size(); i++)
+            adjacency[fill[out_indices[i]]++] = i / 3;
+
+        // Both directions of every edge, as long as the vertex that moves is free
+        candidates.clear();
+        for (unsigned int i=0; i<out_indices.size(); i+=3){
+            for (int e=0; e<3; e++){
+                unsigned short a = out_indices[i+e];
+                unsigned short b = out_indices[i+(e+1)%3];
+                for (int dir=0; dir<2; dir++){
+                    unsigned short from = dir ? b : a;
+                    unsigned short to   = dir ? a : b;
+                    if (locked[from])
+                        continue;
+                    Quadric q = quadrics[positionIds[from]];
+                    addQuadric(q, quadrics[positionIds[to]]);
+                    CollapseCandidate c = { from, to, evaluateQuadric(q, in_vertices[to]) };
+                    candidates.push_back(c);
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const CollapseCandidate & a, const CollapseCandidate & b){
+            return a.cost < b.cost;
+        });
+
+        for (unsigned int i=0; i<vertexCount; i++)
+            remap[i] = (unsigned short)i;
+        std::fill(touched.begin(), touched.end(), false);
+
+        unsigned int collapses = 0;
+        for (unsigned int c=0; c<candidates.size() && triangleCount > targetTriangles; c++){
+            unsigned int fromPosition = positionIds[candidates[c].from];
+            unsigned int toPosition = positionIds[candidates[c].to];
+
+            // A position moves with all its wedges : each one onto the wedge of the other end of one of its edges.
+            // A wedge without one would lose its attributes, as at the corners of a hard edged mesh.
+            moves.clear();
+            bool valid = true;
+            for (unsigned int w=wedgeOffsets[fromPosition]; w<wedgeOffsets[fromPosition + 1] && valid; w++){
+                unsigned short from = (unsigned short)wedges[w];
+                if (adjacencyOffsets[from] == adjacencyOffsets[from+1])
+                    continue; // not used anymore
+                int to = -1;
+                for (unsigned int k=adjacencyOffsets[from]; k<adjacencyOffsets[from+1] && to == -1; k++){
+                    unsigned int t = adjacency[k] * 3;
+                    for (int v=0; v<3; v++)
+                        if (positionIds[out_indices[t+v]] == toPosition)
+                            to = out_indices[t+v];
+                }
+                valid = to != -1 && !touched[from] && !touched[to];
+                moves.push_back(std::make_pair(from, (unsigned short)(to == -1 ? 0 : to)));
+            }
+            if (!valid)
+                continue;
+
+            // Reject the collapse if a remaining triangle would flip
+            bool flips = false;
+            unsigned int removed = 0;
+            const glm::vec3 & target = in_vertices[candidates[c].to];
+            for (unsigned int m=0; m<moves.size() && !flips; m++){
+                unsigned short from = moves[m].first;
+                for (unsigned int k=adjacencyOffsets[from]; k<adjacencyOffsets[from+1] && !flips; k++){
+                    unsigned int t = adjacency[k] * 3;
+                    unsigned short i0 = out_indices[t], i1 = out_indices[t+1], i2 = out_indices[t+2];
+                    if (positionIds[i0] == toPosition || positionIds[i1] == toPosition || positionIds[i2] == toPosition){
+                        removed++;
+                        continue;
+                    }
+                    glm::vec3 before = triangleNormal(in_vertices[i0], in_vertices[i1], in_vertices[i2]);
+                    glm::vec3 after = triangleNormal(
+                        i0 == from ? target : in_vertices[i0],
+                        i1 == from ? target : in_vertices[i1],
+                        i2 == from ? target : in_vertices[i2]);
+                    flips = glm::dot(before, after) <= 0.0f;
+                }
+            }
+            if (flips)
+                continue;
+
+            // Triangles around the wedges that move change : nothing else may move around them in this pass
+            for (unsigned int m=0; m<moves.size(); m++){
+                unsigned short from = moves[m].first;
+                remap[from] = moves[m].second;
+                for (unsigned int k=adjacencyOffsets[from]; k<adjacencyOffsets[from+1]; k++){
+                    unsigned int t = adjacency[k] * 3;
+                    touched[out_indices[t]] = touched[out_indices[t+1]] = touched[out_indices[t+2]] = true;
+                }
+            }
+            addQuadric(quadrics[toPosition], quadrics[fromPosition]);
+            maxCost = std::max(maxCost, candidates[c].cost);
+            triangleCount -= removed;
+            collapses++;
+        }
+
+        if (collapses == 0)
+            break;
+
+        // Apply the collapses and drop the degenerate triangles
+        unsigned int write = 0;
+        for (unsigned int i=0; i<out_indices.size(); i+=3){
+            unsigned short a = remap[out_indices[i]], b = remap[out_indices[i+1]], c = remap[out_indices[i+2]];
+            unsigned int pa = positionIds[a], pb = positionIds[b], pc = positionIds[c];
+            if (pa == pb || pb == pc || pa == pc)
+                continue;
+            out_indices[write++] = a;
+            out_indices[write++] = b;
+            out_indices[write++] = c;
+        }
+        out_indices.resize(write);
+        triangleCount = write / 3;
+    }
+
+    return (float)sqrt(maxCost);
+}
+
+void buildLODChain(
+    const std::vector<unsigned short> & in_indices,
+    const std::vector<glm::vec3> & in_vertices,
+    const std::vector<float> & ratios,
+    std::vector<unsigned short> & out_indices,
+    std::vector<MeshLOD> & out_lods
+){
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    out_indices = in_indices;
+    out_lods.clear();
+    MeshLOD lod0 = { 0, (unsigned int)in_indices.size(), 0.0f };
+    out_lods.push_back(lod0);
+
+    std::vector<unsigned short> previous = in_indices;
+    std::vector<unsigned short> simplified;
+    float error = 0.0f;
+    for (unsigned int i=0; i<ratios.size(); i++){
+        unsigned int target = (unsigned int)(in_indices.size() / 3 * ratios[i]) * 3;
+        // Errors of successive simplifications add up
+        error += simplifyMesh(previous, in_vertices, target, simplified);
+
+        // Nothing more can go without tearing a seam or a border : the next ratios wouldn't do better
+        if (simplified.size() >= previous.size())
+            break;
+
+        MeshLOD lod = { (unsigned int)out_indices.size(), (unsigned int)simplified.size(), error };
+        out_lods.push_back(lod);
+        out_indices.insert(out_indices.end(), simplified.begin(), simplified.end());
+        previous.swap(simplified);
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    printf("LOD chain built in %.2f ms :", ms);
+    for (unsigned int i=0; i<out_lods.size(); i++)
+        printf(" %u", out_lods[i].indexCount / 3);
+    printf(" triangles\n");
+}
+
+int selectLOD(
+    const std::vector<MeshLOD> & lods,
+    float distance,
+    float scale,
+    const glm::mat4 & projMat,
+    float viewportHeight,
+    float maxPixelError
+){
+    // Size in pixels of one world unit at this distance
+    float pixelsPerUnit = projMat[1][1] * viewportHeight * 0.5f / std::max(distance, 0.0001f);
+
+    int selected = 0;
+    for (unsigned int i=1; i<lods.size(); i++){
+        if (lods[i].error * scale * pixelsPerUnit > maxPixelError)
+            break;
+        selected = i;
+    }
+    return selected;
+}
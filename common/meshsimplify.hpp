@@ -0,0 +1,51 @@
+#ifndef MESHSIMPLIFY_HPP
+#define MESHSIMPLIFY_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// One level of detail : a range of the shared element buffer
+struct MeshLOD {
+    unsigned int indexOffset; // in indices, not bytes
+    unsigned int indexCount;
+    float error;              // geometric error in object space units
+};
+
+// Quadric error metric simplification by edge collapse.
+// Vertices are collapsed onto existing vertices, so the result indexes the same vertex buffer.
+// On UV and normal seams (several vertices at one position, see indexVBO), all the vertices of a position
+// collapse together along the seam, each onto the vertex of its own side, and the seam keeps its line.
+// Hard corners, where that is not possible, and vertices on open borders are never moved.
+// Returns the geometric error of the result.
+float simplifyMesh(
+    const std::vector<unsigned short> & in_indices,
+    const std::vector<glm::vec3> & in_vertices,
+    unsigned int targetIndexCount,
+    std::vector<unsigned short> & out_indices
+);
+
+// Builds a chain of LODs, each one simplified from the previous one
+// (for example ratios 0.5, 0.25, 0.125). LOD 0 is the input mesh. The chain stops at the first ratio
+// that removes nothing.
+// All index buffers are concatenated in out_indices.
+void buildLODChain(
+    const std::vector<unsigned short> & in_indices,
+    const std::vector<glm::vec3> & in_vertices,
+    const std::vector<float> & ratios,
+    std::vector<unsigned short> & out_indices,
+    std::vector<MeshLOD> & out_lods
+);
+
+// Picks the coarsest LOD whose error, projected on screen, stays under maxPixelError.
+// "distance" is the view space distance to the object, "scale" the object to world scale,
+// projMat the projection matrix and viewportHeight the height of the viewport in pixels.
+int selectLOD(
+    const std::vector<MeshLOD> & lods,
+    float distance,
+    float scale,
+    const glm::mat4 & projMat,
+    float viewportHeight,
+    float maxPixelError
+);
+
+#endif
@@ -5,6 +5,8 @@
 
 #include <glm/glm.hpp>
 
+#include "memory.hpp"
+#include "trace.hpp"
 #include "objloader.hpp"
 
 // Very, VERY simple OBJ loader.
@@ -21,14 +23,18 @@ bool loadOBJ(
 	const char * path, 
 	std::vector<glm::vec3> & out_vertices, 
 	std::vector<glm::vec2> & out_uvs,
-	std::vector<glm::vec3> & out_normals
+	std::vector<glm::vec3> & out_normals,
+	Arena * scratch
 ){
+	TRACE_ZONE("loadOBJ");
 	printf("Loading OBJ file %s...\n", path);
 
-	std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
-	std::vector<glm::vec3> temp_vertices; 
-	std::vector<glm::vec2> temp_uvs;
-	std::vector<glm::vec3> temp_normals;
+	// Everything here is thrown away at the end : bump allocated, and rewound on return
+	ArenaScope scope(scratch);
+	std::vector<unsigned int, ArenaAllocator<unsigned int> > vertexIndices(scratch), uvIndices(scratch), normalIndices(scratch);
+	std::vector<glm::vec3, ArenaAllocator<glm::vec3> > temp_vertices(scratch);
+	std::vector<glm::vec2, ArenaAllocator<glm::vec2> > temp_uvs(scratch);
+	std::vector<glm::vec3, ArenaAllocator<glm::vec3> > temp_normals(scratch);
 
 
 	FILE * file = fopen(path, "r");
@@ -88,6 +94,9 @@ bool loadOBJ(
 	}
 
 	// For each vertex of each triangle
+	out_vertices.reserve(out_vertices.size() + vertexIndices.size());
+	out_uvs     .reserve(out_uvs     .size() + vertexIndices.size());
+	out_normals .reserve(out_normals .size() + vertexIndices.size());
 	for( unsigned int i=0; i<vertexIndices.size(); i++ ){
 
 		// Get the indices of its attributes
@@ -1,11 +1,15 @@
 #ifndef OBJLOADER_H
 #define OBJLOADER_H
 
+struct Arena;
+
+// The temporary arrays come from scratch when given, which is rewound before returning
 bool loadOBJ(
 	const char * path, 
 	std::vector<glm::vec3> & out_vertices, 
 	std::vector<glm::vec2> & out_uvs, 
-	std::vector<glm::vec3> & out_normals
+	std::vector<glm::vec3> & out_normals,
+	Arena * scratch = NULL
 );
 
 
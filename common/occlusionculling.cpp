@@ -0,0 +1,351 @@
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+// SSE2 is always there on x86-64. Other targets use the scalar path.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "parallel.hpp"
+#include "occlusionculling.hpp"
+
+// Height of the bands of screen given to each rasterizer thread
+static const int BAND_HEIGHT = 16;
+
+// Object depth must be clearly behind the occluders to be culled, so that
+// an object never hides itself because of rounding errors
+static const float DEPTH_BIAS = 1.0001f;
+
+struct ScreenTriangle {
+    glm::vec3 v[3]; // x, y in pixels, z = 1/w
+    float minX, maxX, minY, maxY;
+};
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start){
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static int levelWidth(const OcclusionCuller & culler, int level){
+    return std::max(1, culler.width >> level);
+}
+
+static int levelHeight(const OcclusionCuller & culler, int level){
+    return std::max(1, culler.height >> level);
+}
+
+void initOcclusionCuller(OcclusionCuller & culler, int width, int height, unsigned int threadCount){
+    culler.width = (width + 3) & ~3;
+    culler.height = height;
+    culler.threadCount = threadCount;
+    culler.viewProj = glm::mat4(1.0f);
+    culler.minLevels.clear();
+    culler.maxLevels.clear();
+
+    int level = 0;
+    while (true){
+        int w = levelWidth(culler, level);
+        int h = levelHeight(culler, level);
+        culler.minLevels.push_back(std::vector<float>(w * h, 0.0f));
+        culler.maxLevels.push_back(std::vector<float>(w * h, 0.0f));
+        if (w == 1 && h == 1)
+            break;
+        level++;
+    }
+}
+
+void beginOcclusionFrame(OcclusionCuller & culler, const glm::mat4 & viewProj){
+    culler.viewProj = viewProj;
+    std::fill(culler.minLevels[0].begin(), culler.minLevels[0].end(), 0.0f);
+    OcclusionStats empty = { 0, 0, 0, 0.0, 0.0, 0.0 };
+    culler.stats = empty;
+}
+
+// Fills the pixels of the triangle inside rows [bandY0, bandY1) with max(depth, triangle depth).
+// The triangle is counter-clockwise : the 3 edge functions are positive inside.
+static void rasterizeTriangle(float * depth, int width, int bandY0, int bandY1, const ScreenTriangle & tri){
+    const glm::vec3 & v0 = tri.v[0];
+    const glm::vec3 & v1 = tri.v[1];
+    const glm::vec3 & v2 = tri.v[2];
+
+    float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+    float invArea = 1.0f / area;
+
+    // Depth plane : z = z0 + (x - x0) * dzdx + (y - y0) * dzdy
+    float dzdx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) * invArea;
+    float dzdy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) * invArea;
+    float zc = v0.z - v0.x * dzdx - v0.y * dzdy;
+
+    // Edge functions : E(x, y) = A x + B y + C
+    float A[3], B[3], C[3];
+    for (int i=0; i<3; i++){
+        const glm::vec3 & a = tri.v[i];
+        const glm::vec3 & b = tri.v[(i + 1) % 3];
+        A[i] = -(b.y - a.y);
+        B[i] = b.x - a.x;
+        C[i] = (b.y - a.y) * a.x - (b.x - a.x) * a.y;
+    }
+
+    int x0 = std::max(0, (int)floor(tri.minX)) & ~3; // 4 pixels at a time
+    int x1 = std::min(width - 1, (int)ceil(tri.maxX));
+    int y0 = std::max(bandY0, (int)floor(tri.minY));
+    int y1 = std::min(bandY1 - 1, (int)ceil(tri.maxY));
+
+#ifdef OCCLUSION_SSE2
+    __m128 pixelOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+    __m128 zero = _mm_setzero_ps();
+    __m128 a0 = _mm_set1_ps(A[0]), a1 = _mm_set1_ps(A[1]), a2 = _mm_set1_ps(A[2]);
+    __m128 dz = _mm_set1_ps(dzdx);
+    for (int y=y0; y<=y1; y++){
+        float py = y + 0.5f;
+        __m128 r0 = _mm_set1_ps(B[0] * py + C[0]);
+        __m128 r1 = _mm_set1_ps(B[1] * py + C[1]);
+        __m128 r2 = _mm_set1_ps(B[2] * py + C[2]);
+        __m128 rz = _mm_set1_ps(dzdy * py + zc);
+        float * row = depth + y * width;
+        for (int x=x0; x<=x1; x+=4){
+            __m128 px = _mm_add_ps(_mm_set1_ps((float)x), pixelOffsets);
+            __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), r0);
+            __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), r1);
+            __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), r2);
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+            if (_mm_movemask_ps(inside) == 0)
+                continue;
+            __m128 z = _mm_add_ps(_mm_mul_ps(dz, px), rz);
+            __m128 old = _mm_loadu_ps(row + x);
+            __m128 closest = _mm_max_ps(old, z);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closest), _mm_andnot_ps(inside, old)));
+        }
+    }
+#else
+    for (int y=y0; y<=y1; y++){
+        float py = y + 0.5f;
+        float * row = depth + y * width;
+        for (int x=x0; x<=x1; x++){
+            float px = x + 0.5f;
+            if (A[0]*px + B[0]*py + C[0] < 0.0f || A[1]*px + B[1]*py + C[1] < 0.0f || A[2]*px + B[2]*py + C[2] < 0.0f)
+                continue;
+            row[x] = std::max(row[x], zc + px * dzdx + py * dzdy);
+        }
+    }
+#endif
+}
+
+void rasterizeOccluders(OcclusionCuller & culler, const std::vector<Occluder> & occluders){
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    // Transform everything to screen space once
+    std::vector<ScreenTriangle> triangles;
+    std::vector<glm::vec3> screen;
+    for (unsigned int o=0; o<occluders.size(); o++){
+        const Occluder & occluder = occluders[o];
+        glm::mat4 mvp = culler.viewProj * occluder.modelMat;
+
+        const std::vector<glm::vec3> & vertices = *occluder.vertices;
+        screen.resize(vertices.size());
+        for (unsigned int i=0; i<vertices.size(); i++){
+            glm::vec4 clip = mvp * glm::vec4(vertices[i], 1.0f);
+            // Behind the camera : mark it, triangles using it are dropped.
+            // Dropping occluders is always safe, it only culls less.
+            if (clip.w < 0.001f){
+                screen[i] = glm::vec3(0.0f, 0.0f, -1.0f);
+                continue;
+            }
+            float invW = 1.0f / clip.w;
+            screen[i] = glm::vec3(
+                (clip.x * invW * 0.5f + 0.5f) * culler.width,
+                (clip.y * invW * 0.5f + 0.5f) * culler.height,
+                invW);
+        }
+
+        for (unsigned int i=0; i+2<occluder.indexCount; i+=3){
+            ScreenTriangle tri;
+            tri.v[0] = screen[occluder.indices[i]];
+            tri.v[1] = screen[occluder.indices[i+1]];
+            tri.v[2] = screen[occluder.indices[i+2]];
+            if (tri.v[0].z < 0.0f || tri.v[1].z < 0.0f || tri.v[2].z < 0.0f)
+                continue;
+
+            // Both facings are drawn : make it counter-clockwise
+            float area = (tri.v[1].x - tri.v[0].x) * (tri.v[2].y - tri.v[0].y) - (tri.v[2].x - tri.v[0].x) * (tri.v[1].y - tri.v[0].y);
+            if (fabs(area) < 1e-6f)
+                continue;
+            if (area < 0.0f)
+                std::swap(tri.v[1], tri.v[2]);
+
+            tri.minX = std::min(tri.v[0].x, std::min(tri.v[1].x, tri.v[2].x));
+            tri.maxX = std::max(tri.v[0].x, std::max(tri.v[1].x, tri.v[2].x));
+            tri.minY = std::min(tri.v[0].y, std::min(tri.v[1].y, tri.v[2].y));
+            tri.maxY = std::max(tri.v[0].y, std::max(tri.v[1].y, tri.v[2].y));
+            if (tri.maxX < 0.0f || tri.maxY < 0.0f || tri.minX >= culler.width || tri.minY >= culler.height)
+                continue;
+            triangles.push_back(tri);
+        }
+    }
+    culler.stats.occluderTriangles = (unsigned int)triangles.size();
+
+    // Each thread owns some bands of rows, no two threads write the same pixel
+    float * depth = &culler.minLevels[0][0];
+    int width = culler.width;
+    int height = culler.height;
+    unsigned int bandCount = (height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+    parallelFor(bandCount, culler.threadCount, [&](unsigned int bandBegin, unsigned int bandEnd){
+        for (unsigned int band=bandBegin; band<bandEnd; band++){
+            int bandY0 = band * BAND_HEIGHT;
+            int bandY1 = std::min(height, bandY0 + BAND_HEIGHT);
+            for (unsigned int t=0; t<triangles.size(); t++){
+                const ScreenTriangle & tri = triangles[t];
+                if (tri.maxY < bandY0 || tri.minY >= bandY1)
+                    continue;
+                rasterizeTriangle(depth, width, bandY0, bandY1, tri);
+            }
+        }
+    });
+
+    culler.stats.rasterTime = elapsedMs(start);
+}
+
+void buildDepthPyramid(OcclusionCuller & culler){
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    // Level 0 : the depth buffer is both the min and the max
+    culler.maxLevels[0] = culler.minLevels[0];
+
+    for (unsigned int level=1; level<culler.minLevels.size(); level++){
+        int w = levelWidth(culler, level);
+        int h = levelHeight(culler, level);
+        int pw = levelWidth(culler, level - 1);
+        int ph = levelHeight(culler, level - 1);
+        const std::vector<float> & parentMin = culler.minLevels[level - 1];
+        const std::vector<float> & parentMax = culler.maxLevels[level - 1];
+        std::vector<float> & outMin = culler.minLevels[level];
+        std::vector<float> & outMax = culler.maxLevels[level];
+
+        parallelFor(h, culler.threadCount, [&](unsigned int rowBegin, unsigned int rowEnd){
+            for (int y=rowBegin; y<(int)rowEnd; y++){
+                int y0 = std::min(y * 2, ph - 1), y1 = std::min(y * 2 + 1, ph - 1);
+                for (int x=0; x<w; x++){
+                    int x0 = std::min(x * 2, pw - 1), x1 = std::min(x * 2 + 1, pw - 1);
+                    outMin[y * w + x] = std::min(
+                        std::min(parentMin[y0 * pw + x0], parentMin[y0 * pw + x1]),
+                        std::min(parentMin[y1 * pw + x0], parentMin[y1 * pw + x1]));
+                    outMax[y * w + x] = std::max(
+                        std::max(parentMax[y0 * pw + x0], parentMax[y0 * pw + x1]),
+                        std::max(parentMax[y1 * pw + x0], parentMax[y1 * pw + x1]));
+                }
+            }
+        });
+    }
+
+    culler.stats.pyramidTime = elapsedMs(start);
+}
+
+// Hierarchical test of one texel : culled if the object is behind the farthest occluder of the texel,
+// visible if it's in front of the nearest one, otherwise look at the children that overlap the rectangle.
+static bool isTexelVisible(const OcclusionCuller & culler, int level, int tx, int ty, const int rect[4], float depth){
+    int w = levelWidth(culler, level);
+    if (depth * DEPTH_BIAS < culler.minLevels[level][ty * w + tx])
+        return false;
+    if (level == 0 || depth >= culler.maxLevels[level][ty * w + tx])
+        return true;
+
+    int child = level - 1;
+    for (int cy=ty*2; cy<=ty*2+1 && cy<levelHeight(culler, child); cy++){
+        if ((((cy + 1) << child) - 1) < rect[1] || (cy << child) > rect[3])
+            continue;
+        for (int cx=tx*2; cx<=tx*2+1 && cx<levelWidth(culler, child); cx++){
+            if ((((cx + 1) << child) - 1) < rect[0] || (cx << child) > rect[2])
+                continue;
+            if (isTexelVisible(culler, child, cx, cy, rect, depth))
+                return true;
+        }
+    }
+    return false;
+}
+
+static bool isBoxVisible(const OcclusionCuller & culler, const BoundingBox & box){
+    glm::vec2 lo(1e30f), hi(-1e30f);
+    float depth = 0.0f; // nearest point of the box, as 1/w
+    int behind = 0;
+    for (int i=0; i<8; i++){
+        glm::vec4 corner(
+            (i & 1) ? box.max.x : box.min.x,
+            (i & 2) ? box.max.y : box.min.y,
+            (i & 4) ? box.max.z : box.min.z,
+            1.0f);
+        glm::vec4 clip = culler.viewProj * corner;
+        if (clip.w < 0.001f){
+            behind++;
+            continue;
+        }
+        float invW = 1.0f / clip.w;
+        glm::vec2 ndc = glm::vec2(clip) * invW;
+        lo = glm::min(lo, ndc);
+        hi = glm::max(hi, ndc);
+        depth = std::max(depth, invW);
+    }
+
+    // Completely behind the camera, or crossing the camera plane (can't say anything)
+    if (behind == 8)
+        return false;
+    if (behind > 0)
+        return true;
+
+    // Outside of the frustum
+    if (hi.x < -1.0f || hi.y < -1.0f || lo.x > 1.0f || lo.y > 1.0f)
+        return false;
+
+    int rect[4] = {
+        glm::clamp((int)floor((lo.x * 0.5f + 0.5f) * culler.width),  0, culler.width - 1),
+        glm::clamp((int)floor((lo.y * 0.5f + 0.5f) * culler.height), 0, culler.height - 1),
+        glm::clamp((int)floor((hi.x * 0.5f + 0.5f) * culler.width),  0, culler.width - 1),
+        glm::clamp((int)floor((hi.y * 0.5f + 0.5f) * culler.height), 0, culler.height - 1)
+    };
+
+    // Start at the level where the rectangle covers at most 2x2 texels
+    int size = std::max(rect[2] - rect[0], rect[3] - rect[1]);
+    int level = 0;
+    while ((size >> level) > 1 && level + 1 < (int)culler.minLevels.size())
+        level++;
+
+    for (int ty=rect[1]>>level; ty<=(rect[3]>>level); ty++){
+        for (int tx=rect[0]>>level; tx<=(rect[2]>>level); tx++){
+            if (isTexelVisible(culler, level, tx, ty, rect, depth))
+                return true;
+        }
+    }
+    return false;
+}
+
+void cullObjects(OcclusionCuller & culler, const std::vector<BoundingBox> & boxes, std::vector<unsigned int> & out_visible){
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    std::vector<char> visible(boxes.size());
+    parallelFor((unsigned int)boxes.size(), culler.threadCount, [&](unsigned int begin, unsigned int end){
+        for (unsigned int i=begin; i<end; i++)
+            visible[i] = isBoxVisible(culler, boxes[i]);
+    });
+
+    out_visible.clear();
+    for (unsigned int i=0; i<boxes.size(); i++){
+        if (visible[i])
+            out_visible.push_back(i);
+    }
+
+    culler.stats.testedObjects += (unsigned int)boxes.size();
+    culler.stats.visibleObjects += (unsigned int)out_visible.size();
+    culler.stats.testTime += elapsedMs(start);
+}
+
+void printOcclusionStats(const OcclusionCuller & culler){
+    const OcclusionStats & s = culler.stats;
+    printf("Occlusion : %u occluder triangles, %u / %u objects visible (%.1f%% culled)\n",
+        s.occluderTriangles, s.visibleObjects, s.testedObjects,
+        s.testedObjects ? 100.0 * (s.testedObjects - s.visibleObjects) / s.testedObjects : 0.0);
+    printf("  raster %.3f ms, pyramid %.3f ms, tests %.3f ms\n", s.rasterTime, s.pyramidTime, s.testTime);
+}
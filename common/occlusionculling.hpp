@@ -0,0 +1,56 @@
+#ifndef OCCLUSIONCULLING_HPP
+#define OCCLUSIONCULLING_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// A simplified mesh used to hide other objects (for example the coarsest LOD of a wall)
+struct Occluder {
+    const std::vector<glm::vec3> * vertices;
+    const unsigned short * indices;
+    unsigned int indexCount;
+    glm::mat4 modelMat;
+};
+
+struct BoundingBox {
+    glm::vec3 min; // world space
+    glm::vec3 max;
+};
+
+struct OcclusionStats {
+    unsigned int occluderTriangles;
+    unsigned int testedObjects;
+    unsigned int visibleObjects;
+    double rasterTime;  // ms
+    double pyramidTime; // ms
+    double testTime;    // ms
+};
+
+// Low resolution software depth buffer + min/max pyramid.
+// Depth is stored as 1/w : bigger is closer, 0 means nothing was drawn.
+struct OcclusionCuller {
+    int width, height; // multiples of 4, powers of 2 for a complete pyramid
+    unsigned int threadCount;
+    glm::mat4 viewProj;
+    std::vector<std::vector<float> > minLevels; // level 0 is the depth buffer itself
+    std::vector<std::vector<float> > maxLevels;
+    OcclusionStats stats;
+};
+
+void initOcclusionCuller(OcclusionCuller & culler, int width, int height, unsigned int threadCount);
+
+// Clears the depth buffer for a new view
+void beginOcclusionFrame(OcclusionCuller & culler, const glm::mat4 & viewProj);
+
+// Rasterizes the occluders with SIMD, in parallel over horizontal bands of the screen
+void rasterizeOccluders(OcclusionCuller & culler, const std::vector<Occluder> & occluders);
+
+// Builds the min/max pyramid from the depth buffer
+void buildDepthPyramid(OcclusionCuller & culler);
+
+// Tests world space boxes against the pyramid, in parallel. out_visible gets the indices of the visible boxes.
+void cullObjects(OcclusionCuller & culler, const std::vector<BoundingBox> & boxes, std::vector<unsigned int> & out_visible);
+
+void printOcclusionStats(const OcclusionCuller & culler);
+
+#endif
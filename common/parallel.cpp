@@ -0,0 +1,108 @@
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "parallel.hpp"
+
+// One parallelFor call, on the stack of its caller until its last chunk is done
+struct ParallelJob {
+    const ParallelTask * task;
+    unsigned int count, chunkCount;
+    unsigned int claimed, done; // chunks, under the pool's mutex
+};
+
+struct WorkerPool {
+    std::mutex mutex;
+    std::condition_variable wake;     // a job was queued, or quit
+    std::condition_variable finished; // a chunk is done
+    std::deque<ParallelJob *> jobs;   // with chunks nobody has claimed yet
+    std::vector<std::thread> workers;
+    bool quit;
+
+    WorkerPool();
+    ~WorkerPool();
+};
+
+// Takes the next chunk of the oldest job, under the mutex. False when there are none.
+static bool claimChunk(WorkerPool & pool, ParallelJob * & job, unsigned int & chunk){
+    if (pool.jobs.empty())
+        return false;
+    job = pool.jobs.front();
+    chunk = job->claimed++;
+    if (job->claimed == job->chunkCount)
+        pool.jobs.pop_front();
+    return true;
+}
+
+// Same chunks as the threads of the old parallelFor : [count * c / chunkCount, count * (c + 1) / chunkCount)
+static void runChunk(WorkerPool & pool, ParallelJob * job, unsigned int chunk){
+    (*job->task)(
+        (unsigned int)((unsigned long long)job->count * chunk / job->chunkCount),
+        (unsigned int)((unsigned long long)job->count * (chunk + 1) / job->chunkCount));
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    // The caller may return as soon as the mutex is released : job isn't touched after this
+    if (++job->done == job->chunkCount)
+        pool.finished.notify_all();
+}
+
+static void workerLoop(WorkerPool * pool){
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    for (;;){
+        pool->wake.wait(lock, [pool](){ return pool->quit || !pool->jobs.empty(); });
+        if (pool->quit)
+            return;
+        ParallelJob * job;
+        unsigned int chunk;
+        if (!claimChunk(*pool, job, chunk))
+            continue;
+        lock.unlock();
+        runChunk(*pool, job, chunk);
+        lock.lock();
+    }
+}
+
+WorkerPool::WorkerPool() : quit(false){
+    unsigned int threads = std::thread::hardware_concurrency();
+    for (unsigned int t=1; t<threads; t++)
+        workers.push_back(std::thread(workerLoop, this));
+}
+
+WorkerPool::~WorkerPool(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for (size_t t=0; t<workers.size(); t++)
+        workers[t].join();
+}
+
+static WorkerPool & workerPool(){
+    static WorkerPool pool;
+    return pool;
+}
+
+void runParallelChunks(unsigned int count, unsigned int chunkCount, const ParallelTask & task){
+    WorkerPool & pool = workerPool();
+    ParallelJob job = { &task, count, chunkCount, 0, 0 };
+
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.jobs.push_back(&job);
+    if (!pool.workers.empty())
+        pool.wake.notify_all();
+
+    // Take the chunks of this job nobody has started, rather than sleep. Then only the running ones are waited for,
+    // which is what makes nested calls safe.
+    while (job.claimed < job.chunkCount){
+        unsigned int chunk = job.claimed++;
+        if (job.claimed == job.chunkCount)
+            pool.jobs.erase(std::find(pool.jobs.begin(), pool.jobs.end(), &job));
+        lock.unlock();
+        runChunk(pool, &job, chunk);
+        lock.lock();
+    }
+    pool.finished.wait(lock, [&job](){ return job.done == job.chunkCount; });
+}
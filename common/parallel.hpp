@@ -0,0 +1,29 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <functional>
+#include <algorithm>
+
+// Worker threads, started on first use and shared by every parallelFor : the per-frame callers (light binning,
+// occlusion culling, command recording, scene graph updates) don't create and join threads each time.
+// There are hardware_concurrency - 1 of them, the calling thread being the last one.
+
+typedef std::function<void(unsigned int, unsigned int)> ParallelTask;
+
+// Runs task on the chunks of [0, count) of parallelFor, on the pool and the calling thread, and returns when all are done.
+// The caller takes chunks too while it waits, so a task can itself call parallelFor.
+void runParallelChunks(unsigned int count, unsigned int chunkCount, const ParallelTask & task);
+
+// Runs func(begin, end) over [0, count), split in threadCount chunks of the same size.
+// Chunks are independent : they go to the threads of the pool that are free, in any order.
+template <typename Func>
+void parallelFor(unsigned int count, unsigned int threadCount, Func func){
+    threadCount = std::max(1u, std::min(threadCount, count));
+    if (threadCount == 1){
+        func(0, count);
+        return;
+    }
+    runParallelChunks(count, threadCount, ParallelTask(func));
+}
+
+#endif
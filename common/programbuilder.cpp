@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include <GL/glew.h>
+
+#include "programbuilder.hpp"
+#include "gpuresources.hpp"
+#include "trace.hpp"
+
+// Same values in the KHR and ARB versions of the extension. GLEW 1.13 only knows the ARB one.
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR GL_COMPLETION_STATUS_ARB
+#endif
+
+static double elapsedMs(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool hasExtension(const char * name){
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i=0; i<count; i++){
+        const char * extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+void initProgramBuilder(ProgramBuilder & builder, unsigned int compilerThreads){
+    builder.inFlight.clear();
+    memset(&builder.stats, 0, sizeof(builder.stats));
+
+    bool khr = hasExtension("GL_KHR_parallel_shader_compile");
+    bool arb = hasExtension("GL_ARB_parallel_shader_compile");
+    builder.parallel = khr || arb;
+
+    // glMaxShaderCompilerThreadsKHR has the same signature and meaning : drivers exposing KHR expose the ARB entry point too
+    if (builder.parallel && compilerThreads > 0 && glMaxShaderCompilerThreadsARB != NULL)
+        glMaxShaderCompilerThreadsARB(compilerThreads);
+    printf("Program builder : %s\n", builder.parallel ? (khr ? "GL_KHR_parallel_shader_compile" : "GL_ARB_parallel_shader_compile") : "no parallel shader compile, one build finished per update");
+}
+
+static GLuint issueShader(GLenum type, const ShaderSource & source){
+    GLuint shader = glCreateShader(type);
+    const char * code = source.code.c_str();
+    glShaderSource(shader, 1, &code, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+ProgramBuild * beginProgramBuild(ProgramBuilder & builder, const ShaderSource & vertex, const ShaderSource & fragment, const char * name){
+    TRACE_ZONE("begin program build");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ProgramBuild * build = new ProgramBuild();
+    build->name = name;
+    build->vertex = vertex;
+    build->fragment = fragment;
+    build->state = PROGRAM_BUILDING;
+    build->latency = 0.0;
+    build->issued = start;
+
+    // Linked right away, without asking whether the compiles went well : that would wait for them
+    build->vertexShader = issueShader(GL_VERTEX_SHADER, vertex);
+    build->fragmentShader = issueShader(GL_FRAGMENT_SHADER, fragment);
+    build->program = createGPUResource(GPU_PROGRAM, name);
+    glAttachShader(build->program, build->vertexShader);
+    glAttachShader(build->program, build->fragmentShader);
+    glLinkProgram(build->program);
+
+    builder.inFlight.push_back(build);
+    builder.stats.issueTime += elapsedMs(start);
+    builder.stats.maxInFlight = std::max(builder.stats.maxInFlight, (unsigned int)builder.inFlight.size());
+    return build;
+}
+
+// The link is done : its status and the logs are free to query now
+static void completeBuild(ProgramBuilder & builder, ProgramBuild * build){
+    GLint compiled = GL_FALSE, linked = GL_FALSE;
+    glGetShaderiv(build->vertexShader, GL_COMPILE_STATUS, &compiled);
+    if (compiled) glGetShaderiv(build->fragmentShader, GL_COMPILE_STATUS, &compiled);
+    glGetProgramiv(build->program, GL_LINK_STATUS, &linked);
+    build->latency = elapsedMs(build->issued);
+
+    if (!compiled || !linked){
+        printShaderLog(build->vertexShader, build->vertex);
+        printShaderLog(build->fragmentShader, build->fragment);
+        printProgramLog(build->program);
+    }
+    glDetachShader(build->program, build->vertexShader);
+    glDetachShader(build->program, build->fragmentShader);
+    glDeleteShader(build->vertexShader);
+    glDeleteShader(build->fragmentShader);
+    build->vertexShader = build->fragmentShader = 0;
+
+    if (compiled && linked){
+        build->state = PROGRAM_READY;
+        builder.stats.built++;
+    }
+    else {
+        deleteGPUResource(GPU_PROGRAM, build->program);
+        build->program = 0;
+        build->state = PROGRAM_FAILED;
+        builder.stats.failed++;
+    }
+    builder.stats.totalLatency += build->latency;
+    builder.stats.maxLatency = std::max(builder.stats.maxLatency, build->latency);
+    printf("Program %s %s in %.2f ms\n", build->name.c_str(), build->state == PROGRAM_READY ? "built" : "failed", build->latency);
+}
+
+void updateProgramBuilder(ProgramBuilder & builder){
+    if (builder.inFlight.empty())
+        return;
+    TRACE_ZONE("update program builder");
+
+    if (!builder.parallel){
+        // Any query waits : the oldest one only
+        completeBuild(builder, builder.inFlight.front());
+        builder.inFlight.erase(builder.inFlight.begin());
+        return;
+    }
+
+    size_t kept = 0;
+    for (size_t i=0; i<builder.inFlight.size(); i++){
+        ProgramBuild * build = builder.inFlight[i];
+        GLint done = GL_FALSE;
+        glGetProgramiv(build->program, GL_COMPLETION_STATUS_KHR, &done);
+        if (done) completeBuild(builder, build);
+        else builder.inFlight[kept++] = build;
+    }
+    builder.inFlight.resize(kept);
+}
+
+void finishProgramBuild(ProgramBuilder & builder, ProgramBuild * build){
+    std::vector<ProgramBuild *>::iterator found = std::find(builder.inFlight.begin(), builder.inFlight.end(), build);
+    if (found == builder.inFlight.end())
+        return; // done already
+    TRACE_ZONE("finish program build");
+    builder.inFlight.erase(found);
+    completeBuild(builder, build);
+}
+
+void printProgramBuilderStats(ProgramBuilder & builder){
+    ProgramBuilderStats & stats = builder.stats;
+    unsigned int done = stats.built + stats.failed;
+    if (done == 0)
+        return;
+    printf("Program builder : %u built, %u failed, latency %.2f ms average, %.2f ms max, %.2f ms issuing, up to %u in flight\n",
+        stats.built, stats.failed, stats.totalLatency / done, stats.maxLatency, stats.issueTime, stats.maxInFlight);
+    memset(&stats, 0, sizeof(stats));
+}
+
+void cleanupProgramBuilder(ProgramBuilder & builder){
+    for (size_t i=0; i<builder.inFlight.size(); i++)
+        completeBuild(builder, builder.inFlight[i]);
+    builder.inFlight.clear();
+}
@@ -0,0 +1,64 @@
+#ifndef PROGRAMBUILDER_HPP
+#define PROGRAMBUILDER_HPP
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <GL/glew.h>
+
+#include "shader.hpp"
+
+// Builds programs without waiting for them. Every compile and link is issued right away, and nothing is asked about
+// them until GL_COMPLETION_STATUS says they are done : with KHR / ARB_parallel_shader_compile the driver works on
+// them on its own threads meanwhile. Without the extension, any status query waits for the compiler : updates then
+// finish one build each, so that a batch costs one hitch per frame rather than all of them in one frame.
+
+enum ProgramBuildState {
+    PROGRAM_BUILDING,
+    PROGRAM_READY,
+    PROGRAM_FAILED   // compile or link error, logged. program is 0.
+};
+
+struct ProgramBuild {
+    std::string name;
+    ShaderSource vertex, fragment; // kept for the logs
+    GLuint vertexShader, fragmentShader;
+    GLuint program;
+    int state;
+    std::chrono::steady_clock::time_point issued;
+    double latency; // ms, from the issue to the link status being known
+};
+
+struct ProgramBuilderStats {
+    unsigned int built, failed;
+    double issueTime;     // ms spent in the GL calls issuing the builds
+    double totalLatency;  // ms, of the builds done
+    double maxLatency;
+    unsigned int maxInFlight;
+};
+
+struct ProgramBuilder {
+    bool parallel;          // completion can be polled without blocking
+    std::vector<ProgramBuild *> inFlight;
+    ProgramBuilderStats stats; // since the last print
+};
+
+// GL thread. compilerThreads : for glMaxShaderCompilerThreads, 0 keeps the driver's choice.
+void initProgramBuilder(ProgramBuilder & builder, unsigned int compilerThreads);
+
+// Issues the compiles and the link. The build belongs to the caller, who deletes it once it isn't PROGRAM_BUILDING
+// anymore, and takes its program.
+ProgramBuild * beginProgramBuild(ProgramBuilder & builder, const ShaderSource & vertex, const ShaderSource & fragment, const char * name);
+
+// GL thread, once per frame : collects the builds that are done
+void updateProgramBuilder(ProgramBuilder & builder);
+
+// Waits for one build, when its program is needed right now
+void finishProgramBuild(ProgramBuilder & builder, ProgramBuild * build);
+
+void printProgramBuilderStats(ProgramBuilder & builder);
+
+// Waits for the builds still in flight : their owners can then delete them
+void cleanupProgramBuilder(ProgramBuilder & builder);
+
+#endif
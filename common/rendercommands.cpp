@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "rendercommands.hpp"
+#include "glcapture.hpp"
+
+// DrawData per block of the linear allocator
+static const unsigned int DRAW_DATA_BLOCK_SIZE = 1024;
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start){
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+unsigned long long makeSortKey(unsigned int pass, GLuint program, GLuint material, GLuint vao, float depth01){
+    unsigned long long depth = (unsigned long long)(glm::clamp(depth01, 0.0f, 1.0f) * 0xFFFFFF);
+    return ((unsigned long long)(pass     & 0xF)   << 56)
+         | ((unsigned long long)(program  & 0xFF)  << 48)
+         | ((unsigned long long)(material & 0xFFF) << 36)
+         | ((unsigned long long)(vao      & 0xFFF) << 24)
+         | depth;
+}
+
+void initRenderQueue(RenderQueue & queue, unsigned int threadCount){
+    queue.buffers.resize(std::max(1u, threadCount));
+    for (unsigned int i=0; i<queue.buffers.size(); i++)
+        queue.buffers[i].used = DRAW_DATA_BLOCK_SIZE;
+    memset(&queue.stats, 0, sizeof(queue.stats));
+}
+
+void cleanupRenderQueue(RenderQueue & queue){
+    for (unsigned int i=0; i<queue.buffers.size(); i++){
+        for (unsigned int b=0; b<queue.buffers[i].blocks.size(); b++)
+            delete [] queue.buffers[i].blocks[b];
+    }
+    queue.buffers.clear();
+}
+
+DrawData * allocateDrawData(CommandBuffer & buffer){
+    if (buffer.used == DRAW_DATA_BLOCK_SIZE){
+        buffer.blocks.push_back(new DrawData[DRAW_DATA_BLOCK_SIZE]);
+        buffer.used = 0;
+    }
+    return &buffer.blocks.back()[buffer.used++];
+}
+
+void addDrawPacket(CommandBuffer & buffer, unsigned long long key, const DrawData * data){
+    DrawPacket packet = { key, data };
+    buffer.packets.push_back(packet);
+}
+
+void beginRenderQueue(RenderQueue & queue){
+    for (unsigned int i=0; i<queue.buffers.size(); i++){
+        CommandBuffer & buffer = queue.buffers[i];
+        buffer.packets.clear();
+        // Keep one block : the next frame will most likely need it again
+        for (unsigned int b=1; b<buffer.blocks.size(); b++)
+            delete [] buffer.blocks[b];
+        if (buffer.blocks.size() > 1)
+            buffer.blocks.resize(1);
+        buffer.used = buffer.blocks.empty() ? DRAW_DATA_BLOCK_SIZE : 0;
+    }
+    queue.stats.recordTime = 0.0;
+}
+
+// LSD radix sort, 8 bits per pass. Passes where all keys have the same byte are skipped,
+// which is most of them since only a few programs / materials / VAOs are used in a frame.
+static void radixSort(std::vector<DrawPacket> & packets, std::vector<DrawPacket> & scratch){
+    size_t count = packets.size();
+    scratch.resize(count);
+
+    unsigned int histograms[8][256];
+    memset(histograms, 0, sizeof(histograms));
+    for (size_t i=0; i<count; i++){
+        unsigned long long key = packets[i].key;
+        for (int pass=0; pass<8; pass++)
+            histograms[pass][(key >> (pass * 8)) & 0xFF]++;
+    }
+
+    DrawPacket * from = packets.data();
+    DrawPacket * to = scratch.data();
+    for (int pass=0; pass<8; pass++){
+        unsigned int * histogram = histograms[pass];
+        bool trivial = false;
+        for (int b=0; b<256; b++){
+            if (histogram[b] == count){
+                trivial = true;
+                break;
+            }
+        }
+        if (trivial)
+            continue;
+
+        unsigned int offsets[256];
+        unsigned int sum = 0;
+        for (int b=0; b<256; b++){
+            offsets[b] = sum;
+            sum += histogram[b];
+        }
+        for (size_t i=0; i<count; i++)
+            to[offsets[(from[i].key >> (pass * 8)) & 0xFF]++] = from[i];
+        std::swap(from, to);
+    }
+
+    if (from != packets.data())
+        packets.swap(scratch);
+}
+
+void sortRenderQueue(RenderQueue & queue){
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    queue.packets.clear();
+    for (unsigned int i=0; i<queue.buffers.size(); i++)
+        queue.packets.insert(queue.packets.end(), queue.buffers[i].packets.begin(), queue.buffers[i].packets.end());
+    radixSort(queue.packets, queue.scratch);
+
+    queue.stats.sortTime = elapsedMs(start);
+}
+
+void submitRenderQueue(RenderQueue & queue, const glm::mat4 & viewProj){
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    // Nothing is known about the current state at the start of the queue
+    GLuint program = 0, texture = 0, vao = 0;
+    bool first = true;
+    unsigned int stateChanges = 0, textureBinds = 0;
+
+    for (size_t i=0; i<queue.packets.size(); i++){
+        const DrawData & draw = *queue.packets[i].data;
+
+        if (first || draw.program != program){
+            glUseProgram(draw.program);
+            program = draw.program;
+            stateChanges++;
+        }
+        if (first || draw.texture != texture){
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(draw.textureTarget, draw.texture);
+            texture = draw.texture;
+            stateChanges++;
+            textureBinds++;
+        }
+        if (first || draw.vao != vao){
+            glBindVertexArray(draw.vao);
+            vao = draw.vao;
+            stateChanges++;
+        }
+        first = false;
+
+        glm::mat4 mvp = viewProj * draw.model;
+        glUniformMatrix4fv(draw.mvpLocation, 1, GL_FALSE, &mvp[0][0]);
+        glUniformMatrix4fv(draw.modelLocation, 1, GL_FALSE, &draw.model[0][0]);
+        if (draw.materialRectLocation >= 0){
+            glUniform4fv(draw.materialRectLocation, 1, &draw.materialRect[0]);
+            glUniform1f(draw.materialLayerLocation, draw.materialLayer);
+        }
+        if (draw.rangeCount > 0)
+            glMultiDrawElements(GL_TRIANGLES, draw.rangeCounts, GL_UNSIGNED_SHORT, draw.rangeOffsets, draw.rangeCount);
+        else
+            glDrawElements(GL_TRIANGLES, draw.indexCount, GL_UNSIGNED_SHORT, (void*)(draw.indexOffset * sizeof(unsigned short)));
+    }
+
+    queue.stats.commands = (unsigned int)queue.packets.size();
+    queue.stats.stateChanges = stateChanges;
+    queue.stats.textureBinds = textureBinds;
+    queue.stats.submitTime = elapsedMs(start);
+}
+
+void printRenderQueueStats(const RenderQueue & queue){
+    const RenderQueueStats & s = queue.stats;
+    double total = s.recordTime + s.sortTime + s.submitTime;
+    printf("Render queue : %u commands, %u state changes (%u texture binds), record %.3f ms, sort %.3f ms, submit %.3f ms (%.0f commands/s)\n",
+        s.commands, s.stateChanges, s.textureBinds, s.recordTime, s.sortTime, s.submitTime,
+        total > 0.0 ? s.commands / (total / 1000.0) : 0.0);
+}
@@ -0,0 +1,100 @@
+#ifndef RENDERCOMMANDS_HPP
+#define RENDERCOMMANDS_HPP
+
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "parallel.hpp"
+
+// Everything the submission thread needs to issue one draw
+struct DrawData {
+    GLuint program;
+    GLint mvpLocation;
+    GLint modelLocation;
+    GLuint texture;
+    GLenum textureTarget;     // GL_TEXTURE_2D, or GL_TEXTURE_2D_ARRAY for shared material textures
+    GLint materialRectLocation, materialLayerLocation; // -1 without materials
+    glm::vec4 materialRect;
+    float materialLayer;
+    GLuint vao;
+    GLsizei indexCount;
+    unsigned int indexOffset; // in indices
+    GLsizei rangeCount;       // > 0 : glMultiDrawElements of these ranges (see cullMeshlets) instead of the one above
+    const GLsizei * rangeCounts;
+    const void * const * rangeOffsets; // in bytes
+    glm::mat4 model;          // MVP is computed at submission, from the latest camera
+};
+
+// 16 bytes : what gets sorted
+struct DrawPacket {
+    unsigned long long key;
+    const DrawData * data;
+};
+
+// One per recording thread : packets, and a linear allocator for their DrawData.
+// DrawData lives in fixed size blocks so pointers stay valid while recording.
+struct CommandBuffer {
+    std::vector<DrawPacket> packets;
+    std::vector<DrawData *> blocks;
+    unsigned int used; // DrawData used in the last block
+};
+
+struct RenderQueueStats {
+    unsigned int commands;     // last frame
+    unsigned int stateChanges; // program + texture + VAO binds, last frame
+    unsigned int textureBinds; // last frame
+    double recordTime, sortTime, submitTime; // ms, last frame
+};
+
+struct RenderQueue {
+    std::vector<CommandBuffer> buffers;
+    std::vector<DrawPacket> packets; // merged and sorted
+    std::vector<DrawPacket> scratch;
+    RenderQueueStats stats;
+};
+
+// Sort key, from the most to the least significant bits :
+// pass (4) | program (8) | material (12) | VAO (12) | depth (24).
+// IDs are truncated to their bits : that only affects how well draws get grouped,
+// the submission compares the real GL names before changing any state.
+unsigned long long makeSortKey(unsigned int pass, GLuint program, GLuint material, GLuint vao, float depth01);
+
+void initRenderQueue(RenderQueue & queue, unsigned int threadCount);
+void cleanupRenderQueue(RenderQueue & queue);
+
+// Returns a DrawData that stays valid until the next beginRenderQueue
+DrawData * allocateDrawData(CommandBuffer & buffer);
+void addDrawPacket(CommandBuffer & buffer, unsigned long long key, const DrawData * data);
+
+// Resets all the command buffers for a new frame
+void beginRenderQueue(RenderQueue & queue);
+
+// Merges the command buffers and radix sorts the packets by key
+void sortRenderQueue(RenderQueue & queue);
+
+// Issues the sorted draws on the calling (GL) thread, skipping redundant state changes.
+// viewProj is late-latched : it can be more recent than the camera used while recording.
+void submitRenderQueue(RenderQueue & queue, const glm::mat4 & viewProj);
+
+void printRenderQueueStats(const RenderQueue & queue);
+
+// Records count items with one CommandBuffer per thread, on the worker pool of parallelFor :
+// record(buffer, begin, end) is called once per buffer with its own range.
+template <typename Func>
+void recordCommands(RenderQueue & queue, unsigned int count, Func record){
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    // One chunk per buffer
+    unsigned int threadCount = (unsigned int)queue.buffers.size();
+    parallelFor(threadCount, threadCount, [&](unsigned int begin, unsigned int end){
+        for (unsigned int t=begin; t<end; t++)
+            record(queue.buffers[t], (unsigned int)((unsigned long long)count * t / threadCount), (unsigned int)((unsigned long long)count * (t + 1) / threadCount));
+    });
+
+    queue.stats.recordTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+#endif
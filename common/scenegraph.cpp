@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// SSE2 is always there on x86-64. Other targets use the scalar path.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCENEGRAPH_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "parallel.hpp"
+#include "scenegraph.hpp"
+#include "trace.hpp"
+
+// Below this many world matrices to recompute, starting threads costs more than it saves
+static const unsigned int MIN_PARALLEL_NODES = 16384;
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start){
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void initSceneGraph(SceneGraph & graph, unsigned int capacity){
+    graph.parents.clear();
+    graph.subtreeEnds.clear();
+    graph.positions.clear();
+    graph.rotations.clear();
+    graph.scales.clear();
+    graph.worlds.clear();
+    graph.dirty.clear();
+    graph.dirtyNodes.clear();
+    graph.tasks.clear();
+    graph.parents.reserve(capacity);
+    graph.subtreeEnds.reserve(capacity);
+    graph.positions.reserve(capacity);
+    graph.rotations.reserve(capacity);
+    graph.scales.reserve(capacity);
+    graph.worlds.reserve(capacity);
+    graph.dirty.reserve(capacity);
+    memset(&graph.stats, 0, sizeof(graph.stats));
+}
+
+int addSceneNode(SceneGraph & graph, int parent, const glm::vec3 & position, const glm::quat & rotation, const glm::vec3 & scale){
+    unsigned int node = (unsigned int)graph.parents.size();
+
+    // The last node and its ancestors are the only subtrees still open : they end at node
+    if (parent >= (int)node || (parent >= 0 && graph.subtreeEnds[parent] != node)){
+        printf("Scene node %u : parent %d isn't the previous node or one of its ancestors\n", node, parent);
+        return -1;
+    }
+    for (int ancestor = parent; ancestor >= 0; ancestor = graph.parents[ancestor])
+        graph.subtreeEnds[ancestor] = node + 1;
+
+    graph.parents.push_back(parent);
+    graph.subtreeEnds.push_back(node + 1);
+    graph.positions.push_back(position);
+    graph.rotations.push_back(rotation);
+    graph.scales.push_back(scale);
+    graph.worlds.push_back(glm::mat4(1.0f));
+    graph.dirty.push_back(1);
+    graph.dirtyNodes.push_back(node);
+    return (int)node;
+}
+
+static void markDirty(SceneGraph & graph, unsigned int node){
+    if (graph.dirty[node])
+        return;
+    graph.dirty[node] = 1;
+    graph.dirtyNodes.push_back(node);
+}
+
+void setSceneNodeTransform(SceneGraph & graph, unsigned int node, const glm::vec3 & position, const glm::quat & rotation, const glm::vec3 & scale){
+    graph.positions[node] = position;
+    graph.rotations[node] = rotation;
+    graph.scales[node] = scale;
+    markDirty(graph, node);
+}
+
+void setSceneNodePosition(SceneGraph & graph, unsigned int node, const glm::vec3 & position){
+    graph.positions[node] = position;
+    markDirty(graph, node);
+}
+
+void setSceneNodeRotation(SceneGraph & graph, unsigned int node, const glm::quat & rotation){
+    graph.rotations[node] = rotation;
+    markDirty(graph, node);
+}
+
+// world = parentWorld * translate * rotate * scale. The local matrix is never built : its last row is always 0 0 0 1,
+// so its first three columns are the scaled rotation, and the last one the translation.
+static inline void composeWorld(const float * parentWorld, const glm::vec3 & t, const glm::quat & q, const glm::vec3 & s, float * world){
+    float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    float local[12] = {
+        (1.0f - 2.0f * (yy + zz)) * s.x, 2.0f * (xy + wz) * s.x, 2.0f * (xz - wy) * s.x,
+        2.0f * (xy - wz) * s.y, (1.0f - 2.0f * (xx + zz)) * s.y, 2.0f * (yz + wx) * s.y,
+        2.0f * (xz + wy) * s.z, 2.0f * (yz - wx) * s.z, (1.0f - 2.0f * (xx + yy)) * s.z,
+        t.x, t.y, t.z
+    };
+    if (parentWorld == NULL){
+        for (int c=0; c<4; c++){
+            world[c * 4 + 0] = local[c * 3 + 0];
+            world[c * 4 + 1] = local[c * 3 + 1];
+            world[c * 4 + 2] = local[c * 3 + 2];
+            world[c * 4 + 3] = c == 3 ? 1.0f : 0.0f;
+        }
+        return;
+    }
+#ifdef SCENEGRAPH_SSE2
+    // Column c of the product : the parent's columns weighted by column c of the local matrix
+    __m128 p0 = _mm_loadu_ps(parentWorld);
+    __m128 p1 = _mm_loadu_ps(parentWorld + 4);
+    __m128 p2 = _mm_loadu_ps(parentWorld + 8);
+    __m128 p3 = _mm_loadu_ps(parentWorld + 12);
+    for (int c=0; c<4; c++){
+        __m128 column = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(p0, _mm_set1_ps(local[c * 3 + 0])),
+            _mm_mul_ps(p1, _mm_set1_ps(local[c * 3 + 1]))),
+            _mm_mul_ps(p2, _mm_set1_ps(local[c * 3 + 2])));
+        if (c == 3) column = _mm_add_ps(column, p3);
+        _mm_storeu_ps(world + c * 4, column);
+    }
+#else
+    for (int c=0; c<4; c++){
+        for (int r=0; r<4; r++){
+            world[c * 4 + r] = parentWorld[r] * local[c * 3 + 0] + parentWorld[4 + r] * local[c * 3 + 1] + parentWorld[8 + r] * local[c * 3 + 2] +
+                (c == 3 ? parentWorld[12 + r] : 0.0f);
+        }
+    }
+#endif
+}
+
+static inline void recomputeNode(SceneGraph & graph, unsigned int node){
+    int parent = graph.parents[node];
+    composeWorld(parent >= 0 ? &graph.worlds[parent][0][0] : NULL,
+        graph.positions[node], graph.rotations[node], graph.scales[node], &graph.worlds[node][0][0]);
+}
+
+// In order : every parent is done before its children
+static void recomputeSubtree(SceneGraph & graph, unsigned int root){
+    unsigned int end = graph.subtreeEnds[root];
+    for (unsigned int node=root; node<end; node++)
+        recomputeNode(graph, node);
+}
+
+void updateSceneGraph(SceneGraph & graph, unsigned int threadCount){
+    TRACE_ZONE("updateSceneGraph");
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    graph.stats.updates++;
+    if (graph.dirtyNodes.empty())
+        return;
+
+    // Topmost dirty nodes : the others are inside their subtrees
+    std::sort(graph.dirtyNodes.begin(), graph.dirtyNodes.end());
+    graph.tasks.clear();
+    unsigned int covered = 0, total = 0;
+    for (size_t i=0; i<graph.dirtyNodes.size(); i++){
+        unsigned int node = graph.dirtyNodes[i];
+        graph.dirty[node] = 0;
+        if (node < covered)
+            continue;
+        graph.tasks.push_back(node);
+        covered = graph.subtreeEnds[node];
+        total += covered - node;
+    }
+    graph.dirtyNodes.clear();
+    graph.stats.recomputed += total;
+
+    threadCount = std::max(1u, threadCount);
+    if (threadCount == 1 || total < MIN_PARALLEL_NODES){
+        for (size_t t=0; t<graph.tasks.size(); t++)
+            recomputeSubtree(graph, graph.tasks[t]);
+        graph.stats.tasks += (unsigned int)graph.tasks.size();
+        graph.stats.updateTime += elapsedMs(start);
+        return;
+    }
+
+    // Subtrees too big to balance the threads : their root is done here, their children become tasks
+    unsigned int grain = std::max(1u, total / (threadCount * 8));
+    std::vector<unsigned int> pending;
+    pending.swap(graph.tasks);
+    while (!pending.empty()){
+        unsigned int root = pending.back();
+        pending.pop_back();
+        unsigned int end = graph.subtreeEnds[root];
+        if (end - root <= grain){
+            graph.tasks.push_back(root);
+            continue;
+        }
+        recomputeNode(graph, root);
+        for (unsigned int child=root + 1; child<end; child=graph.subtreeEnds[child])
+            pending.push_back(child);
+    }
+    std::sort(graph.tasks.begin(), graph.tasks.end());
+
+    // Contiguous runs of tasks, of about the same number of nodes, one per thread
+    std::vector<size_t> firstTask(threadCount + 1, graph.tasks.size());
+    unsigned int done = 0, bucket = 0;
+    firstTask[0] = 0;
+    for (size_t t=0; t<graph.tasks.size(); t++){
+        while (bucket + 1 < threadCount && done >= (unsigned long long)total * (bucket + 1) / threadCount)
+            firstTask[++bucket] = t;
+        done += graph.subtreeEnds[graph.tasks[t]] - graph.tasks[t];
+    }
+    parallelFor(threadCount, threadCount, [&](unsigned int begin, unsigned int end){
+        for (unsigned int b=begin; b<end; b++)
+            for (size_t t=firstTask[b]; t<firstTask[b + 1]; t++)
+                recomputeSubtree(graph, graph.tasks[t]);
+    });
+    graph.stats.tasks += (unsigned int)graph.tasks.size();
+    graph.stats.updateTime += elapsedMs(start);
+}
+
+void updateSceneGraphNaive(SceneGraph & graph){
+    for (size_t node=0; node<graph.parents.size(); node++){
+        glm::mat4 local = glm::translate(glm::mat4(1.0f), graph.positions[node]) * glm::mat4_cast(graph.rotations[node]) * glm::scale(glm::mat4(1.0f), graph.scales[node]);
+        int parent = graph.parents[node];
+        graph.worlds[node] = parent >= 0 ? graph.worlds[parent] * local : local;
+        graph.dirty[node] = 0;
+    }
+    graph.dirtyNodes.clear();
+}
+
+void printSceneGraphStats(SceneGraph & graph){
+    SceneGraphStats & stats = graph.stats;
+    if (stats.updates == 0)
+        return;
+    printf("Scene graph : %u nodes, %.1f world matrices recomputed per update in %.1f tasks, %.3f ms per update\n",
+        (unsigned int)graph.parents.size(), (double)stats.recomputed / stats.updates, (double)stats.tasks / stats.updates, stats.updateTime / stats.updates);
+    memset(&stats, 0, sizeof(stats));
+}
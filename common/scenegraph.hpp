@@ -0,0 +1,55 @@
+#ifndef SCENEGRAPH_HPP
+#define SCENEGRAPH_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Transform hierarchy as structure of arrays, in depth first order : a parent always comes before its children,
+// and the descendants of a node are the nodes right after it, up to its subtree end.
+// Changing a local transform only marks the node. updateSceneGraph then recomputes the dirty subtrees and nothing
+// else, each in one forward pass (the parent's world matrix is always ready), and spreads them over threads.
+// World matrices are contiguous : a range of them is ready to upload as instance data or a uniform block.
+
+struct SceneGraphStats {
+    unsigned int updates;
+    unsigned int recomputed;  // world matrices
+    unsigned int tasks;       // subtrees handed to the threads
+    double updateTime;        // ms
+};
+
+struct SceneGraph {
+    // By node
+    std::vector<int> parents;                // -1 for roots
+    std::vector<unsigned int> subtreeEnds;   // one past the last descendant
+    std::vector<glm::vec3> positions;        // local
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> worlds;
+    std::vector<unsigned char> dirty;
+
+    std::vector<unsigned int> dirtyNodes;    // marked since the last update, in any order
+    std::vector<unsigned int> tasks;         // scratch : roots of the subtrees to recompute
+    SceneGraphStats stats;                   // since the last print
+};
+
+void initSceneGraph(SceneGraph & graph, unsigned int capacity);
+
+// Nodes are added depth first : parent is -1, the last node added, or one of its ancestors.
+// Returns the new node, or -1 when parent breaks that order.
+int addSceneNode(SceneGraph & graph, int parent, const glm::vec3 & position, const glm::quat & rotation, const glm::vec3 & scale);
+
+void setSceneNodeTransform(SceneGraph & graph, unsigned int node, const glm::vec3 & position, const glm::quat & rotation, const glm::vec3 & scale);
+void setSceneNodePosition(SceneGraph & graph, unsigned int node, const glm::vec3 & position);
+void setSceneNodeRotation(SceneGraph & graph, unsigned int node, const glm::quat & rotation);
+
+// Recomputes the world matrices below the dirty nodes. Subtrees are split across threadCount threads when there
+// are enough nodes to recompute : a big dirty subtree is split into the subtrees of its children.
+void updateSceneGraph(SceneGraph & graph, unsigned int threadCount);
+
+// Every world matrix, one by one with glm : the reference the benchmark compares against
+void updateSceneGraphNaive(SceneGraph & graph);
+
+void printSceneGraphStats(SceneGraph & graph);
+
+#endif
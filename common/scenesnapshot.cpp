@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+
+#include "scenesnapshot.hpp"
+
+// Set in 'middle' while the snapshot there hasn't been taken by the reader
+static const unsigned int SNAPSHOT_FRESH = 4;
+
+void initSnapshotBuffer(SnapshotTripleBuffer & buffer){
+    buffer.back = 0;
+    buffer.middle = 1;
+    buffer.front = 2;
+    buffer.hasFront = false;
+    buffer.published = 0;
+    buffer.skipped = 0;
+}
+
+SceneSnapshot & beginSnapshotWrite(SnapshotTripleBuffer & buffer){
+    return buffer.slots[buffer.back];
+}
+
+const SceneSnapshot * publishSnapshot(SnapshotTripleBuffer & buffer){
+    // Release : the reader sees the whole snapshot once it sees its index
+    unsigned int previous = buffer.middle.exchange(buffer.back | SNAPSHOT_FRESH, std::memory_order_acq_rel);
+    buffer.back = previous & ~SNAPSHOT_FRESH;
+    buffer.published++;
+
+    if (previous & SNAPSHOT_FRESH){
+        buffer.skipped++;
+        return &buffer.slots[buffer.back];
+    }
+    return NULL;
+}
+
+const SceneSnapshot * acquireSnapshot(SnapshotTripleBuffer & buffer, bool & fresh){
+    fresh = (buffer.middle.load(std::memory_order_relaxed) & SNAPSHOT_FRESH) != 0;
+    if (fresh){
+        unsigned int previous = buffer.middle.exchange(buffer.front, std::memory_order_acq_rel);
+        buffer.front = previous & ~SNAPSHOT_FRESH;
+        buffer.hasFront = true;
+    }
+    return buffer.hasFront ? &buffer.slots[buffer.front] : NULL;
+}
+
+void addBusyInterval(ThreadActivity & activity, double begin, double end){
+    std::lock_guard<std::mutex> lock(activity.mutex);
+    activity.intervals.push_back(begin);
+    activity.intervals.push_back(end);
+}
+
+// Intervals clipped to the window, and their total length
+static double clipIntervals(ThreadActivity & activity, double windowBegin, double windowEnd, std::vector<double> & out){
+    std::lock_guard<std::mutex> lock(activity.mutex);
+    double total = 0.0;
+    out.clear();
+    for (size_t i=0; i<activity.intervals.size(); i+=2){
+        double begin = std::max(activity.intervals[i], windowBegin);
+        double end = std::min(activity.intervals[i+1], windowEnd);
+        if (end > begin){
+            out.push_back(begin);
+            out.push_back(end);
+            total += end - begin;
+        }
+    }
+    activity.intervals.clear();
+    return total;
+}
+
+void printFramePipelineStats(SnapshotTripleBuffer & buffer, ThreadActivity & sim, ThreadActivity & render, double windowBegin, double windowEnd){
+    std::vector<double> a, b;
+    double simBusy = clipIntervals(sim, windowBegin, windowEnd, a);
+    double renderBusy = clipIntervals(render, windowBegin, windowEnd, b);
+
+    // Both lists are sorted : each thread logs its intervals in order
+    double overlap = 0.0;
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()){
+        double begin = std::max(a[i], b[j]);
+        double end = std::min(a[i+1], b[j+1]);
+        if (end > begin)
+            overlap += end - begin;
+        if (a[i+1] < b[j+1]) i += 2;
+        else j += 2;
+    }
+
+    double window = std::max(windowEnd - windowBegin, 1e-6);
+    unsigned int published = buffer.published.exchange(0);
+    unsigned int skipped = buffer.skipped.exchange(0);
+    printf("Threads : sim %.1f%% busy, render %.1f%% busy, overlap %.1f%% (%.1f%% of render time), %u snapshots, %u skipped\n",
+        simBusy / window * 100.0, renderBusy / window * 100.0, overlap / window * 100.0,
+        renderBusy > 0.0 ? overlap / renderBusy * 100.0 : 0.0, published, skipped);
+}
@@ -0,0 +1,64 @@
+#ifndef SCENESNAPSHOT_HPP
+#define SCENESNAPSHOT_HPP
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <glm/glm.hpp>
+
+#include "clusteredlighting.hpp" // includes glew, before GLFW
+#include "occlusionculling.hpp"
+#include "input.hpp"
+
+// Everything the render thread needs from one simulation step.
+// Written by the simulation thread, never modified once published.
+struct SceneSnapshot {
+    unsigned int step; // simulation step that produced it
+    double simTime;    // glfwGetTime() at the start of the step
+    Camera camera;
+    glm::mat4 projMat, viewMat;
+    std::vector<glm::mat4> modelMats;
+    std::vector<BoundingBox> boxes; // world space, one per model
+    std::vector<PointLight> lights;
+    LatchedInput input; // events first shown by this snapshot
+    bool quit;
+};
+
+// Lock-free triple buffer : the writer always has a free slot, the reader always gets the newest complete snapshot.
+// Slots are only swapped through 'middle', so neither side ever waits for the other.
+struct SnapshotTripleBuffer {
+    SceneSnapshot slots[3];
+    std::atomic<unsigned int> middle; // slot index, | SNAPSHOT_FRESH until the reader takes it
+    unsigned int back;  // writer side
+    unsigned int front; // reader side
+    bool hasFront;      // reader side : false until the first snapshot is taken
+    std::atomic<unsigned int> published;
+    std::atomic<unsigned int> skipped; // overwritten before the reader took them
+};
+
+// Busy time of one thread, as [begin, end] pairs in seconds
+struct ThreadActivity {
+    std::mutex mutex;
+    std::vector<double> intervals;
+};
+
+void initSnapshotBuffer(SnapshotTripleBuffer & buffer);
+
+// Writer side : fill the returned snapshot, then publish it
+SceneSnapshot & beginSnapshotWrite(SnapshotTripleBuffer & buffer);
+
+// Returns the snapshot this one replaced if the reader never took it (so its input can be carried over), else NULL.
+// The returned snapshot is the next one to be written : read it before calling beginSnapshotWrite.
+const SceneSnapshot * publishSnapshot(SnapshotTripleBuffer & buffer);
+
+// Reader side : returns the newest published snapshot, NULL if there is none yet.
+// fresh is true the first time a snapshot is returned. The previous snapshot must not be used anymore.
+const SceneSnapshot * acquireSnapshot(SnapshotTripleBuffer & buffer, bool & fresh);
+
+void addBusyInterval(ThreadActivity & activity, double begin, double end);
+
+// Prints the utilization of both threads and how much of the time they were busy together
+// over [windowBegin, windowEnd], then resets the intervals.
+void printFramePipelineStats(SnapshotTripleBuffer & buffer, ThreadActivity & sim, ThreadActivity & render, double windowBegin, double windowEnd);
+
+#endif
@@ -13,90 +13,168 @@ using namespace std;
 #include <GL/glew.h>
 
 #include "shader.hpp"
+#include "gpuresources.hpp"
+#include "trace.hpp"
 
-GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
+static std::string shaderDirectory(const std::string & path){
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
 
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+// "#include" at the start of the line, then the file name in quotes. Returns false for any other line.
+static bool parseInclude(const std::string & line, std::string & name){
+	size_t i = line.find_first_not_of(" \t");
+	if (i == std::string::npos || line.compare(i, 8, "#include") != 0)
+		return false;
+	size_t open = line.find('"', i + 8);
+	size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+	if (close == std::string::npos){
+		name.clear();
+		return true;
+	}
+	name = line.substr(open + 1, close - open - 1);
+	return true;
+}
 
-	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if(VertexShaderStream.is_open()){
-		std::stringstream sstr;
-		sstr << VertexShaderStream.rdbuf();
-		VertexShaderCode = sstr.str();
-		VertexShaderStream.close();
-	}else{
-		printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", vertex_file_path);
-		getchar();
-		return 0;
+static bool expandShaderFile(const std::string & path, ShaderSource & source, std::vector<std::string> & stack){
+	if (std::find(stack.begin(), stack.end(), path) != stack.end()){
+		printf("%s includes itself\n", path.c_str());
+		return false;
+	}
+	if (std::find(source.files.begin(), source.files.end(), path) != source.files.end())
+		return true; // already there
+
+	std::ifstream stream(path.c_str(), std::ios::in);
+	if(!stream.is_open()){
+		printf("Impossible to open %s. Are you in the right directory ? Don't forget to read the FAQ !\n", path.c_str());
+		return false;
+	}
+	int fileIndex = (int)source.files.size();
+	source.files.push_back(path);
+	stack.push_back(path);
+
+	// Included files restart the numbering, and the including one resumes after them : compile errors point to the right line
+	if (fileIndex > 0){
+		char directive[32];
+		snprintf(directive, sizeof(directive), "#line 1 %d\n", fileIndex);
+		source.code += directive;
+	}
+	std::string line, name;
+	int lineNumber = 0;
+	while (std::getline(stream, line)){
+		lineNumber++;
+		if (!parseInclude(line, name)){
+			source.code += line;
+			source.code += '\n';
+			continue;
+		}
+		if (name.empty()){
+			printf("%s:%d : #include needs a file name in quotes\n", path.c_str(), lineNumber);
+			return false;
+		}
+		if (!expandShaderFile(shaderDirectory(path) + name, source, stack))
+			return false;
+		char directive[32];
+		snprintf(directive, sizeof(directive), "#line %d %d\n", lineNumber + 1, fileIndex);
+		source.code += directive;
 	}
+	stack.pop_back();
+	return true;
+}
+
+bool loadShaderSource(const char * path, ShaderSource & source){
+	TRACE_ZONE("loadShaderSource");
+	source.code.clear();
+	source.files.clear();
+	std::vector<std::string> stack;
+	return expandShaderFile(path, source, stack);
+}
 
-	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if(FragmentShaderStream.is_open()){
-		std::stringstream sstr;
-		sstr << FragmentShaderStream.rdbuf();
-		FragmentShaderCode = sstr.str();
-		FragmentShaderStream.close();
+void injectShaderDefines(ShaderSource & source, const std::vector<std::string> & defines){
+	if (defines.empty())
+		return;
+
+	// #version must stay first
+	size_t version = source.code.find("#version");
+	size_t insert = 0;
+	int nextLine = 1;
+	if (version != std::string::npos){
+		size_t end = source.code.find('\n', version);
+		insert = end == std::string::npos ? source.code.size() : end + 1;
+		nextLine = (int)std::count(source.code.begin(), source.code.begin() + insert, '\n') + 1;
 	}
 
-	GLint Result = GL_FALSE;
+	std::string lines;
+	for (size_t i=0; i<defines.size(); i++)
+		lines += "#define " + defines[i] + "\n";
+	char directive[32];
+	snprintf(directive, sizeof(directive), "#line %d 0\n", nextLine);
+	lines += directive;
+	if (insert == source.code.size() && insert > 0 && source.code[insert - 1] != '\n')
+		lines = "\n" + lines;
+	source.code.insert(insert, lines);
+}
+
+void printShaderLog(GLuint ShaderID, const ShaderSource & source){
 	int InfoLogLength;
+	glGetShaderiv(ShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if ( InfoLogLength > 0 ){
+		std::vector<char> ShaderErrorMessage(InfoLogLength+1);
+		glGetShaderInfoLog(ShaderID, InfoLogLength, NULL, &ShaderErrorMessage[0]);
+		printf("%s\n", &ShaderErrorMessage[0]);
+		for (size_t i=1; i<source.files.size(); i++)
+			printf("Source string %u : %s\n", (unsigned int)i, source.files[i].c_str());
+	}
+}
+
+void printProgramLog(GLuint ProgramID){
+	int InfoLogLength;
+	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if ( InfoLogLength > 0 ){
+		std::vector<char> ProgramErrorMessage(InfoLogLength+1);
+		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+		printf("%s\n", &ProgramErrorMessage[0]);
+	}
+}
 
+GLuint LoadShadersFromSource(const ShaderSource & vertex, const ShaderSource & fragment, const char * name){
+	TRACE_ZONE("LoadShadersFromSource");
+
+	// Create the shaders
+	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
 
 	// Compile Vertex Shader
-	printf("Compiling shader : %s\n", vertex_file_path);
-	char const * VertexSourcePointer = VertexShaderCode.c_str();
+	printf("Compiling shader : %s\n", vertex.files.empty() ? name : vertex.files[0].c_str());
+	char const * VertexSourcePointer = vertex.code.c_str();
 	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
 	glCompileShader(VertexShaderID);
 
 	// Check Vertex Shader
-	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if ( InfoLogLength > 0 ){
-		std::vector<char> VertexShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-		printf("%s\n", &VertexShaderErrorMessage[0]);
-	}
+	printShaderLog(VertexShaderID, vertex);
 
 
 
 	// Compile Fragment Shader
-	printf("Compiling shader : %s\n", fragment_file_path);
-	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
+	printf("Compiling shader : %s\n", fragment.files.empty() ? name : fragment.files[0].c_str());
+	char const * FragmentSourcePointer = fragment.code.c_str();
 	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
 	glCompileShader(FragmentShaderID);
 
 	// Check Fragment Shader
-	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if ( InfoLogLength > 0 ){
-		std::vector<char> FragmentShaderErrorMessage(InfoLogLength+1);
-		glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-		printf("%s\n", &FragmentShaderErrorMessage[0]);
-	}
+	printShaderLog(FragmentShaderID, fragment);
 
 
 
 	// Link the program
 	printf("Linking program\n");
-	GLuint ProgramID = glCreateProgram();
+	GLuint ProgramID = createGPUResource(GPU_PROGRAM, name);
 	glAttachShader(ProgramID, VertexShaderID);
 	glAttachShader(ProgramID, FragmentShaderID);
 	glLinkProgram(ProgramID);
 
 	// Check the program
-	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
-	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if ( InfoLogLength > 0 ){
-		std::vector<char> ProgramErrorMessage(InfoLogLength+1);
-		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
-		printf("%s\n", &ProgramErrorMessage[0]);
-	}
+	printProgramLog(ProgramID);
 
 	
 	glDetachShader(ProgramID, VertexShaderID);
@@ -108,4 +186,17 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	return ProgramID;
 }
 
+GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
+	TRACE_ZONE("LoadShaders");
+
+	// Read the shaders, with what they include
+	ShaderSource VertexShaderSource, FragmentShaderSource;
+	if(!loadShaderSource(vertex_file_path, VertexShaderSource) || !loadShaderSource(fragment_file_path, FragmentShaderSource)){
+		getchar();
+		return 0;
+	}
+
+	return LoadShadersFromSource(VertexShaderSource, FragmentShaderSource, fragment_file_path);
+}
+
 
@@ -1,6 +1,29 @@
 #ifndef SHADER_HPP
 #define SHADER_HPP
 
+#include <string>
+#include <vector>
+
+// Preprocessed GLSL : includes expanded, defines injected
+struct ShaderSource {
+    std::string code;
+    std::vector<std::string> files; // by #line source string number : 0 is the file itself, then what it includes
+};
+
+// Reads a shader and expands its #include "file" lines, relative to the including file.
+// A file is only included once per shader, like with #pragma once. Cycles and missing files fail.
+bool loadShaderSource(const char * path, ShaderSource & source);
+
+// Inserts a "#define NAME VALUE" line per entry right after #version. Line numbers of the file are kept.
+void injectShaderDefines(ShaderSource & source, const std::vector<std::string> & defines);
+
+// Info logs, if any. The shader one also says which file each source string number is.
+void printShaderLog(GLuint shader, const ShaderSource & source);
+void printProgramLog(GLuint program);
+
+// name : of the program, in the logs and the GPU resource list
+GLuint LoadShadersFromSource(const ShaderSource & vertex, const ShaderSource & fragment, const char * name);
+
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path);
 
 #endif
@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+#include <GL/glew.h>
+
+#include "shadervariants.hpp"
+#include "gpuresources.hpp"
+#include "trace.hpp"
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start){
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void initShaderVariants(ShaderVariants & variants, ProgramBuilder & builder, const char * vertexPath, const char * fragmentPath){
+    variants.vertexPath = vertexPath;
+    variants.fragmentPath = fragmentPath;
+    variants.permutations.clear();
+    variants.constants.clear();
+    variants.builder = &builder;
+    variants.watcher = NULL;
+    variants.programs.clear();
+    variants.building.clear();
+    variants.superseded.clear();
+    variants.generation = 0;
+    variants.ready.clear();
+    variants.pendingCount = 0;
+    memset(&variants.stats, 0, sizeof(variants.stats));
+}
+
+void watchShaderVariants(ShaderVariants & variants, FileWatcher & watcher){
+    variants.watcher = &watcher;
+}
+
+static unsigned int usedBits(const ShaderVariants & variants){
+    if (variants.permutations.empty())
+        return 0;
+    const ShaderPermutation & last = variants.permutations.back();
+    return last.shift + last.bits;
+}
+
+unsigned int addShaderPermutation(ShaderVariants & variants, const char * name, unsigned int bits){
+    unsigned int shift = usedBits(variants);
+    if (bits == 0 || shift + bits > 32){
+        printf("Shader permutation %s doesn't fit in the mask\n", name);
+        return shift;
+    }
+    ShaderPermutation permutation = { name, shift, bits };
+    variants.permutations.push_back(permutation);
+    return shift;
+}
+
+void setShaderConstant(ShaderVariants & variants, const char * name, const char * value){
+    variants.constants.push_back(std::string(name) + " " + value);
+}
+
+unsigned int shaderVariantMask(const ShaderVariants & variants, const char * name, unsigned int value){
+    for (size_t i=0; i<variants.permutations.size(); i++){
+        const ShaderPermutation & permutation = variants.permutations[i];
+        if (permutation.name != name)
+            continue;
+        if (permutation.bits < 32 && value >= (1u << permutation.bits))
+            printf("Shader permutation %s : %u doesn't fit in %u bits\n", name, value, permutation.bits);
+        unsigned int fieldMask = permutation.bits < 32 ? (1u << permutation.bits) - 1 : ~0u;
+        return (value & fieldMask) << permutation.shift;
+    }
+    printf("Unknown shader permutation %s\n", name);
+    return 0;
+}
+
+void shaderVariantDefines(const ShaderVariants & variants, unsigned int mask, std::vector<std::string> & defines){
+    defines = variants.constants;
+    for (size_t i=0; i<variants.permutations.size(); i++){
+        const ShaderPermutation & permutation = variants.permutations[i];
+        unsigned int fieldMask = permutation.bits < 32 ? (1u << permutation.bits) - 1 : ~0u;
+        char value[16];
+        snprintf(value, sizeof(value), " %u", (mask >> permutation.shift) & fieldMask);
+        defines.push_back(permutation.name + value);
+    }
+}
+
+// Any thread : only reads files
+static void preprocessVariant(const ShaderVariants & variants, PreprocessedVariant & variant){
+    std::vector<std::string> defines;
+    shaderVariantDefines(variants, variant.mask, defines);
+    variant.loaded = loadShaderSource(variants.vertexPath.c_str(), variant.vertex) &&
+                     loadShaderSource(variants.fragmentPath.c_str(), variant.fragment);
+    if (variant.loaded){
+        injectShaderDefines(variant.vertex, defines);
+        injectShaderDefines(variant.fragment, defines);
+    }
+}
+
+static void beginVariantBuild(ShaderVariants & variants, const PreprocessedVariant & variant){
+    char name[32];
+    snprintf(name, sizeof(name), "variant %08x of ", variant.mask);
+    std::map<unsigned int, ProgramBuild *>::iterator previous = variants.building.find(variant.mask);
+    if (previous != variants.building.end())
+        variants.superseded.push_back(previous->second);
+    variants.building[variant.mask] = beginProgramBuild(*variants.builder, variant.vertex, variant.fragment, (name + variants.fragmentPath).c_str());
+}
+
+// A build is done : its program replaces the old one, unless it failed and there is an old one to keep
+static void takeVariantBuild(ShaderVariants & variants, unsigned int mask, ProgramBuild * build){
+    std::map<unsigned int, GLuint>::iterator old = variants.programs.find(mask);
+    bool reload = old != variants.programs.end();
+    if (reload && build->state == PROGRAM_FAILED && old->second != 0){
+        printf("Keeping the previous %s\n", build->name.c_str());
+        variants.stats.failedReloads++;
+    }
+    else {
+        if (reload){
+            if (old->second != 0)
+                deleteGPUResource(GPU_PROGRAM, old->second);
+            variants.generation++;
+            variants.stats.reloaded++;
+        }
+        else variants.stats.compiled++;
+        variants.programs[mask] = build->program;
+    }
+
+    // Its includes may have changed too
+    if (variants.watcher != NULL){
+        for (size_t i=0; i<build->vertex.files.size(); i++)
+            watchFile(*variants.watcher, build->vertex.files[i]);
+        for (size_t i=0; i<build->fragment.files.size(); i++)
+            watchFile(*variants.watcher, build->fragment.files[i]);
+    }
+    delete build;
+}
+
+GLuint getShaderVariant(ShaderVariants & variants, unsigned int mask){
+    std::map<unsigned int, GLuint>::const_iterator found = variants.programs.find(mask);
+    if (found != variants.programs.end())
+        return found->second;
+
+    // Not asked for before, or still with the worker : preprocessed right here
+    if (variants.building.find(mask) == variants.building.end()){
+        PreprocessedVariant variant;
+        variant.mask = mask;
+        preprocessVariant(variants, variant);
+        if (!variant.loaded){
+            variants.programs[mask] = 0;
+            return 0;
+        }
+        beginVariantBuild(variants, variant);
+    }
+    ProgramBuild * build = variants.building[mask];
+    variants.building.erase(mask);
+    finishProgramBuild(*variants.builder, build);
+    takeVariantBuild(variants, mask, build);
+    return variants.programs[mask];
+}
+
+void allShaderVariantMasks(const ShaderVariants & variants, std::vector<unsigned int> & masks){
+    unsigned int bits = usedBits(variants);
+    masks.clear();
+    if (bits >= 20){
+        printf("%u permutation bits : too many variants to list\n", bits);
+        return;
+    }
+    for (unsigned int mask=0; mask < (1u << bits); mask++)
+        masks.push_back(mask);
+}
+
+void precompileShaderVariants(ShaderVariants & variants, const std::vector<unsigned int> & masks){
+    if (variants.worker.joinable())
+        variants.worker.join();
+    {
+        std::lock_guard<std::mutex> lock(variants.mutex);
+        variants.pendingCount = (unsigned int)masks.size();
+    }
+    variants.worker = std::thread([&variants, masks](){
+        setTraceThreadName("shader precompile");
+        for (size_t i=0; i<masks.size(); i++){
+            TRACE_ZONE("preprocess shader variant");
+            std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+            PreprocessedVariant * variant = new PreprocessedVariant();
+            variant->mask = masks[i];
+            preprocessVariant(variants, *variant);
+            std::lock_guard<std::mutex> lock(variants.mutex);
+            variants.ready.push_back(variant);
+            variants.pendingCount--;
+            variants.stats.preprocessTime += elapsedMs(start);
+        }
+    });
+}
+
+// Every variant built so far, preprocessed again from the files as they are now
+static void reloadShaderVariants(ShaderVariants & variants){
+    TRACE_ZONE("reload shader variants");
+    for (std::map<unsigned int, GLuint>::const_iterator it = variants.programs.begin(); it != variants.programs.end(); ++it){
+        PreprocessedVariant variant;
+        variant.mask = it->first;
+        preprocessVariant(variants, variant);
+        if (variant.loaded)
+            beginVariantBuild(variants, variant);
+    }
+}
+
+unsigned int updateShaderVariants(ShaderVariants & variants, unsigned int maxPrograms){
+    std::vector<PreprocessedVariant *> batch;
+    unsigned int left;
+    {
+        std::lock_guard<std::mutex> lock(variants.mutex);
+        size_t count = std::min((size_t)maxPrograms, variants.ready.size());
+        batch.assign(variants.ready.begin(), variants.ready.begin() + count);
+        variants.ready.erase(variants.ready.begin(), variants.ready.begin() + count);
+        left = variants.pendingCount + (unsigned int)variants.ready.size();
+    }
+    for (size_t i=0; i<batch.size(); i++){
+        // Already built on first use while it was with the worker
+        unsigned int mask = batch[i]->mask;
+        if (variants.programs.find(mask) == variants.programs.end() && variants.building.find(mask) == variants.building.end()){
+            if (batch[i]->loaded){
+                beginVariantBuild(variants, *batch[i]);
+                variants.stats.precompiled++;
+            }
+            else variants.programs[mask] = 0;
+        }
+        delete batch[i];
+    }
+
+    // Done builds
+    for (std::map<unsigned int, ProgramBuild *>::iterator it = variants.building.begin(); it != variants.building.end(); ){
+        if (it->second->state == PROGRAM_BUILDING){
+            if (variants.programs.find(it->first) == variants.programs.end())
+                left++;
+            ++it;
+            continue;
+        }
+        takeVariantBuild(variants, it->first, it->second);
+        variants.building.erase(it++);
+    }
+    size_t kept = 0;
+    for (size_t i=0; i<variants.superseded.size(); i++){
+        ProgramBuild * build = variants.superseded[i];
+        if (build->state == PROGRAM_BUILDING){
+            variants.superseded[kept++] = build;
+            continue;
+        }
+        if (build->program != 0)
+            deleteGPUResource(GPU_PROGRAM, build->program);
+        delete build;
+    }
+    variants.superseded.resize(kept);
+
+    // Hot reload
+    if (variants.watcher != NULL){
+        std::vector<std::string> changed;
+        pollFileWatcher(*variants.watcher, changed);
+        for (size_t i=0; i<changed.size(); i++)
+            printf("%s changed\n", changed[i].c_str());
+        if (!changed.empty())
+            reloadShaderVariants(variants);
+    }
+    return left;
+}
+
+void printShaderVariantStats(ShaderVariants & variants){
+    std::lock_guard<std::mutex> lock(variants.mutex);
+    const ShaderVariantStats & stats = variants.stats;
+    printf("Shader variants of %s : %u built (%u precompiled), %u reloads, %u failed, %.2f ms preprocessing on the worker\n",
+        variants.fragmentPath.c_str(), stats.compiled, stats.precompiled, stats.reloaded, stats.failedReloads, stats.preprocessTime);
+}
+
+void cleanupShaderVariants(ShaderVariants & variants){
+    if (variants.worker.joinable())
+        variants.worker.join();
+    for (size_t i=0; i<variants.ready.size(); i++)
+        delete variants.ready[i];
+    variants.ready.clear();
+    variants.pendingCount = 0;
+
+    // Builds still going : waited for, then thrown away
+    for (std::map<unsigned int, ProgramBuild *>::iterator it = variants.building.begin(); it != variants.building.end(); ++it)
+        variants.superseded.push_back(it->second);
+    variants.building.clear();
+    for (size_t i=0; i<variants.superseded.size(); i++){
+        ProgramBuild * build = variants.superseded[i];
+        finishProgramBuild(*variants.builder, build);
+        if (build->program != 0)
+            deleteGPUResource(GPU_PROGRAM, build->program);
+        delete build;
+    }
+    variants.superseded.clear();
+
+    for (std::map<unsigned int, GLuint>::iterator it = variants.programs.begin(); it != variants.programs.end(); ++it)
+        if (it->second != 0)
+            deleteGPUResource(GPU_PROGRAM, it->second);
+    variants.programs.clear();
+}
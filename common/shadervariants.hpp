@@ -0,0 +1,98 @@
+#ifndef SHADERVARIANTS_HPP
+#define SHADERVARIANTS_HPP
+
+#include <vector>
+#include <map>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <GL/glew.h>
+
+#include "shader.hpp"
+#include "programbuilder.hpp"
+#include "filewatcher.hpp"
+
+// Compile-time permutations of a vertex + fragment shader pair. Each permutation is a field of a bitmask, and is
+// #defined to the value of its field in the variant the mask selects : the shaders test it with #if, so a variant
+// only contains the code it needs, without uniform branches. Programs are compiled the first time they are asked for,
+// or ahead of time : the sources of a precompile phase are read and preprocessed by a worker thread, then built by
+// the ProgramBuilder, all at once, without waiting for them.
+// With a FileWatcher, the variants already built are rebuilt when one of their files is written, and only replace
+// the old programs once they are linked : a reload never stalls a frame, a broken edit keeps the old program.
+struct ShaderPermutation {
+    std::string name; // of the #define
+    unsigned int shift, bits;
+};
+
+struct PreprocessedVariant {
+    unsigned int mask;
+    bool loaded;
+    ShaderSource vertex, fragment;
+};
+
+struct ShaderVariantStats {
+    unsigned int compiled;      // programs
+    unsigned int precompiled;   // of which, preprocessed by the worker
+    unsigned int reloaded, failedReloads;
+    double preprocessTime;      // ms on the worker
+};
+
+struct ShaderVariants {
+    std::string vertexPath, fragmentPath;
+    std::vector<ShaderPermutation> permutations;
+    std::vector<std::string> constants;     // "NAME VALUE", defined in every variant
+    ProgramBuilder * builder;
+    FileWatcher * watcher;                  // NULL : no hot reload
+
+    // GL thread only
+    std::map<unsigned int, GLuint> programs; // 0 : the files couldn't be read, or it didn't build
+    std::map<unsigned int, ProgramBuild *> building; // first builds, and reloads of programs still in use
+    std::vector<ProgramBuild *> superseded; // reloads that a newer edit made useless, deleted once done
+    unsigned int generation;                // +1 whenever a program is replaced : uniform locations must be looked up again
+
+    std::thread worker;
+    std::mutex mutex;                       // ready, pendingCount, stats.preprocessTime
+    std::vector<PreprocessedVariant *> ready; // from the worker to the GL thread
+    unsigned int pendingCount;              // masks the worker hasn't preprocessed yet
+
+    ShaderVariantStats stats;
+};
+
+void initShaderVariants(ShaderVariants & variants, ProgramBuilder & builder, const char * vertexPath, const char * fragmentPath);
+
+// Rebuilds the variants when their files, includes too, are written. Checked by updateShaderVariants.
+void watchShaderVariants(ShaderVariants & variants, FileWatcher & watcher);
+
+// Adds a field of bits to the mask and returns its shift : 1 bit for an on / off switch, more for a count.
+// Before any variant is compiled.
+unsigned int addShaderPermutation(ShaderVariants & variants, const char * name, unsigned int bits = 1);
+
+// "#define name value" in every variant
+void setShaderConstant(ShaderVariants & variants, const char * name, const char * value);
+
+// The bits that set a permutation to value, to OR together into a mask. 0 for unknown names.
+unsigned int shaderVariantMask(const ShaderVariants & variants, const char * name, unsigned int value);
+
+// The defines of a variant, for injectShaderDefines
+void shaderVariantDefines(const ShaderVariants & variants, unsigned int mask, std::vector<std::string> & defines);
+
+// GL thread : the program of a variant, built on first use. Waits for it if it is still building.
+GLuint getShaderVariant(ShaderVariants & variants, unsigned int mask);
+
+// Starts reading and preprocessing these variants on a worker thread. One phase at a time.
+void precompileShaderVariants(ShaderVariants & variants, const std::vector<unsigned int> & masks);
+
+// Every combination of the permutations
+void allShaderVariantMasks(const ShaderVariants & variants, std::vector<unsigned int> & masks);
+
+// GL thread, once per frame, after updateProgramBuilder : issues the builds of at most maxPrograms of the variants
+// the worker has preprocessed, takes the programs that are done, starts the reloads.
+// Returns how many variants of the precompile phase aren't built yet.
+unsigned int updateShaderVariants(ShaderVariants & variants, unsigned int maxPrograms);
+
+void printShaderVariantStats(ShaderVariants & variants);
+
+// Waits for the worker and the builds, and deletes the programs
+void cleanupShaderVariants(ShaderVariants & variants);
+
+#endif
@@ -1,5 +1,9 @@
 #include <vector>
+#include <math.h>
+#include <algorithm>
 #include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_precision.hpp>
 
 #include "tangentspace.hpp"
 
@@ -70,4 +74,81 @@ void computeTangentBasis(
 
 }
 
+// Smallest |w| that snorm16 keeps apart from 0
+static const float QTANGENT_BIAS = 1.0f / 32767.0f;
+
+// Normal, Gram-Schmidt tangent, and the handedness of the bitangent.
+// Degenerate UVs give no tangent : any one perpendicular to the normal will do.
+static float orthonormalFrame(glm::vec3 normal, glm::vec3 tangent, const glm::vec3 & bitangent, glm::vec3 & n, glm::vec3 & t){
+	n = glm::normalize(normal);
+	t = tangent - n * glm::dot(n, tangent);
+	float length2 = glm::dot(t, t);
+	if (!(length2 > 1e-12f * glm::dot(tangent, tangent)))
+		t = glm::cross(fabsf(n.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0), n);
+	// A tangent almost along the normal loses most of its bits in the subtraction : a second pass removes what is left
+	t = glm::normalize(t);
+	t = glm::normalize(t - n * glm::dot(n, t));
+	return glm::dot(glm::cross(n, t), bitangent) < 0.0f ? -1.0f : 1.0f;
+}
+
+static short toSnorm16(float x){
+	return (short)std::min(32767.0f, std::max(-32767.0f, floorf(x * 32767.0f + 0.5f)));
+}
+
+void packQTangents(
+	const std::vector<glm::vec3> & normals,
+	const std::vector<glm::vec3> & tangents,
+	const std::vector<glm::vec3> & bitangents,
+	std::vector<glm::i16vec4> & qtangents
+){
+	qtangents.resize(normals.size());
+	for (unsigned int i=0; i<normals.size(); i++){
+		glm::vec3 n, t;
+		float handedness = orthonormalFrame(normals[i], tangents[i], bitangents[i], n, t);
+
+		// Columns : x -> tangent, y -> bitangent, z -> normal. Always a rotation, the reflection is in the sign.
+		glm::quat q = glm::normalize(glm::quat_cast(glm::mat3(t, glm::cross(n, t), n)));
+		if (q.w < 0.0f)
+			q = -q;
+		if (q.w < QTANGENT_BIAS){
+			float scale = sqrtf(1.0f - QTANGENT_BIAS * QTANGENT_BIAS) / sqrtf(q.x * q.x + q.y * q.y + q.z * q.z);
+			q = glm::quat(QTANGENT_BIAS, q.x * scale, q.y * scale, q.z * scale);
+		}
+		if (handedness < 0.0f)
+			q = -q;
+
+		qtangents[i] = glm::i16vec4(toSnorm16(q.x), toSnorm16(q.y), toSnorm16(q.z), toSnorm16(q.w));
+	}
+}
+
+void unpackQTangent(const glm::i16vec4 & qtangent, glm::vec3 & normal, glm::vec3 & tangent, glm::vec3 & bitangent){
+	glm::vec4 q = glm::normalize(glm::max(glm::vec4(qtangent) / 32767.0f, glm::vec4(-1.0f)));
+	float handedness = q.w < 0.0f ? -1.0f : 1.0f;
+	tangent = glm::vec3(1.0f - 2.0f * (q.y * q.y + q.z * q.z), 2.0f * (q.x * q.y + q.w * q.z), 2.0f * (q.x * q.z - q.w * q.y));
+	normal  = glm::vec3(2.0f * (q.x * q.z + q.w * q.y), 2.0f * (q.y * q.z - q.w * q.x), 1.0f - 2.0f * (q.x * q.x + q.y * q.y));
+	bitangent = glm::cross(normal, tangent) * handedness;
+}
+
+// atan2 rather than acos, which can't resolve small angles in float
+static float angleDegrees(const glm::vec3 & a, const glm::vec3 & b){
+	return atan2f(glm::length(glm::cross(a, b)), glm::dot(a, b)) * 57.2957795f;
+}
 
+float qtangentError(
+	const std::vector<glm::vec3> & normals,
+	const std::vector<glm::vec3> & tangents,
+	const std::vector<glm::vec3> & bitangents,
+	const std::vector<glm::i16vec4> & qtangents
+){
+	float worst = 0.0f;
+	for (unsigned int i=0; i<qtangents.size(); i++){
+		glm::vec3 n, t;
+		float handedness = orthonormalFrame(normals[i], tangents[i], bitangents[i], n, t);
+		glm::vec3 b = glm::cross(n, t) * handedness;
+
+		glm::vec3 dn, dt, db;
+		unpackQTangent(qtangents[i], dn, dt, db);
+		worst = std::max(worst, std::max(angleDegrees(n, dn), std::max(angleDegrees(t, dt), angleDegrees(b, db))));
+	}
+	return worst;
+}
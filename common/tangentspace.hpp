@@ -1,6 +1,8 @@
 #ifndef TANGENTSPACE_HPP
 #define TANGENTSPACE_HPP
 
+#include <glm/gtc/type_precision.hpp>
+
 void computeTangentBasis(
 	// inputs
 	std::vector<glm::vec3> & vertices,
@@ -11,5 +13,27 @@ void computeTangentBasis(
 	std::vector<glm::vec3> & bitangents
 );
 
+// QTangents : the whole tangent frame as one quaternion in 4 x snorm16, 8 bytes instead of 36.
+// The quaternion rotates x, y, z to the tangent, the bitangent and the normal. The frame is made
+// orthonormal first, so the bitangent is cross(normal, tangent), and its sign is stored as the sign of w
+// (q and -q being the same rotation). w is kept away from 0 so that snorm16 never loses that sign.
+// Upload as 4 x GL_SHORT normalized : VertexShader.vert decodes them when QTANGENT is defined to 1.
+void packQTangents(
+	const std::vector<glm::vec3> & normals,
+	const std::vector<glm::vec3> & tangents,
+	const std::vector<glm::vec3> & bitangents,
+	std::vector<glm::i16vec4> & qtangents
+);
+
+// Same decode as the shader
+void unpackQTangent(const glm::i16vec4 & qtangent, glm::vec3 & normal, glm::vec3 & tangent, glm::vec3 & bitangent);
+
+// Largest angle, in degrees, between the decoded frames and the orthonormalized float ones
+float qtangentError(
+	const std::vector<glm::vec3> & normals,
+	const std::vector<glm::vec3> & tangents,
+	const std::vector<glm::vec3> & bitangents,
+	const std::vector<glm::i16vec4> & qtangents
+);
 
 #endif
\ No newline at end of file
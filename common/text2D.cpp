@@ -1,4 +1,5 @@
 #include <vector>
+#include <string.h>
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
@@ -7,7 +8,11 @@ using namespace glm;
 #include "shader.hpp"
 #include "texture.hpp"
 
+#include "gpuresources.hpp"
+#include "memory.hpp"
+#include "trace.hpp"
 #include "text2D.hpp"
+#include "glcapture.hpp"
 
 int width;
 int height;
@@ -28,8 +33,8 @@ void initText2D(const char * texturePath, int winWidth, int winHeight){
 	Text2DTextureID = loadDDS(texturePath);
 
 	// Initialize VBO
-	glGenBuffers(1, &Text2DVertexBufferID);
-	glGenBuffers(1, &Text2DUVBufferID);
+	Text2DVertexBufferID = createGPUResource(GPU_BUFFER, "text2D vertices");
+	Text2DUVBufferID = createGPUResource(GPU_BUFFER, "text2D uvs");
 
 	// Initialize Shader
 	Text2DShaderID = LoadShaders("shaders/TextVertexShader.vert", "shaders/TextVertexShader.frag");
@@ -39,13 +44,8 @@ void initText2D(const char * texturePath, int winWidth, int winHeight){
     Text2DScaleID = glGetUniformLocation(Text2DShaderID, "text2D_size");
 }
 
-void printText2D(const char * text, int x, int y, int size){
-
-	unsigned int length = strlen(text);
+void buildText2DQuads(const char * text, unsigned int length, int x, int y, int size, glm::vec2 * vertices, glm::vec2 * UVs){
 
-	// Fill buffers
-	std::vector<glm::vec2> vertices;
-	std::vector<glm::vec2> UVs;
 	for ( unsigned int i=0 ; i<length ; i++ ){
 		
 		glm::vec2 vertex_up_left    = glm::vec2( x+i*size     , y+size );
@@ -53,13 +53,14 @@ void printText2D(const char * text, int x, int y, int size){
 		glm::vec2 vertex_down_right = glm::vec2( x+i*size+size, y      );
 		glm::vec2 vertex_down_left  = glm::vec2( x+i*size     , y      );
 
-		vertices.push_back(vertex_up_left   );
-		vertices.push_back(vertex_down_left );
-		vertices.push_back(vertex_up_right  );
+		glm::vec2 * v = vertices + i*6;
+		v[0] = vertex_up_left;
+		v[1] = vertex_down_left;
+		v[2] = vertex_up_right;
 
-		vertices.push_back(vertex_down_right);
-		vertices.push_back(vertex_up_right);
-		vertices.push_back(vertex_down_left);
+		v[3] = vertex_down_right;
+		v[4] = vertex_up_right;
+		v[5] = vertex_down_left;
 
 		char character = text[i];
 		float uv_x = (character%16)/16.0f;
@@ -69,18 +70,35 @@ void printText2D(const char * text, int x, int y, int size){
 		glm::vec2 uv_up_right   = glm::vec2( uv_x+1.0f/16.0f, uv_y );
 		glm::vec2 uv_down_right = glm::vec2( uv_x+1.0f/16.0f, (uv_y + 1.0f/16.0f) );
 		glm::vec2 uv_down_left  = glm::vec2( uv_x           , (uv_y + 1.0f/16.0f) );
-		UVs.push_back(uv_up_left   );
-		UVs.push_back(uv_down_left );
-		UVs.push_back(uv_up_right  );
-
-		UVs.push_back(uv_down_right);
-		UVs.push_back(uv_up_right);
-		UVs.push_back(uv_down_left);
+		glm::vec2 * uv = UVs + i*6;
+		uv[0] = uv_up_left;
+		uv[1] = uv_down_left;
+		uv[2] = uv_up_right;
+
+		uv[3] = uv_down_right;
+		uv[4] = uv_up_right;
+		uv[5] = uv_down_left;
 	}
+}
+
+void printText2D(const char * text, int x, int y, int size){
+	TRACE_ZONE("printText2D");
+
+	unsigned int length = strlen(text);
+	if (length == 0)
+		return;
+
+	// Fill buffers. They only live until glBufferData : per frame memory.
+	FrameAllocatorAdaptor<glm::vec2> frame(&frameMemory());
+	std::vector<glm::vec2, FrameAllocatorAdaptor<glm::vec2> > vertices(length * 6, glm::vec2(), frame);
+	std::vector<glm::vec2, FrameAllocatorAdaptor<glm::vec2> > UVs(length * 6, glm::vec2(), frame);
+	buildText2DQuads(text, length, x, y, size, &vertices[0], &UVs[0]);
 	glBindBuffer(GL_ARRAY_BUFFER, Text2DVertexBufferID);
 	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec2), &vertices[0], GL_STATIC_DRAW);
+	setGPUResourceBytes(GPU_BUFFER, Text2DVertexBufferID, vertices.size() * sizeof(glm::vec2));
 	glBindBuffer(GL_ARRAY_BUFFER, Text2DUVBufferID);
 	glBufferData(GL_ARRAY_BUFFER, UVs.size() * sizeof(glm::vec2), &UVs[0], GL_STATIC_DRAW);
+	setGPUResourceBytes(GPU_BUFFER, Text2DUVBufferID, UVs.size() * sizeof(glm::vec2));
 
 	// Bind shader
 	glUseProgram(Text2DShaderID);
@@ -118,12 +136,12 @@ void printText2D(const char * text, int x, int y, int size){
 void cleanupText2D(){
 
 	// Delete buffers
-	glDeleteBuffers(1, &Text2DVertexBufferID);
-	glDeleteBuffers(1, &Text2DUVBufferID);
+	deleteGPUResource(GPU_BUFFER, Text2DVertexBufferID);
+	deleteGPUResource(GPU_BUFFER, Text2DUVBufferID);
 
 	// Delete texture
-	glDeleteTextures(1, &Text2DTextureID);
+	deleteGPUResource(GPU_TEXTURE, Text2DTextureID);
 
 	// Delete shader
-	glDeleteProgram(Text2DShaderID);
+	deleteGPUResource(GPU_PROGRAM, Text2DShaderID);
 }
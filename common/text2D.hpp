@@ -1,8 +1,13 @@
 #ifndef TEXT2D_HPP
 #define TEXT2D_HPP
 
+#include <glm/glm.hpp>
+
 void initText2D(const char * texturePath, int winWidth, int winHeight);
 void printText2D(const char * text, int x, int y, int size);
+// The two triangles of each character, in pixels, with their UVs in the 16x16 characters texture.
+// Writes length * 6 vertices and UVs.
+void buildText2DQuads(const char * text, unsigned int length, int x, int y, int size, glm::vec2 * vertices, glm::vec2 * UVs);
 void cleanupText2D();
 
 #endif
\ No newline at end of file
@@ -1,11 +1,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <vector>
+#include <thread>
+#include <algorithm>
 
 #include <GL/glew.h>
 
 #include <GLFW/glfw3.h>
 
+#include "dds.hpp"
+#include "bcencode.hpp"
+#include "gpuresources.hpp"
+#include "trace.hpp"
+#include "glcapture.hpp"
+
 
 GLuint loadBMP_custom(const char * imagepath){
 
@@ -65,14 +74,14 @@ GLuint loadBMP_custom(const char * imagepath){
 	fclose (file);
 
 	// Create one OpenGL texture
-	GLuint textureID;
-	glGenTextures(1, &textureID);
+	GLuint textureID = createGPUResource(GPU_TEXTURE, imagepath);
 	
 	// "Bind" the newly created texture : all future texture functions will modify this texture
 	glBindTexture(GL_TEXTURE_2D, textureID);
 
 	// Give the image to OpenGL
 	glTexImage2D(GL_TEXTURE_2D, 0,GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
+	setGPUResourceBytes(GPU_TEXTURE, textureID, gpuTextureBytes(GL_RGB8, width, height, 1, 0)); // with the mipmaps below
 
 	// OpenGL has now copied the data. Free our own version
 	delete [] data;
@@ -93,6 +102,29 @@ GLuint loadBMP_custom(const char * imagepath){
 	return textureID;
 }
 
+GLuint loadBMP_compressed(const char * imagepath){
+
+	printf("Reading image %s\n", imagepath);
+
+	// Same file as loadBMP_custom, in RGBA
+	unsigned int width, height;
+	std::vector<unsigned char> rgba;
+	if (!readBMP(imagepath, width, height, rgba))
+		return 0;
+
+	// Mipmaps filtered on the CPU and compressed to DXT1 : 8 times smaller than the RGB texture, which is stored as RGBA
+	DDSImage image;
+	std::vector<unsigned char> data;
+	BCEncodeStats stats;
+	unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+	if (!compressImage(&rgba[0], width, height, BC_FORMAT_BC1, threads, image, data, stats))
+		return 0;
+	printBCEncodeStats(imagepath, stats);
+
+	// Same upload as a .DDS file
+	return uploadDDS(image, &data[0], imagepath);
+}
+
 // Since GLFW 3, glfwLoadTexture2D() has been removed. You have to use another texture loading library, 
 // or do it yourself (just like loadBMP_custom and loadDDS)
 //GLuint loadTGA_glfw(const char * imagepath){
@@ -120,99 +152,28 @@ GLuint loadBMP_custom(const char * imagepath){
 
 
 
-#define FOURCC_DXT1 0x31545844 // Equivalent to "DXT1" in ASCII
-#define FOURCC_DXT3 0x33545844 // Equivalent to "DXT3" in ASCII
-#define FOURCC_DXT5 0x35545844 // Equivalent to "DXT5" in ASCII
-
 GLuint loadDDS(const char * imagepath){
+	TRACE_ZONE("loadDDS");
 
-	unsigned char header[124];
-
-	FILE *fp; 
- 
-	/* try to open the file */ 
-	fp = fopen(imagepath, "rb"); 
-	if (fp == NULL){
+	/* map the file : the data goes straight from there to OpenGL */ 
+	MappedFile file;
+	if (!mapFile(imagepath, file)){
 		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath); getchar(); 
 		return 0;
 	}
-   
-	/* verify the type of file */ 
-	char filecode[4]; 
-	fread(filecode, 1, 4, fp); 
-	if (strncmp(filecode, "DDS ", 4) != 0) { 
-		fclose(fp); 
-		return 0; 
-	}
-	
-	/* get the surface desc */ 
-	fread(&header, 124, 1, fp); 
-
-	unsigned int height      = *(unsigned int*)&(header[8 ]);
-	unsigned int width	     = *(unsigned int*)&(header[12]);
-	unsigned int linearSize	 = *(unsigned int*)&(header[16]);
-	unsigned int mipMapCount = *(unsigned int*)&(header[24]);
-	unsigned int fourCC      = *(unsigned int*)&(header[80]);
-
- 
-	unsigned char * buffer;
-	unsigned int bufsize;
-	/* how big is it going to be including all mipmaps? */ 
-	bufsize = mipMapCount > 1 ? linearSize * 2 : linearSize; 
-	buffer = (unsigned char*)malloc(bufsize * sizeof(unsigned char)); 
-	fread(buffer, 1, bufsize, fp); 
-	/* close the file pointer */ 
-	fclose(fp);
-
-	unsigned int components  = (fourCC == FOURCC_DXT1) ? 3 : 4; 
-	unsigned int format;
-	switch(fourCC) 
-	{ 
-	case FOURCC_DXT1: 
-		format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; 
-		break; 
-	case FOURCC_DXT3: 
-		format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT; 
-		break; 
-	case FOURCC_DXT5: 
-		format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; 
-		break; 
-	default: 
-		free(buffer); 
-		return 0; 
-	}
-
-	// Create one OpenGL texture
-	GLuint textureID;
-	glGenTextures(1, &textureID);
-
-	// "Bind" the newly created texture : all future texture functions will modify this texture
-	glBindTexture(GL_TEXTURE_2D, textureID);
-	glPixelStorei(GL_UNPACK_ALIGNMENT,1);	
-	
-	unsigned int blockSize = (format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) ? 8 : 16; 
-	unsigned int offset = 0;
-
-	/* load the mipmaps */ 
-	for (unsigned int level = 0; level < mipMapCount && (width || height); ++level) 
-	{ 
-		unsigned int size = ((width+3)/4)*((height+3)/4)*blockSize; 
-		glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height,  
-			0, size, buffer + offset); 
-	 
-		offset += size; 
-		width  /= 2; 
-		height /= 2; 
 
-		// Deal with Non-Power-Of-Two textures. This code is not included in the webpage to reduce clutter.
-		if(width < 1) width = 1;
-		if(height < 1) height = 1;
+	/* validate the header(s) and find every mipmap, face and layer */ 
+	DDSImage image;
+	const char * error;
+	if (!parseDDS(file.data, file.size, image, &error)){
+		printf("%s : %s\n", imagepath, error);
+		unmapFile(file);
+		return 0;
+	}
 
-	} 
+	GLuint textureID = uploadDDS(image, file.data, imagepath);
 
-	free(buffer); 
+	unmapFile(file);
 
 	return textureID;
-
-
-}
\ No newline at end of file
+}
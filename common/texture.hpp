@@ -4,12 +4,17 @@
 // Load a .BMP file using our custom loader
 GLuint loadBMP_custom(const char * imagepath);
 
+// Load a .BMP file, with its mipmaps built on the CPU and compressed to DXT1.
+// Same orientation as loadBMP_custom. Offline, compressBMP writes the same texture as a .DDS file.
+GLuint loadBMP_compressed(const char * imagepath);
+
 //// Since GLFW 3, glfwLoadTexture2D() has been removed. You have to use another texture loading library, 
 //// or do it yourself (just like loadBMP_custom and loadDDS)
 //// Load a .TGA file using GLFW's own loader
 //GLuint loadTGA_glfw(const char * imagepath);
 
-// Load a .DDS file using GLFW's own loader
+// Load a .DDS file : DXT1/3/5, BC4/5/6H/7 and a few uncompressed formats, legacy or DX10 header.
+// Cubemaps, arrays and 3D textures are bound to their own target instead of GL_TEXTURE_2D.
 GLuint loadDDS(const char * imagepath);
 
 
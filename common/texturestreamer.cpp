@@ -0,0 +1,345 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include <GL/glew.h>
+
+#include "texturestreamer.hpp"
+#include "bcdecode.hpp"
+#include "gpuresources.hpp"
+#include "glcapture.hpp"
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start){
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static unsigned int readUint(const MappedFile & file, size_t offset){
+    unsigned int value;
+    memcpy(&value, file.data + offset, 4);
+    return value;
+}
+
+// 2D textures only : exact mip sizes come from the DDS parser
+static bool parseStreamedDDS(StreamedTexture & texture, const DDSSupport & support){
+    DDSImage image;
+    const char * error;
+    if (!parseDDS(texture.file.data, texture.file.size, image, &error) || image.target != GL_TEXTURE_2D)
+        return false;
+
+    // Decoded here rather than on the GL thread : this worker is already one of several
+    if (!ddsFormatSupported(support, image.internalFormat)){
+        DDSImage decoded;
+        if (!decodeDDSImage(image, texture.file.data, decoded, texture.decoded, 1))
+            return false;
+        image = decoded;
+    }
+
+    texture.compressed = image.compressed;
+    texture.format = image.internalFormat;
+    texture.pixelFormat = image.format;
+    texture.pixelType = image.type;
+    texture.unpackAlignment = 1;
+    texture.mips.clear();
+    for (size_t i=0; i<image.surfaces.size(); i++){
+        const DDSSurface & surface = image.surfaces[i];
+        StreamedMip mip = { surface.offset, surface.size, surface.width, surface.height };
+        texture.mips.push_back(mip);
+    }
+    return true;
+}
+
+// Same checks as loadBMP_custom. Rows are padded to 4 bytes, like GL_UNPACK_ALIGNMENT 4.
+static bool parseBMP(StreamedTexture & texture){
+    const MappedFile & file = texture.file;
+    if (file.size < 54 || file.data[0] != 'B' || file.data[1] != 'M')
+        return false;
+    if (readUint(file, 0x1E) != 0 || (readUint(file, 0x1C) & 0xFFFF) != 24)
+        return false;
+
+    unsigned int dataPos = readUint(file, 0x0A);
+    unsigned int width   = readUint(file, 0x12);
+    unsigned int height  = readUint(file, 0x16);
+    if (dataPos == 0) dataPos = 54;
+    if (width == 0 || height == 0 || width > 16384 || height > 16384)
+        return false;
+
+    StreamedMip mip;
+    mip.width = width;
+    mip.height = height;
+    mip.offset = dataPos;
+    mip.size = (size_t)((width * 3 + 3) & ~3u) * height;
+    if (mip.offset + mip.size > file.size)
+        return false;
+
+    texture.compressed = false;
+    texture.format = GL_RGB;
+    texture.pixelFormat = GL_BGR;
+    texture.pixelType = GL_UNSIGNED_BYTE;
+    texture.unpackAlignment = 4;
+    texture.mips.assign(1, mip);
+    return true;
+}
+
+static void streamerWorker(TextureStreamer * streamer){
+    for (;;){
+        StreamedTexture * texture;
+        {
+            std::unique_lock<std::mutex> lock(streamer->mutex);
+            streamer->wake.wait(lock, [streamer]{ return streamer->quit || !streamer->requests.empty(); });
+            if (streamer->quit)
+                return;
+            texture = streamer->requests.front();
+            streamer->requests.pop_front();
+        }
+
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        bool ok = mapFile(texture->path.c_str(), texture->file);
+        if (ok){
+            const char * extension = strrchr(texture->path.c_str(), '.');
+            bool dds = extension != NULL && (strcmp(extension, ".dds") == 0 || strcmp(extension, ".DDS") == 0);
+            ok = dds ? parseStreamedDDS(*texture, streamer->support) : parseBMP(*texture);
+        }
+        if (ok){
+            texture->state = TEXTURE_LOADED;
+            texture->nextMip = (int)texture->mips.size() - 1;
+        }
+        else {
+            printf("%s could not be streamed\n", texture->path.c_str());
+            texture->state = TEXTURE_FAILED;
+            unmapFile(texture->file);
+        }
+
+        std::lock_guard<std::mutex> lock(streamer->mutex);
+        streamer->loaded.push_back(texture);
+        streamer->stats.loadTime += elapsedMs(start);
+    }
+}
+
+void initTextureStreamer(TextureStreamer & streamer, unsigned int workerCount, size_t bytesPerFrame, unsigned int pboCount){
+    streamer.bytesPerFrame = bytesPerFrame;
+    queryDDSSupport(streamer.support);
+    streamer.hitchMs = 2.0;
+    streamer.quit = false;
+    streamer.pendingCount = 0;
+    memset(&streamer.stats, 0, sizeof(streamer.stats));
+
+    streamer.pbos.resize(std::max(1u, pboCount));
+    for (size_t i=0; i<streamer.pbos.size(); i++)
+        streamer.pbos[i] = createGPUResource(GPU_BUFFER, "texture streamer PBO");
+    streamer.nextPbo = 0;
+
+    for (unsigned int i=0; i<std::max(1u, workerCount); i++)
+        streamer.workers.push_back(std::thread(streamerWorker, &streamer));
+}
+
+GLuint requestTexture(TextureStreamer & streamer, const char * imagepath){
+    // Placeholder : 2x2 grey checker, complete on its own
+    const unsigned char placeholder[16] = {
+        96, 96, 96, 255,   160, 160, 160, 255,
+        160, 160, 160, 255,   96, 96, 96, 255
+    };
+    GLuint textureID = createGPUResource(GPU_TEXTURE, imagepath);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+    setGPUResourceBytes(GPU_TEXTURE, textureID, sizeof(placeholder));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+    StreamedTexture * texture = new StreamedTexture();
+    texture->path = imagepath;
+    texture->texture = textureID;
+    texture->state = TEXTURE_QUEUED;
+    texture->compressed = false;
+    texture->format = texture->pixelFormat = texture->pixelType = 0;
+    texture->unpackAlignment = 1;
+    texture->file.data = NULL;
+    texture->file.size = 0;
+    texture->nextMip = -1;
+    streamer.textures.push_back(texture);
+    streamer.pendingCount++;
+
+    {
+        std::lock_guard<std::mutex> lock(streamer.mutex);
+        streamer.requests.push_back(texture);
+    }
+    streamer.wake.notify_one();
+    return textureID;
+}
+
+// Copies one mip to the next buffer of the ring, and uploads it from there.
+// Orphaning the buffer means we never wait for the GPU to be done with its previous upload.
+// False if the buffer couldn't be filled : nothing is uploaded then.
+static bool uploadMip(TextureStreamer & streamer, StreamedTexture & texture){
+    int level = texture.nextMip;
+    const StreamedMip & mip = texture.mips[level];
+
+    GLuint pbo = streamer.pbos[streamer.nextPbo];
+    streamer.nextPbo = (streamer.nextPbo + 1) % streamer.pbos.size();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, mip.size, NULL, GL_STREAM_DRAW);
+    setGPUResourceBytes(GPU_BUFFER, pbo, mip.size);
+    void * dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, mip.size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (dst == NULL){
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return false;
+    }
+    const unsigned char * src = texture.decoded.empty() ? texture.file.data : &texture.decoded[0];
+    memcpy(dst, src + mip.offset, mip.size);
+    // GL_FALSE : the buffer was lost while mapped (display mode change...), its contents are undefined
+    if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) != GL_TRUE){
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        return false;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, texture.unpackAlignment);
+    if (texture.compressed)
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, texture.format, mip.width, mip.height, 0, (GLsizei)mip.size, (void*)0);
+    else
+        glTexImage2D(GL_TEXTURE_2D, level, texture.format, mip.width, mip.height, 0, texture.pixelFormat, texture.pixelType, (void*)0);
+
+    // Only sample the levels that are there : [level, smallest]
+    if (level == (int)texture.mips.size() - 1)
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+
+    // Resident : the levels uploaded so far, and the placeholder in level 0 until the real one replaces it
+    size_t resident = level > 0 ? 16 : 0;
+    for (size_t l=level; l<texture.mips.size(); l++)
+        resident += texture.mips[l].size;
+    setGPUResourceBytes(GPU_TEXTURE, texture.texture, resident);
+
+    streamer.stats.uploads++;
+    streamer.stats.uploadedBytes += mip.size;
+    texture.nextMip--;
+    return true;
+}
+
+// Keeps the levels uploaded so far, or the placeholder
+static void failTexture(TextureStreamer & streamer, StreamedTexture & texture){
+    printf("%s : mip %d could not be uploaded\n", texture.path.c_str(), texture.nextMip);
+    texture.state = TEXTURE_FAILED;
+    unmapFile(texture.file);
+    std::vector<unsigned char>().swap(texture.decoded);
+    streamer.pendingCount--;
+}
+
+static void finishTexture(TextureStreamer & streamer, StreamedTexture & texture){
+    // A .BMP only has its first level
+    if (texture.mips.size() == 1 && !texture.compressed){
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        setGPUResourceBytes(GPU_TEXTURE, texture.texture, gpuTextureBytes(texture.format, texture.mips[0].width, texture.mips[0].height, 1, 0));
+    }
+    texture.state = TEXTURE_RESIDENT;
+    unmapFile(texture.file);
+    std::vector<unsigned char>().swap(texture.decoded);
+    streamer.pendingCount--;
+}
+
+void updateTextureStreamer(TextureStreamer & streamer){
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    {
+        std::lock_guard<std::mutex> lock(streamer.mutex);
+        for (size_t i=0; i<streamer.loaded.size(); i++){
+            StreamedTexture * texture = streamer.loaded[i];
+            if (texture->state == TEXTURE_FAILED) streamer.pendingCount--;
+            else streamer.uploading.push_back(texture);
+        }
+        streamer.loaded.clear();
+    }
+
+    // Smallest pending mip first, over all textures, until the budget is spent.
+    // The first upload of a frame is always allowed, otherwise a mip bigger than the budget would never go.
+    size_t budget = streamer.bytesPerFrame;
+    bool uploaded = false;
+    while (!streamer.uploading.empty()){
+        size_t best = 0;
+        for (size_t i=1; i<streamer.uploading.size(); i++){
+            const StreamedTexture & t = *streamer.uploading[i];
+            if (t.mips[t.nextMip].size < streamer.uploading[best]->mips[streamer.uploading[best]->nextMip].size)
+                best = i;
+        }
+        StreamedTexture & texture = *streamer.uploading[best];
+        size_t size = texture.mips[texture.nextMip].size;
+        if (uploaded && size > budget)
+            break;
+
+        uploaded = true;
+        if (!uploadMip(streamer, texture)){
+            failTexture(streamer, texture);
+            streamer.uploading.erase(streamer.uploading.begin() + best);
+            continue;
+        }
+        budget -= std::min(budget, size);
+
+        if (texture.nextMip < 0){
+            finishTexture(streamer, texture);
+            streamer.uploading.erase(streamer.uploading.begin() + best);
+        }
+    }
+    if (uploaded)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    double time = elapsedMs(start);
+    streamer.stats.uploadTime += time;
+    if (time > streamer.hitchMs)
+        streamer.stats.hitches++;
+    streamer.stats.frames++;
+}
+
+unsigned int pendingTextureCount(const TextureStreamer & streamer){
+    return streamer.pendingCount;
+}
+
+void printTextureStreamerStats(TextureStreamer & streamer){
+    TextureStreamerStats & s = streamer.stats;
+    double loadTime;
+    {
+        std::lock_guard<std::mutex> lock(streamer.mutex);
+        loadTime = s.loadTime;
+        s.loadTime = 0.0;
+    }
+    if (s.uploads > 0 || streamer.pendingCount > 0){
+        printf("Textures : %u mips, %.1f KB uploaded in %.3f ms (%.1f MB/s), load %.3f ms, %u hitches over %u frames, %u pending\n",
+            s.uploads, s.uploadedBytes / 1024.0, s.uploadTime,
+            s.uploadTime > 0.0 ? s.uploadedBytes / (s.uploadTime / 1000.0) / (1024.0 * 1024.0) : 0.0,
+            loadTime, s.hitches, s.frames, streamer.pendingCount);
+    }
+    s.uploads = 0;
+    s.uploadedBytes = 0;
+    s.uploadTime = 0.0;
+    s.hitches = 0;
+    s.frames = 0;
+}
+
+void cleanupTextureStreamer(TextureStreamer & streamer){
+    {
+        std::lock_guard<std::mutex> lock(streamer.mutex);
+        streamer.quit = true;
+    }
+    streamer.wake.notify_all();
+    for (size_t i=0; i<streamer.workers.size(); i++)
+        streamer.workers[i].join();
+    streamer.workers.clear();
+
+    for (size_t i=0; i<streamer.pbos.size(); i++)
+        deleteGPUResource(GPU_BUFFER, streamer.pbos[i]);
+    streamer.pbos.clear();
+    for (size_t i=0; i<streamer.textures.size(); i++){
+        unmapFile(streamer.textures[i]->file);
+        delete streamer.textures[i];
+    }
+    streamer.textures.clear();
+    streamer.uploading.clear();
+    streamer.loaded.clear();
+    streamer.requests.clear();
+}
@@ -0,0 +1,92 @@
+#ifndef TEXTURESTREAMER_HPP
+#define TEXTURESTREAMER_HPP
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <GL/glew.h>
+
+#include "dds.hpp"
+
+enum StreamedTextureState {
+    TEXTURE_QUEUED,    // waiting for a worker
+    TEXTURE_LOADED,    // in memory, mips being uploaded
+    TEXTURE_RESIDENT,  // all mips on the GPU
+    TEXTURE_FAILED     // keeps its placeholder, or the levels uploaded before the failure
+};
+
+struct StreamedMip {
+    size_t offset, size; // in StreamedTexture::file, or in decoded
+    unsigned int width, height;
+};
+
+struct StreamedTexture {
+    std::string path;
+    GLuint texture;
+    int state; // set by the worker until it hands the texture over, then by the GL thread
+
+    // Filled by a worker, then only used by the GL thread
+    bool compressed;
+    GLenum format;       // internal format
+    GLenum pixelFormat, pixelType; // when not compressed
+    int unpackAlignment;
+    MappedFile file; // mapped by the worker, unmapped once resident
+    std::vector<unsigned char> decoded; // RGBA8 levels, when the GPU can't sample the format of the file
+    std::vector<StreamedMip> mips;
+    int nextMip;      // next level to upload : from the smallest one down to 0
+};
+
+struct TextureStreamerStats {
+    unsigned int uploads;   // mip levels
+    size_t uploadedBytes;
+    double uploadTime;      // ms spent in updateTextureStreamer
+    double loadTime;        // ms spent by the workers reading files
+    unsigned int hitches;   // updates longer than hitchMs
+    unsigned int frames;
+};
+
+// Placeholders right away, files read by worker threads,
+// then a few mip levels per frame through a ring of pixel unpack buffers.
+struct TextureStreamer {
+    size_t bytesPerFrame;  // upload budget
+    DDSSupport support;    // queried on the GL thread, read by the workers
+    double hitchMs;
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;      // requests, loaded, quit, stats.loadTime
+    std::condition_variable wake;
+    bool quit;
+    std::deque<StreamedTexture *> requests; // to the workers
+    std::vector<StreamedTexture *> loaded;  // to the GL thread
+
+    std::vector<StreamedTexture *> textures;  // all of them
+    std::vector<StreamedTexture *> uploading; // GL thread only
+    unsigned int pendingCount; // GL thread only : neither resident nor failed
+    std::vector<GLuint> pbos;
+    unsigned int nextPbo;
+
+    TextureStreamerStats stats; // since the last print
+};
+
+void initTextureStreamer(TextureStreamer & streamer, unsigned int workerCount, size_t bytesPerFrame, unsigned int pboCount);
+
+// Returns a texture that can be used right away : a tiny placeholder until the real mips arrive.
+// 2D .DDS files (see loadDDS for the formats) and 24 bits .BMP files are supported.
+// BC1-5 files the GPU can't sample are decoded to RGBA8 by the worker.
+GLuint requestTexture(TextureStreamer & streamer, const char * imagepath);
+
+// GL thread, once per frame : uploads pending mips, smallest first, within the byte budget
+void updateTextureStreamer(TextureStreamer & streamer);
+
+// Number of textures that aren't resident yet
+unsigned int pendingTextureCount(const TextureStreamer & streamer);
+
+void printTextureStreamerStats(TextureStreamer & streamer);
+
+// Stops the workers and frees the buffers. The textures themselves belong to the caller.
+void cleanupTextureStreamer(TextureStreamer & streamer);
+
+#endif
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <thread>
+
+#include "trace.hpp"
+
+static const unsigned int MAX_TRACE_THREADS = 256;
+
+TraceState traceGlobalState;
+thread_local TraceBuffer * traceThreadBuffer = NULL;
+thread_local unsigned int traceThreadGeneration = 0;
+
+// Buffers stay after their thread ends, until cleanupTrace : their events are still exported.
+// A slot is counted before its buffer is stored : readers skip the ones still NULL.
+static std::atomic<TraceBuffer *> buffers[MAX_TRACE_THREADS];
+static std::atomic<unsigned int> bufferCount(0);
+
+// Shared by threads past MAX_TRACE_THREADS. Without events, traceEvent only counts theirs : nothing else is written to it.
+static TraceBuffer overflowBuffer;
+
+void initTrace(unsigned int eventsPerThread){
+    unsigned int capacity = 1;
+    while (capacity < eventsPerThread && capacity < (1u << 30))
+        capacity *= 2;
+    traceState().capacity = capacity;
+    traceState().origin = std::chrono::steady_clock::now();
+    traceState().originTicks = traceTime();
+    traceState().enabled = false;
+    overflowBuffer.events = NULL;
+    overflowBuffer.mask = 0;
+    overflowBuffer.written = 0;
+    overflowBuffer.thread = MAX_TRACE_THREADS;
+}
+
+void setTraceEnabled(bool enabled){
+    if (enabled && traceState().capacity == 0){
+        printf("Tracing can't be enabled before initTrace\n");
+        return;
+    }
+    traceState().enabled = enabled;
+}
+
+TraceBuffer & createTraceBuffer(){
+    // Not initialized, or cleaned up under a zone that was still open : counted, not recorded
+    if (traceState().capacity == 0)
+        return overflowBuffer;
+    traceThreadGeneration = traceState().generation.load(std::memory_order_acquire);
+    unsigned int index = bufferCount.fetch_add(1);
+    if (index >= MAX_TRACE_THREADS){
+        bufferCount = MAX_TRACE_THREADS;
+        traceThreadBuffer = &overflowBuffer;
+        return overflowBuffer;
+    }
+    TraceBuffer * buffer = new TraceBuffer();
+    buffer->events = new TraceEvent[traceState().capacity];
+    buffer->mask = traceState().capacity - 1;
+    buffer->written = 0;
+    buffer->thread = index;
+    snprintf(buffer->name, sizeof(buffer->name), "thread %u", index);
+    buffers[index].store(buffer, std::memory_order_release);
+    traceThreadBuffer = buffer;
+    return *buffer;
+}
+
+void setTraceThreadName(const char * name){
+    if (traceState().capacity == 0)
+        return;
+    TraceBuffer & buffer = traceBuffer();
+    if (&buffer != &overflowBuffer)
+        snprintf(buffer.name, sizeof(buffer.name), "%s", name);
+}
+
+// The events of a buffer that are still there : the writer may overwrite the oldest ones while they are copied
+static void copyEvents(TraceBuffer & buffer, std::vector<TraceEvent> & events){
+    unsigned long long capacity = buffer.mask + 1;
+    unsigned long long end = buffer.written.load(std::memory_order_acquire);
+    unsigned long long begin = end > capacity ? end - capacity : 0;
+    events.clear();
+    for (unsigned long long i=begin; i<end; i++)
+        events.push_back(buffer.events[i & buffer.mask]);
+    unsigned long long after = buffer.written.load(std::memory_order_acquire);
+    unsigned long long overwritten = after > capacity ? after - capacity : 0;
+    if (overwritten > begin)
+        events.erase(events.begin(), events.begin() + (size_t)std::min(overwritten - begin, (unsigned long long)events.size()));
+}
+
+// JSON strings : names are literals from the code, only quotes and backslashes need escaping
+static void writeJSONString(FILE * file, const char * text){
+    fputc('"', file);
+    for (const char * c = text; *c; c++){
+        if (*c == '"' || *c == '\\')
+            fputc('\\', file);
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+// Ticks per microsecond, measured against the steady clock over the whole trace
+static double traceTicksPerUs(){
+#ifdef TRACE_TSC
+    double us;
+    unsigned long long ticks;
+    do {
+        us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - traceState().origin).count();
+        ticks = traceTime() - traceState().originTicks;
+        if (us < 10000.0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    } while (us < 10000.0);
+    return ticks / us;
+#else
+    return 1000.0;
+#endif
+}
+
+bool writeChromeTrace(const char * path){
+    FILE * file = fopen(path, "w");
+    if (file == NULL){
+        printf("%s could not be created\n", path);
+        return false;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    unsigned int count = std::min(bufferCount.load(), MAX_TRACE_THREADS);
+    double ticksPerUs = traceTicksPerUs();
+    unsigned long long origin = traceState().originTicks;
+    size_t written = 0;
+    std::vector<TraceEvent> events;
+    const char * separator = "";
+    for (unsigned int b=0; b<count; b++){
+        TraceBuffer * slot = buffers[b].load(std::memory_order_acquire);
+        if (slot == NULL)
+            continue;
+        TraceBuffer & buffer = *slot;
+        fprintf(file, "%s\n{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":", separator, buffer.thread);
+        separator = ",";
+        writeJSONString(file, buffer.name);
+        fprintf(file, "}}");
+
+        copyEvents(buffer, events);
+        for (size_t i=0; i<events.size(); i++){
+            const TraceEvent & e = events[i];
+            double ts = e.start >= origin ? (e.start - origin) / ticksPerUs : 0.0;
+            fprintf(file, ",\n{\"name\":");
+            writeJSONString(file, e.name);
+            switch (e.type){
+            case TRACE_EVENT_ZONE:
+                fprintf(file, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f", ts, e.duration / ticksPerUs);
+                break;
+            case TRACE_EVENT_COUNTER:
+                fprintf(file, ",\"ph\":\"C\",\"ts\":%.3f,\"args\":{\"value\":%.9g}", ts, e.value);
+                break;
+            case TRACE_EVENT_FLOW_BEGIN:
+                fprintf(file, ",\"ph\":\"s\",\"cat\":\"flow\",\"id\":%llu,\"ts\":%.3f", e.id, ts);
+                break;
+            default:
+                fprintf(file, ",\"ph\":\"f\",\"bp\":\"e\",\"cat\":\"flow\",\"id\":%llu,\"ts\":%.3f", e.id, ts);
+                break;
+            }
+            fprintf(file, ",\"pid\":1,\"tid\":%u}", buffer.thread);
+        }
+        written += events.size();
+    }
+    fprintf(file, "\n]}\n");
+    bool ok = fclose(file) == 0;
+    printf("Trace : %u events of %u threads written to %s\n", (unsigned int)written, count, path);
+    return ok;
+}
+
+void printTraceStats(){
+    unsigned int count = std::min(bufferCount.load(), MAX_TRACE_THREADS);
+    for (unsigned int b=0; b<count; b++){
+        const TraceBuffer * buffer = buffers[b].load(std::memory_order_acquire);
+        if (buffer == NULL)
+            continue;
+        unsigned long long written = buffer->written.load(std::memory_order_relaxed);
+        unsigned long long capacity = buffer->mask + 1;
+        printf("Trace %-16s : %llu events, %llu overwritten\n", buffer->name, written, written > capacity ? written - capacity : 0);
+    }
+    unsigned long long dropped = overflowBuffer.written.load(std::memory_order_relaxed);
+    if (dropped > 0)
+        printf("Trace : %llu events dropped, of the threads past the first %u\n", dropped, MAX_TRACE_THREADS);
+}
+
+void cleanupTrace(){
+    traceState().enabled = false;
+    traceState().generation.fetch_add(1, std::memory_order_release);
+    unsigned int count = std::min(bufferCount.load(), MAX_TRACE_THREADS);
+    for (unsigned int b=0; b<count; b++){
+        TraceBuffer * buffer = buffers[b].exchange(NULL);
+        if (buffer == NULL)
+            continue;
+        delete[] buffer->events;
+        delete buffer;
+    }
+    bufferCount = 0;
+    traceThreadBuffer = NULL;
+    traceState().capacity = 0;
+}
@@ -0,0 +1,155 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <string.h>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define TRACE_TSC
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define TRACE_TSC
+#endif
+
+// CPU timeline tracing : zones, counters and flows, recorded per thread, exported for chrome://tracing or
+// ui.perfetto.dev. Always compiled in : while disabled, a zone costs one relaxed load and a branch.
+// Every thread writes to its own ring buffer, without locks. When it is full, the oldest events are overwritten.
+// Names are not copied : use string literals.
+// Times are in ticks of the time stamp counter where there is one (a clock read costs several times more), converted on export.
+
+// Not TRACE_ZONE... : those are the macros below
+enum TraceEventType {
+    TRACE_EVENT_ZONE,       // start + duration
+    TRACE_EVENT_COUNTER,    // value at start
+    TRACE_EVENT_FLOW_BEGIN, // arrow from this point...
+    TRACE_EVENT_FLOW_END    // ...to this one, same id, possibly on another thread
+};
+
+struct TraceEvent {
+    const char * name;
+    unsigned long long start; // ticks
+    union {
+        unsigned long long duration;
+        unsigned long long id;
+        double value;
+    };
+    unsigned int type;
+};
+
+struct TraceBuffer {
+    TraceEvent * events;
+    unsigned int mask;                        // capacity - 1, a power of two
+    std::atomic<unsigned long long> written;  // ever, the next one goes to written & mask
+    unsigned int thread;                      // index, the tid of the export
+    char name[32];
+};
+
+struct TraceState {
+    std::atomic<bool> enabled;
+    std::chrono::steady_clock::time_point origin;
+    unsigned long long originTicks;           // traceTime() at origin
+    unsigned int capacity;                    // events per thread
+    std::atomic<unsigned int> generation;     // bumped by cleanupTrace : the buffers of older ones are gone
+};
+
+extern TraceState traceGlobalState;
+inline TraceState & traceState(){
+    return traceGlobalState;
+}
+
+// Events per thread, rounded up to a power of two. Starts disabled.
+void initTrace(unsigned int eventsPerThread = 1 << 16);
+void setTraceEnabled(bool enabled);
+inline bool traceEnabled(){
+    return traceState().enabled.load(std::memory_order_relaxed);
+}
+
+// The name of the calling thread in the exports
+void setTraceThreadName(const char * name);
+
+// Ticks : an invariant time stamp counter, else ns of the steady clock
+inline unsigned long long traceTime(){
+#ifdef TRACE_TSC
+    return __rdtsc();
+#else
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// The calling thread's buffer, created on first use and again after cleanupTrace. Threads past the last buffer
+// all get the same one, which has no events : theirs are only counted.
+extern thread_local TraceBuffer * traceThreadBuffer;
+extern thread_local unsigned int traceThreadGeneration;
+TraceBuffer & createTraceBuffer();
+inline TraceBuffer & traceBuffer(){
+    if (traceThreadBuffer != NULL && traceThreadGeneration == traceState().generation.load(std::memory_order_acquire))
+        return *traceThreadBuffer;
+    return createTraceBuffer();
+}
+
+inline void traceEvent(unsigned int type, const char * name, unsigned long long start, unsigned long long payload){
+    TraceBuffer & buffer = traceBuffer();
+    if (buffer.events == NULL){
+        buffer.written.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    unsigned long long index = buffer.written.load(std::memory_order_relaxed);
+    TraceEvent & event = buffer.events[index & buffer.mask];
+    event.name = name;
+    event.start = start;
+    event.duration = payload;
+    event.type = type;
+    buffer.written.store(index + 1, std::memory_order_release);
+}
+
+// Everything recorded so far, as Chrome trace event JSON. Can be called at any time, from any thread.
+bool writeChromeTrace(const char * path);
+
+// Prints how many events each thread recorded and lost
+void printTraceStats();
+
+// Once no thread is recording. Threads that outlive it, like the parallelFor workers, drop their buffer
+// pointer on their next event and get a new buffer after initTrace.
+void cleanupTrace();
+
+// Times the enclosing scope, or until end()
+struct TraceZone {
+    const char * name;
+    unsigned long long start;
+    bool active; // tracing was enabled when entered, and the zone isn't over
+    explicit TraceZone(const char * zoneName) : name(zoneName), start(0), active(traceEnabled()){
+        if (active) start = traceTime();
+    }
+    ~TraceZone(){
+        end();
+    }
+    void end(){
+        if (active && traceEnabled())
+            traceEvent(TRACE_EVENT_ZONE, name, start, traceTime() - start);
+        active = false;
+    }
+};
+
+inline void traceCounter(const char * name, double value){
+    if (!traceEnabled())
+        return;
+    unsigned long long bits;
+    memcpy(&bits, &value, sizeof(bits));
+    traceEvent(TRACE_EVENT_COUNTER, name, traceTime(), bits);
+}
+
+inline void traceFlow(unsigned int type, const char * name, unsigned long long id){
+    if (traceEnabled())
+        traceEvent(type, name, traceTime(), id);
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(name)
+#define TRACE_COUNTER(name, value) traceCounter(name, (double)(value))
+#define TRACE_FLOW_BEGIN(name, id) traceFlow(TRACE_EVENT_FLOW_BEGIN, name, (unsigned long long)(id))
+#define TRACE_FLOW_END(name, id) traceFlow(TRACE_EVENT_FLOW_END, name, (unsigned long long)(id))
+
+#endif
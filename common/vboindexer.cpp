@@ -3,6 +3,8 @@
 
 #include <glm/glm.hpp>
 
+#include "memory.hpp"
+#include "trace.hpp"
 #include "vboindexer.hpp"
 
 #include <string.h> // for memcmp
@@ -83,12 +85,15 @@ struct PackedVertex{
 	};
 };
 
+// One node per unique vertex : the nodes come from a pool instead of one heap allocation each
+typedef std::map<PackedVertex, unsigned short, std::less<PackedVertex>, PoolAllocator<std::pair<const PackedVertex, unsigned short> > > VertexIndexMap;
+
 bool getSimilarVertexIndex_fast( 
 	PackedVertex & packed, 
-	std::map<PackedVertex,unsigned short> & VertexToOutIndex,
+	VertexIndexMap & VertexToOutIndex,
 	unsigned short & result
 ){
-	std::map<PackedVertex,unsigned short>::iterator it = VertexToOutIndex.find(packed);
+	VertexIndexMap::iterator it = VertexToOutIndex.find(packed);
 	if ( it == VertexToOutIndex.end() ){
 		return false;
 	}else{
@@ -107,29 +112,38 @@ void indexVBO(
 	std::vector<glm::vec2> & out_uvs,
 	std::vector<glm::vec3> & out_normals
 ){
-	std::map<PackedVertex,unsigned short> VertexToOutIndex;
-
-	// For each input vertex
-	for ( unsigned int i=0; i<in_vertices.size(); i++ ){
-
-		PackedVertex packed = {in_vertices[i], in_uvs[i], in_normals[i]};
+	TRACE_ZONE("indexVBO");
+	NodePools pools;
+	initNodePools(pools, "indexVBO", 256);
+	{
+		std::less<PackedVertex> compare;
+		VertexIndexMap VertexToOutIndex(compare, PoolAllocator<std::pair<const PackedVertex, unsigned short> >(&pools));
+		out_indices.reserve(out_indices.size() + in_vertices.size());
+
+		// For each input vertex
+		for ( unsigned int i=0; i<in_vertices.size(); i++ ){
+
+			PackedVertex packed = {in_vertices[i], in_uvs[i], in_normals[i]};
 		
 
-		// Try to find a similar vertex in out_XXXX
-		unsigned short index;
-		bool found = getSimilarVertexIndex_fast( packed, VertexToOutIndex, index);
-
-		if ( found ){ // A similar vertex is already in the VBO, use it instead !
-			out_indices.push_back( index );
-		}else{ // If not, it needs to be added in the output data.
-			out_vertices.push_back( in_vertices[i]);
-			out_uvs     .push_back( in_uvs[i]);
-			out_normals .push_back( in_normals[i]);
-			unsigned short newindex = (unsigned short)out_vertices.size() - 1;
-			out_indices .push_back( newindex );
-			VertexToOutIndex[ packed ] = newindex;
+			// Try to find a similar vertex in out_XXXX
+			unsigned short index;
+			bool found = getSimilarVertexIndex_fast( packed, VertexToOutIndex, index);
+
+			if ( found ){ // A similar vertex is already in the VBO, use it instead !
+				out_indices.push_back( index );
+			}else{ // If not, it needs to be added in the output data.
+				out_vertices.push_back( in_vertices[i]);
+				out_uvs     .push_back( in_uvs[i]);
+				out_normals .push_back( in_normals[i]);
+				unsigned short newindex = (unsigned short)out_vertices.size() - 1;
+				out_indices .push_back( newindex );
+				VertexToOutIndex[ packed ] = newindex;
+			}
 		}
 	}
+	// The map is gone : its nodes can go back
+	cleanupNodePools(pools);
 }
 
 
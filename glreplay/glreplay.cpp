@@ -0,0 +1,704 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <chrono>
+#include <algorithm>
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <common/dds.hpp>
+// The replay makes the real calls
+#define GLCAPTURE_NO_REDIRECT
+#include <common/glcapture.hpp>
+
+// Plays back a GL capture of the playground (playground --capture FILE) in a hidden window, as fast as it goes.
+//   glreplay CAPTURE [--loops N] [--csv FILE]
+// The first frame, loading included, is played once. The others are looped N times, each timed from its first call
+// to its last : the CPU cost of submitting it. The swap and a glFinish follow, outside of that time, so a frame
+// never pays for the GPU work of the previous one.
+// The input, the window and the simulation are out of the picture : a fixed trace to bisect frame time regressions on.
+
+struct Reader {
+    const unsigned char * data;
+    size_t offset, end;
+};
+
+static unsigned int get32(Reader & r){
+    unsigned int value = 0;
+    if (r.offset + sizeof(value) <= r.end)
+        memcpy(&value, r.data + r.offset, sizeof(value));
+    r.offset += sizeof(value);
+    return value;
+}
+
+static GLint getInt(Reader & r){
+    return (GLint)get32(r);
+}
+
+static float getFloat(Reader & r){
+    unsigned int value = get32(r);
+    float result;
+    memcpy(&result, &value, sizeof(result));
+    return result;
+}
+
+static unsigned long long get64(Reader & r){
+    unsigned long long value = 0;
+    if (r.offset + sizeof(value) <= r.end)
+        memcpy(&value, r.data + r.offset, sizeof(value));
+    r.offset += sizeof(value);
+    return value;
+}
+
+// count bytes in place, or NULL when the record is shorter
+static const unsigned char * getBytes(Reader & r, size_t count){
+    if (count > r.end - std::min(r.offset, r.end)){
+        r.offset = r.end + 1;
+        return NULL;
+    }
+    const unsigned char * bytes = r.data + r.offset;
+    r.offset += count;
+    return bytes;
+}
+
+// Captured name -> name in this context. 0 stays 0.
+struct NameMap {
+    std::vector<GLuint> names;
+};
+
+static GLuint lookup(const NameMap & map, GLuint captured){
+    return captured < map.names.size() ? map.names[captured] : 0;
+}
+
+static GLuint & slot(NameMap & map, GLuint captured){
+    if (captured >= map.names.size())
+        map.names.resize(captured + 1, 0);
+    return map.names[captured];
+}
+
+struct Blob {
+    const unsigned char * data;
+    size_t size;
+};
+
+struct Replay {
+    std::unordered_map<unsigned long long, Blob> blobs;
+    NameMap textures, buffers, vertexArrays, framebuffers, renderbuffers, programs; // programs : shaders too, like GL
+    std::map<GLuint, std::vector<GLint> > locations; // per captured program, captured location -> location
+    GLuint currentProgram;                           // captured
+    const std::vector<GLint> * currentLocations;     // of currentProgram
+    unsigned int unsupported, missingBlobs;
+    std::vector<GLuint> names;
+    std::vector<GLsizei> counts;
+    std::vector<const void *> offsets;
+};
+
+static GLint location(const Replay & replay, GLint captured){
+    if (captured < 0 || replay.currentLocations == NULL || (size_t)captured >= replay.currentLocations->size())
+        return -1;
+    return (*replay.currentLocations)[captured];
+}
+
+// size : of the blob, 0 otherwise
+static const void * getPayload(Replay & replay, Reader & r, size_t * size = NULL){
+    unsigned int kind = get32(r);
+    unsigned long long value = get64(r);
+    if (size != NULL)
+        *size = 0;
+    if (kind == PAYLOAD_OFFSET)
+        return (const void *)(size_t)value;
+    if (kind != PAYLOAD_BLOB)
+        return NULL;
+    std::unordered_map<unsigned long long, Blob>::const_iterator it = replay.blobs.find(value);
+    if (it == replay.blobs.end()){
+        replay.missingBlobs++;
+        return NULL;
+    }
+    if (size != NULL)
+        *size = it->second.size;
+    return it->second.data;
+}
+
+// glGen* : names generated again by a looped frame replace the previous ones
+typedef void (GLAPIENTRY * DeleteNames)(GLsizei n, const GLuint * names);
+static void generateNames(Replay & replay, Reader & r, NameMap & map, void (GLAPIENTRY * generate)(GLsizei, GLuint *), DeleteNames destroy){
+    GLsizei n = getInt(r);
+    replay.names.resize(std::max(n, 1));
+    generate(n, &replay.names[0]);
+    for (GLsizei i=0; i<n; i++){
+        GLuint & name = slot(map, get32(r));
+        if (name != 0)
+            destroy(1, &name);
+        name = replay.names[i];
+    }
+}
+
+static void deleteNames(Replay & replay, Reader & r, NameMap & map, DeleteNames destroy){
+    GLsizei n = getInt(r);
+    replay.names.clear();
+    for (GLsizei i=0; i<n; i++){
+        GLuint & name = slot(map, get32(r));
+        if (name != 0)
+            replay.names.push_back(name);
+        name = 0;
+    }
+    if (!replay.names.empty())
+        destroy((GLsizei)replay.names.size(), &replay.names[0]);
+}
+
+static void replaceProgramName(Replay & replay, GLuint captured, GLuint name){
+    GLuint & old = slot(replay.programs, captured);
+    if (old != 0){
+        if (glIsProgram(old))
+            glDeleteProgram(old);
+        else
+            glDeleteShader(old);
+    }
+    old = name;
+}
+
+// Reads the draw ranges of a glMultiDrawElements* record into the scratch arrays
+static GLsizei getDrawRanges(Replay & replay, Reader & r){
+    GLsizei drawcount = getInt(r);
+    replay.counts.resize(std::max(drawcount, 1));
+    replay.offsets.resize(std::max(drawcount, 1));
+    for (GLsizei i=0; i<drawcount; i++)
+        replay.counts[i] = getInt(r);
+    for (GLsizei i=0; i<drawcount; i++)
+        replay.offsets[i] = (const void *)(size_t)get64(r);
+    return drawcount;
+}
+
+static void execute(Replay & replay, unsigned int op, Reader & r){
+    switch (op){
+    case CAPTURE_FRAME:
+    case CAPTURE_BLOB:
+        break;
+    case CAPTURE_CLEAR: glClear(get32(r)); break;
+    case CAPTURE_CLEAR_COLOR: {
+        float c[4];
+        for (int i=0; i<4; i++)
+            c[i] = getFloat(r);
+        glClearColor(c[0], c[1], c[2], c[3]);
+        break;
+    }
+    case CAPTURE_VIEWPORT: {
+        GLint v[4];
+        for (int i=0; i<4; i++)
+            v[i] = getInt(r);
+        glViewport(v[0], v[1], v[2], v[3]);
+        break;
+    }
+    case CAPTURE_ENABLE: glEnable(get32(r)); break;
+    case CAPTURE_DISABLE: glDisable(get32(r)); break;
+    case CAPTURE_DEPTH_FUNC: glDepthFunc(get32(r)); break;
+    case CAPTURE_BLEND_FUNC: {
+        GLenum s = get32(r);
+        glBlendFunc(s, get32(r));
+        break;
+    }
+    case CAPTURE_PIXEL_STORE: {
+        GLenum pname = get32(r);
+        glPixelStorei(pname, getInt(r));
+        break;
+    }
+    case CAPTURE_GEN_TEXTURES: generateNames(replay, r, replay.textures, glGenTextures, glDeleteTextures); break;
+    case CAPTURE_DELETE_TEXTURES: deleteNames(replay, r, replay.textures, glDeleteTextures); break;
+    case CAPTURE_BIND_TEXTURE: {
+        GLenum target = get32(r);
+        glBindTexture(target, lookup(replay.textures, get32(r)));
+        break;
+    }
+    case CAPTURE_ACTIVE_TEXTURE: glActiveTexture(get32(r)); break;
+    case CAPTURE_TEX_PARAMETER: {
+        GLenum target = get32(r);
+        GLenum pname = get32(r);
+        glTexParameteri(target, pname, getInt(r));
+        break;
+    }
+    case CAPTURE_TEX_IMAGE_2D: {
+        GLint a[8];
+        for (int i=0; i<8; i++)
+            a[i] = getInt(r);
+        glTexImage2D(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], getPayload(replay, r));
+        break;
+    }
+    case CAPTURE_TEX_IMAGE_3D: {
+        GLint a[9];
+        for (int i=0; i<9; i++)
+            a[i] = getInt(r);
+        glTexImage3D(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8], getPayload(replay, r));
+        break;
+    }
+    case CAPTURE_TEX_SUB_IMAGE_3D: {
+        GLint a[10];
+        for (int i=0; i<10; i++)
+            a[i] = getInt(r);
+        glTexSubImage3D(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8], a[9], getPayload(replay, r));
+        break;
+    }
+    case CAPTURE_COMPRESSED_TEX_IMAGE_2D: {
+        GLint a[7];
+        for (int i=0; i<7; i++)
+            a[i] = getInt(r);
+        glCompressedTexImage2D(a[0], a[1], a[2], a[3], a[4], a[5], a[6], getPayload(replay, r));
+        break;
+    }
+    case CAPTURE_COMPRESSED_TEX_IMAGE_3D: {
+        GLint a[8];
+        for (int i=0; i<8; i++)
+            a[i] = getInt(r);
+        glCompressedTexImage3D(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], getPayload(replay, r));
+        break;
+    }
+    case CAPTURE_GENERATE_MIPMAP: glGenerateMipmap(get32(r)); break;
+    case CAPTURE_TEX_BUFFER: {
+        GLenum target = get32(r);
+        GLenum format = get32(r);
+        glTexBuffer(target, format, lookup(replay.buffers, get32(r)));
+        break;
+    }
+    case CAPTURE_GEN_BUFFERS: generateNames(replay, r, replay.buffers, glGenBuffers, glDeleteBuffers); break;
+    case CAPTURE_DELETE_BUFFERS: deleteNames(replay, r, replay.buffers, glDeleteBuffers); break;
+    case CAPTURE_BIND_BUFFER: {
+        GLenum target = get32(r);
+        glBindBuffer(target, lookup(replay.buffers, get32(r)));
+        break;
+    }
+    case CAPTURE_BUFFER_DATA: {
+        GLenum target = get32(r);
+        GLsizeiptr size = (GLsizeiptr)get64(r);
+        GLenum usage = get32(r);
+        glBufferData(target, size, getPayload(replay, r), usage);
+        break;
+    }
+    case CAPTURE_BUFFER_SUB_DATA: {
+        GLenum target = get32(r);
+        GLintptr offset = (GLintptr)get64(r);
+        GLsizeiptr size = (GLsizeiptr)get64(r);
+        const void * data = getPayload(replay, r);
+        if (data != NULL)
+            glBufferSubData(target, offset, size, data);
+        break;
+    }
+    case CAPTURE_MAPPED_WRITE: {
+        GLenum target = get32(r);
+        GLintptr offset = (GLintptr)get64(r);
+        GLsizeiptr length = (GLsizeiptr)get64(r);
+        GLbitfield access = get32(r) & ~GL_MAP_FLUSH_EXPLICIT_BIT;
+        const void * data = getPayload(replay, r);
+        void * dst = glMapBufferRange(target, offset, length, access);
+        if (dst != NULL){
+            if (data != NULL)
+                memcpy(dst, data, length);
+            glUnmapBuffer(target);
+        }
+        break;
+    }
+    case CAPTURE_GEN_VERTEX_ARRAYS: generateNames(replay, r, replay.vertexArrays, glGenVertexArrays, glDeleteVertexArrays); break;
+    case CAPTURE_DELETE_VERTEX_ARRAYS: deleteNames(replay, r, replay.vertexArrays, glDeleteVertexArrays); break;
+    case CAPTURE_BIND_VERTEX_ARRAY: glBindVertexArray(lookup(replay.vertexArrays, get32(r))); break;
+    case CAPTURE_ENABLE_ATTRIB: glEnableVertexAttribArray(get32(r)); break;
+    case CAPTURE_DISABLE_ATTRIB: glDisableVertexAttribArray(get32(r)); break;
+    case CAPTURE_ATTRIB_POINTER: {
+        GLuint index = get32(r);
+        GLint size = getInt(r);
+        GLenum type = get32(r);
+        GLboolean normalized = (GLboolean)get32(r);
+        GLsizei stride = getInt(r);
+        glVertexAttribPointer(index, size, type, normalized, stride, (const void *)(size_t)get64(r));
+        break;
+    }
+    case CAPTURE_ATTRIB_DIVISOR: {
+        GLuint index = get32(r);
+        glVertexAttribDivisor(index, get32(r));
+        break;
+    }
+    case CAPTURE_GEN_FRAMEBUFFERS: generateNames(replay, r, replay.framebuffers, glGenFramebuffers, glDeleteFramebuffers); break;
+    case CAPTURE_DELETE_FRAMEBUFFERS: deleteNames(replay, r, replay.framebuffers, glDeleteFramebuffers); break;
+    case CAPTURE_BIND_FRAMEBUFFER: {
+        GLenum target = get32(r);
+        glBindFramebuffer(target, lookup(replay.framebuffers, get32(r)));
+        break;
+    }
+    case CAPTURE_FRAMEBUFFER_RENDERBUFFER: {
+        GLenum target = get32(r), attachment = get32(r), renderbufferTarget = get32(r);
+        glFramebufferRenderbuffer(target, attachment, renderbufferTarget, lookup(replay.renderbuffers, get32(r)));
+        break;
+    }
+    case CAPTURE_BLIT_FRAMEBUFFER: {
+        GLint a[10];
+        for (int i=0; i<10; i++)
+            a[i] = getInt(r);
+        glBlitFramebuffer(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8], a[9]);
+        break;
+    }
+    case CAPTURE_GEN_RENDERBUFFERS: generateNames(replay, r, replay.renderbuffers, glGenRenderbuffers, glDeleteRenderbuffers); break;
+    case CAPTURE_DELETE_RENDERBUFFERS: deleteNames(replay, r, replay.renderbuffers, glDeleteRenderbuffers); break;
+    case CAPTURE_BIND_RENDERBUFFER: {
+        GLenum target = get32(r);
+        glBindRenderbuffer(target, lookup(replay.renderbuffers, get32(r)));
+        break;
+    }
+    case CAPTURE_RENDERBUFFER_STORAGE_MULTISAMPLE: {
+        GLint a[5];
+        for (int i=0; i<5; i++)
+            a[i] = getInt(r);
+        glRenderbufferStorageMultisample(a[0], a[1], a[2], a[3], a[4]);
+        break;
+    }
+    case CAPTURE_CREATE_SHADER: {
+        GLenum type = get32(r);
+        replaceProgramName(replay, get32(r), glCreateShader(type));
+        break;
+    }
+    case CAPTURE_DELETE_SHADER: {
+        GLuint & name = slot(replay.programs, get32(r));
+        glDeleteShader(name);
+        name = 0;
+        break;
+    }
+    case CAPTURE_SHADER_SOURCE: {
+        GLuint shader = lookup(replay.programs, get32(r));
+        size_t size;
+        const char * source = (const char *)getPayload(replay, r, &size);
+        GLint length = (GLint)size;
+        if (source != NULL)
+            glShaderSource(shader, 1, &source, &length);
+        break;
+    }
+    case CAPTURE_COMPILE_SHADER: glCompileShader(lookup(replay.programs, get32(r))); break;
+    case CAPTURE_CREATE_PROGRAM: replaceProgramName(replay, get32(r), glCreateProgram()); break;
+    case CAPTURE_DELETE_PROGRAM: {
+        GLuint captured = get32(r);
+        GLuint & name = slot(replay.programs, captured);
+        glDeleteProgram(name);
+        name = 0;
+        replay.locations.erase(captured);
+        if (captured == replay.currentProgram)
+            replay.currentLocations = NULL;
+        break;
+    }
+    case CAPTURE_ATTACH_SHADER: {
+        GLuint program = lookup(replay.programs, get32(r));
+        glAttachShader(program, lookup(replay.programs, get32(r)));
+        break;
+    }
+    case CAPTURE_DETACH_SHADER: {
+        GLuint program = lookup(replay.programs, get32(r));
+        glDetachShader(program, lookup(replay.programs, get32(r)));
+        break;
+    }
+    case CAPTURE_LINK_PROGRAM: glLinkProgram(lookup(replay.programs, get32(r))); break;
+    case CAPTURE_USE_PROGRAM: {
+        GLuint captured = get32(r);
+        glUseProgram(lookup(replay.programs, captured));
+        replay.currentProgram = captured;
+        std::map<GLuint, std::vector<GLint> >::const_iterator it = replay.locations.find(captured);
+        replay.currentLocations = it != replay.locations.end() ? &it->second : NULL;
+        break;
+    }
+    case CAPTURE_UNIFORM_LOCATION: {
+        GLuint captured = get32(r);
+        GLint capturedLocation = getInt(r);
+        unsigned int length = get32(r);
+        const unsigned char * name = getBytes(r, length);
+        if (name == NULL || capturedLocation < 0)
+            break;
+        std::string uniform((const char *)name, length);
+        std::vector<GLint> & map = replay.locations[captured];
+        if ((size_t)capturedLocation >= map.size())
+            map.resize(capturedLocation + 1, -1);
+        map[capturedLocation] = glGetUniformLocation(lookup(replay.programs, captured), uniform.c_str());
+        if (captured == replay.currentProgram)
+            replay.currentLocations = &map;
+        break;
+    }
+    case CAPTURE_UNIFORM_1I: {
+        GLint l = location(replay, getInt(r));
+        glUniform1i(l, getInt(r));
+        break;
+    }
+    case CAPTURE_UNIFORM_1F: {
+        GLint l = location(replay, getInt(r));
+        glUniform1f(l, getFloat(r));
+        break;
+    }
+    case CAPTURE_UNIFORM_2F: {
+        GLint l = location(replay, getInt(r));
+        float x = getFloat(r);
+        glUniform2f(l, x, getFloat(r));
+        break;
+    }
+    case CAPTURE_UNIFORM_3F: {
+        GLint l = location(replay, getInt(r));
+        float x = getFloat(r), y = getFloat(r);
+        glUniform3f(l, x, y, getFloat(r));
+        break;
+    }
+    case CAPTURE_UNIFORM_3I: {
+        GLint l = location(replay, getInt(r));
+        GLint x = getInt(r), y = getInt(r);
+        glUniform3i(l, x, y, getInt(r));
+        break;
+    }
+    case CAPTURE_UNIFORM_4FV: {
+        GLint l = location(replay, getInt(r));
+        GLsizei count = getInt(r);
+        const unsigned char * values = getBytes(r, count * 4 * sizeof(GLfloat));
+        if (values != NULL)
+            glUniform4fv(l, count, (const GLfloat *)values);
+        break;
+    }
+    case CAPTURE_UNIFORM_MATRIX_4FV: {
+        GLint l = location(replay, getInt(r));
+        GLsizei count = getInt(r);
+        GLboolean transpose = (GLboolean)get32(r);
+        const unsigned char * values = getBytes(r, count * 16 * sizeof(GLfloat));
+        if (values != NULL)
+            glUniformMatrix4fv(l, count, transpose, (const GLfloat *)values);
+        break;
+    }
+    case CAPTURE_DRAW_ARRAYS: {
+        GLenum mode = get32(r);
+        GLint first = getInt(r);
+        glDrawArrays(mode, first, getInt(r));
+        break;
+    }
+    case CAPTURE_DRAW_ELEMENTS: {
+        GLenum mode = get32(r);
+        GLsizei count = getInt(r);
+        GLenum type = get32(r);
+        glDrawElements(mode, count, type, (const void *)(size_t)get64(r));
+        break;
+    }
+    case CAPTURE_MULTI_DRAW_ELEMENTS: {
+        GLenum mode = get32(r), type = get32(r);
+        GLsizei drawcount = getDrawRanges(replay, r);
+        glMultiDrawElements(mode, &replay.counts[0], type, &replay.offsets[0], drawcount);
+        break;
+    }
+    case CAPTURE_MULTI_DRAW_ELEMENTS_BASE_VERTEX: {
+        GLenum mode = get32(r), type = get32(r);
+        GLsizei drawcount = getDrawRanges(replay, r);
+        const unsigned char * baseVertices = getBytes(r, drawcount * sizeof(GLint));
+        if (baseVertices != NULL)
+            glMultiDrawElementsBaseVertex(mode, &replay.counts[0], type, &replay.offsets[0], drawcount, (const GLint *)baseVertices);
+        break;
+    }
+    case CAPTURE_MULTI_DRAW_ELEMENTS_INDIRECT: {
+        GLenum mode = get32(r), type = get32(r);
+        GLsizei drawcount = getInt(r), stride = getInt(r);
+        const void * indirect = getPayload(replay, r);
+        if (glMultiDrawElementsIndirect == NULL)
+            replay.unsupported++;
+        else
+            glMultiDrawElementsIndirect(mode, type, indirect, drawcount, stride);
+        break;
+    }
+    default:
+        replay.unsupported++;
+        break;
+    }
+}
+
+struct FrameRange {
+    size_t begin, end;  // records, the CAPTURE_FRAME one included
+    unsigned int calls;
+};
+
+static double nowMs(){
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static double percentile(std::vector<double> values, double p){
+    if (values.empty())
+        return 0.0;
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, (size_t)(p * (values.size() - 1) + 0.5))];
+}
+
+int main(int argc, char * argv[]){
+    if (argc < 2){
+        printf("Usage : glreplay CAPTURE [--loops N] [--csv FILE]\n");
+        return -1;
+    }
+    int loops = 10;
+    const char * csvPath = NULL;
+    for (int i=2; i+1<argc; i++){
+        if (strcmp(argv[i], "--loops") == 0)
+            loops = std::max(1, atoi(argv[i + 1]));
+        if (strcmp(argv[i], "--csv") == 0)
+            csvPath = argv[i + 1];
+    }
+
+    MappedFile file;
+    if (!mapFile(argv[1], file)){
+        printf("%s could not be opened\n", argv[1]);
+        return -1;
+    }
+    GLCaptureHeader header;
+    if (file.size < sizeof(header)){
+        printf("%s is not a GL capture\n", argv[1]);
+        return -1;
+    }
+    memcpy(&header, file.data, sizeof(header));
+    if (header.magic != GL_CAPTURE_MAGIC || header.version != GL_CAPTURE_VERSION){
+        printf("%s is not a GL capture of version %u\n", argv[1], GL_CAPTURE_VERSION);
+        return -1;
+    }
+
+    // Find the frames and the blobs up front : a looped frame uses blobs first written by an earlier one
+    Replay replay;
+    replay.currentProgram = 0;
+    replay.currentLocations = NULL;
+    replay.unsupported = replay.missingBlobs = 0;
+    std::vector<FrameRange> frames;
+    FrameRange frame = { sizeof(header), sizeof(header), 0 };
+    size_t offset = sizeof(header);
+    while (offset + 2 * sizeof(unsigned int) <= file.size){
+        unsigned int record[2];
+        memcpy(record, file.data + offset, sizeof(record));
+        size_t payload = offset + sizeof(record);
+        if (record[1] > file.size - payload){
+            printf("Capture truncated after %u frames\n", (unsigned int)frames.size());
+            break;
+        }
+        offset = payload + record[1];
+        if (record[0] == CAPTURE_BLOB && record[1] >= sizeof(unsigned long long)){
+            unsigned long long hash;
+            memcpy(&hash, file.data + payload, sizeof(hash));
+            Blob blob = { file.data + payload + sizeof(hash), record[1] - sizeof(hash) };
+            replay.blobs[hash] = blob;
+        }
+        else if (record[0] != CAPTURE_BLOB)
+            frame.calls++;
+        if (record[0] == CAPTURE_FRAME){
+            frame.end = offset;
+            frames.push_back(frame);
+            frame.begin = frame.end = offset;
+            frame.calls = 0;
+        }
+    }
+    if (frames.empty()){
+        printf("No complete frame in %s\n", argv[1]);
+        return -1;
+    }
+
+    // Same context as the playground, in a window that is never shown
+    if (!glfwInit()){
+        fprintf(stderr, "Failed to Init GLFW\n");
+        return -1;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    GLFWwindow * window = glfwCreateWindow(header.width, header.height, "glreplay", NULL, NULL);
+    if (window == NULL){
+        fprintf(stderr, "Failed to open GLFW window\n");
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(0);
+    glewExperimental = true;
+    if (glewInit() != GLEW_OK){
+        fprintf(stderr, "Failed to Init GLEW\n");
+        return -1;
+    }
+    glGetError(); // glewInit leaves GL_INVALID_ENUM on core profiles
+
+    // One frame : its calls, timed, then the swap and the GPU
+    std::vector<double> submitMs, frameMs;
+    auto playFrame = [&](const FrameRange & range){
+        double begin = nowMs();
+        Reader r = { file.data, range.begin, range.end };
+        while (r.offset + 2 * sizeof(unsigned int) <= range.end){
+            unsigned int op = get32(r);
+            unsigned int size = get32(r);
+            Reader args = { file.data, r.offset, r.offset + size };
+            execute(replay, op, args);
+            r.offset += size;
+        }
+        double submitted = nowMs();
+        glfwSwapBuffers(window);
+        glFinish();
+        submitMs.push_back(submitted - begin);
+        frameMs.push_back(nowMs() - begin);
+    };
+
+    printf("Replaying %s : %u x %u, %u frames, %u MB\n", argv[1], header.width, header.height, (unsigned int)frames.size(), (unsigned int)(file.size >> 20));
+    playFrame(frames[0]);
+    printf("First frame (loading) : %.2f ms for %u calls\n", frameMs[0], frames[0].calls);
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR)
+        printf("GL error 0x%04X while loading : the capture may not match this driver\n", error);
+
+    // samples[frame - 1][loop]
+    size_t looped = frames.size() - 1;
+    if (looped == 0)
+        printf("Only one frame captured : nothing to loop\n");
+    std::vector<std::vector<double> > submitSamples(looped), frameSamples(looped);
+    double loopBegin = nowMs();
+    for (int loop=0; loop<loops && looped > 0; loop++){
+        for (size_t f=1; f<frames.size(); f++){
+            submitMs.clear();
+            frameMs.clear();
+            playFrame(frames[f]);
+            submitSamples[f - 1].push_back(submitMs[0]);
+            frameSamples[f - 1].push_back(frameMs[0]);
+        }
+    }
+    double loopMs = nowMs() - loopBegin;
+
+    if (looped > 0){
+        // Per frame : the median over the loops, which is what regresses
+        std::vector<double> submitMedians(looped), frameMedians(looped), all;
+        std::vector<size_t> order(looped);
+        for (size_t f=0; f<looped; f++){
+            submitMedians[f] = percentile(submitSamples[f], 0.5);
+            frameMedians[f] = percentile(frameSamples[f], 0.5);
+            all.insert(all.end(), submitSamples[f].begin(), submitSamples[f].end());
+            order[f] = f;
+        }
+        printf("%u frames x %d loops in %.1f ms : %.1f frames per second\n", (unsigned int)looped, loops, loopMs, looped * loops * 1000.0 / loopMs);
+        printf("CPU submit per frame : median %.3f ms, 95th percentile %.3f ms, max %.3f ms\n",
+            percentile(all, 0.5), percentile(all, 0.95), percentile(all, 1.0));
+
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b){ return submitMedians[a] > submitMedians[b]; });
+        printf("%8s %8s %14s %14s\n", "frame", "calls", "submit (ms)", "frame (ms)");
+        for (size_t i=0; i<std::min<size_t>(10, looped); i++){
+            size_t f = order[i];
+            printf("%8u %8u %14.3f %14.3f\n", (unsigned int)f + 1, frames[f + 1].calls, submitMedians[f], frameMedians[f]);
+        }
+    }
+    if (replay.unsupported > 0)
+        printf("%u calls not supported by this context were skipped\n", replay.unsupported);
+    if (replay.missingBlobs > 0)
+        printf("%u calls referenced missing payloads\n", replay.missingBlobs);
+
+    if (csvPath != NULL){
+        FILE * csv = fopen(csvPath, "w");
+        if (csv == NULL)
+            printf("%s could not be written\n", csvPath);
+        else {
+            fprintf(csv, "frame,loop,calls,submit_ms,frame_ms\n");
+            for (size_t f=0; f<looped; f++)
+                for (size_t l=0; l<submitSamples[f].size(); l++)
+                    fprintf(csv, "%u,%u,%u,%.4f,%.4f\n", (unsigned int)f + 1, (unsigned int)l, frames[f + 1].calls, submitSamples[f][l], frameSamples[f][l]);
+            fclose(csv);
+            printf("Frame times written to %s\n", csvPath);
+        }
+    }
+
+    glfwTerminate();
+    unmapFile(file);
+    return 0;
+}
@@ -1,21 +1,112 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <vector>
 #include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
 #include <common/shader.hpp>
+#include <common/shadervariants.hpp>
+#include <common/programbuilder.hpp>
+#include <common/filewatcher.hpp>
 #include <common/texture.hpp>
 #include <common/input.hpp>
 #include <common/objloader.hpp>
 #include <common/vboindexer.hpp>
+#include <common/tangentspace.hpp>
 #include <common/text2D.hpp>
+#include <common/meshsimplify.hpp>
+#include <common/meshlets.hpp>
+#include <common/geometrypool.hpp>
+#include <common/clusteredlighting.hpp>
+#include <common/occlusionculling.hpp>
+#include <common/rendercommands.hpp>
+#include <common/scenesnapshot.hpp>
+#include <common/scenegraph.hpp>
+#include <common/framegovernor.hpp>
+#include <common/texturestreamer.hpp>
+#include <common/materialtextures.hpp>
+#include <common/memory.hpp>
+#include <common/gpuresources.hpp>
+#include <common/cookedassets.hpp>
+#include <common/trace.hpp>
+#include <common/bcdecode.hpp>
+#include <common/bcencode.hpp>
+#include <common/glcapture.hpp>
 
 using namespace glm;
 
-int main()
+int main(int argc, char* argv[])
 {
+    // "--lights N" : clustered lighting benchmark, a grid of cubes lit by N random point lights
+    // "--frame-budget MS" : GPU time the resolution scale is adjusted for
+    // "--fps-cap N" : frame rate limit, "--frame-log FILE" : scale and frame time history, as CSV
+    // "--materials N" : the grid of cubes with N materials sharing texture arrays, "--separate-materials" : one texture each
+    // "--qtangents" : the mesh gets its tangent frames as snorm16 quaternions, instead of float normals
+    // "--bump" : normals tilted by the luminance of the texture, "--precompile-shaders" : builds every shader variant in the background
+    // "--watch-shaders" : rebuilds the shaders when their files are saved, and swaps them in once linked
+    // "--meshlets" : the mesh is drawn as clusters, frustum and backface culled on the CPU every frame
+    // "--geometry-pool N" : N distinct cubes share a few big buffers and are drawn in one multi-draw call
+    // "--gpu-budget MB" : warns when the buffers, the textures or the render targets go over it
+    // "--capture FILE" : records every GL call from startup to exit, for glreplay
+    // "--trace FILE" : records the loading and every frame, written on exit for chrome://tracing or ui.perfetto.dev
+    // "--bc-benchmark" : checks and times the software BCn decoder, then exits
+    // "--compress-bmp IN.bmp OUT.dds [bc1|bc3]" : converts a texture offline, then exits
+    int lightCount = 0;
+    float frameBudget = 14.0f;
+    float fpsCap = 0.0f;
+    const char* frameLogPath = NULL;
+    int materialCount = 0;
+    bool separateMaterials = false;
+    int gpuBudget = 256;
+    bool qtangents = false;
+    bool bump = false;
+    bool precompileShaders = false;
+    bool watchShaders = false;
+    bool meshletCulling = false;
+    int poolMeshCount = 0;
+    const char* tracePath = NULL;
+    const char* capturePath = NULL;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--lights") == 0) lightCount = atoi(argv[i + 1]);
+        if (strcmp(argv[i], "--frame-budget") == 0) frameBudget = (float)atof(argv[i + 1]);
+        if (strcmp(argv[i], "--fps-cap") == 0) fpsCap = (float)atof(argv[i + 1]);
+        if (strcmp(argv[i], "--frame-log") == 0) frameLogPath = argv[i + 1];
+        if (strcmp(argv[i], "--materials") == 0) materialCount = atoi(argv[i + 1]);
+        if (strcmp(argv[i], "--gpu-budget") == 0) gpuBudget = atoi(argv[i + 1]);
+        if (strcmp(argv[i], "--geometry-pool") == 0) poolMeshCount = atoi(argv[i + 1]);
+        if (strcmp(argv[i], "--trace") == 0) tracePath = argv[i + 1];
+        if (strcmp(argv[i], "--capture") == 0) capturePath = argv[i + 1];
+    }
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--separate-materials") == 0) separateMaterials = true;
+        if (strcmp(argv[i], "--qtangents") == 0) qtangents = true;
+        if (strcmp(argv[i], "--bump") == 0) bump = true;
+        if (strcmp(argv[i], "--precompile-shaders") == 0) precompileShaders = true;
+        if (strcmp(argv[i], "--watch-shaders") == 0) watchShaders = true;
+        if (strcmp(argv[i], "--meshlets") == 0) meshletCulling = true;
+        if (strcmp(argv[i], "--bc-benchmark") == 0) {
+            benchmarkBCDecoder(std::max(1u, std::thread::hardware_concurrency()));
+            return 0;
+        }
+        if (strcmp(argv[i], "--compress-bmp") == 0 && i + 2 < argc) {
+            BCFormat format = i + 3 < argc && strcmp(argv[i + 3], "bc3") == 0 ? BC_FORMAT_BC3 : BC_FORMAT_BC1;
+            return compressBMP(argv[i + 1], argv[i + 2], format, std::max(1u, std::thread::hardware_concurrency())) ? 0 : -1;
+        }
+    }
+
+    if (tracePath != NULL) {
+        initTrace();
+        setTraceEnabled(true);
+        setTraceThreadName("render");
+    }
+
     // Init GLFW
     glewExperimental = true;
     if (!glfwInit()) {
@@ -23,7 +114,6 @@ int main()
         return -1;
     }
 
-    glfwWindowHint(GLFW_SAMPLES, 4); // Anti-aliasing 4x
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3); // OpenGL 3
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // For MasOS
@@ -48,69 +138,392 @@ int main()
         return -1;
     }
 
-    glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE); // Get keyboard event
+    // Before anything is created : the replay starts from an empty context
+    if (capturePath != NULL) {
+        int captureWidth, captureHeight;
+        glfwGetFramebufferSize(window, &captureWidth, &captureHeight);
+        startGLCapture(capturePath, captureWidth, captureHeight);
+    }
+
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED); // Disable cursor
 
+    // Input events are queued by the GLFW callbacks and latched into the camera by the simulation thread
+    InputSystem input;
+    initInput(window, input);
+    Camera camera;
+    initCamera(camera, window);
+
+    setGPUBudget(GPU_BUFFER, (size_t)gpuBudget * 1024 * 1024);
+    setGPUBudget(GPU_TEXTURE, (size_t)gpuBudget * 1024 * 1024);
+    setGPUBudget(GPU_RENDERBUFFER, (size_t)gpuBudget * 1024 * 1024);
+
     // Create VAO
-    GLuint VertexArrayID;
-    glGenVertexArrays(1, &VertexArrayID);
+    GLuint VertexArrayID = createGPUResource(GPU_VERTEX_ARRAY, "default VAO");
     glBindVertexArray(VertexArrayID);
 
     // Compile GLSL program from shaders
-    GLuint programID = LoadShaders("shaders/VertexShader.vert", "shaders/FragmentShader.frag");
-
-    // Get a handle for MVP uniform in shader
-    GLuint matrixID = glGetUniformLocation(programID, "MVP");
-    GLuint modelMatrixID = glGetUniformLocation(programID, "V");
-    GLuint viewMatrixID = glGetUniformLocation(programID, "M");
-
-    // Get a handle for Light Position in shader
-    GLuint lightID = glGetUniformLocation(programID, "LightPosition_worldspace");
-
-    // Load texture
-    GLuint texture = loadDDS("Cube.dds");
-    GLuint textureID = glGetUniformLocation(programID, "myTextureSampler");
-
-    // Load OBJ
-    std::vector<vec3> vertices;
-    std::vector<vec2> uvs;
-    std::vector<vec3> normals;
-    if (!loadOBJ("cube.obj", vertices, uvs, normals)) {
-        printf("Error occurred while loading obj file");
-        return -1;
+    if (lightCount > 0 && materialCount > 0) {
+        printf("--materials is ignored with --lights\n");
+        materialCount = 0;
+    }
+    const char* fragmentShader = "shaders/FragmentShader.frag";
+    if (lightCount > 0) fragmentShader = "shaders/ClusteredFragmentShader.frag";
+    if (materialCount > 0) fragmentShader = "shaders/MaterialFragmentShader.frag";
+
+    // Compiles and links are issued without waiting for them, the driver builds them on its threads when it can
+    ProgramBuilder programBuilder;
+    initProgramBuilder(programBuilder, std::max(1u, std::thread::hardware_concurrency()));
+    FileWatcher shaderWatcher;
+    initFileWatcher(shaderWatcher);
+
+    // Permutations are compiled in : no branches on them in the fragment shaders
+    ShaderVariants shaderVariants;
+    initShaderVariants(shaderVariants, programBuilder, "shaders/VertexShader.vert", fragmentShader);
+    if (watchShaders) watchShaderVariants(shaderVariants, shaderWatcher);
+    addShaderPermutation(shaderVariants, "QTANGENT");
+    addShaderPermutation(shaderVariants, "NORMAL_MAPPING");
+    addShaderPermutation(shaderVariants, "LIGHT_COUNT", 2);
+    unsigned int variantMask =
+        shaderVariantMask(shaderVariants, "QTANGENT", qtangents ? 1 : 0) |
+        shaderVariantMask(shaderVariants, "NORMAL_MAPPING", bump ? 1 : 0) |
+        shaderVariantMask(shaderVariants, "LIGHT_COUNT", 1);
+    if (precompileShaders) {
+        std::vector<unsigned int> masks;
+        allShaderVariantMasks(shaderVariants, masks);
+        precompileShaderVariants(shaderVariants, masks);
+    }
+    GLuint programID = getShaderVariant(shaderVariants, variantMask);
+    unsigned int shaderGeneration = shaderVariants.generation;
+
+    // Handles of the uniforms : looked up again when a reload replaces the program
+    GLuint matrixID, modelMatrixID, viewMatrixID, lightID, textureID;
+    GLint materialRectID, materialLayerID, materialTexturesID;
+    auto lookUpUniforms = [&]() {
+        matrixID = glGetUniformLocation(programID, "MVP");
+        modelMatrixID = glGetUniformLocation(programID, "M");
+        viewMatrixID = glGetUniformLocation(programID, "V");
+        lightID = glGetUniformLocation(programID, "LightPosition_worldspace");
+        textureID = glGetUniformLocation(programID, "myTextureSampler");
+        materialRectID = glGetUniformLocation(programID, "materialRect");
+        materialLayerID = glGetUniformLocation(programID, "materialLayer");
+        materialTexturesID = glGetUniformLocation(programID, "materialTextures");
+    };
+    lookUpUniforms();
+
+    // Assets cooked offline (see assetcook) are loaded as they are, the sources are only processed here when missing
+    CookedAssets cookedAssets;
+    if (!loadCookedAssets("cooked", cookedAssets)) printf("No cooked assets : processing the sources at load time\n");
+
+    // Stream textures : a placeholder now, the mips over the next frames, smallest first
+    TextureStreamer textureStreamer;
+    initTextureStreamer(textureStreamer, 2, 256 * 1024, 3);
+    GLuint texture = requestTexture(textureStreamer, resolveAssetPath(cookedAssets, "Cube.dds").c_str());
+
+    // Materials : checkers of a few sizes. Same sized ones become layers of an array, odd sized ones share an atlas.
+    MaterialTextures materials;
+    initMaterialTextures(materials, 1024, 4);
+    for (int m = 0; m < materialCount; m++) {
+        unsigned int w = m % 3 == 0 ? 256 : m % 3 == 1 ? 128 : 100 + 12 * (m % 40);
+        unsigned int h = m % 3 == 2 ? 60 + 7 * (m % 40) : w;
+        vec3 color = vec3(0.5f) + 0.5f * vec3(cos(m * 1.7f), cos(m * 1.7f + 2.1f), cos(m * 1.7f + 4.2f));
+        std::vector<unsigned char> pixels(w * h * 4);
+        for (unsigned int y = 0; y < h; y++) {
+            for (unsigned int x = 0; x < w; x++) {
+                float shade = ((x * 8 / w + y * 8 / h) % 2) ? 1.0f : 0.5f;
+                unsigned char* p = &pixels[(y * w + x) * 4];
+                p[0] = (unsigned char)(color.r * shade * 255);
+                p[1] = (unsigned char)(color.g * shade * 255);
+                p[2] = (unsigned char)(color.b * shade * 255);
+                p[3] = 255;
+            }
+        }
+        addMaterialImage(materials, &pixels[0], w, h);
+    }
+    if (materialCount > 0) {
+        buildMaterialTextures(materials, !separateMaterials);
+        printMaterialTextureStats(materials);
     }
 
-    // Load Index
+    // Load the mesh : indexed, with its tangent frames and LODs (50% / 25% / 12.5%) all sharing the same vertex buffer
     std::vector<unsigned short> indices;
     std::vector<vec3> indexed_vertices;
     std::vector<vec2> indexed_uvs;
     std::vector<vec3> indexed_normals;
-    indexVBO(vertices, uvs, normals, indices, indexed_vertices, indexed_uvs, indexed_normals);
+    std::vector<vec3> indexed_tangents;
+    std::vector<vec3> indexed_bitangents;
+    std::vector<unsigned short> lodIndices;
+    std::vector<MeshLOD> lods;
+    // Loaders take their scratch memory from an arena, reset once the assets are in
+    Arena loadArena;
+    initArena(loadArena, "load", 1024 * 1024);
+    std::string cookedMeshPath = cookedAssetPath(cookedAssets, "cube.obj");
+    CookedMesh cookedMesh;
+    if (!cookedMeshPath.empty() && loadCookedMesh(cookedMeshPath.c_str(), cookedMesh)) {
+        indexed_vertices.swap(cookedMesh.vertices);
+        indexed_uvs.swap(cookedMesh.uvs);
+        indexed_normals.swap(cookedMesh.normals);
+        indexed_tangents.swap(cookedMesh.tangents);
+        indexed_bitangents.swap(cookedMesh.bitangents);
+        lodIndices.swap(cookedMesh.lodIndices);
+        lods.swap(cookedMesh.lods);
+        indices.assign(lodIndices.begin() + lods[0].indexOffset, lodIndices.begin() + lods[0].indexOffset + lods[0].indexCount);
+        printf("Loaded cube.obj from %s : %u vertices, %u LODs\n", cookedMeshPath.c_str(), (unsigned int)indexed_vertices.size(), (unsigned int)lods.size());
+    }
+    else {
+        std::vector<vec3> vertices;
+        std::vector<vec2> uvs;
+        std::vector<vec3> normals;
+        if (!loadOBJ("cube.obj", vertices, uvs, normals, &loadArena)) {
+            printf("Error occurred while loading obj file");
+            return -1;
+        }
+
+        // Load Index
+        if (qtangents) {
+            std::vector<vec3> tangents;
+            std::vector<vec3> bitangents;
+            computeTangentBasis(vertices, uvs, normals, tangents, bitangents);
+            indexVBO_TBN(vertices, uvs, normals, tangents, bitangents, indices, indexed_vertices, indexed_uvs, indexed_normals, indexed_tangents, indexed_bitangents);
+        }
+        else indexVBO(vertices, uvs, normals, indices, indexed_vertices, indexed_uvs, indexed_normals);
+
+        // Build LODs
+        std::vector<float> lodRatios = { 0.5f, 0.25f, 0.125f };
+        buildLODChain(indices, indexed_vertices, lodRatios, lodIndices, lods);
+    }
+
+    // Meshlets : the triangles of each LOD reordered into clusters, so that the LODs stay ranges of one buffer
+    std::vector<Meshlet> meshlets;
+    std::vector<unsigned int> lodMeshlets(1, 0); // first meshlet of each LOD, then the end
+    MeshletCullStats meshletStats;
+    resetMeshletCullStats(meshletStats);
+    if (meshletCulling) {
+        std::vector<unsigned short> clustered;
+        for (size_t l = 0; l < lods.size(); l++) {
+            unsigned int offset = (unsigned int)clustered.size();
+            buildMeshlets(lodIndices, lods[l].indexOffset, lods[l].indexCount, indexed_vertices, clustered, meshlets);
+            lods[l].indexOffset = offset;
+            lodMeshlets.push_back((unsigned int)meshlets.size());
+        }
+        lodIndices.swap(clustered);
+        printMeshletStats(meshlets);
+    }
+    printMemoryStats(loadArena.stats);
+    resetArena(loadArena);
 
     // Init Vertex Buffer
-    GLuint vertexbuffer;
-    glGenBuffers(1, &vertexbuffer);
+    GLuint vertexbuffer = createGPUResource(GPU_BUFFER, "cube positions");
     glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
     glBufferData(GL_ARRAY_BUFFER, indexed_vertices.size() * sizeof(vec3), &indexed_vertices[0], GL_STATIC_DRAW);
+    setGPUResourceBytes(GPU_BUFFER, vertexbuffer, indexed_vertices.size() * sizeof(vec3));
 
     // Init UV buffer
-    GLuint uvbuffer;
-    glGenBuffers(1, &uvbuffer);
+    GLuint uvbuffer = createGPUResource(GPU_BUFFER, "cube uvs");
     glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
     glBufferData(GL_ARRAY_BUFFER, indexed_uvs.size() * sizeof(vec2), &indexed_uvs[0], GL_STATIC_DRAW);
+    setGPUResourceBytes(GPU_BUFFER, uvbuffer, indexed_uvs.size() * sizeof(vec2));
 
     // Init Normal buffer
-    GLuint normalbuffer;
-    glGenBuffers(1, &normalbuffer);
+    GLuint normalbuffer = createGPUResource(GPU_BUFFER, "cube normals");
     glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-    glBufferData(GL_ARRAY_BUFFER, indexed_normals.size() * sizeof(vec3), &indexed_normals[0], GL_STATIC_DRAW);
+    if (qtangents) {
+        // 8 bytes per vertex for the whole frame, instead of 12 for the normal alone, or 36 for the three vectors
+        std::vector<i16vec4> packed;
+        packQTangents(indexed_normals, indexed_tangents, indexed_bitangents, packed);
+        printf("QTangents : %u vertices, %u bytes instead of %u, max error %.4f degrees\n", (unsigned int)packed.size(),
+            (unsigned int)(packed.size() * sizeof(i16vec4)), (unsigned int)(packed.size() * 3 * sizeof(vec3)),
+            qtangentError(indexed_normals, indexed_tangents, indexed_bitangents, packed));
+        glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(i16vec4), &packed[0], GL_STATIC_DRAW);
+        setGPUResourceBytes(GPU_BUFFER, normalbuffer, packed.size() * sizeof(i16vec4));
+    }
+    else {
+        glBufferData(GL_ARRAY_BUFFER, indexed_normals.size() * sizeof(vec3), &indexed_normals[0], GL_STATIC_DRAW);
+        setGPUResourceBytes(GPU_BUFFER, normalbuffer, indexed_normals.size() * sizeof(vec3));
+    }
+
+    GLuint elementbuffer = createGPUResource(GPU_BUFFER, "cube LOD indices");
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, lodIndices.size() * sizeof(unsigned short), &lodIndices[0], GL_STATIC_DRAW);
+    setGPUResourceBytes(GPU_BUFFER, elementbuffer, lodIndices.size() * sizeof(unsigned short));
+
+    // Mesh VAO : vertex attributes and index buffer are set once
+    GLuint meshVAO = createGPUResource(GPU_VERTEX_ARRAY, "cube mesh");
+    glBindVertexArray(meshVAO);
 
-    GLuint elementbuffer;
-    glGenBuffers(1, &elementbuffer);
+    // Set vertex position data
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+    glVertexAttribPointer(
+        0,          // attr 0 (same with shader)
+        3,          // size
+        GL_FLOAT,   // type
+        GL_FALSE,   // normalized?
+        0,          // stride
+        (void*)0    // array buffer offset
+    );
+
+    // Set UV data
+    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
+    glVertexAttribPointer(
+        1,
+        2,
+        GL_FLOAT,
+        GL_FALSE,
+        0,
+        (void*)0
+    );
+
+    // Set Normal data : 3 floats, or a quaternion in 4 normalized shorts
+    glEnableVertexAttribArray(2);
+    glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
+    glVertexAttribPointer(
+        2,
+        qtangents ? 4 : 3,
+        qtangents ? GL_SHORT : GL_FLOAT,
+        qtangents ? GL_TRUE : GL_FALSE,
+        0,
+        (void*)0
+    );
+
+    // Set index data
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), &indices[0], GL_STATIC_DRAW);
 
-    initText2D("CascadiaMono.dds", width, height);
+    // Geometry pool : each cube deformed its own way, baked in world space above the scene,
+    // so that they all use model matrix 0 and the pass is a single call on both paths
+    GeometryPool geometryPool;
+    GeometryPoolDraws poolDraws;
+    GLuint poolProgramID = 0;
+    GLint poolViewProjID = -1, poolViewID = -1, poolLightID = -1, poolTextureID = -1;
+    if (poolMeshCount > 0) {
+        initGeometryPool(geometryPool, poolMeshCount * (unsigned int)indexed_vertices.size(), poolMeshCount * (unsigned int)indices.size());
+        int side = (int)ceil(sqrt((float)poolMeshCount));
+        std::vector<vec3> poolVertices(indexed_vertices.size());
+        for (int m = 0; m < poolMeshCount; m++) {
+            vec3 offset = vec3(m % side - side / 2, 2, m / side - side / 2);
+            float phase = m * 0.7f;
+            for (size_t i = 0; i < indexed_vertices.size(); i++) {
+                // A function of the position only, so that vertices split on seams stay together
+                const vec3& p = indexed_vertices[i];
+                float bulge = 1.0f + 0.2f * sin(p.y * 3.0f + phase) * cos(p.x * 2.0f + phase);
+                poolVertices[i] = offset + 0.2f * bulge * p;
+            }
+            int mesh = addPoolMesh(geometryPool, poolVertices, indexed_uvs, indexed_normals, indices);
+            if (mesh == -1) break;
+            addPoolDraw(poolDraws, geometryPool, mesh, 0);
+        }
+        poolDraws.models.push_back(mat4(1.0f));
+        poolProgramID = LoadShaders("shaders/PoolVertexShader.vert", "shaders/FragmentShader.frag");
+        poolViewProjID = glGetUniformLocation(poolProgramID, "VP");
+        poolViewID = glGetUniformLocation(poolProgramID, "V");
+        poolLightID = glGetUniformLocation(poolProgramID, "LightPosition_worldspace");
+        poolTextureID = glGetUniformLocation(poolProgramID, "myTextureSampler");
+        printGeometryPoolStats(geometryPool);
+    }
+
+    glBindVertexArray(VertexArrayID);
+
+    initText2D(resolveAssetPath(cookedAssets, "CascadiaMono.dds").c_str(), width, height);
+
+    // Random lights for the benchmark scene
+    std::vector<PointLight> lights(lightCount);
+    for (int i = 0; i < lightCount; i++) {
+        lights[i].position = vec3(rand() / (float)RAND_MAX * 20 - 10, rand() / (float)RAND_MAX * 3, rand() / (float)RAND_MAX * 20 - 10);
+        lights[i].radius = 1.0f + rand() / (float)RAND_MAX;
+        lights[i].color = vec3(rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX);
+        lights[i].power = 2.0f;
+    }
+    ClusterGrid clusterGrid;
+    initClusterGrid(clusterGrid, 16, 9, 24, 0.1f, 100.0f);
+    ClusteredLightingBuffers clusterBuffers;
+    if (lightCount > 0) initClusteredLighting(clusterBuffers);
+    unsigned int workerThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Software occlusion culling, with the coarsest LOD of each object as its occluder
+    OcclusionCuller occlusionCuller;
+    initOcclusionCuller(occlusionCuller, 256, 128, workerThreads);
+    const MeshLOD& occluderLOD = lods.back();
+    vec3 meshMin = indexed_vertices[0], meshMax = indexed_vertices[0];
+    for (size_t i = 0; i < indexed_vertices.size(); i++) {
+        meshMin = min(meshMin, indexed_vertices[i]);
+        meshMax = max(meshMax, indexed_vertices[i]);
+    }
+    std::vector<Occluder> occluders;
+    std::vector<unsigned int> visibleObjects;
+
+    // Draws are recorded by worker threads, sorted, then submitted here
+    RenderQueue renderQueue;
+    initRenderQueue(renderQueue, workerThreads);
+
+    // Simulation thread : input, camera, transforms and lights, published as snapshots.
+    // This thread only renders the newest one, so a slow step never blocks presentation.
+    const double SIM_STEP = 1.0 / 120.0;
+    SnapshotTripleBuffer snapshots;
+    initSnapshotBuffer(snapshots);
+    ThreadActivity simActivity, renderActivity;
+    std::atomic<bool> running(true);
+
+    // One cube, or a 16x16 grid of cubes for the benchmark scene, below a root node : moving the root moves the grid.
+    // Node 0 is the root, so the world matrix of cube i is sceneGraph.worlds[i + 1].
+    int gridSize = lightCount > 0 || materialCount > 0 ? 16 : 1;
+    SceneGraph sceneGraph;
+    initSceneGraph(sceneGraph, gridSize * gridSize + 1);
+    addSceneNode(sceneGraph, -1, vec3(0), quat(1, 0, 0, 0), vec3(1));
+    for (int i = 0; i < gridSize * gridSize; i++) {
+        vec3 offset = vec3(i % gridSize - gridSize / 2, 0, i / gridSize - gridSize / 2);
+        addSceneNode(sceneGraph, 0, offset, quat(1, 0, 0, 0), vec3(0.2f, 0.2f, 0.2f));
+    }
+
+    std::thread simThread([&]() {
+        setTraceThreadName("simulation");
+        LatchedInput carried = { 0, 0.0, 0.0 };
+        unsigned int step = 0;
+        double nextStep = glfwGetTime();
+        while (running) {
+            double stepBegin = glfwGetTime();
+            TraceZone stepZone("simulation step");
+            SceneSnapshot& snapshot = beginSnapshotWrite(snapshots);
+            snapshot.step = step++;
+            snapshot.simTime = stepBegin;
+
+            latchInputEvents(input, camera);
+            snapshot.camera = camera;
+            computeCameraMatrices(camera, snapshot.projMat, snapshot.viewMat);
+
+            // Only the nodes moved since the last step are recomputed : nothing, once the grid is placed
+            updateSceneGraph(sceneGraph, 1);
+            snapshot.modelMats.assign(sceneGraph.worlds.begin() + 1, sceneGraph.worlds.end());
+            snapshot.boxes.resize(snapshot.modelMats.size());
+            for (size_t i = 0; i < snapshot.modelMats.size(); i++) {
+                // World space box : the model matrix is a translation + uniform scale
+                snapshot.boxes[i].min = vec3(snapshot.modelMats[i] * vec4(meshMin, 1));
+                snapshot.boxes[i].max = vec3(snapshot.modelMats[i] * vec4(meshMax, 1));
+            }
+
+            // Lights slowly orbit around the grid
+            mat4 lightRotation = rotate(mat4(1.0f), (float)stepBegin * 0.2f, vec3(0, 1, 0));
+            snapshot.lights = lights;
+            for (size_t i = 0; i < lights.size(); i++) {
+                snapshot.lights[i].position = vec3(lightRotation * vec4(lights[i].position, 1));
+            }
+
+            // Events of a snapshot that was never rendered are first shown by this one
+            snapshot.input = takeLatchedInput(input);
+            mergeLatchedInput(snapshot.input, carried);
+            snapshot.quit = isKeyDown(input, GLFW_KEY_ESCAPE);
+
+            TRACE_FLOW_BEGIN("snapshot", snapshot.step);
+            const SceneSnapshot* skipped = publishSnapshot(snapshots);
+            carried = skipped ? skipped->input : LatchedInput{ 0, 0.0, 0.0 };
+            addBusyInterval(simActivity, stepBegin, glfwGetTime());
+            stepZone.end();
+
+            // Fixed rate, without trying to catch up after a long stall
+            nextStep = std::max(nextStep + SIM_STEP, glfwGetTime() - SIM_STEP);
+            double wait = nextStep - glfwGetTime();
+            if (wait > 0.0) std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+        }
+    });
 
     glEnable(GL_DEPTH_TEST); // Enable Depth test
     glDepthFunc(GL_LESS);
@@ -118,110 +531,273 @@ int main()
 
     glClearColor(0.0f, 0.0f, 0.4f, 0.0f); // Clear color to dark blue
 
+    // The scene is rendered offscreen (anti-aliasing 4x) at a resolution that follows the frame budget
+    FrameGovernor governor;
+    initFrameGovernor(governor, frameBudget, fpsCap, 4, frameLogPath != NULL);
+
     double lastTime = glfwGetTime();
     int nbFrames = 0;
-    std::string text;
+    char text[32] = "";
+    InputLatencyStats inputLatency = { 0.0, 0.0, 0 };
+
+    // Wait for the first snapshot
+    bool fresh;
+    const SceneSnapshot* snapshot;
+    while ((snapshot = acquireSnapshot(snapshots, fresh)) == NULL) {
+        std::this_thread::yield();
+    }
+    LatchedInput frameInput = snapshot->input;
 
     do {
+        TRACE_ZONE("frame");
+
         // Print FPS
         double currentTime = glfwGetTime();
         nbFrames++;
         if (currentTime - lastTime >= 1.0) {
-            text = std::to_string(nbFrames) + " FPS";
-            printf("%s\n", text.c_str());
+            snprintf(text, sizeof(text), "%d FPS", nbFrames);
+            printf("%s\n", text);
+            if (lightCount > 0) {
+                printf("%d lights, %u light indices, binning %.3f ms\n", lightCount, (unsigned int)clusterGrid.lightIndices.size(), clusterGrid.binningTime);
+            }
+            printOcclusionStats(occlusionCuller);
+            printRenderQueueStats(renderQueue);
+            printInputLatency(inputLatency, input);
+            printFramePipelineStats(snapshots, simActivity, renderActivity, currentTime - 1.0, currentTime);
+            printFrameGovernorStats(governor);
+            printTextureStreamerStats(textureStreamer);
+            printMemoryStats(frameMemory().stats);
+            printGPUResourceStats();
+            if (meshletCulling) printMeshletCullStats(meshletStats);
+            if (poolMeshCount > 0) printGeometryPoolStats(geometryPool);
 
             nbFrames = 0;
             lastTime += 1.0;
         }
 
+        // Render the newest complete snapshot
+        snapshot = acquireSnapshot(snapshots, fresh);
+        if (fresh) {
+            mergeLatchedInput(frameInput, snapshot->input);
+            TRACE_FLOW_END("snapshot", snapshot->step);
+        }
+        const SceneSnapshot& scene = *snapshot;
+
+        {
+            TRACE_ZONE("texture streamer");
+            updateTextureStreamer(textureStreamer);
+        }
+
+        // Shader builds : swapped in once linked, never waited for
+        updateProgramBuilder(programBuilder);
+        if (updateShaderVariants(shaderVariants, ~0u) == 0 && precompileShaders) {
+            printShaderVariantStats(shaderVariants);
+            printProgramBuilderStats(programBuilder);
+            precompileShaders = false;
+        }
+        if (shaderVariants.generation != shaderGeneration) {
+            shaderGeneration = shaderVariants.generation;
+            programID = getShaderVariant(shaderVariants, variantMask);
+            lookUpUniforms();
+        }
+
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        beginScaledFrame(governor, framebufferWidth, framebufferHeight);
+
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         glUseProgram(programID); // Use GLSL program
 
-        // Bind texture
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture);
+        // Textures are bound by the render queue, only when they change
         glUniform1i(textureID, 0);
-
-        // Set vertex position data
-        glEnableVertexAttribArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-        glVertexAttribPointer(
-            0,          // attr 0 (same with shader)
-            3,          // size
-            GL_FLOAT,   // type
-            GL_FALSE,   // normalized?
-            0,          // stride
-            (void*)0    // array buffer offset
-        );
-
-        // Set UV data
-        glEnableVertexAttribArray(1);
-        glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-        glVertexAttribPointer(
-            1,
-            2,
-            GL_FLOAT,
-            GL_FALSE,
-            0,
-            (void*)0
-        );
-
-        // Set Normal data
-        glEnableVertexAttribArray(2);
-        glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-        glVertexAttribPointer(
-            2,
-            3,
-            GL_FLOAT,
-            GL_FALSE,
-            0,
-            (void*)0
-        );
-
-        // Set index data
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-
-        // Calculate MVP Matrix each frame
-        mat4 projMat, viewMat;
-        computeMatricesFromInputs(window, projMat, viewMat);
-        mat4 modelMat = scale(mat4(1.0f), vec3(0.2f, 0.2f, 0.2f));
-        mat4 mvpMat = projMat * viewMat * modelMat;
-
-        glUniformMatrix4fv(matrixID, 1, GL_FALSE, &mvpMat[0][0]); // Send MVP Matrix to shader
-        glUniformMatrix4fv(modelMatrixID, 1, GL_FALSE, &modelMat[0][0]); // Send Model Matrix to shader
-        glUniformMatrix4fv(viewMatrixID, 1, GL_FALSE, &viewMat[0][0]); // Send View Matrix to shader
+        glUniform1i(materialTexturesID, 0);
 
         vec3 lightPos = vec3(4, 4, 4);
         glUniform3f(lightID, lightPos.x, lightPos.y, lightPos.z); // Send Light position to shader
 
-        // Draw with VBO indexing
-        glDrawElements(
-            GL_TRIANGLES,
-            indices.size(),
-            GL_UNSIGNED_SHORT,
-            (void*)0
-        );
+        occluders.resize(scene.modelMats.size());
+        for (size_t i = 0; i < scene.modelMats.size(); i++) {
+            Occluder occluder = { &indexed_vertices, &lodIndices[occluderLOD.indexOffset], occluderLOD.indexCount, scene.modelMats[i] };
+            occluders[i] = occluder;
+        }
 
-        printText2D(text.c_str(), 50, 50, 50);
+        // Keep only the objects that aren't hidden by the others
+        {
+            TRACE_ZONE("occlusion culling");
+            beginOcclusionFrame(occlusionCuller, scene.projMat * scene.viewMat);
+            rasterizeOccluders(occlusionCuller, occluders);
+            buildDepthPyramid(occlusionCuller);
+            cullObjects(occlusionCuller, scene.boxes, visibleObjects);
+        }
+        TRACE_COUNTER("visible objects", visibleObjects.size());
+
+        // Record one draw packet per visible object, on the worker threads
+        mat4 viewProj = scene.projMat * scene.viewMat;
+        vec3 eye = vec3(inverse(scene.viewMat)[3]);
+        beginRenderQueue(renderQueue);
+        recordCommands(renderQueue, (unsigned int)visibleObjects.size(), [&](CommandBuffer& commands, unsigned int begin, unsigned int end) {
+            TRACE_ZONE("record commands");
+            for (unsigned int v = begin; v < end; v++) {
+                const mat4& modelMat = scene.modelMats[visibleObjects[v]];
+
+                // Select LOD from the projected error (1 pixel max)
+                vec3 center_cameraspace = vec3(scene.viewMat * modelMat * vec4(0, 0, 0, 1));
+                int lodIndex = selectLOD(lods, length(center_cameraspace), 0.2f, scene.projMat, (float)scene.camera.height, 1.0f);
+                const MeshLOD& lod = lods[lodIndex];
+
+                // Visible meshlets, as ranges that live in frame memory until the swap
+                GLsizei rangeCount = 0;
+                GLsizei* rangeCounts = NULL;
+                const void** rangeOffsets = NULL;
+                if (meshletCulling) {
+                    unsigned int first = lodMeshlets[lodIndex], count = lodMeshlets[lodIndex + 1] - first;
+                    rangeCounts = (GLsizei*)frameAllocate(frameMemory(), count * sizeof(GLsizei), alignof(GLsizei));
+                    rangeOffsets = (const void**)frameAllocate(frameMemory(), count * sizeof(void*), alignof(void*));
+                    rangeCount = cullMeshlets(&meshlets[first], count, viewProj, modelMat, eye, rangeCounts, rangeOffsets, meshletStats);
+                    if (rangeCount == 0) continue;
+                }
+
+                DrawData* draw = allocateDrawData(commands);
+                draw->program = programID;
+                draw->mvpLocation = matrixID;
+                draw->modelLocation = modelMatrixID;
+                draw->texture = texture;
+                draw->textureTarget = GL_TEXTURE_2D;
+                draw->materialRectLocation = -1;
+                draw->materialLayerLocation = -1;
+                if (materialCount > 0) {
+                    // Materials that share an array only differ by these uniforms
+                    const MaterialSlot& slot = materials.slots[visibleObjects[v] % materials.slots.size()];
+                    draw->texture = slot.texture;
+                    draw->textureTarget = GL_TEXTURE_2D_ARRAY;
+                    draw->materialRectLocation = materialRectID;
+                    draw->materialLayerLocation = materialLayerID;
+                    draw->materialRect = slot.uvRect;
+                    draw->materialLayer = slot.layer;
+                }
+                draw->vao = meshVAO;
+                draw->indexCount = lod.indexCount;
+                draw->indexOffset = lod.indexOffset;
+                draw->rangeCount = rangeCount;
+                draw->rangeCounts = rangeCounts;
+                draw->rangeOffsets = rangeOffsets;
+                draw->model = modelMat;
+
+                // Front to back inside a state bucket
+                float depth = -center_cameraspace.z / 100.0f;
+                addDrawPacket(commands, makeSortKey(0, programID, draw->texture, meshVAO, depth), draw);
+            }
+        });
+
+        // Sort by state and draw everything from this thread
+        {
+            TRACE_ZONE("sort");
+            sortRenderQueue(renderQueue);
+        }
+
+        // Late latch : a newer snapshot may have been published while recording.
+        // From here on, the snapshot used for recording must not be read anymore.
+        glfwPollEvents();
+        snapshot = acquireSnapshot(snapshots, fresh);
+        if (fresh) {
+            mergeLatchedInput(frameInput, snapshot->input);
+            TRACE_FLOW_END("snapshot", snapshot->step);
+        }
+        const SceneSnapshot& latest = *snapshot;
+
+        glUseProgram(programID);
+        glUniformMatrix4fv(viewMatrixID, 1, GL_FALSE, &latest.viewMat[0][0]); // Send View Matrix to shader
+
+        // Bin the lights into clusters and send them to the shader
+        if (lightCount > 0) {
+            TRACE_ZONE("lights");
+            binLights(clusterGrid, latest.lights, latest.viewMat, latest.projMat, workerThreads);
+            uploadClusteredLighting(clusterBuffers, clusterGrid);
+            bindClusteredLighting(clusterBuffers, clusterGrid, programID, 1, (float)governor.renderWidth, (float)governor.renderHeight);
+        }
 
-        glDisableVertexAttribArray(0);
-        glDisableVertexAttribArray(1);
-        glDisableVertexAttribArray(2);
+        {
+            TRACE_ZONE("submit");
+            submitRenderQueue(renderQueue, latest.projMat * latest.viewMat);
+        }
 
-        glfwSwapBuffers(window);
+        // The pooled cubes : the whole pass from one command buffer
+        if (poolMeshCount > 0) {
+            TRACE_ZONE("geometry pool");
+            mat4 poolViewProj = latest.projMat * latest.viewMat;
+            glUseProgram(poolProgramID);
+            glUniformMatrix4fv(poolViewProjID, 1, GL_FALSE, &poolViewProj[0][0]);
+            glUniformMatrix4fv(poolViewID, 1, GL_FALSE, &latest.viewMat[0][0]);
+            glUniform3f(poolLightID, lightPos.x, lightPos.y, lightPos.z);
+            glUniform1i(poolTextureID, 0);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            drawGeometryPool(geometryPool, poolDraws);
+        }
+        recordInputLatency(inputLatency, frameInput, glfwGetTime());
+        frameInput = LatchedInput{ 0, 0.0, 0.0 };
+
+        // Upscale, then draw the text at full resolution
+        endScaledFrame(governor, framebufferWidth, framebufferHeight);
+
+        glBindVertexArray(VertexArrayID);
+        printText2D(text, 50, 50, 50);
+
+        // Waiting for vsync isn't counted as busy
+        addBusyInterval(renderActivity, currentTime, glfwGetTime());
+        {
+            TRACE_ZONE("present");
+            paceFrame(governor);
+            endGLCaptureFrame();
+            glfwSwapBuffers(window);
+        }
+        resetFrameAllocator(frameMemory());
         glfwPollEvents();
     }
-    while(glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS && glfwWindowShouldClose(window) == 0);
+    while(!snapshot->quit && glfwWindowShouldClose(window) == 0);
+
+    running = false;
+    simThread.join();
+    printSceneGraphStats(sceneGraph);
 
     // Cleanup
-    glDeleteBuffers(1, &vertexbuffer);
-    glDeleteBuffers(1, &uvbuffer);
-    glDeleteProgram(programID);
-    glDeleteTextures(1, &texture);
-    glDeleteVertexArrays(1, &VertexArrayID);
+    deleteGPUResource(GPU_BUFFER, vertexbuffer);
+    deleteGPUResource(GPU_BUFFER, uvbuffer);
+    deleteGPUResource(GPU_BUFFER, normalbuffer);
+    deleteGPUResource(GPU_BUFFER, elementbuffer);
+    printShaderVariantStats(shaderVariants);
+    cleanupShaderVariants(shaderVariants);
+    printProgramBuilderStats(programBuilder);
+    cleanupProgramBuilder(programBuilder);
+    cleanupFileWatcher(shaderWatcher);
+    deleteGPUResource(GPU_TEXTURE, texture);
+    deleteGPUResource(GPU_VERTEX_ARRAY, VertexArrayID);
+    deleteGPUResource(GPU_VERTEX_ARRAY, meshVAO);
+    if (poolMeshCount > 0) {
+        cleanupGeometryPool(geometryPool);
+        deleteGPUResource(GPU_PROGRAM, poolProgramID);
+    }
+    cleanupRenderQueue(renderQueue);
+    cleanupMaterialTextures(materials);
+
+    if (lightCount > 0) cleanupClusteredLighting(clusterBuffers);
+
+    if (frameLogPath != NULL) writeFrameGovernorLog(governor, frameLogPath);
+    cleanupFrameGovernor(governor);
+    cleanupTextureStreamer(textureStreamer);
+    cleanupArena(loadArena);
+
+    // After the streamer and shader variant workers are joined : they record events too
+    if (tracePath != NULL) {
+        writeChromeTrace(tracePath);
+        printTraceStats();
+        cleanupTrace();
+    }
 
     cleanupText2D();
+    reportGPUResourceLeaks();
+    stopGLCapture();
     glfwTerminate();
 
     return 0;
@@ -0,0 +1,60 @@
+#version 330 core
+
+// Input UV data
+in vec2 UV;
+in vec3 Position_worldspace;
+in vec3 Normal_cameraspace;
+in vec3 EyeDirection_cameraspace;
+
+// Output color data
+out vec3 color;
+
+uniform sampler2D myTextureSampler;
+
+// Light clusters (see common/clusteredlighting.cpp)
+uniform usamplerBuffer ClusterGrid;  // offset, count
+uniform usamplerBuffer LightIndices;
+uniform samplerBuffer LightData;     // view space position + radius, color * power
+uniform ivec3 ClusterCount;
+uniform vec2 TileSize;
+uniform float ZNear;
+uniform float SliceScale;
+
+#include "Lighting.glsl"
+
+void main() {
+    vec3 MaterialDiffuseColor = texture(myTextureSampler, UV).rgb; // Get color from texture rgb
+    vec3 MaterialAmbientColor = AMBIENT_COLOR * MaterialDiffuseColor;
+
+    vec3 n = normalize(Normal_cameraspace);
+#if NORMAL_MAPPING
+    n = bumpNormal(n, -EyeDirection_cameraspace, MaterialDiffuseColor);
+#endif
+    vec3 E = normalize(EyeDirection_cameraspace);
+
+    // Find our cluster : screen tile + exponential depth slice
+    float depth = EyeDirection_cameraspace.z; // = -z of the fragment in camera space
+    int slice = clamp(int(log(max(depth, ZNear) / ZNear) * SliceScale), 0, ClusterCount.z - 1);
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / TileSize), ivec2(0), ClusterCount.xy - 1);
+    int cluster = (slice * ClusterCount.y + tile.y) * ClusterCount.x + tile.x;
+    uvec2 range = texelFetch(ClusterGrid, cluster).xy;
+
+    color = MaterialAmbientColor;
+
+    // Only the lights of this cluster
+    for (uint i = 0u; i < range.y; i++) {
+        int light = int(texelFetch(LightIndices, int(range.x + i)).x);
+        vec4 positionRadius = texelFetch(LightData, light * 2);
+        vec3 LightColor = texelFetch(LightData, light * 2 + 1).rgb; // color * power
+
+        vec3 LightDirection_cameraspace = positionRadius.xyz + EyeDirection_cameraspace;
+        float distance = length(LightDirection_cameraspace);
+
+        // Fade to 0 at the radius, so that the light can't leak out of its clusters
+        float window = clamp(1.0 - pow(distance / positionRadius.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (distance * distance);
+
+        vec3 l = LightDirection_cameraspace / distance;
+        color += shadeLight(MaterialDiffuseColor, n, l, E, LightColor * attenuation);
+    }
+}
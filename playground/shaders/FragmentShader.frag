@@ -1,38 +1,44 @@
 #version 330 core
 
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 1
+#endif
+
 // Input UV data
 in vec2 UV;
 in vec3 Position_worldspace;
 in vec3 Normal_cameraspace;
 in vec3 EyeDirection_cameraspace;
-in vec3 LightDirection_cameraspace;
 
 // Output color data
 out vec3 color;
 
 uniform sampler2D myTextureSampler;
-uniform mat4 MV;
-uniform vec3 LightPosition_worldspace;
+uniform mat4 V;
+#if LIGHT_COUNT > 0
+uniform vec3 LightPosition_worldspace[LIGHT_COUNT];
+#endif
 
-void main() {
-    vec3 LightColor = vec3(1, 1, 1);
-    float LightPower = 50.0f;
+#include "Lighting.glsl"
 
+void main() {
     vec3 MaterialDiffuseColor = texture(myTextureSampler, UV).rgb; // Get color from texture rgb
-    vec3 MaterialAmbientColor = vec3(0.1, 0.1, 0.1) * MaterialDiffuseColor; // Multiply 0.1 for ambient light
-    vec3 MaterialSpecularColor = vec3(0.3, 0.3, 0.3); // Reflect color
-
-    float distance = length(LightPosition_worldspace - Position_worldspace);
+    vec3 MaterialAmbientColor = AMBIENT_COLOR * MaterialDiffuseColor;
 
     vec3 n = normalize(Normal_cameraspace);
-    vec3 l = normalize(LightDirection_cameraspace);
-    float cosTheta = clamp(dot(n, l), 0, 1);
-
+#if NORMAL_MAPPING
+    n = bumpNormal(n, -EyeDirection_cameraspace, MaterialDiffuseColor);
+#endif
     vec3 E = normalize(EyeDirection_cameraspace);
-    vec3 R = reflect(-l, n);
-    float cosAlpha = clamp(dot(E, R), 0, 1);
 
-	color = MaterialAmbientColor +
-	        MaterialDiffuseColor * LightColor * LightPower * cosTheta / (distance * distance) +
-	        MaterialSpecularColor * LightColor * LightPower * pow(cosAlpha, 5) / (distance * distance);
-}
\ No newline at end of file
+    color = MaterialAmbientColor;
+
+    // Unrolled : the count is known when compiling
+#if LIGHT_COUNT > 0
+    for (int i = 0; i < LIGHT_COUNT; i++) {
+        float distance = length(LightPosition_worldspace[i] - Position_worldspace);
+        vec3 l = normalize((V * vec4(LightPosition_worldspace[i], 1)).xyz + EyeDirection_cameraspace);
+        color += shadeLight(MaterialDiffuseColor, n, l, E, LIGHT_COLOR * LIGHT_POWER / (distance * distance));
+    }
+#endif
+}
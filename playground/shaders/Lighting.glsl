@@ -0,0 +1,47 @@
+// Shared by the fragment shaders. Every constant can be overridden per program with a #define (see shadervariants.hpp) :
+// they are literals in the compiled code, not uniforms.
+
+#ifndef LIGHT_COLOR
+#define LIGHT_COLOR vec3(1, 1, 1)
+#endif
+#ifndef LIGHT_POWER
+#define LIGHT_POWER 50.0
+#endif
+#ifndef AMBIENT_COLOR
+#define AMBIENT_COLOR vec3(0.1, 0.1, 0.1) // Multiplied by the diffuse color
+#endif
+#ifndef SPECULAR_COLOR
+#define SPECULAR_COLOR vec3(0.3, 0.3, 0.3) // Reflect color
+#endif
+#ifndef SPECULAR_EXPONENT
+#define SPECULAR_EXPONENT 5.0
+#endif
+#ifndef NORMAL_MAPPING
+#define NORMAL_MAPPING 0
+#endif
+#ifndef BUMP_SCALE
+#define BUMP_SCALE 0.02
+#endif
+
+// Diffuse and specular of one light, times what reaches the surface (color * power * attenuation).
+// n, l, E : normal, to the light, to the eye, normalized.
+vec3 shadeLight(vec3 MaterialDiffuseColor, vec3 n, vec3 l, vec3 E, vec3 radiance) {
+    float cosTheta = clamp(dot(n, l), 0, 1);
+    vec3 R = reflect(-l, n);
+    float cosAlpha = clamp(dot(E, R), 0, 1);
+    return radiance * (MaterialDiffuseColor * cosTheta + SPECULAR_COLOR * pow(cosAlpha, SPECULAR_EXPONENT));
+}
+
+// Normal mapping without a normal map or tangents : the luminance of the diffuse texture is the height,
+// its screen space derivatives tilt the normal (Mikkelsen, "Bump Mapping Unparametrized Surfaces on the GPU").
+// position : of the fragment, in the space of n.
+vec3 bumpNormal(vec3 n, vec3 position, vec3 MaterialDiffuseColor) {
+    float height = dot(MaterialDiffuseColor, vec3(0.299, 0.587, 0.114));
+    vec3 dpdx = dFdx(position);
+    vec3 dpdy = dFdy(position);
+    vec3 r1 = cross(dpdy, n);
+    vec3 r2 = cross(n, dpdx);
+    float det = dot(dpdx, r1);
+    vec3 gradient = sign(det) * (dFdx(height) * r1 + dFdy(height) * r2);
+    return normalize(abs(det) * n - BUMP_SCALE * gradient);
+}
@@ -0,0 +1,49 @@
+#version 330 core
+
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 1
+#endif
+
+// Input UV data
+in vec2 UV;
+in vec3 Position_worldspace;
+in vec3 Normal_cameraspace;
+in vec3 EyeDirection_cameraspace;
+
+// Output color data
+out vec3 color;
+
+// Material : a layer of a texture array, and the rectangle of that layer the material covers
+uniform sampler2DArray materialTextures;
+uniform vec4 materialRect; // offset in xy, scale in zw
+uniform float materialLayer;
+uniform mat4 V;
+#if LIGHT_COUNT > 0
+uniform vec3 LightPosition_worldspace[LIGHT_COUNT];
+#endif
+
+#include "Lighting.glsl"
+
+void main() {
+    // Repeat inside the rectangle. The gradients come from the unwrapped UVs, so the wrap doesn't select the smallest mip.
+    vec2 materialUV = materialRect.xy + fract(UV) * materialRect.zw;
+    vec3 MaterialDiffuseColor = textureGrad(materialTextures, vec3(materialUV, materialLayer), dFdx(UV) * materialRect.zw, dFdy(UV) * materialRect.zw).rgb;
+    vec3 MaterialAmbientColor = AMBIENT_COLOR * MaterialDiffuseColor;
+
+    vec3 n = normalize(Normal_cameraspace);
+#if NORMAL_MAPPING
+    n = bumpNormal(n, -EyeDirection_cameraspace, MaterialDiffuseColor);
+#endif
+    vec3 E = normalize(EyeDirection_cameraspace);
+
+    color = MaterialAmbientColor;
+
+    // Unrolled : the count is known when compiling
+#if LIGHT_COUNT > 0
+    for (int i = 0; i < LIGHT_COUNT; i++) {
+        float distance = length(LightPosition_worldspace[i] - Position_worldspace);
+        vec3 l = normalize((V * vec4(LightPosition_worldspace[i], 1)).xyz + EyeDirection_cameraspace);
+        color += shadeLight(MaterialDiffuseColor, n, l, E, LIGHT_COLOR * LIGHT_POWER / (distance * distance));
+    }
+#endif
+}
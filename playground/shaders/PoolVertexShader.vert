@@ -0,0 +1,28 @@
+#version 330 core
+
+// Input vertex, uv, normal data, from the geometry pool
+layout(location = 0) in vec3 vertexPosition_modelspace;
+layout(location = 1) in vec2 vertexUV;
+layout(location = 2) in vec3 vertexNormal_modelspace;
+// Model matrix, one per instance : each draw selects its own with its base instance
+layout(location = 4) in mat4 M;
+
+out vec2 UV;
+out vec3 Position_worldspace;
+out vec3 Normal_cameraspace;
+out vec3 EyeDirection_cameraspace;
+
+uniform mat4 VP; // Input View * Projection matrix
+uniform mat4 V; // Input View matrix
+
+void main() {
+    Position_worldspace = (M * vec4(vertexPosition_modelspace, 1)).xyz;
+    gl_Position = VP * vec4(Position_worldspace, 1);
+
+    vec3 vertexPosition_cameraspace = (V * vec4(Position_worldspace, 1)).xyz;
+    EyeDirection_cameraspace = vec3(0, 0, 0) - vertexPosition_cameraspace;
+
+    Normal_cameraspace = (V * M * vec4(vertexNormal_modelspace,0)).xyz;
+
+    UV = vertexUV;
+}
\ No newline at end of file
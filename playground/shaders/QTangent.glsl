@@ -0,0 +1,8 @@
+// The quaternion rotates x, y, z to the tangent, the bitangent and the normal.
+// The sign of w is the handedness of the bitangent.
+void decodeQTangent(vec4 q, out vec3 normal, out vec3 tangent, out vec3 bitangent) {
+    q = normalize(q);
+    tangent = vec3(1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y + q.w * q.z), 2.0 * (q.x * q.z - q.w * q.y));
+    normal = vec3(2.0 * (q.x * q.z + q.w * q.y), 2.0 * (q.y * q.z - q.w * q.x), 1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+    bitangent = cross(normal, tangent) * (q.w < 0.0 ? -1.0 : 1.0);
+}
@@ -1,20 +1,30 @@
 #version 330 core
 
-// Input vertex, uv, normal data
+#ifndef QTANGENT
+#define QTANGENT 0
+#endif
+
+// Input vertex, uv, normal data : float normals, or the tangent frame as a quaternion (4 x snorm16, see packQTangents)
 layout(location = 0) in vec3 vertexPosition_modelspace;
 layout(location = 1) in vec2 vertexUV;
+#if QTANGENT
+layout(location = 2) in vec4 vertexQTangent;
+#else
 layout(location = 2) in vec3 vertexNormal_modelspace;
+#endif
 
 out vec2 UV;
 out vec3 Position_worldspace;
 out vec3 Normal_cameraspace;
 out vec3 EyeDirection_cameraspace;
-out vec3 LightDirection_cameraspace;
 
 uniform mat4 MVP; // Input MVP matrix
 uniform mat4 V; // Input View matrix
 uniform mat4 M; // Input Model matrix
-uniform vec3 LightPosition_worldspace; // Input light position
+
+#if QTANGENT
+#include "QTangent.glsl"
+#endif
 
 void main() {
     gl_Position = MVP * vec4(vertexPosition_modelspace, 1);
@@ -24,10 +34,14 @@ void main() {
     vec3 vertexPosition_cameraspace = (V * M * vec4(vertexPosition_modelspace, 1)).xyz;
     EyeDirection_cameraspace = vec3(0, 0, 0) - vertexPosition_cameraspace;
 
-    vec3 LightPosition_cameraspace = (V * vec4(LightPosition_worldspace,1)).xyz;
-    LightDirection_cameraspace = LightPosition_cameraspace + EyeDirection_cameraspace;
-
+#if QTANGENT
+    // Only the normal : the bump path (Lighting.glsl) works from screen space derivatives, not from the tangents
+    vec3 normal, tangent, bitangent;
+    decodeQTangent(vertexQTangent, normal, tangent, bitangent);
+    Normal_cameraspace = (V * M * vec4(normal,0)).xyz;
+#else
     Normal_cameraspace = (V * M * vec4(vertexNormal_modelspace,0)).xyz;
+#endif
 
     UV = vertexUV;
-}
\ No newline at end of file
+}
@@ -0,0 +1,1008 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+using namespace glm;
+
+#include <common/clusteredlighting.hpp>
+#include <common/dds.hpp>
+#include <common/cookedassets.hpp>
+#include <common/bcdecode.hpp>
+#include <common/memory.hpp>
+#include <common/parallel.hpp>
+#include <common/scenegraph.hpp>
+#include <common/tangentspace.hpp>
+
+// Checks of the common/ code that needs no GL context.
+//   tests [NAME...]
+// Runs the named checks, or all of them. Each one prints its failures, the first few of them, and a summary line.
+// The exit code is the number of checks that failed : CTest runs them one by one (see CMakeLists.txt).
+
+static unsigned int failures; // of the running check
+
+static void expect(bool condition, const char * format, ...){
+    if (condition)
+        return;
+    if (failures++ < 10){
+        va_list args;
+        va_start(args, format);
+        printf("  FAILED : ");
+        vprintf(format, args);
+        printf("\n");
+        va_end(args);
+    }
+}
+
+static float randomFloat(float lo, float hi){
+    return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+// View space point of a cluster : u, v, w in [0, 1] across its tile and its depth slice
+static vec3 clusterPoint(const ClusterGrid & grid, const mat4 & projMat, unsigned int x, unsigned int y, unsigned int z, float u, float v, float w){
+    float depth = grid.zNear * pow(grid.zFar / grid.zNear, (z + w) / grid.slices);
+    float ndcX = -1.0f + 2.0f * (x + u) / grid.tilesX;
+    float ndcY = -1.0f + 2.0f * (y + v) / grid.tilesY;
+    return vec3(ndcX * depth / projMat[0][0], ndcY * depth / projMat[1][1], -depth);
+}
+
+// binLights against brute force : every cluster with a point inside a light has that light, every listed light
+// touches the depth range of its slice, and the lists don't depend on the thread count.
+static void checkBinLights(){
+    ClusterGrid grid, threaded;
+    initClusterGrid(grid, 16, 9, 24, 0.1f, 100.0f);
+    initClusterGrid(threaded, 16, 9, 24, 0.1f, 100.0f);
+    mat4 projMat = perspective(radians(45.0f), 16.0f / 9.0f, grid.zNear, grid.zFar);
+    mat4 viewMat = lookAt(vec3(0, 2, 5), vec3(0, 0, -10), vec3(0, 1, 0));
+
+    // In front of the camera, behind it, and beyond the far plane
+    srand(1);
+    std::vector<PointLight> lights(300);
+    for (size_t i=0; i<lights.size(); i++){
+        lights[i].position = vec3(randomFloat(-30, 30), randomFloat(-8, 12), randomFloat(-110, 15));
+        lights[i].radius = randomFloat(0.2f, 6.0f);
+        lights[i].color = vec3(1.0f);
+        lights[i].power = 1.0f;
+    }
+    binLights(grid, lights, viewMat, projMat, 1);
+    binLights(threaded, lights, viewMat, projMat, 4);
+    expect(grid.clusters == threaded.clusters && grid.lightIndices == threaded.lightIndices, "4 threads bin differently from 1");
+
+    // Samples of each cluster, on a 5x5x5 lattice : corners, edges, faces and inside
+    const unsigned int steps = 5;
+    unsigned int expected = 0, binned = (unsigned int)grid.lightIndices.size();
+    std::vector<vec3> points;
+    for (unsigned int z=0; z<grid.slices; z++){
+        float sliceNear = grid.zNear * pow(grid.zFar / grid.zNear, (float)z / grid.slices);
+        float sliceFar = grid.zNear * pow(grid.zFar / grid.zNear, (float)(z + 1) / grid.slices);
+        for (unsigned int y=0; y<grid.tilesY; y++){
+            for (unsigned int x=0; x<grid.tilesX; x++){
+                unsigned int cluster = (z * grid.tilesY + y) * grid.tilesX + x;
+                unsigned int offset = grid.clusters[cluster * 2], count = grid.clusters[cluster * 2 + 1];
+                const unsigned int * list = count ? &grid.lightIndices[offset] : NULL;
+                expect(offset + count <= grid.lightIndices.size(), "cluster %u : list out of range", cluster);
+                if (offset + count > grid.lightIndices.size())
+                    continue;
+                for (unsigned int k=1; k<count; k++)
+                    expect(list[k-1] < list[k], "cluster %u : list not sorted or with duplicates", cluster);
+
+                points.clear();
+                for (unsigned int i=0; i<steps*steps*steps; i++)
+                    points.push_back(clusterPoint(grid, projMat, x, y, z,
+                        (i % steps) / (float)(steps - 1), (i / steps % steps) / (float)(steps - 1), (i / steps / steps) / (float)(steps - 1)));
+
+                for (unsigned int l=0; l<lights.size(); l++){
+                    vec3 center = vec3(viewMat * vec4(lights[l].position, 1.0f));
+                    float radius = lights[l].radius;
+                    bool touched = false;
+                    for (size_t p=0; p<points.size() && !touched; p++)
+                        touched = distance(points[p], center) < radius * 0.999f;
+                    bool listed = std::binary_search(list, list + count, l);
+                    if (touched){
+                        expected++;
+                        expect(listed, "cluster (%u %u %u) : light %u missing", x, y, z, l);
+                    }
+                    if (listed)
+                        expect(-center.z + radius >= sliceNear * 0.999f && -center.z - radius <= sliceFar * 1.001f,
+                            "cluster (%u %u %u) : light %u listed outside of its depth range", x, y, z, l);
+                }
+            }
+        }
+    }
+    printf("  %u lights, %u clusters : %u light references, %u of them found by sampling (%.2fx)\n",
+        (unsigned int)lights.size(), grid.tilesX * grid.tilesY * grid.slices, binned, expected, expected ? (double)binned / expected : 0.0);
+    expect(expected > 0, "no light touches any cluster : the check checks nothing");
+}
+
+// A copy of bytes that ends right before an unreadable page : reading past its end crashes the check
+struct GuardedCopy {
+    unsigned char * data;
+    unsigned char * mapping;
+    size_t mappingSize;
+};
+
+static void guardedCopy(const std::vector<unsigned char> & bytes, GuardedCopy & copy){
+#ifndef _WIN32
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t pages = (bytes.size() + page - 1) / page + 1;
+    copy.mappingSize = pages * page;
+    copy.mapping = (unsigned char *)mmap(NULL, copy.mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    mprotect(copy.mapping + copy.mappingSize - page, page, PROT_NONE);
+    copy.data = copy.mapping + copy.mappingSize - page - bytes.size();
+#else
+    copy.mappingSize = bytes.size() + 1;
+    copy.mapping = new unsigned char[copy.mappingSize];
+    copy.data = copy.mapping;
+#endif
+    if (!bytes.empty())
+        memcpy(copy.data, &bytes[0], bytes.size());
+}
+
+static void freeGuardedCopy(GuardedCopy & copy){
+#ifndef _WIN32
+    munmap(copy.mapping, copy.mappingSize);
+#else
+    delete[] copy.mapping;
+#endif
+}
+
+static void putUint(std::vector<unsigned char> & bytes, size_t offset, unsigned int value){
+    memcpy(&bytes[offset], &value, 4);
+}
+
+#define FOURCC(a, b, c, d) ((unsigned int)(a) | ((unsigned int)(b) << 8) | ((unsigned int)(c) << 16) | ((unsigned int)(d) << 24))
+
+// Legacy header of a 2D texture with a FourCC format, without data
+static std::vector<unsigned char> ddsHeader(unsigned int width, unsigned int height, unsigned int levels, unsigned int fourCC){
+    std::vector<unsigned char> bytes(4 + 124, 0);
+    memcpy(&bytes[0], "DDS ", 4);
+    putUint(bytes, 4, 124);
+    putUint(bytes, 8, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000); // caps, height, width, pixel format, mip count
+    putUint(bytes, 12, height);
+    putUint(bytes, 16, width);
+    putUint(bytes, 28, levels);
+    putUint(bytes, 76, 32);
+    putUint(bytes, 80, 0x4); // FourCC
+    putUint(bytes, 84, fourCC);
+    putUint(bytes, 108, 0x1000);
+    return bytes;
+}
+
+// DX10 header : dimension 3 is 2D, misc 0x4 a cubemap
+static std::vector<unsigned char> dx10Header(unsigned int width, unsigned int height, unsigned int levels,
+    unsigned int dxgi, unsigned int dimension, unsigned int misc, unsigned int layers){
+    std::vector<unsigned char> bytes = ddsHeader(width, height, levels, FOURCC('D','X','1','0'));
+    bytes.resize(4 + 124 + 20, 0);
+    putUint(bytes, 128, dxgi);
+    putUint(bytes, 132, dimension);
+    putUint(bytes, 136, misc);
+    putUint(bytes, 140, layers);
+    return bytes;
+}
+
+// Header followed by the bytes its surfaces need, or 0 if it doesn't parse
+static size_t withData(std::vector<unsigned char> & bytes){
+    DDSImage image;
+    GuardedCopy copy;
+    std::vector<unsigned char> big(bytes);
+    big.resize(bytes.size() + (1 << 22), 0);
+    guardedCopy(big, copy);
+    bool parsed = parseDDS(copy.data, big.size(), image, NULL);
+    freeGuardedCopy(copy);
+    if (!parsed || image.surfaces.empty())
+        return 0;
+    const DDSSurface & last = image.surfaces.back();
+    bytes.resize(last.offset + last.size, 0xA5);
+    return bytes.size();
+}
+
+// Parses a guarded copy. Whatever is accepted must describe every surface, each inside the file and after the header.
+static bool parseGuarded(const std::vector<unsigned char> & bytes, DDSImage & image, const char * what){
+    GuardedCopy copy;
+    guardedCopy(bytes, copy);
+    const char * error = NULL;
+    bool parsed = parseDDS(copy.data, bytes.size(), image, &error);
+    freeGuardedCopy(copy);
+    if (!parsed){
+        expect(error != NULL, "%s : rejected without a reason", what);
+        return false;
+    }
+    expect(image.surfaces.size() == (size_t)image.layers * image.faces * image.levels, "%s : %u surfaces for %u x %u x %u",
+        what, (unsigned int)image.surfaces.size(), image.layers, image.faces, image.levels);
+    for (size_t i=0; i<image.surfaces.size(); i++){
+        const DDSSurface & surface = image.surfaces[i];
+        expect(surface.offset >= 128 && surface.size > 0 && surface.offset <= bytes.size() && surface.size <= bytes.size() - surface.offset,
+            "%s : surface %u at %u, %u bytes, outside of the %u bytes", what, (unsigned int)i,
+            (unsigned int)surface.offset, (unsigned int)surface.size, (unsigned int)bytes.size());
+    }
+    return true;
+}
+
+static void expectRejected(const std::vector<unsigned char> & bytes, const char * what){
+    DDSImage image;
+    expect(!parseGuarded(bytes, image, what), "%s : accepted", what);
+}
+
+// parseDDS on broken and hostile files : each is rejected, reading nothing past the end of the buffer
+// (it is followed by an unreadable page), and whatever random mutations get through stays inside the file.
+static void checkParseDDS(){
+    DDSImage image;
+    std::vector<unsigned char> dxt1 = ddsHeader(64, 64, 7, FOURCC('D','X','T','1'));
+    std::vector<unsigned char> cubes = dx10Header(16, 16, 5, 98, 3, 0x4, 2); // BC7 cubemap array
+    expect(withData(dxt1) == 128 + 8 * (256 + 64 + 16 + 4 + 1 + 1 + 1), "DXT1 64x64 : wrong size %u", (unsigned int)dxt1.size());
+    expect(withData(cubes) > 0, "BC7 cubemap array : rejected");
+    expect(parseGuarded(dxt1, image, "DXT1") && image.levels == 7 && image.target == GL_TEXTURE_2D, "DXT1 64x64 : not read back");
+    expect(parseGuarded(cubes, image, "BC7 cubes") && image.surfaces.size() == 2 * 6 * 5 && image.target == GL_TEXTURE_CUBE_MAP_ARRAY,
+        "BC7 cubemap array : not read back");
+
+    // Truncated anywhere : in the magic, the header, the DX10 header or any surface
+    char what[64];
+    for (size_t size=0; size<dxt1.size(); size++){
+        snprintf(what, sizeof(what), "DXT1 cut at %u", (unsigned int)size);
+        expectRejected(std::vector<unsigned char>(dxt1.begin(), dxt1.begin() + size), what);
+    }
+    for (size_t size=0; size<cubes.size(); size++){
+        snprintf(what, sizeof(what), "BC7 cubes cut at %u", (unsigned int)size);
+        expectRejected(std::vector<unsigned char>(cubes.begin(), cubes.begin() + size), what);
+    }
+
+    // Oversized : trailing bytes are ignored, oversized header fields are not
+    std::vector<unsigned char> bytes = dxt1;
+    bytes.resize(dxt1.size() + 1000, 0);
+    expect(parseGuarded(bytes, image, "DXT1 with trailing bytes") && image.levels == 7, "DXT1 with trailing bytes : rejected");
+    bytes = dxt1;
+    putUint(bytes, 4, 0xFFFFFFFF);
+    expectRejected(bytes, "header size 0xFFFFFFFF");
+    bytes = dxt1;
+    putUint(bytes, 76, 0xFFFFFFFF);
+    expectRejected(bytes, "pixel format size 0xFFFFFFFF");
+    bytes = dxt1;
+    putUint(bytes, 28, 8);
+    expectRejected(bytes, "64x64 with 8 levels");
+    bytes = dxt1;
+    putUint(bytes, 28, 0xFFFFFFFF);
+    expectRejected(bytes, "0xFFFFFFFF levels");
+
+    // Bad FourCC, or none
+    const unsigned int fourCCs[] = { 0, FOURCC('D','X','T','9'), FOURCC('d','x','t','1'), FOURCC('B','C','7',' '), 0xFFFFFFFF };
+    for (size_t i=0; i<sizeof(fourCCs) / sizeof(fourCCs[0]); i++){
+        bytes = dxt1;
+        putUint(bytes, 84, fourCCs[i]);
+        snprintf(what, sizeof(what), "FourCC 0x%08X", fourCCs[i]);
+        expectRejected(bytes, what);
+    }
+    bytes = dxt1;
+    putUint(bytes, 80, 0);
+    expectRejected(bytes, "DXT1 without the FourCC flag");
+    bytes = dxt1;
+    memcpy(&bytes[0], "DDS_", 4);
+    expectRejected(bytes, "bad magic");
+
+    // Bad DX10 headers
+    const unsigned int formats[] = { 0, 1, 100, 1000, 0xFFFFFFFF };
+    for (size_t i=0; i<sizeof(formats) / sizeof(formats[0]); i++){
+        bytes = cubes;
+        putUint(bytes, 128, formats[i]);
+        snprintf(what, sizeof(what), "DXGI format %u", formats[i]);
+        expectRejected(bytes, what);
+    }
+    const unsigned int dimensions[] = { 0, 1, 5, 0xFFFFFFFF };
+    for (size_t i=0; i<sizeof(dimensions) / sizeof(dimensions[0]); i++){
+        bytes = cubes;
+        putUint(bytes, 132, dimensions[i]);
+        snprintf(what, sizeof(what), "resource dimension %u", dimensions[i]);
+        expectRejected(bytes, what);
+    }
+    const unsigned int layers[] = { 0, 3, 2049, 0xFFFFFFFF };
+    for (size_t i=0; i<sizeof(layers) / sizeof(layers[0]); i++){
+        bytes = cubes;
+        putUint(bytes, 140, layers[i]);
+        snprintf(what, sizeof(what), "array size %u", layers[i]);
+        expectRejected(bytes, what);
+    }
+    bytes = cubes;
+    putUint(bytes, 16, 32);
+    expectRejected(bytes, "cubemap of 32x16");
+    bytes = cubes;
+    putUint(bytes, 132, 4);
+    expectRejected(bytes, "array of 3D textures");
+
+    // Huge dimensions : rejected by the limits, or for the data they would need
+    const unsigned int sizes[] = { 0, 16385, 0x10000, 0x40000000, 0x80000000, 0xFFFFFFFF };
+    for (size_t i=0; i<sizeof(sizes) / sizeof(sizes[0]); i++){
+        bytes = dxt1;
+        putUint(bytes, 16, sizes[i]);
+        snprintf(what, sizeof(what), "width %u", sizes[i]);
+        expectRejected(bytes, what);
+        bytes = dxt1;
+        putUint(bytes, 12, sizes[i]);
+        snprintf(what, sizeof(what), "height %u", sizes[i]);
+        expectRejected(bytes, what);
+    }
+    bytes = dx10Header(16384, 16384, 15, 2, 3, 0x4, 2048); // RGBA32F : 48 TB of cubemaps
+    expectRejected(bytes, "16384x16384 RGBA32F cubemap array of 2048");
+    bytes = dx10Header(16384, 16384, 1, 2, 4, 0, 1);
+    putUint(bytes, 24, 0xFFFFFFFF);
+    expectRejected(bytes, "volume of depth 0xFFFFFFFF");
+    bytes = dx10Header(16384, 16384, 1, 2, 4, 0, 1);
+    putUint(bytes, 24, 2048);
+    expectRejected(bytes, "16384x16384x2048 RGBA32F volume");
+
+    // Random mutations of the headers and their sizes : anything goes, as long as it stays in the file
+    srand(2);
+    unsigned int accepted = 0;
+    const unsigned int mutations = 20000;
+    for (unsigned int i=0; i<mutations; i++){
+        bytes = (i & 1) ? cubes : dxt1;
+        unsigned int changes = 1 + rand() % 4;
+        for (unsigned int c=0; c<changes; c++){
+            size_t offset = rand() % 37 * 4; // a field of the headers
+            unsigned int value = (rand() & 1) ? (unsigned int)rand() % 64 : ((unsigned int)rand() << 16) ^ (unsigned int)rand();
+            putUint(bytes, offset, value);
+        }
+        if (rand() % 4 == 0)
+            bytes.resize(rand() % (bytes.size() + 64));
+        snprintf(what, sizeof(what), "mutation %u", i);
+        accepted += parseGuarded(bytes, image, what) ? 1 : 0;
+    }
+    printf("  %u of %u mutated files accepted\n", accepted, mutations);
+}
+
+// deserializeCookedMesh on a guarded copy : whatever is accepted has its LODs in the index buffer, its indices in the vertex one
+static bool deserializeGuarded(const std::vector<unsigned char> & bytes, CookedMesh & mesh, const char * what){
+    GuardedCopy copy;
+    guardedCopy(bytes, copy);
+    bool ok = deserializeCookedMesh(copy.data, bytes.size(), mesh);
+    freeGuardedCopy(copy);
+    if (!ok)
+        return false;
+    for (size_t l=0; l<mesh.lods.size(); l++)
+        expect(mesh.lods[l].indexOffset + mesh.lods[l].indexCount <= mesh.lodIndices.size(), "%s : LOD %u out of the indices", what, (unsigned int)l);
+    for (size_t i=0; i<mesh.lodIndices.size(); i++)
+        expect(mesh.lodIndices[i] < mesh.vertices.size(), "%s : index %u out of the vertices", what, (unsigned int)i);
+    return true;
+}
+
+// Cooked meshes that are truncated or whose counts are corrupt, crafted so that the sizes they imply wrap around
+static void checkCookedMesh(){
+    CookedMesh mesh;
+    for (int v=0; v<4; v++){
+        mesh.vertices.push_back(vec3(v, v * v, 1));
+        mesh.uvs.push_back(vec2(v, 0));
+        mesh.normals.push_back(vec3(0, 0, 1));
+        mesh.tangents.push_back(vec3(1, 0, 0));
+        mesh.bitangents.push_back(vec3(0, 1, 0));
+    }
+    const unsigned short indices[9] = { 0, 1, 2, 0, 2, 3, 0, 1, 3 }; // odd : the LODs come after a padding index
+    mesh.lodIndices.assign(indices, indices + 9);
+    MeshLOD lod0 = { 0, 6, 0.0f }, lod1 = { 6, 3, 0.5f };
+    mesh.lods.push_back(lod0);
+    mesh.lods.push_back(lod1);
+    std::vector<unsigned char> cooked;
+    serializeCookedMesh(mesh, cooked);
+
+    CookedMesh read;
+    expect(deserializeGuarded(cooked, read, "cooked mesh") && read.vertices == mesh.vertices && read.lodIndices == mesh.lodIndices
+        && read.lods.size() == 2 && read.lods[1].indexOffset == 6 && read.lods[1].error == 0.5f, "cooked mesh : not read back");
+
+    char what[64];
+    for (size_t size=0; size<cooked.size(); size++){
+        snprintf(what, sizeof(what), "cooked mesh cut at %u", (unsigned int)size);
+        expect(!deserializeGuarded(std::vector<unsigned char>(cooked.begin(), cooked.begin() + size), read, what), "%s : accepted", what);
+    }
+
+    // Header fields : 8 vertex count, 12 index count, 16 LOD count. 0x55555556 LODs are 2 values once multiplied by 3 in 32 bits.
+    struct Corruption {
+        size_t offset;
+        unsigned int value;
+    };
+    const Corruption corruptions[] = {
+        { 0, 0 }, { 4, COOKED_MESH_VERSION + 1 },
+        { 8, 5 }, { 8, 0x15555556 }, { 8, 0x40000000 }, { 8, 0xFFFFFFFF },
+        { 12, 12 }, { 12, 0x80000001 }, { 12, 0xFFFFFFFF },
+        { 16, 0 }, { 16, 3 }, { 16, 0x55555556 }, { 16, 0xAAAAAAAB }, { 16, 0xFFFFFFFF },
+        { cooked.size() - 24, 7 },     // LOD 0 offset past the indices
+        { cooked.size() - 20, 10 },    // LOD 0 count past the indices
+        { 20 + 4 * 56, 4 },            // an index past the vertices
+    };
+    for (size_t c=0; c<sizeof(corruptions) / sizeof(corruptions[0]); c++){
+        std::vector<unsigned char> bytes = cooked;
+        if (corruptions[c].offset == 20 + 4 * 56)
+            bytes[corruptions[c].offset] = (unsigned char)corruptions[c].value; // a 16 bits index
+        else
+            putUint(bytes, corruptions[c].offset, corruptions[c].value);
+        snprintf(what, sizeof(what), "0x%08X at %u", corruptions[c].value, (unsigned int)corruptions[c].offset);
+        expect(!deserializeGuarded(bytes, read, what), "cooked mesh with %s : accepted", what);
+    }
+}
+
+// One block and its 4x4 RGBA pixels, row by row, worked out by hand from the format specifications :
+// RGB565 expanded by bit replication, interpolations rounded down.
+struct BCVector {
+    const char * name;
+    BCFormat format;
+    unsigned char block[16];
+    unsigned char pixels[64];
+};
+
+static const BCVector BC_VECTORS[] = {
+    // c0 > c1 : 4 colors. Red, blue, 2/3 red + 1/3 blue, 1/3 red + 2/3 blue, on every row
+    { "BC1 4 colors", BC_FORMAT_BC1, { 0x00, 0xF8, 0x1F, 0x00, 0xE4, 0xE4, 0xE4, 0xE4 },
+        { 255,0,0,255,   0,0,255,255,   170,0,85,255,  85,0,170,255,
+          255,0,0,255,   0,0,255,255,   170,0,85,255,  85,0,170,255,
+          255,0,0,255,   0,0,255,255,   170,0,85,255,  85,0,170,255,
+          255,0,0,255,   0,0,255,255,   170,0,85,255,  85,0,170,255 } },
+    // c0 <= c1 : blue, red, their average, transparent black. Rows of indices 0123, 3210, 0000, 3333
+    { "BC1 3 colors", BC_FORMAT_BC1, { 0x1F, 0x00, 0x00, 0xF8, 0xE4, 0x1B, 0x00, 0xFF },
+        { 0,0,255,255,   255,0,0,255,   127,0,127,255, 0,0,0,0,
+          0,0,0,0,       127,0,127,255, 255,0,0,255,   0,0,255,255,
+          0,0,255,255,   0,0,255,255,   0,0,255,255,   0,0,255,255,
+          0,0,0,0,       0,0,0,0,       0,0,0,0,       0,0,0,0 } },
+    // Green 63 and 32 : 255 and 130 once the top bits are replicated
+    { "BC1 bit replication", BC_FORMAT_BC1, { 0xE0, 0x07, 0x00, 0x04, 0x1B, 0x1B, 0x1B, 0x1B },
+        { 0,171,0,255,   0,213,0,255,   0,130,0,255,   0,255,0,255,
+          0,171,0,255,   0,213,0,255,   0,130,0,255,   0,255,0,255,
+          0,171,0,255,   0,213,0,255,   0,130,0,255,   0,255,0,255,
+          0,171,0,255,   0,213,0,255,   0,130,0,255,   0,255,0,255 } },
+    // Alpha i * 17 at pixel i. The color block has c0 <= c1, which is still 4 colors in BC2.
+    { "BC2", BC_FORMAT_BC2, { 0x10, 0x32, 0x54, 0x76, 0x98, 0xBA, 0xDC, 0xFE, 0x1F, 0x00, 0x00, 0xF8, 0xE4, 0xE4, 0xE4, 0xE4 },
+        { 0,0,255,0,     255,0,0,17,    85,0,170,34,   170,0,85,51,
+          0,0,255,68,    255,0,0,85,    85,0,170,102,  170,0,85,119,
+          0,0,255,136,   255,0,0,153,   85,0,170,170,  170,0,85,187,
+          0,0,255,204,   255,0,0,221,   85,0,170,238,  170,0,85,255 } },
+    // Alpha 200 > 100 : 6 interpolated values. Index i & 7 at pixel i.
+    { "BC3", BC_FORMAT_BC3, { 0xC8, 0x64, 0x88, 0xC6, 0xFA, 0x88, 0xC6, 0xFA, 0xE0, 0x07, 0x00, 0x04, 0x1B, 0x1B, 0x1B, 0x1B },
+        { 0,171,0,200,   0,213,0,100,   0,130,0,185,   0,255,0,171,
+          0,171,0,157,   0,213,0,142,   0,130,0,128,   0,255,0,114,
+          0,171,0,200,   0,213,0,100,   0,130,0,185,   0,255,0,171,
+          0,171,0,157,   0,213,0,142,   0,130,0,128,   0,255,0,114 } },
+    // 40 <= 240 : 4 interpolated values, then 0 and 255
+    { "BC4 6 values", BC_FORMAT_BC4, { 0x28, 0xF0, 0x88, 0xC6, 0xFA, 0x88, 0xC6, 0xFA },
+        { 40,0,0,255,    240,0,0,255,   80,0,0,255,    120,0,0,255,
+          160,0,0,255,   200,0,0,255,   0,0,0,255,     255,0,0,255,
+          40,0,0,255,    240,0,0,255,   80,0,0,255,    120,0,0,255,
+          160,0,0,255,   200,0,0,255,   0,0,0,255,     255,0,0,255 } },
+    // Equal endpoints are the 6 values mode too
+    { "BC4 equal endpoints", BC_FORMAT_BC4, { 0x4D, 0x4D, 0x88, 0xC6, 0xFA, 0x88, 0xC6, 0xFA },
+        { 77,0,0,255,    77,0,0,255,    77,0,0,255,    77,0,0,255,
+          77,0,0,255,    77,0,0,255,    0,0,0,255,     255,0,0,255,
+          77,0,0,255,    77,0,0,255,    77,0,0,255,    77,0,0,255,
+          77,0,0,255,    77,0,0,255,    0,0,0,255,     255,0,0,255 } },
+    // Red in the 8 values mode, green in the 6 values one
+    { "BC5", BC_FORMAT_BC5, { 0xC8, 0x64, 0x88, 0xC6, 0xFA, 0x88, 0xC6, 0xFA, 0x28, 0xF0, 0x88, 0xC6, 0xFA, 0x88, 0xC6, 0xFA },
+        { 200,40,0,255,  100,240,0,255, 185,80,0,255,  171,120,0,255,
+          157,160,0,255, 142,200,0,255, 128,0,0,255,   114,255,0,255,
+          200,40,0,255,  100,240,0,255, 185,80,0,255,  171,120,0,255,
+          157,160,0,255, 142,200,0,255, 128,0,0,255,   114,255,0,255 } },
+};
+
+static void expectPixels(const unsigned char * pixels, const unsigned char * expected, const char * decoder, const char * name){
+    for (unsigned int i=0; i<16; i++){
+        const unsigned char * p = pixels + i * 4;
+        const unsigned char * e = expected + i * 4;
+        expect(memcmp(p, e, 4) == 0, "%s, %s : pixel (%u %u) is %u %u %u %u instead of %u %u %u %u", name, decoder,
+            i % 4, i / 4, p[0], p[1], p[2], p[3], e[0], e[1], e[2], e[3]);
+    }
+}
+
+// The BC1-5 decoders against known answers, then the SIMD one against the reference one on random blocks
+static void checkBCDecode(){
+    unsigned char pixels[64];
+    for (size_t v=0; v<sizeof(BC_VECTORS) / sizeof(BC_VECTORS[0]); v++){
+        const BCVector & vector = BC_VECTORS[v];
+        decodeBCBlockReference(vector.format, vector.block, pixels, 16);
+        expectPixels(pixels, vector.pixels, "reference", vector.name);
+        decodeBCBlock(vector.format, vector.block, pixels, 16);
+        expectPixels(pixels, vector.pixels, "SIMD", vector.name);
+    }
+
+    srand(3);
+    unsigned char block[16], reference[64];
+    const unsigned int blocks = 100000;
+    for (unsigned int b=0; b<blocks; b++){
+        BCFormat format = (BCFormat)(b % 5);
+        for (unsigned int i=0; i<16; i++)
+            block[i] = (unsigned char)rand();
+        // Equal endpoints are rare at random : every pair of endpoints of every format, bytes 0-3 and 8-11
+        if (b % 7 == 0){
+            block[1] = block[2] = block[3] = block[0];
+            block[9] = block[10] = block[11] = block[8];
+        }
+        decodeBCBlockReference(format, block, reference, 16);
+        decodeBCBlock(format, block, pixels, 16);
+        expect(memcmp(reference, pixels, 64) == 0, "random block %u, BC%u : SIMD and reference differ", b, (unsigned int)format + 1);
+    }
+    printf("  %u known answers, %u random blocks\n", (unsigned int)(sizeof(BC_VECTORS) / sizeof(BC_VECTORS[0])), blocks);
+}
+
+static bool aligned(const void * p, size_t alignment){
+    return ((size_t)p & (alignment - 1)) == 0;
+}
+
+// Fills an allocation with its own byte, to find the ones that overlap once they are all made
+struct Filled {
+    unsigned char * data;
+    size_t size;
+    unsigned char value;
+};
+
+static void fill(std::vector<Filled> & filled, void * p, size_t size){
+    Filled f = { (unsigned char *)p, size, (unsigned char)(filled.size() * 37 + 1) };
+    memset(f.data, f.value, size);
+    filled.push_back(f);
+}
+
+static void expectFilled(const std::vector<Filled> & filled, const char * what){
+    for (size_t i=0; i<filled.size(); i++){
+        size_t k = 0;
+        while (k < filled[i].size && filled[i].data[k] == filled[i].value)
+            k++;
+        expect(k == filled[i].size, "%s : allocation %u overwritten at byte %u", what, (unsigned int)i, (unsigned int)k);
+    }
+}
+
+static void checkArena(){
+    Arena arena;
+    initArena(arena, "test arena", 1024);
+    std::vector<Filled> filled;
+    fill(filled, arenaAllocate(arena, 100, 1), 100);
+    void * p = arenaAllocate(arena, 8, 16);
+    fill(filled, p, 8);
+    expect(aligned(p, 16), "arena : 16 bytes alignment ignored");
+    expect(arena.stats.used == 120 && arena.stats.highWater == 120, "arena : %u bytes used after 100 + 8 aligned to 16",
+        (unsigned int)arena.stats.used);
+
+    // Rewinding gives the same memory back
+    ArenaMarker marker = arenaMark(arena);
+    void * first = arenaAllocate(arena, 200, 8);
+    arenaRewind(arena, marker);
+    expect(arena.stats.used == 120, "arena : rewind to %u bytes instead of 120", (unsigned int)arena.stats.used);
+    expect(arenaAllocate(arena, 200, 8) == first, "arena : rewind doesn't reuse the memory");
+    fill(filled, first, 200);
+
+    // Out of the chunk : a new one, the old allocations stay where they are
+    for (unsigned int i=0; i<20; i++){
+        size_t size = 50 + i * 40;
+        fill(filled, arenaAllocate(arena, size, 8), size);
+    }
+    expectFilled(filled, "arena");
+    size_t highWater = arena.stats.highWater;
+    expect(arena.chunks.size() > 1 && arena.stats.overflows == arena.chunks.size() - 1, "arena : %u chunks, %u overflows",
+        (unsigned int)arena.chunks.size(), arena.stats.overflows);
+    expect(highWater == arena.stats.used && highWater > 1024, "arena : high water %u, used %u",
+        (unsigned int)highWater, (unsigned int)arena.stats.used);
+
+    // The reset merges the chunks into one that holds the high water mark : the same allocations then fit
+    resetArena(arena);
+    expect(arena.chunks.size() == 1 && arena.stats.capacity >= highWater && arena.stats.used == 0,
+        "arena : reset to %u chunks of %u bytes", (unsigned int)arena.chunks.size(), (unsigned int)arena.stats.capacity);
+    unsigned int overflows = arena.stats.overflows;
+    arenaAllocate(arena, 100, 1);
+    arenaAllocate(arena, 8, 16);
+    arenaAllocate(arena, 200, 8);
+    for (unsigned int i=0; i<20; i++)
+        arenaAllocate(arena, 50 + i * 40, 8);
+    expect(arena.stats.overflows == overflows && arena.chunks.size() == 1, "arena : a new chunk after the reset");
+
+    // STL adaptor, rewound by a scope on the way out
+    resetArena(arena);
+    {
+        ArenaScope scope(&arena);
+        std::vector<int, ArenaAllocator<int> > values((ArenaAllocator<int>(&arena)));
+        for (int i=0; i<1000; i++)
+            values.push_back(i * 3);
+        bool same = true;
+        for (int i=0; i<1000; i++)
+            same = same && values[i] == i * 3;
+        expect(same, "arena vector : wrong values");
+        expect(arena.stats.used >= 1000 * sizeof(int), "arena vector : only %u bytes used", (unsigned int)arena.stats.used);
+    }
+    expect(arena.stats.used == 0, "arena scope : %u bytes left after the scope", (unsigned int)arena.stats.used);
+    std::vector<int, ArenaAllocator<int> > heap;
+    heap.assign(100, 7);
+    expect(heap.size() == 100 && heap[99] == 7 && arena.stats.used == 0, "arena vector without an arena : not on the heap");
+    cleanupArena(arena);
+}
+
+static void checkFrameAllocator(){
+    FrameAllocator frame;
+    initFrameAllocator(frame, "test frame", 1024);
+    std::vector<Filled> filled;
+    const size_t alignments[] = { 1, 4, 16, 64 };
+    for (unsigned int i=0; i<8; i++){
+        size_t alignment = alignments[i % 4];
+        void * p = frameAllocate(frame, 40 + i, alignment);
+        expect(aligned(p, alignment), "frame : %u bytes alignment ignored", (unsigned int)alignment);
+        expect((unsigned char *)p >= frame.buffer && (unsigned char *)p + 40 + i <= frame.buffer + frame.capacity,
+            "frame : allocation %u outside of the buffer", i);
+        fill(filled, p, 40 + i);
+    }
+
+    // Full : the heap takes over until the reset, which grows the buffer
+    void * big = frameAllocate(frame, 4000, 16);
+    expect(aligned(big, 16) && frame.overflow.size() == 1, "frame : overflow not from the heap");
+    fill(filled, big, 4000);
+    expectFilled(filled, "frame");
+    resetFrameAllocator(frame);
+    expect(frame.stats.overflows == 1 && frame.stats.highWater >= 4000 && frame.capacity >= frame.stats.highWater,
+        "frame : reset to %u bytes after a %u bytes frame", (unsigned int)frame.capacity, (unsigned int)frame.stats.highWater);
+    expect(frame.offset == 0 && frame.overflow.empty(), "frame : not reset");
+
+    // The same frame fits now, and from several threads at once
+    filled.clear();
+    std::vector<std::vector<Filled> > threads(4);
+    parallelFor(4, 4, [&](unsigned int begin, unsigned int end){
+        for (unsigned int t=begin; t<end; t++){
+            for (unsigned int i=0; i<25; i++){
+                Filled f = { (unsigned char *)frameAllocate(frame, 40, 8), 40, (unsigned char)(t * 25 + i + 1) };
+                memset(f.data, f.value, f.size);
+                threads[t].push_back(f);
+            }
+        }
+    });
+    for (size_t t=0; t<threads.size(); t++)
+        filled.insert(filled.end(), threads[t].begin(), threads[t].end());
+    expectFilled(filled, "threaded frame");
+    std::set<unsigned char *> distinct;
+    for (size_t i=0; i<filled.size(); i++)
+        distinct.insert(filled[i].data);
+    expect(distinct.size() == 100 && frame.overflow.empty(), "frame : %u distinct allocations out of 100, %u overflows",
+        (unsigned int)distinct.size(), (unsigned int)frame.overflow.size());
+
+    std::vector<float, FrameAllocatorAdaptor<float> > values((FrameAllocatorAdaptor<float>(&frame)));
+    values.assign(64, 0.5f);
+    expect((unsigned char *)&values[0] >= frame.buffer && (unsigned char *)&values[0] < frame.buffer + frame.capacity,
+        "frame vector : not in the frame buffer");
+    resetFrameAllocator(frame);
+    expect(frame.stats.overflows == 1, "frame : %u overflows", frame.stats.overflows);
+    cleanupFrameAllocator(frame);
+}
+
+static void checkPools(){
+    Pool pool;
+    initPool(pool, "test pool", 24, 8);
+    std::vector<void *> nodes;
+    for (unsigned int i=0; i<20; i++)
+        nodes.push_back(poolAllocate(pool));
+    std::set<void *> distinct(nodes.begin(), nodes.end());
+    expect(distinct.size() == 20 && pool.blocks.size() == 3, "pool : %u distinct nodes in %u blocks",
+        (unsigned int)distinct.size(), (unsigned int)pool.blocks.size());
+    expect(pool.stats.used == 20 * 24 && pool.stats.highWater == 20 * 24, "pool : %u bytes used", (unsigned int)pool.stats.used);
+
+    // Freed nodes are reused before any new block
+    std::set<void *> freed;
+    for (unsigned int i=0; i<20; i+=2){
+        poolFree(pool, nodes[i]);
+        freed.insert(nodes[i]);
+    }
+    expect(pool.stats.used == 10 * 24, "pool : %u bytes used after freeing half", (unsigned int)pool.stats.used);
+    unsigned int reused = 0;
+    for (unsigned int i=0; i<10; i++)
+        reused += freed.count(poolAllocate(pool)) ? 1 : 0;
+    expect(reused == 10 && pool.blocks.size() == 3 && pool.stats.highWater == 20 * 24, "pool : %u of 10 freed nodes reused, %u blocks",
+        reused, (unsigned int)pool.blocks.size());
+    cleanupPool(pool);
+
+    // std::map nodes from the pools, the same blocks again once erased
+    NodePools pools;
+    initNodePools(pools, "test nodes", 64);
+    {
+        typedef std::map<int, int, std::less<int>, PoolAllocator<std::pair<const int, int> > > PooledMap;
+        PooledMap map((std::less<int>()), PoolAllocator<std::pair<const int, int> >(&pools));
+        for (int i=0; i<1000; i++)
+            map[i] = i * i;
+        size_t used = 0, capacity = 0;
+        for (int c=0; c<NODE_POOL_CLASSES; c++){
+            used += pools.pools[c].stats.used;
+            capacity += pools.pools[c].stats.capacity;
+        }
+        expect(used > 0 && used % 1000 == 0, "pooled map : %u bytes for 1000 nodes", (unsigned int)used);
+        for (int i=0; i<1000; i+=2)
+            map.erase(i);
+        for (int i=0; i<1000; i+=2)
+            map[i] = i * i;
+        bool same = map.size() == 1000;
+        for (PooledMap::iterator it = map.begin(); it != map.end(); ++it)
+            same = same && it->second == it->first * it->first;
+        expect(same, "pooled map : wrong values");
+        size_t after = 0;
+        for (int c=0; c<NODE_POOL_CLASSES; c++)
+            after += pools.pools[c].stats.capacity;
+        expect(after == capacity, "pooled map : %u bytes of blocks after erasing and inserting, %u before",
+            (unsigned int)after, (unsigned int)capacity);
+    }
+    size_t used = 0;
+    for (int c=0; c<NODE_POOL_CLASSES; c++)
+        used += pools.pools[c].stats.used;
+    expect(used == 0, "pooled map : %u bytes left once destroyed", (unsigned int)used);
+    cleanupNodePools(pools);
+}
+
+static vec3 randomDirection(){
+    vec3 v;
+    do
+        v = vec3(randomFloat(-1, 1), randomFloat(-1, 1), randomFloat(-1, 1));
+    while (dot(v, v) > 1.0f || dot(v, v) < 1e-4f);
+    return normalize(v);
+}
+
+// QTangents against the float frames they come from : random frames, both handednesses, the 48 axis aligned frames
+// (180 degree rotations and reflections), and triangles whose UVs are mirrored or degenerate.
+static void checkQTangents(){
+    const float maxDegrees = 0.01f;
+    std::vector<vec3> normals, tangents, bitangents;
+
+    srand(4);
+    const unsigned int frames = 200000;
+    for (unsigned int i=0; i<frames; i++){
+        vec3 n = randomDirection() * randomFloat(0.1f, 10.0f);
+        vec3 t = randomDirection() * randomFloat(0.1f, 10.0f);
+        if (i % 10 == 1)
+            t = n * 2.0f + randomDirection() * 1e-3f; // almost along the normal
+        else if (i % 10 == 2)
+            t = vec3(0.0f);
+        vec3 b = cross(n, t) * randomFloat(0.1f, 10.0f) + randomDirection() * 0.1f;
+        if (i & 1)
+            b = -b;
+        normals.push_back(n);
+        tangents.push_back(t);
+        bitangents.push_back(b);
+    }
+
+    const vec3 axes[6] = { vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1) };
+    unsigned int axisFrames = 0;
+    for (int a=0; a<6; a++){
+        for (int c=0; c<6; c++){
+            if (dot(axes[a], axes[c]) != 0.0f)
+                continue;
+            normals.push_back(axes[a]);
+            tangents.push_back(axes[c]);
+            bitangents.push_back(cross(axes[a], axes[c]));
+            normals.push_back(axes[a]);
+            tangents.push_back(axes[c]);
+            bitangents.push_back(-cross(axes[a], axes[c]));
+            axisFrames += 2;
+        }
+    }
+
+    // Triangles through computeTangentBasis : plain, mirrored in u, all UVs equal, UVs on a line
+    std::vector<vec3> vertices, triangleNormals, triangleTangents, triangleBitangents;
+    std::vector<vec2> uvs;
+    const unsigned int triangles = 4000;
+    for (unsigned int i=0; i<triangles; i++){
+        vec3 p0 = randomDirection(), p1 = randomDirection(), p2 = randomDirection();
+        vec3 n = cross(p1 - p0, p2 - p0);
+        if (dot(n, n) < 1e-6f)
+            n = randomDirection();
+        vec2 uv0(randomFloat(0, 1), randomFloat(0, 1)), uv1(randomFloat(0, 1), randomFloat(0, 1)), uv2(randomFloat(0, 1), randomFloat(0, 1));
+        if (i % 4 == 1){
+            uv0.x = -uv0.x;
+            uv1.x = -uv1.x;
+            uv2.x = -uv2.x;
+        }
+        else if (i % 4 == 2)
+            uv1 = uv2 = uv0;
+        else if (i % 4 == 3)
+            uv2 = uv0 + (uv1 - uv0) * 0.5f;
+        vertices.push_back(p0);
+        vertices.push_back(p1);
+        vertices.push_back(p2);
+        uvs.push_back(uv0);
+        uvs.push_back(uv1);
+        uvs.push_back(uv2);
+        for (int k=0; k<3; k++)
+            triangleNormals.push_back(normalize(n));
+    }
+    computeTangentBasis(vertices, uvs, triangleNormals, triangleTangents, triangleBitangents);
+    normals.insert(normals.end(), triangleNormals.begin(), triangleNormals.end());
+    tangents.insert(tangents.end(), triangleTangents.begin(), triangleTangents.end());
+    bitangents.insert(bitangents.end(), triangleBitangents.begin(), triangleBitangents.end());
+
+    std::vector<glm::i16vec4> packed;
+    packQTangents(normals, tangents, bitangents, packed);
+    expect(packed.size() == normals.size(), "%u qtangents for %u frames", (unsigned int)packed.size(), (unsigned int)normals.size());
+
+    // Each group on its own, so that a failure says which one
+    struct Group {
+        const char * name;
+        size_t begin, end;
+    };
+    const Group groups[] = {
+        { "random frames", 0, frames },
+        { "axis aligned frames", frames, frames + axisFrames },
+        { "triangles", frames + axisFrames, normals.size() },
+    };
+    for (size_t g=0; g<sizeof(groups) / sizeof(groups[0]); g++){
+        const Group & group = groups[g];
+        float error = qtangentError(
+            std::vector<vec3>(normals.begin() + group.begin, normals.begin() + group.end),
+            std::vector<vec3>(tangents.begin() + group.begin, tangents.begin() + group.end),
+            std::vector<vec3>(bitangents.begin() + group.begin, bitangents.begin() + group.end),
+            std::vector<glm::i16vec4>(packed.begin() + group.begin, packed.begin() + group.end));
+        printf("  %s : %u frames, %.4f degrees at most\n", group.name, (unsigned int)(group.end - group.begin), error);
+        expect(error <= maxDegrees, "%s : %.4f degrees, more than %.4f", group.name, error, maxDegrees);
+    }
+
+    // The handedness of every frame with a usable tangent survives, and nothing decodes to NaN
+    unsigned int flipped = 0, invalid = 0;
+    for (size_t i=0; i<packed.size(); i++){
+        vec3 n, t, b;
+        unpackQTangent(packed[i], n, t, b);
+        if (!(fabsf(length(n) - 1.0f) < 1e-3f && fabsf(length(t) - 1.0f) < 1e-3f && fabsf(length(b) - 1.0f) < 1e-3f))
+            invalid++;
+        // Only where the input says clearly : a bitangent almost in the plane of the normal and the tangent has no handedness
+        vec3 inputNormal = normalize(normals[i]);
+        vec3 inputTangent = tangents[i] - inputNormal * dot(inputNormal, tangents[i]);
+        float inputSign = dot(cross(inputNormal, inputTangent), bitangents[i]);
+        if (fabsf(inputSign) > 1e-3f * length(inputTangent) * length(bitangents[i]) && (inputSign < 0.0f) != (dot(cross(n, t), b) < 0.0f))
+            flipped++;
+    }
+    expect(invalid == 0, "%u frames decode to non unit vectors", invalid);
+    expect(flipped == 0, "%u frames lost their handedness", flipped);
+}
+
+static void randomTransform(vec3 & position, quat & rotation, vec3 & scale){
+    position = randomDirection() * randomFloat(0.0f, 2.0f);
+    rotation = angleAxis(randomFloat(-3.14159f, 3.14159f), randomDirection());
+    scale = vec3(randomFloat(0.8f, 1.25f), randomFloat(0.8f, 1.25f), randomFloat(0.8f, 1.25f));
+}
+
+// World matrices of graph that differ from the reference ones, relative to their size
+static unsigned int worldMismatches(const SceneGraph & graph, const SceneGraph & reference){
+    unsigned int mismatches = 0;
+    for (size_t n=0; n<graph.worlds.size(); n++){
+        bool same = true;
+        for (int c=0; c<4; c++)
+            for (int r=0; r<4; r++)
+                same = same && fabsf(graph.worlds[n][c][r] - reference.worlds[n][c][r]) <= 1e-4f * (1.0f + fabsf(reference.worlds[n][c][r]));
+        if (!same)
+            mismatches++;
+    }
+    return mismatches;
+}
+
+// Changes a node of both graphs the same way : all of its transform, or its position or rotation only
+static void moveSceneNode(SceneGraph & graph, SceneGraph & reference, unsigned int node){
+    vec3 position, scale;
+    quat rotation;
+    randomTransform(position, rotation, scale);
+    switch (rand() % 3){
+    case 0:
+        setSceneNodeTransform(graph, node, position, rotation, scale);
+        setSceneNodeTransform(reference, node, position, rotation, scale);
+        break;
+    case 1:
+        setSceneNodePosition(graph, node, position);
+        setSceneNodePosition(reference, node, position);
+        break;
+    default:
+        setSceneNodeRotation(graph, node, rotation);
+        setSceneNodeRotation(reference, node, rotation);
+        break;
+    }
+}
+
+// updateSceneGraph against updateSceneGraphNaive, on a few wide and deep trees : the first update, a few moved nodes,
+// and enough moved subtrees for the threads, whose big subtrees are split into the ones of their children.
+static void checkSceneGraph(){
+    const unsigned int count = 60000; // above the node count that goes to the threads
+    SceneGraph graph, reference;
+    initSceneGraph(graph, count);
+    initSceneGraph(reference, count);
+
+    srand(5);
+    std::vector<int> path; // the last node added and its ancestors : the parents addSceneNode accepts
+    std::vector<unsigned int> roots;
+    for (unsigned int i=0; i<count; i++){
+        while (path.size() > 1 && (path.size() >= 12 || rand() % 2 == 0))
+            path.pop_back();
+        if (path.size() == 1 && rand() % 500 == 0)
+            path.clear();
+        int parent = path.empty() ? -1 : path.back();
+        vec3 position, scale;
+        quat rotation;
+        randomTransform(position, rotation, scale);
+        int node = addSceneNode(graph, parent, position, rotation, scale);
+        addSceneNode(reference, parent, position, rotation, scale);
+        if (parent < 0)
+            roots.push_back((unsigned int)node);
+        path.push_back(node);
+    }
+    printf("  %u nodes under %u roots\n", count, (unsigned int)roots.size());
+
+    struct Update {
+        const char * name;
+        unsigned int moved;     // random nodes
+        bool movedRoots;        // all roots but the last : most of the graph
+        unsigned int threadCount;
+    };
+    const Update updates[] = {
+        { "first update", 0, false, 4 },
+        { "a few nodes", 50, false, 1 },
+        { "a few nodes, 4 threads", 50, false, 4 },
+        { "most subtrees, 3 threads", 500, true, 3 },
+        { "most subtrees, 8 threads", 500, true, 8 },
+    };
+    for (size_t u=0; u<sizeof(updates) / sizeof(updates[0]); u++){
+        const Update & update = updates[u];
+        for (unsigned int i=0; i<update.moved; i++)
+            moveSceneNode(graph, reference, rand() % count);
+        for (size_t r=0; update.movedRoots && r + 1<roots.size(); r++)
+            moveSceneNode(graph, reference, roots[r]);
+
+        SceneGraphStats before = graph.stats;
+        updateSceneGraph(graph, update.threadCount);
+        updateSceneGraphNaive(reference);
+        unsigned int recomputed = graph.stats.recomputed - before.recomputed;
+        unsigned int tasks = graph.stats.tasks - before.tasks;
+        printf("  %s : %u world matrices in %u tasks\n", update.name, recomputed, tasks);
+
+        unsigned int mismatches = worldMismatches(graph, reference);
+        expect(mismatches == 0, "%s : %u world matrices differ from the naive update", update.name, mismatches);
+        expect(graph.dirtyNodes.empty() && std::count(graph.dirty.begin(), graph.dirty.end(), 1) == 0, "%s : nodes left dirty", update.name);
+        if (u == 0)
+            expect(recomputed == count, "%s : %u world matrices recomputed, not %u", update.name, recomputed, count);
+        else
+            expect(recomputed <= count, "%s : %u world matrices recomputed, more than the %u nodes", update.name, recomputed, count);
+        if (update.movedRoots)
+            expect(recomputed >= count / 2 && tasks > update.threadCount, "%s : %u world matrices in %u tasks, the threaded split didn't run",
+                update.name, recomputed, tasks);
+    }
+}
+
+struct Check {
+    const char * name;
+    void (*run)();
+};
+
+static const Check checks[] = {
+    { "binLights", checkBinLights },
+    { "parseDDS", checkParseDDS },
+    { "cookedMesh", checkCookedMesh },
+    { "BCDecode", checkBCDecode },
+    { "arena", checkArena },
+    { "frameAllocator", checkFrameAllocator },
+    { "pools", checkPools },
+    { "qtangents", checkQTangents },
+    { "sceneGraph", checkSceneGraph },
+};
+
+int main(int argc, char * argv[]){
+    unsigned int failed = 0, run = 0;
+    for (size_t c=0; c<sizeof(checks)/sizeof(checks[0]); c++){
+        bool selected = argc < 2;
+        for (int i=1; i<argc; i++)
+            selected = selected || strcmp(argv[i], checks[c].name) == 0;
+        if (!selected)
+            continue;
+        printf("%s\n", checks[c].name);
+        failures = 0;
+        checks[c].run();
+        printf("%s : %s", checks[c].name, failures ? "FAILED" : "ok");
+        if (failures)
+            printf(" (%u failures)", failures);
+        printf("\n");
+        failed += failures ? 1 : 0;
+        run++;
+    }
+    if (run == 0){
+        printf("No check named so. Checks :");
+        for (size_t c=0; c<sizeof(checks)/sizeof(checks[0]); c++)
+            printf(" %s", checks[c].name);
+        printf("\n");
+        return -1;
+    }
+    return (int)failed;
+}